@@ -233,6 +233,7 @@ class Descriptor(PluginVariant):
                            table_stride_2: float = 0.1,
                            check_frequency: int = -1,
                            suffix: str = "",
+                           fuse_env_mat: bool = False,
                            ) -> None:
         """
         Reveive the statisitcs (distance, max_nbor_size and env_mat_range) of the
@@ -254,6 +255,8 @@ class Descriptor(PluginVariant):
                 The overflow check frequency
         suffix : str, optional
                 The suffix of the scope
+        fuse_env_mat : bool, default: False
+                Evaluate the tabulated embedding in the op of the environment matrix
 
         Notes
         -----
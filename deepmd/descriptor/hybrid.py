@@ -238,7 +238,8 @@ class DescrptHybrid (Descriptor):
                            table_stride_1: float = 0.01,
                            table_stride_2: float = 0.1,
                            check_frequency: int = -1,
-                           suffix: str = ""
+                           suffix: str = "",
+                           fuse_env_mat: bool = False,
                            ) -> None:
         """
         Reveive the statisitcs (distance, max_nbor_size and env_mat_range) of the
@@ -260,9 +261,11 @@ class DescrptHybrid (Descriptor):
                 The overflow check frequency
         suffix : str, optional
                 The suffix of the scope
+        fuse_env_mat : bool, default: False
+                Evaluate the tabulated embedding in the op of the environment matrix
         """
         for idx, ii in enumerate(self.descrpt_list):
-            ii.enable_compression(min_nbor_dist, model_file, table_extrapolate, table_stride_1, table_stride_2, check_frequency, suffix=f"{suffix}_{idx}")
+            ii.enable_compression(min_nbor_dist, model_file, table_extrapolate, table_stride_1, table_stride_2, check_frequency, suffix=f"{suffix}_{idx}", fuse_env_mat=fuse_env_mat)
 
     def init_variables(self,
                        model_file : str,
@@ -159,6 +159,8 @@ class DescrptSeA (DescrptSe):
         self.dstd = None
         self.davg = None
         self.compress = False
+        self.fuse_env_mat = False
+        self.fused = False
         self.embedding_net_variables = None
         self.place_holders = {}
         nei_type = np.array([])
@@ -302,6 +304,7 @@ class DescrptSeA (DescrptSe):
                            table_stride_2 : float = 0.1,
                            check_frequency : int = -1,
                            suffix : str = "",
+                           fuse_env_mat : bool = False,
     ) -> None:
         """
         Reveive the statisitcs (distance, max_nbor_size and env_mat_range) of the training data.
@@ -322,6 +325,8 @@ class DescrptSeA (DescrptSe):
                 The overflow check frequency
         suffix : str, optional
                 The suffix of the scope
+        fuse_env_mat : bool, optional
+                Evaluate the tabulated embedding in the op of the environment matrix, only on CPU
         """
         assert (
             not self.filter_resnet_dt
@@ -335,6 +340,18 @@ class DescrptSeA (DescrptSe):
                                table_extrapolate, 
                                table_stride_1, 
                                table_stride_2)
+        self.fuse_env_mat = fuse_env_mat
+        if self.fuse_env_mat:
+            # the tables of all the nets in one tensor, the nets of the excluded pairs are zero
+            nets = []
+            for ii in range(self.ntypes if self.type_one_side else self.ntypes * self.ntypes):
+                if self.type_one_side:
+                    net = 'filter_-1_net_' + str(ii)
+                else:
+                    net = 'filter_' + str(ii // self.ntypes) + '_net_' + str(ii % self.ntypes)
+                nets.append(net)
+            table_shape = [data.shape for data in self.table.data.values()][0]
+            self.fused_table = np.stack([self.table.data[net] if net in self.table.data else np.zeros(table_shape) for net in nets])
         
         graph, _ = load_graph_def(model_file)
         self.davg = get_tensor_by_name_from_graph(graph, 'descrpt_attr%s/t_avg' % suffix)
@@ -416,19 +433,45 @@ class DescrptSeA (DescrptSe):
         box   = tf.reshape (box_, [-1, 9])
         atype = tf.reshape (atype_, [-1, natoms[1]])
 
-        self.descrpt, self.descrpt_deriv, self.rij, self.nlist \
-            = op_module.prod_env_mat_a (coord,
-                                       atype,
-                                       natoms,
-                                       box,
-                                       mesh,
-                                       self.t_avg,
-                                       self.t_std,
-                                       rcut_a = self.rcut_a,
-                                       rcut_r = self.rcut_r,
-                                       rcut_r_smth = self.rcut_r_smth,
-                                       sel_a = self.sel_a,
-                                       sel_r = self.sel_r)
+        self.atype = atype
+        self.fused = self.compress and self.fuse_env_mat \
+            and (input_dict is None or input_dict.get('type_embedding', None) is None) \
+            and self.filter_precision == GLOBAL_TF_FLOAT_PRECISION
+        if self.fused:
+            # the tabulated embedding is evaluated with the environment matrix
+            self.tab_table = tf.constant(self.fused_table, dtype = GLOBAL_TF_FLOAT_PRECISION)
+            self.tab_info = tf.constant([self.lower, self.upper, self.upper * self.table_config[0], self.table_config[1], self.table_config[2], self.table_config[3]], dtype = GLOBAL_TF_FLOAT_PRECISION)
+            self.descrpt, self.descrpt_deriv, self.rij, self.nlist, self.tab_descrpt \
+                = op_module.prod_env_mat_a_tabulate (coord,
+                                                     atype,
+                                                     natoms,
+                                                     box,
+                                                     mesh,
+                                                     self.t_avg,
+                                                     self.t_std,
+                                                     self.tab_table,
+                                                     self.tab_info,
+                                                     rcut_a = self.rcut_a,
+                                                     rcut_r = self.rcut_r,
+                                                     rcut_r_smth = self.rcut_r_smth,
+                                                     sel_a = self.sel_a,
+                                                     sel_r = self.sel_r,
+                                                     last_layer_size = self.filter_neuron[-1],
+                                                     type_one_side = self.type_one_side)
+        else:
+            self.descrpt, self.descrpt_deriv, self.rij, self.nlist \
+                = op_module.prod_env_mat_a (coord,
+                                           atype,
+                                           natoms,
+                                           box,
+                                           mesh,
+                                           self.t_avg,
+                                           self.t_std,
+                                           rcut_a = self.rcut_a,
+                                           rcut_r = self.rcut_r,
+                                           rcut_r_smth = self.rcut_r_smth,
+                                           sel_a = self.sel_a,
+                                           sel_r = self.sel_r)
         # only used when tensorboard was set as true
         tf.summary.histogram('descrpt', self.descrpt)
         tf.summary.histogram('rij', self.rij)
@@ -437,13 +480,19 @@ class DescrptSeA (DescrptSe):
         self.descrpt_reshape = tf.reshape(self.descrpt, [-1, self.ndescrpt])
         self._identity_tensors(suffix=suffix)
 
-        self.dout, self.qmat = self._pass_filter(self.descrpt_reshape, 
-                                                 atype,
-                                                 natoms, 
-                                                 input_dict,
-                                                 suffix = suffix, 
-                                                 reuse = reuse, 
-                                                 trainable = self.trainable)
+        if self.fused:
+            nframes = tf.shape(self.descrpt)[0]
+            layer, qmat = self._filter_output(self.tab_descrpt, self.ndescrpt)
+            self.dout = tf.reshape(layer, [nframes, natoms[0] * self.get_dim_out()])
+            self.qmat = tf.reshape(qmat, [nframes, natoms[0] * self.get_dim_rot_mat_1() * 3])
+        else:
+            self.dout, self.qmat = self._pass_filter(self.descrpt_reshape, 
+                                                     atype,
+                                                     natoms, 
+                                                     input_dict,
+                                                     suffix = suffix, 
+                                                     reuse = reuse, 
+                                                     trainable = self.trainable)
 
         # only used when tensorboard was set as true
         tf.summary.histogram('embedding_net_output', self.dout)
@@ -481,24 +530,43 @@ class DescrptSeA (DescrptSe):
         atom_virial
                 The atomic virial
         """
-        [net_deriv] = tf.gradients (atom_ener, self.descrpt_reshape)
+        if self.fused:
+            # the gradient of the tabulated embedding with respect to the environment matrix
+            [dy] = tf.gradients (atom_ener, self.tab_descrpt)
+            net_deriv = op_module.tabulate_fusion_se_a_grad (self.tab_table,
+                                                             self.tab_info,
+                                                             self.descrpt,
+                                                             self.nlist,
+                                                             self.atype,
+                                                             natoms,
+                                                             dy,
+                                                             sel_a = self.sel_a,
+                                                             type_one_side = self.type_one_side)
+        else:
+            [net_deriv] = tf.gradients (atom_ener, self.descrpt_reshape)
         tf.summary.histogram('net_derivative', net_deriv)
         net_deriv_reshape = tf.reshape (net_deriv, [-1, natoms[0] * self.ndescrpt])        
-        force \
-            = op_module.prod_force_se_a (net_deriv_reshape,
-                                          self.descrpt_deriv,
-                                          self.nlist,
-                                          natoms,
-                                          n_a_sel = self.nnei_a,
-                                          n_r_sel = self.nnei_r)
-        virial, atom_virial \
+        # force and virial come from one op so that their gradients are fused,
+        # the atomic virial is skipped and only computed when it is fetched
+        force, virial, _ \
+            = op_module.prod_force_virial_se_a (net_deriv_reshape,
+                                                 self.descrpt_deriv,
+                                                 self.rij,
+                                                 self.nlist,
+                                                 natoms,
+                                                 n_a_sel = self.nnei_a,
+                                                 n_r_sel = self.nnei_r,
+                                                 sel_a = self.sel_a,
+                                                 compute_atom_virial = False)
+        _, atom_virial \
             = op_module.prod_virial_se_a (net_deriv_reshape,
                                            self.descrpt_deriv,
                                            self.rij,
                                            self.nlist,
                                            natoms,
                                            n_a_sel = self.nnei_a,
-                                           n_r_sel = self.nnei_r)
+                                           n_r_sel = self.nnei_r,
+                                           sel_a = self.sel_a)
         tf.summary.histogram('force', force)
         tf.summary.histogram('virial', virial)
         tf.summary.histogram('atom_virial', atom_virial)
@@ -789,18 +857,28 @@ class DescrptSeA (DescrptSe):
           # inputs_reshape = tf.reshape(inputs, [-1, shape[1]//4, 4])
           # natom x 4 x outputs_size
           # xyz_scatter_1 = tf.matmul(inputs_reshape, xyz_scatter, transpose_a = True)
-          xyz_scatter_1 = xyz_scatter_1 * (4.0 / shape[1])
-          # natom x 4 x outputs_size_2
-          xyz_scatter_2 = tf.slice(xyz_scatter_1, [0,0,0],[-1,-1,outputs_size_2])
-          # # natom x 3 x outputs_size_2
-          # qmat = tf.slice(xyz_scatter_2, [0,1,0], [-1, 3, -1])
-          # natom x 3 x outputs_size_1
-          qmat = tf.slice(xyz_scatter_1, [0,1,0], [-1, 3, -1])
-          # natom x outputs_size_1 x 3
-          qmat = tf.transpose(qmat, perm = [0, 2, 1])
-          # natom x outputs_size x outputs_size_2
-          result = tf.matmul(xyz_scatter_1, xyz_scatter_2, transpose_a = True)
-          # natom x (outputs_size x outputs_size_2)
-          result = tf.reshape(result, [-1, outputs_size_2 * outputs_size[-1]])
+          result, qmat = self._filter_output(xyz_scatter_1, shape[1])
+
+        return result, qmat
 
+
+    def _filter_output(self, xyz_scatter_1, ndescrpt):
+        """
+        input R.G of natom x 4 x outputs_size, returns the descriptor and the rotation matrix
+        """
+        outputs_size = [1] + self.filter_neuron
+        outputs_size_2 = self.n_axis_neuron
+        xyz_scatter_1 = xyz_scatter_1 * (4.0 / ndescrpt)
+        # natom x 4 x outputs_size_2
+        xyz_scatter_2 = tf.slice(xyz_scatter_1, [0,0,0],[-1,-1,outputs_size_2])
+        # # natom x 3 x outputs_size_2
+        # qmat = tf.slice(xyz_scatter_2, [0,1,0], [-1, 3, -1])
+        # natom x 3 x outputs_size_1
+        qmat = tf.slice(xyz_scatter_1, [0,1,0], [-1, 3, -1])
+        # natom x outputs_size_1 x 3
+        qmat = tf.transpose(qmat, perm = [0, 2, 1])
+        # natom x outputs_size x outputs_size_2
+        result = tf.matmul(xyz_scatter_1, xyz_scatter_2, transpose_a = True)
+        # natom x (outputs_size x outputs_size_2)
+        result = tf.reshape(result, [-1, outputs_size_2 * outputs_size[-1]])
         return result, qmat
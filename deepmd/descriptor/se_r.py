@@ -362,7 +362,16 @@ class DescrptSeR (DescrptSe):
                                          self.descrpt_deriv,
                                          self.nlist,
                                          natoms)
-        virial, atom_virial \
+        # the virial is taken from an op that skips the atomic virial, 
+        # so the atomic virial is only computed when it is fetched
+        virial, _ \
+            = op_module.prod_virial_se_r (net_deriv_reshape,
+                                          self.descrpt_deriv,
+                                          self.rij,
+                                          self.nlist,
+                                          natoms,
+                                          compute_atom_virial = False)
+        _, atom_virial \
             = op_module.prod_virial_se_r (net_deriv_reshape,
                                           self.descrpt_deriv,
                                           self.rij,
@@ -354,14 +354,18 @@ class DescrptSeT (DescrptSe):
         """
         [net_deriv] = tf.gradients (atom_ener, self.descrpt_reshape)
         net_deriv_reshape = tf.reshape (net_deriv, [-1, natoms[0] * self.ndescrpt])        
-        force \
-            = op_module.prod_force_se_a (net_deriv_reshape,
-                                          self.descrpt_deriv,
-                                          self.nlist,
-                                          natoms,
-                                          n_a_sel = self.nnei_a,
-                                          n_r_sel = self.nnei_r)
-        virial, atom_virial \
+        # force and virial come from one op so that their gradients are fused,
+        # the atomic virial is skipped and only computed when it is fetched
+        force, virial, _ \
+            = op_module.prod_force_virial_se_a (net_deriv_reshape,
+                                                 self.descrpt_deriv,
+                                                 self.rij,
+                                                 self.nlist,
+                                                 natoms,
+                                                 n_a_sel = self.nnei_a,
+                                                 n_r_sel = self.nnei_r,
+                                                 compute_atom_virial = False)
+        _, atom_virial \
             = op_module.prod_virial_se_a (net_deriv_reshape,
                                            self.descrpt_deriv,
                                            self.rij,
@@ -10,7 +10,7 @@ from .test import test
 from .train import train as train_dp
 from .transfer import transfer
 from ..infer.model_devi import make_model_devi
-from .convert import convert
+from .convert import convert, convert_to_mmap
 
 __all__ = [
     "config",
@@ -23,4 +23,5 @@ __all__ = [
     "doc_train_input",
     "make_model_devi",
     "convert",
+    "convert_to_mmap",
 ]
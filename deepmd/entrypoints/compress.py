@@ -33,6 +33,7 @@ def compress(
     mpi_log: str,
     log_path: Optional[str],
     log_level: int,
+    fuse_env_mat: bool = False,
     **kwargs
 ):
     """Compress model.
@@ -65,6 +66,8 @@ def compress(
         if speccified log will be written to this file
     log_level : int
         logging level
+    fuse_env_mat : bool
+        evaluate the tabulated embedding in the op of the environment matrix, only on CPU
     """
     try:
         t_jdata = get_tensor_by_name(input, 'train_attr/training_script')
@@ -103,6 +106,7 @@ def compress(
         10 * step,
         int(frequency),
     ]
+    jdata["model"]["compress"]["fuse_env_mat"] = fuse_env_mat
     jdata["training"]["save_ckpt"] = "model-compression/model.ckpt"
     jdata = normalize(jdata)
 
@@ -1,4 +1,4 @@
-from deepmd.utils.convert import convert_13_to_20, convert_12_to_20
+from deepmd.utils.convert import convert_13_to_20, convert_12_to_20, convert_pb_to_mmap
 
 def convert(
     *,
@@ -13,3 +13,12 @@ def convert(
         convert_13_to_20(input_model, output_model)
     else:
         raise RuntimeError('unsupported model version ' + FROM)
+
+def convert_to_mmap(
+    *,
+    input_model: str,
+    output_model: str,
+    min_size: int,
+    **kwargs,
+):
+    convert_pb_to_mmap(input_model, output_model, min_size)
@@ -16,6 +16,7 @@ from deepmd.entrypoints import (
     transfer,
     make_model_devi,
     convert,
+    convert_to_mmap,
 )
 from deepmd.loggers import set_log_handles
 
@@ -321,6 +322,12 @@ def parse_args(args: Optional[List[str]] = None):
         default=None,
         help="The training script of the input frozen model",
     )
+    parser_compress.add_argument(
+        "--fuse-env-mat",
+        action="store_true",
+        help="Evaluate the tabulated embedding-net in the op of the environment matrix. "
+        "The fused op is only implemented on CPU",
+    )
 
     # * print docs script **************************************************************
     parsers_doc = subparsers.add_parser(
@@ -403,6 +410,35 @@ def parse_args(args: Optional[List[str]] = None):
         type=str, 
 		help='the output model',
     )
+    # * memory-map models *************************************************************
+    # the constants of the model are mapped read-only by the C++ interface
+    parser_mmap = subparsers.add_parser(
+        'convert-to-mmap',
+        parents=[parser_log],
+        help='convert a frozen model to the memory-mapped format used by the C++ interface',
+        formatter_class=argparse.ArgumentDefaultsHelpFormatter,
+    )
+    parser_mmap.add_argument(
+        '-i',
+        "--input-model",
+        default = "frozen_model.pb",
+        type=str,
+        help = "the input frozen model",
+    )
+    parser_mmap.add_argument(
+        "-o",
+        "--output-model",
+        default = "frozen_model.mmap.pb",
+        type=str,
+        help='the output memory-mapped model',
+    )
+    parser_mmap.add_argument(
+        "-s",
+        "--min-size",
+        default = 1024,
+        type=int,
+        help='constant tensors smaller than this size (in bytes) are kept in the graph',
+    )
     # --version
     parser.add_argument('--version', action='version', version='DeePMD-kit v%s' % __version__)
 
@@ -451,6 +487,8 @@ def main():
         make_model_devi(**dict_args)
     elif args.command == "convert-from":
         convert(**dict_args)
+    elif args.command == "convert-to-mmap":
+        convert_to_mmap(**dict_args)
     elif args.command is None:
         pass
     else:
@@ -375,12 +375,14 @@ def model_compression():
     doc_model_file = f"The input model file, which will be compressed by the DeePMD-kit."
     doc_table_config = f"The arguments of model compression, including extrapolate(scale of model extrapolation), stride(uniform stride of tabulation's first and second table), and frequency(frequency of tabulation overflow check)."
     doc_min_nbor_dist = f"The nearest distance between neighbor atoms saved in the frozen model."
+    doc_fuse_env_mat = f"Evaluate the tabulated embedding-net in the op of the environment matrix. The fused op is only implemented on CPU."
     
     return [
         Argument("compress", bool, optional = False, doc = doc_compress),
         Argument("model_file", str, optional = False, doc = doc_model_file),
         Argument("table_config", list, optional = False, doc = doc_table_config),
         Argument("min_nbor_dist", float, optional = False, doc = doc_min_nbor_dist),
+        Argument("fuse_env_mat", bool, optional = True, default = False, doc = doc_fuse_env_mat),
     ]
 
 #  --- model compression configurations: --- #
@@ -1,8 +1,12 @@
 import os
+import struct
+import logging
 from deepmd.env import tf
 from google.protobuf import text_format
 from tensorflow.python.platform import gfile
 
+log = logging.getLogger(__name__)
+
 def convert_13_to_20(input_model: str, output_model: str):
     convert_pb_to_pbtxt(input_model, 'frozen_model.pbtxt')
     convert_dp13_to_dp20('frozen_model.pbtxt')
@@ -88,3 +92,76 @@ node {
                    .replace('DescrptSeR', 'ProdEnvMatR')
     with open(fname, 'w') as fp:
         fp.write(file_content)
+
+# names and alignment follow tensorflow/core/util/memmapped_file_system.h
+MEMMAPPED_PACKAGE_PREFIX = "memmapped_package://"
+MEMMAPPED_PACKAGE_DEFAULT_GRAPH_DEF = MEMMAPPED_PACKAGE_PREFIX + "."
+MEMMAPPED_TENSOR_ALIGNMENT = 64
+
+def convert_pb_to_mmap(input_model: str, output_model: str, min_conversion_size: int = 1024):
+    """Convert a frozen model to the TensorFlow memmapped package format.
+
+    Every constant tensor that is not smaller than `min_conversion_size` bytes
+    is moved out of the graph into an aligned region of the package and
+    replaced by an `ImmutableConst` node. The scalars are kept as `Const`,
+    since the model attributes, like `descrpt_attr/rcut`, are read from the
+    graph. The C++ interface maps these regions
+    read-only from the file, so all processes on a node share one copy of
+    the weights, tabulated embeddings and statistics.
+
+    Parameters
+    ----------
+    input_model : str
+        the frozen model
+    output_model : str
+        the memmapped model
+    min_conversion_size : int
+        the minimal size of converted tensors in bytes
+    """
+    from tensorflow.core.util import memmapped_file_system_pb2
+    with gfile.FastGFile(input_model, 'rb') as f:
+        graph_def = tf.GraphDef()
+        graph_def.ParseFromString(f.read())
+    directory = memmapped_file_system_pb2.MemmappedFileSystemDirectory()
+    nconverted = 0
+    with open(output_model, 'wb') as fp:
+        offset = 0
+        for node in graph_def.node:
+            if node.op != 'Const':
+                continue
+            dtype = tf.as_dtype(node.attr['dtype'].type)
+            if dtype == tf.string:
+                continue
+            value = tf.make_ndarray(node.attr['value'].tensor)
+            if value.ndim == 0:
+                continue
+            data = value.astype(value.dtype.newbyteorder('<')).tobytes()
+            if len(data) < min_conversion_size:
+                continue
+            # aligned so that the mapped tensor can be used without a copy
+            pad = (- offset) % MEMMAPPED_TENSOR_ALIGNMENT
+            fp.write(b'\0' * pad)
+            offset += pad
+            region_name = MEMMAPPED_PACKAGE_PREFIX + "c%d" % nconverted
+            element = directory.element.add()
+            element.offset = offset
+            element.name = region_name
+            element.length = len(data)
+            fp.write(data)
+            offset += len(data)
+            shape = node.attr['value'].tensor.tensor_shape
+            node.op = 'ImmutableConst'
+            del node.attr['value']
+            node.attr['shape'].shape.CopyFrom(shape)
+            node.attr['memory_region_name'].s = region_name.encode()
+            nconverted += 1
+        encoded = graph_def.SerializeToString()
+        element = directory.element.add()
+        element.offset = offset
+        element.name = MEMMAPPED_PACKAGE_DEFAULT_GRAPH_DEF
+        element.length = len(encoded)
+        fp.write(encoded)
+        offset += len(encoded)
+        fp.write(directory.SerializeToString())
+        fp.write(struct.pack('<Q', offset))
+    log.info("%d constant tensors are memory-mapped in %s" % (nconverted, output_model))
@@ -9,8 +9,10 @@ import logging
 
 from deepmd.env import GLOBAL_NP_FLOAT_PRECISION
 from deepmd.env import GLOBAL_ENER_FLOAT_PRECISION
+from deepmd.env import tf
+from deepmd.env import op_module
 from deepmd.utils import random as dp_random
-from deepmd.utils.path import DPPath
+from deepmd.utils.path import DPPath, DPOSPath
 
 log = logging.getLogger(__name__)
 
@@ -222,6 +224,73 @@ class DeepmdData() :
         ret = self._get_subdata(self.batch_set, idx)
         return ret
 
+    def get_batch_op(self,
+                     batch_size : int,
+                     prefetch : int = 2,
+                     nthreads : int = 1,
+                     seed : int = 0,
+                     shuffle : bool = True,
+    ) -> dict :
+        """
+        Build an op that loads the training batches in the background threads of
+        the `NpyBatchLoader` op. The frames are picked in the same way as `get_batch`.
+        The items with `type_sel` or `repeat`, and the data modifier are not supported.
+
+        Parameters
+        ----------
+        batch_size
+                size of the batch
+        prefetch
+                the number of batches assembled ahead of the training step
+        nthreads
+                the number of threads that assemble the batches
+        seed
+                the random seed of the shuffling
+        shuffle
+                shuffle the frames of a set when the set is entered
+
+        Returns
+        -------
+        dict
+                the tensors of the keys and the `find_` flags
+        """
+        if self.modifier is not None:
+            raise RuntimeError("the data modifier is not supported by the batch loader op")
+        if not all(isinstance(dd, DPOSPath) for dd in self.train_dirs):
+            raise RuntimeError("the batch loader op only loads the npy files on the disk")
+        keys = [kk for kk in self.data_dict.keys() if self.data_dict[kk]['reduce'] is None]
+        for kk in keys:
+            if self.data_dict[kk]['type_sel'] is not None or self.data_dict[kk]['repeat'] != 1:
+                raise RuntimeError("%s with type_sel or repeat is not supported by the batch loader op" % kk)
+        out_types = [tf.as_dtype(GLOBAL_ENER_FLOAT_PRECISION if self.data_dict[kk]['high_prec'] else GLOBAL_NP_FLOAT_PRECISION) for kk in keys]
+        outputs = op_module.npy_batch_loader(
+            set_dirs = [str(dd) for dd in self.train_dirs],
+            keys = keys,
+            ndofs = [self.data_dict[kk]['ndof'] for kk in keys],
+            atomic = [bool(self.data_dict[kk]['atomic']) for kk in keys],
+            must = [bool(self.data_dict[kk]['must']) for kk in keys],
+            natoms = self.natoms,
+            idx_map = [int(ii) for ii in self.idx_map],
+            batch_size = batch_size,
+            prefetch = prefetch,
+            nthreads = nthreads,
+            seed = seed,
+            shuffle = shuffle,
+            out_types = out_types)
+        data, find = outputs[:-1], outputs[-1]
+        ret = {}
+        for ii, kk in enumerate(keys):
+            ret[kk] = data[ii]
+            ret['find_'+kk] = find[ii]
+        for kk in self.data_dict.keys():
+            if self.data_dict[kk]['reduce'] is not None :
+                k_in = self.data_dict[kk]['reduce']
+                ndof = self.data_dict[kk]['ndof']
+                ret['find_'+kk] = ret['find_'+k_in]
+                tmp_in = tf.cast(ret[k_in], GLOBAL_ENER_FLOAT_PRECISION)
+                ret[kk] = tf.reduce_sum(tf.reshape(tmp_in, [-1, self.natoms, ndof]), axis = 1)
+        return ret
+
     def get_test (self, 
                   ntests : int = -1
     ) -> dict:
@@ -23,15 +23,24 @@ class NeighborStat():
             The num of atom types
     rcut
             The cut-off radius
+    nbins
+            The number of bins of the histogram of the neighbor distances on [0, rcut). 
+            The histogram is not computed if it is 0.
+    batch_size
+            The number of frames reduced by one call of the op
     """
     def __init__(self,
                  ntypes : int,
-                 rcut: float) -> None:
+                 rcut: float,
+                 nbins: int = 0,
+                 batch_size: int = 1024) -> None:
         """
         Constructor
         """
         self.rcut = rcut
         self.ntypes = ntypes
+        self.nbins = nbins
+        self.batch_size = batch_size
         self.place_holders = {}
         sub_graph = tf.Graph()
         with sub_graph.as_default():
@@ -40,13 +49,15 @@ class NeighborStat():
             self.place_holders['type'] = tf.placeholder(tf.int32, [None, None], name='t_type')
             self.place_holders['natoms_vec'] = tf.placeholder(tf.int32, [self.ntypes+2], name='t_natoms')
             self.place_holders['default_mesh'] = tf.placeholder(tf.int32, [None], name='t_mesh')
-            self._max_nbor_size, self._min_nbor_dist \
-                = op_module.neighbor_stat(self.place_holders['coord'],
-                                         self.place_holders['type'],
-                                         self.place_holders['natoms_vec'],
-                                         self.place_holders['box'],
-                                         self.place_holders['default_mesh'],
-                                         rcut = self.rcut)
+            # the statistics are reduced in the op, one value per frame
+            self._min_nbor_dist, self._max_nbor_size, self._dist_hist \
+                = op_module.neighbor_stat_reduce(self.place_holders['coord'],
+                                                 self.place_holders['type'],
+                                                 self.place_holders['natoms_vec'],
+                                                 self.place_holders['box'],
+                                                 self.place_holders['default_mesh'],
+                                                 rcut = self.rcut,
+                                                 nbins = self.nbins)
         self.sub_sess = tf.Session(graph = sub_graph, config=default_tf_session_config)
 
     def get_stat(self,
@@ -68,27 +79,28 @@ class NeighborStat():
         """
         self.min_nbor_dist = 100.0
         self.max_nbor_size = [0] * self.ntypes
+        self.dist_hist = np.zeros(self.nbins, dtype = np.int64)
 
         # for ii in tqdm(range(len(data.system_dirs)), desc = 'DEEPMD INFO    |-> deepmd.utils.neighbor_stat\t\t\tgetting neighbor status'):
         for ii in range(len(data.system_dirs)):
             for jj in data.data_systems[ii].dirs:
                 data_set = data.data_systems[ii]._load_set(jj)
-                for kk in range(np.array(data_set['type']).shape[0]):
-                    mn, dt \
-                        = run_sess(self.sub_sess, [self._max_nbor_size, self._min_nbor_dist], 
+                coord = np.array(data_set['coord']).reshape([-1, data.natoms[ii] * 3])
+                atype = np.array(data_set['type']).reshape([-1, data.natoms[ii]])
+                box = np.array(data_set['box']).reshape([-1, 9])
+                for kk in range(0, atype.shape[0], self.batch_size):
+                    dt, mn, hist \
+                        = run_sess(self.sub_sess, [self._min_nbor_dist, self._max_nbor_size, self._dist_hist], 
                                             feed_dict = {
-                                                self.place_holders['coord']: np.array(data_set['coord'])[kk].reshape([-1, data.natoms[ii] * 3]),
-                                                self.place_holders['type']: np.array(data_set['type'])[kk].reshape([-1, data.natoms[ii]]),
+                                                self.place_holders['coord']: coord[kk:kk+self.batch_size],
+                                                self.place_holders['type']: atype[kk:kk+self.batch_size],
                                                 self.place_holders['natoms_vec']: np.array(data.natoms_vec[ii]),
-                                                self.place_holders['box']: np.array(data_set['box'])[kk].reshape([-1, 9]),
+                                                self.place_holders['box']: box[kk:kk+self.batch_size],
                                                 self.place_holders['default_mesh']: np.array(data.default_mesh[ii]),
                                             })
-                    if dt.size != 0:
-                        dt = np.min(dt)              
-                    else:
-                        dt = self.rcut
+                    if np.any(np.sum(mn, axis = 1) == 0):
                         log.warning("Atoms with no neighbors found in %s. Please make sure it's what you expected."%jj)
-                        
+                    dt = np.min(dt)
                     if dt < self.min_nbor_dist:
                         if math.isclose(dt, 0., rel_tol=1e-6):
                             # it's unexpected that the distance between two atoms is zero
@@ -98,10 +110,11 @@ class NeighborStat():
                                 " training data to remove duplicated atoms." % jj
                             )
                         self.min_nbor_dist = dt
+                    var = np.max(mn, axis = 0)
                     for ww in range(self.ntypes):
-                        var = np.max(mn[:, ww])
-                        if var > self.max_nbor_size[ww]:
-                            self.max_nbor_size[ww] = var
+                        if var[ww] > self.max_nbor_size[ww]:
+                            self.max_nbor_size[ww] = var[ww]
+                    self.dist_hist += np.sum(hist, axis = 0)
 
         log.info('training data with min nbor dist: ' + str(self.min_nbor_dist))
         log.info('training data with max nbor size: ' + str(self.max_nbor_size))
@@ -139,32 +139,17 @@ class DPTabulate():
         """
         # tabulate range [lower, upper] with stride0 'stride0'
         lower, upper = self._get_env_mat_range(min_nbor_dist)
-        xx = np.arange(lower, upper, stride0, dtype = self.data_type)
-        xx = np.append(xx, np.arange(upper, extrapolate * upper, stride1, dtype = self.data_type))
-        xx = np.append(xx, np.array([extrapolate * upper], dtype = self.data_type))
         self.nspline = int((upper - lower) / stride0 + (extrapolate * upper - upper) / stride1)
-        for ii in range(self.table_size):
-            if self.type_one_side or (ii // self.ntypes, int(ii % self.ntypes)) not in self.exclude_types:
-                vv, dd, d2 = self._make_data(xx, ii)
-                if self.type_one_side:
-                    net = "filter_-1_net_" + str(ii)
-                else:
-                    net = "filter_" + str(ii // self.ntypes) + "_net_" + str(int(ii % self.ntypes))
-                self.data[net] = np.zeros([self.nspline, 6 * self.last_layer_size], dtype = self.data_type)
-                # for jj in tqdm(range(self.nspline), desc = 'DEEPMD INFO    |-> deepmd.utils.tabulate\t\t\t' + net + ', tabulating'):
-                for jj in range(self.nspline):
-                    for kk in range(self.last_layer_size):
-                        if jj < int((upper - lower) / stride0):
-                            tt = stride0
-                        else:
-                            tt = stride1
-                        hh = vv[jj + 1][kk] - vv[jj][kk]
-                        self.data[net][jj][kk * 6 + 0] = vv[jj][kk]
-                        self.data[net][jj][kk * 6 + 1] = dd[jj][kk]
-                        self.data[net][jj][kk * 6 + 2] = 0.5 * d2[jj][kk]
-                        self.data[net][jj][kk * 6 + 3] = (1 / (2 * tt * tt * tt)) * (20 * hh - (8 * dd[jj + 1][kk] + 12 * dd[jj][kk]) * tt - (3 * d2[jj][kk] - d2[jj + 1][kk]) * tt * tt)
-                        self.data[net][jj][kk * 6 + 4] = (1 / (2 * tt * tt * tt * tt)) * (-30 * hh + (14 * dd[jj + 1][kk] + 16 * dd[jj][kk]) * tt + (3 * d2[jj][kk] - 2 * d2[jj + 1][kk]) * tt * tt)
-                        self.data[net][jj][kk * 6 + 5] = (1 / (2 * tt * tt * tt * tt * tt)) * (12 * hh - 6 * (dd[jj + 1][kk] + dd[jj][kk]) * tt + (d2[jj + 1][kk] - d2[jj][kk]) * tt * tt)
+        nets = [ii for ii in range(self.table_size) 
+                if self.type_one_side or (ii // self.ntypes, int(ii % self.ntypes)) not in self.exclude_types]
+        # the tables of all the nets are built by one op, in parallel over the nets and the intervals
+        table = self._build_table(nets, [lower, upper, extrapolate * upper, stride0, stride1])
+        for idx, ii in enumerate(nets):
+            if self.type_one_side:
+                net = "filter_-1_net_" + str(ii)
+            else:
+                net = "filter_" + str(ii // self.ntypes) + "_net_" + str(int(ii % self.ntypes))
+            self.data[net] = table[idx]
         return lower, upper
 
     def _load_sub_graph(self):
@@ -215,44 +200,19 @@ class DPTabulate():
                         matrix["layer_" + str(layer)].append(np.array([]))
         return matrix
 
-    # one-by-one executions
-    def _make_data(self, xx, idx):
+    def _build_table(self, nets, table_info):
         with self.sub_graph.as_default():
-            with self.sub_sess.as_default():
-                xx = tf.reshape(xx, [xx.size, -1])
-                for layer in range(self.layer_size):
-                    if layer == 0:
-                        xbar = tf.matmul(
-                            xx, self.matrix["layer_" + str(layer + 1)][idx]) + self.bias["layer_" + str(layer + 1)][idx]
-                        yy = self._layer_0(
-                            xx, self.matrix["layer_" + str(layer + 1)][idx], self.bias["layer_" + str(layer + 1)][idx])
-                        dy = op_module.unaggregated_dy_dx_s(
-                            yy, self.matrix["layer_" + str(layer + 1)][idx], xbar, tf.constant(self.functype))
-                        dy2 = op_module.unaggregated_dy2_dx_s(
-                            yy, dy, self.matrix["layer_" + str(layer + 1)][idx], xbar, tf.constant(self.functype))
-                    else:
-                        ybar = tf.matmul(
-                            yy, self.matrix["layer_" + str(layer + 1)][idx]) + self.bias["layer_" + str(layer + 1)][idx]
-                        tt, zz = self._layer_1(
-                            yy, self.matrix["layer_" + str(layer + 1)][idx], self.bias["layer_" + str(layer + 1)][idx])
-                        dz = op_module.unaggregated_dy_dx(
-                            zz - tt, self.matrix["layer_" + str(layer + 1)][idx], dy, ybar, tf.constant(self.functype))
-                        dy2 = op_module.unaggregated_dy2_dx(
-                            zz - tt, self.matrix["layer_" + str(layer + 1)][idx], dy, dy2, ybar, tf.constant(self.functype))
-                        dy = dz
-                        yy = zz
-
-                vv = zz.eval()
-                dd = dy.eval()
-                d2 = dy2.eval()
-        return vv, dd, d2
-
-    def _layer_0(self, x, w, b):
-        return self.activation_fn(tf.matmul(x, w) + b)
-
-    def _layer_1(self, x, w, b):
-        t = tf.concat([x, x], axis=1)
-        return t, self.activation_fn(tf.matmul(x, w) + b) + t
+            matrix = []
+            bias = []
+            for layer in range(1, self.layer_size + 1):
+                matrix.append(np.stack([self.matrix["layer_" + str(layer)][ii] for ii in nets]).astype(self.data_type))
+                bias.append(np.stack([self.bias["layer_" + str(layer)][ii] for ii in nets]).astype(self.data_type))
+            table = op_module.build_tabulate_table(matrix,
+                                                   bias,
+                                                   np.array(table_info, dtype = self.data_type),
+                                                   nspline = self.nspline,
+                                                   functype = self.functype)
+            return run_sess(self.sub_sess, table)
 
     def _save_data(self):
         for ii in range(self.ntypes * self.ntypes):
@@ -10,12 +10,13 @@ public:
   DipoleChargeModifier(const std::string & model, 
 	       const int & gpu_rank = 0, 
 	       const std::string & name_scope = "");
-  ~DipoleChargeModifier () {};
+  ~DipoleChargeModifier ();
   void init (const std::string & model, 
 	     const int & gpu_rank = 0, 
 	     const std::string & name_scope = "");
   void print_summary(const std::string &pre) const;
 public:
+  template<typename VALUETYPE>
   void compute (std::vector<VALUETYPE> &		dfcorr_,
 		std::vector<VALUETYPE> &		dvcorr_,
 		const std::vector<VALUETYPE> &	dcoord_,
@@ -24,28 +25,51 @@ public:
 		const std::vector<std::pair<int,int>> &	pairs,
 		const std::vector<VALUETYPE> &	delef_, 
 		const int			nghost,
-		const InputNlist &	lmp_list);
-  VALUETYPE cutoff () const {assert(inited); return rcut;};
+		const InputNlist &	lmp_list,
+		const int			ago = 0);
+  double cutoff () const {assert(inited); return rcut;};
   int numb_types () const {assert(inited); return ntypes;};
   std::vector<int> sel_types () const {assert(inited); return sel_type;};
 private:
   tensorflow::Session* session;
+  std::unique_ptr<tensorflow::MemmappedEnv> mmap_env;
+  SessionCallable callable;
   std::string name_scope, name_prefix;
   int num_intra_nthreads, num_inter_nthreads;
   tensorflow::GraphDef graph_def;
   bool inited;
-  VALUETYPE rcut;
-  VALUETYPE cell_size;
+  double rcut;
+  double cell_size;
+  tensorflow::DataType dtype;
   int ntypes;
   std::string model_type;
   std::vector<int> sel_type;
+  // the maps of the atoms, rebuilt only when the neighbor list is (ago == 0)
+  std::vector<int> real_fwd_map, real_bkw_map;
+  int nghost_real;
+  std::vector<int> datype_real;
+  NeighborListData nlist_data;
+  InputNlist nlist;
+  AtomMap atommap;
+  // the atom providing the external field of each selected atom, in the model order
+  std::vector<int> extf_idx;
+  // the original index of each atom in the model order
+  std::vector<int> out_idx;
+  template<typename VALUETYPE>
+  void make_maps (const std::vector<VALUETYPE> &	dcoord_,
+		  const std::vector<int> &		datype_,
+		  const std::vector<std::pair<int,int>> &	pairs,
+		  const int			nghost,
+		  const InputNlist &	lmp_list);
   template<class VT> VT get_scalar(const std::string & name) const;
   template<class VT> void get_vector(std::vector<VT> & vec, const std::string & name) const;
+  template<typename MODELTYPE, typename VALUETYPE>
   void run_model (std::vector<VALUETYPE> &		dforce,
 		  std::vector<VALUETYPE> &		dvirial,
 		  tensorflow::Session *			session,
+		  const SessionCallable &		callable,
 		  const std::vector<std::pair<std::string, tensorflow::Tensor>> & input_tensors,
-		  const AtomMap<VALUETYPE> &	atommap,
+		  const AtomMap &	atommap,
 		  const int			nghost);
 };
 }
@@ -1,11 +1,17 @@
 #pragma once
 
+#include <future>
+#include <memory>
 #include "common.h"
 #include "neighbor_list.h"
+#include "nlist_stat.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 
 namespace deepmd{
 /**
 * @brief Deep Potential.
+* @details The coordinates, box, parameters and outputs of compute are either float or double 
+* (VALUETYPE), independent of the precision of the model. The energy is always double.
 **/
 class DeepPot 
 {
@@ -19,14 +25,14 @@ public:
   * @brief DP constructor with initialization.
   * @param[in] model The name of the frozen model file.
   * @param[in] gpu_rank The GPU rank. Default is 0.
-  * @param[in] file_content The content of the model file. If it is not empty, DP will read from the string instead of the file.
+  * @param[in] file_content The content of the model file. If it is not empty, DP will read from the string instead of the file. A memmapped model (see `dp convert-to-mmap`) should be read from the file.
   **/
   DeepPot  (const std::string & model, const int & gpu_rank = 0, const std::string & file_content = "");
   /**
   * @brief Initialize the DP.
   * @param[in] model The name of the frozen model file.
   * @param[in] gpu_rank The GPU rank. Default is 0.
-  * @param[in] file_content The content of the model file. If it is not empty, DP will read from the string instead of the file.
+  * @param[in] file_content The content of the model file. If it is not empty, DP will read from the string instead of the file. A memmapped model (see `dp convert-to-mmap`) should be read from the file.
   **/
   void init (const std::string & model, const int & gpu_rank = 0, const std::string & file_content = "");
   /**
@@ -34,6 +40,36 @@ public:
   * @param[in] pre The prefix to each line.
   **/
   void print_summary(const std::string &pre) const;
+  /**
+  * @brief Load a new model on a separate thread, while this DP keeps evaluating the current model.
+  * @details The new model replaces the current one when commit_reload is called. It should have 
+  * the same cutoff radius, number of types and dimensions of the frame and atomic parameters.
+  * @param[in] model The name of the frozen model file.
+  * @param[in] gpu_rank The GPU rank. Default is 0.
+  * @param[in] file_content The content of the model file. If it is not empty, DP will read from the string instead of the file.
+  **/
+  void reload_async (const std::string & model, const int & gpu_rank = 0, const std::string & file_content = "");
+  /**
+  * @brief Whether the model loaded by reload_async is ready to be committed.
+  **/
+  bool reload_ready () const;
+  /**
+  * @brief Replace the current model by the one loaded by reload_async.
+  * @details This should be called between two evaluations. The errors of loading the new model are thrown here.
+  * @param[in] wait Wait for the new model to be loaded. Otherwise nothing is done if it is not ready.
+  * @return Whether the model has been replaced.
+  **/
+  bool commit_reload (const bool wait = false);
+  /**
+  * @brief Pad the numbers of local and ghost atoms fed to the model to multiples of a bucket.
+  * @details With the neighbor list interfaces of compute and compute_async, the real atoms are 
+  * padded by phantom atoms of type 0 that are in no neighbor list, so the shapes of the tensors 
+  * in the graph only change when the number of atoms crosses a bucket. The constant energy of 
+  * the phantom local atoms is subtracted. The padding is not applied to the models with frame 
+  * or atomic parameters. It takes effect at the next update of the neighbor list (ago == 0).
+  * @param[in] bucket The size of the bucket. The padding is disabled if it is 0, the default.
+  **/
+  void set_padding (const int bucket);
 public:
   /**
   * @brief Evaluate the energy, force and virial by using this DP.
@@ -51,6 +87,7 @@ public:
       * natoms x dim_aparam. Then all frames are assumed to be provided with the same aparam.
       * dim_aparam. Then all frames and atoms are provided with the same aparam.
   **/
+  template<typename VALUETYPE>
   void compute (ENERGYTYPE &			ener,
 		std::vector<VALUETYPE> &	force,
 		std::vector<VALUETYPE> &	virial,
@@ -78,6 +115,7 @@ public:
       * natoms x dim_aparam. Then all frames are assumed to be provided with the same aparam.
       * dim_aparam. Then all frames and atoms are provided with the same aparam.
   **/
+  template<typename VALUETYPE>
   void compute (ENERGYTYPE &			ener,
 		std::vector<VALUETYPE> &	force,
 		std::vector<VALUETYPE> &	virial,
@@ -90,6 +128,41 @@ public:
 		const std::vector<VALUETYPE>&	fparam = std::vector<VALUETYPE>(),
 		const std::vector<VALUETYPE>&	aparam = std::vector<VALUETYPE>());
   /**
+  * @brief Launch the evaluation of the energy, force and virial on the worker thread of this DP.
+  * @details The inputs, including the neighbour list, are consumed before this function returns,
+  * so the caller may modify them while the model runs. The outputs are written by the time the
+  * returned future is ready. This DP should not be used again until the future is joined.
+  * @param[out] ener The system energy.
+  * @param[out] force The force on each atom.
+  * @param[out] virial The virial.
+  * @param[in] coord The coordinates of atoms. The array should be of size nframes x natoms x 3.
+  * @param[in] atype The atom types. The list should contain natoms ints.
+  * @param[in] box The cell of the region. The array should be of size nframes x 9.
+  * @param[in] nghost The number of ghost atoms.
+  * @param[in] inlist The input neighbour list.
+  * @param[in] ago Update the internal neighbour list if ago is 0.
+  * @param[in] fparam The frame parameter. The array can be of size :
+      * nframes x dim_fparam.
+      * dim_fparam. Then all frames are assumed to be provided with the same fparam.
+  * @param[in] aparam The atomic parameter The array can be of size :
+      * nframes x natoms x dim_aparam.
+      * natoms x dim_aparam. Then all frames are assumed to be provided with the same aparam.
+      * dim_aparam. Then all frames and atoms are provided with the same aparam.
+  * @return The future to join before reading the outputs.
+  **/
+  template<typename VALUETYPE>
+  std::future<void> compute_async (ENERGYTYPE &			ener,
+				   std::vector<VALUETYPE> &	force,
+				   std::vector<VALUETYPE> &	virial,
+				   const std::vector<VALUETYPE> &	coord,
+				   const std::vector<int> &	atype,
+				   const std::vector<VALUETYPE> &	box, 
+				   const int			nghost,
+				   const InputNlist &		inlist,
+				   const int&			ago,
+				   const std::vector<VALUETYPE>&	fparam = std::vector<VALUETYPE>(),
+				   const std::vector<VALUETYPE>&	aparam = std::vector<VALUETYPE>());
+  /**
   * @brief Evaluate the energy, force, virial, atomic energy, and atomic virial by using this DP.
   * @param[out] ener The system energy.
   * @param[out] force The force on each atom.
@@ -107,6 +180,7 @@ public:
       * natoms x dim_aparam. Then all frames are assumed to be provided with the same aparam.
       * dim_aparam. Then all frames and atoms are provided with the same aparam.
   **/
+  template<typename VALUETYPE>
   void compute (ENERGYTYPE &			ener,
 		std::vector<VALUETYPE> &	force,
 		std::vector<VALUETYPE> &	virial,
@@ -138,6 +212,7 @@ public:
       * natoms x dim_aparam. Then all frames are assumed to be provided with the same aparam.
       * dim_aparam. Then all frames and atoms are provided with the same aparam.
   **/
+  template<typename VALUETYPE>
   void compute (ENERGYTYPE &			ener,
 		std::vector<VALUETYPE> &	force,
 		std::vector<VALUETYPE> &	virial,
@@ -155,7 +230,7 @@ public:
   * @brief Get the cutoff radius.
   * @return The cutoff radius.
   **/
-  VALUETYPE cutoff () const {assert(inited); return rcut;};
+  double cutoff () const {assert(inited); return rcut;};
   /**
   * @brief Get the number of types.
   * @return The number of types.
@@ -176,46 +251,95 @@ public:
   * @param[out] type_map The type map of this model.
   **/
   void get_type_map (std::string & type_map);
+  /**
+  * @brief Get the descriptor attributes of this model.
+  * @return The model metadata.
+  **/
+  const ModelMetadata & model_metadata () const {assert(inited); return metadata;};
+  /**
+  * @brief Enable or disable the collection of the neighbor list statistics, it is disabled by default.
+  * @details The statistics are collected by the CPU descriptors of all the models in the process:
+  * the max and mean numbers of neighbors of each type within the cutoff, the number of atoms whose
+  * neighbors overflow sel, and the numbers of neighbor lists built and of their retries.
+  * The phantom atoms padded by set_padding are recorded once per evaluation of the model, and are
+  * left out of the mean numbers of neighbors.
+  * @param[in] enable Whether to collect the statistics.
+  **/
+  static void enable_nlist_stat (const bool enable = true) {deepmd::nlist_stat_enable(enable);};
+  /**
+  * @brief Get the neighbor list statistics collected since the last reset.
+  * @param[out] stat The statistics.
+  * @param[in] reset Reset the statistics after they are read.
+  **/
+  static void get_nlist_stat (NlistStat & stat, const bool reset = true) {deepmd::nlist_stat_get(stat, reset);};
 private:
   tensorflow::Session* session;
+  std::unique_ptr<tensorflow::MemmappedEnv> mmap_env;
+  SessionCallable callable, callable_atomic;
   int num_intra_nthreads, num_inter_nthreads;
   tensorflow::GraphDef graph_def;
+  ModelMetadata metadata;
   bool inited;
   template<class VT> VT get_scalar(const std::string & name) const;
   // VALUETYPE get_rcut () const;
   // int get_ntypes () const;
-  VALUETYPE rcut;
-  VALUETYPE cell_size;
+  double rcut;
+  double cell_size;
+  tensorflow::DataType dtype;
   std::string model_type;
   std::string model_version;
   int ntypes;
   int dfparam;
   int daparam;
+  template<typename VALUETYPE>
   void validate_fparam_aparam(const int & nloc,
 			      const std::vector<VALUETYPE> &fparam,
 			      const std::vector<VALUETYPE> &aparam)const ;
-  void compute_inner (ENERGYTYPE &			ener,
-		      std::vector<VALUETYPE> &		force,
-		      std::vector<VALUETYPE> &		virial,
-		      const std::vector<VALUETYPE> &	coord,
-		      const std::vector<int> &		atype,
-		      const std::vector<VALUETYPE> &	box, 
-		      const int				nghost,
-		      const int &			ago,
-		      const std::vector<VALUETYPE>&	fparam = std::vector<VALUETYPE>(),
-		      const std::vector<VALUETYPE>&	aparam = std::vector<VALUETYPE>());
+  // prepare the input tensors from the lammps neighbor list, returns the number of ghost atoms fed
+  // to the model, and the number of phantom local atoms padded
+  template<typename VALUETYPE>
+  int make_input_tensors (std::vector<std::pair<std::string, tensorflow::Tensor>> & input_tensors,
+			  std::vector<int> &			bkw_map,
+			  int &					nphantom,
+			  const std::vector<VALUETYPE> &	coord,
+			  const std::vector<int> &		atype,
+			  const std::vector<VALUETYPE> &	box, 
+			  const int				nghost,
+			  const InputNlist &			inlist,
+			  const int &				ago,
+			  const std::vector<VALUETYPE>&		fparam,
+			  const std::vector<VALUETYPE>&		aparam);
 
   // copy neighbor list info from host
   bool init_nbor;
   std::vector<int> sec_a;
   NeighborListData nlist_data;
   InputNlist nlist;
-  AtomMap<VALUETYPE> atommap;
+  AtomMap atommap;
 
   // function used for neighbor list copy
   std::vector<int> get_sel_a() const;
+
+  // the padding of the atoms, see set_padding. The bucket in use is fixed at the neighbor list update
+  int pad_bucket, nlist_pad_bucket;
+  // the energy of a phantom atom, evaluated once per model
+  bool phantom_ready;
+  ENERGYTYPE phantom_ener;
+  ENERGYTYPE get_phantom_energy ();
+
+  // the model being loaded by reload_async
+  std::future<std::unique_ptr<DeepPot> > reload_job;
+  void swap_model (DeepPot & dp);
+
+  // the thread that runs the sessions of compute_async, created at init. Resetting it joins the
+  // evaluations already posted
+  std::unique_ptr<tensorflow::thread::ThreadPool> async_worker;
 };
 
+/**
+* @brief The model deviation of several Deep Potentials.
+* @details As for DeepPot, VALUETYPE of the interfaces is independent of the precision of the models.
+**/
 class DeepPotModelDevi
 {
 public:
@@ -238,6 +362,26 @@ public:
   * @param[in] file_content The contents of the model files. If it is not empty, DP will read from the strings instead of the files.
   **/
   void init (const std::vector<std::string> & models, const int & gpu_rank = 0, const std::vector<std::string> & file_contents = std::vector<std::string>());
+  /**
+  * @brief Load new models on a separate thread, while these DPs keep evaluating the current models.
+  * @details The new models replace the current ones when commit_reload is called. They should have 
+  * the same cutoff radius, number of types and dimensions of the frame and atomic parameters.
+  * @param[in] model The names of the frozen model files.
+  * @param[in] gpu_rank The GPU rank. Default is 0.
+  * @param[in] file_content The contents of the model files. If it is not empty, DP will read from the strings instead of the files.
+  **/
+  void reload_async (const std::vector<std::string> & models, const int & gpu_rank = 0, const std::vector<std::string> & file_contents = std::vector<std::string>());
+  /**
+  * @brief Whether the models loaded by reload_async are ready to be committed.
+  **/
+  bool reload_ready () const;
+  /**
+  * @brief Replace the current models by the ones loaded by reload_async.
+  * @details This should be called between two evaluations. The errors of loading the new models are thrown here.
+  * @param[in] wait Wait for the new models to be loaded. Otherwise nothing is done if they are not ready.
+  * @return Whether the models have been replaced.
+  **/
+  bool commit_reload (const bool wait = false);
 public:
   /**
   * @brief Evaluate the energy, force and virial by using these DP models.
@@ -258,6 +402,7 @@ public:
       * natoms x dim_aparam. Then all frames are assumed to be provided with the same aparam.
       * dim_aparam. Then all frames and atoms are provided with the same aparam.
   **/
+  template<typename VALUETYPE>
   void compute (std::vector<ENERGYTYPE> &		all_ener,
 		std::vector<std::vector<VALUETYPE> > &	all_force,
 		std::vector<std::vector<VALUETYPE> > &	all_virial,
@@ -290,6 +435,7 @@ public:
       * natoms x dim_aparam. Then all frames are assumed to be provided with the same aparam.
       * dim_aparam. Then all frames and atoms are provided with the same aparam.
   **/
+  template<typename VALUETYPE>
   void compute (std::vector<ENERGYTYPE> &		all_ener,
 		std::vector<std::vector<VALUETYPE> > &	all_force,
 		std::vector<std::vector<VALUETYPE> > &	all_virial,
@@ -307,7 +453,7 @@ public:
   * @brief Get the cutoff radius.
   * @return The cutoff radius.
   **/
-  VALUETYPE cutoff () const {assert(inited); return rcut;};
+  double cutoff () const {assert(inited); return rcut;};
   /**
   * @brief Get the number of types.
   * @return The number of types.
@@ -323,20 +469,12 @@ public:
   * @return The dimension of the atomic parameter.
   **/
   int dim_aparam () const {assert(inited); return daparam;};
-#ifndef HIGH_PREC
-  /**
-  * @brief Compute the average energy.
-  * @param[out] dener The average energy.
-  * @param[in] all_energy The energies of all models.
-  **/
-  void compute_avg (ENERGYTYPE &		dener,
-		    const std::vector<ENERGYTYPE > &	all_energy);
-#endif
   /**
   * @brief Compute the average energy.
   * @param[out] dener The average energy.
   * @param[in] all_energy The energies of all models.
   **/
+  template<typename VALUETYPE>
   void compute_avg (VALUETYPE &			dener,
 		    const std::vector<VALUETYPE > &	all_energy);
   /**
@@ -344,6 +482,7 @@ public:
   * @param[out] avg The average of vectors.
   * @param[in] xx The vectors of all models.
   **/
+  template<typename VALUETYPE>
   void compute_avg (std::vector<VALUETYPE> &		avg,
 		    const std::vector<std::vector<VALUETYPE> > &	xx);
   /**
@@ -353,6 +492,7 @@ public:
   * @param[in] xx The vectors of all models.
   * @param[in] stride The stride to compute the deviation.
   **/
+  template<typename VALUETYPE>
   void compute_std (
       std::vector<VALUETYPE> & std,
       const std::vector<VALUETYPE> & avg,
@@ -365,6 +505,7 @@ public:
   * @param[in] eps The level parameter for computing the deviation.
   * @param[in] stride The stride to compute the deviation.
   **/
+  template<typename VALUETYPE>
   void compute_relative_std (
       std::vector<VALUETYPE> & std,
       const std::vector<VALUETYPE> & avg,
@@ -376,6 +517,7 @@ public:
   * @param[in] avg The average of atomic energies.
   * @param[in] xx The vectors of all atomic energies.
   **/
+  template<typename VALUETYPE>
   void compute_std_e (std::vector<VALUETYPE> &		std,
 		      const std::vector<VALUETYPE> &		avg,
 		      const std::vector<std::vector<VALUETYPE> >&	xx);
@@ -385,6 +527,7 @@ public:
   * @param[in] avg The average of forces.
   * @param[in] xx The vectors of all forces.
   **/
+  template<typename VALUETYPE>
   void compute_std_f (std::vector<VALUETYPE> &		std,
 		      const std::vector<VALUETYPE> &		avg,
 		      const std::vector<std::vector<VALUETYPE> >& xx);
@@ -394,25 +537,31 @@ public:
   * @param[in] avg The relative average of forces.
   * @param[in] eps The level parameter for computing the deviation.
   **/
+  template<typename VALUETYPE>
   void compute_relative_std_f (std::vector<VALUETYPE> &		std,
 		      const std::vector<VALUETYPE> &		avg,
 		      const VALUETYPE eps);
 private:
   unsigned numb_models;
   std::vector<tensorflow::Session*> sessions;
+  std::vector<std::unique_ptr<tensorflow::MemmappedEnv> > mmap_envs;
+  std::vector<SessionCallable> callables, callables_atomic;
   int num_intra_nthreads, num_inter_nthreads;
   std::vector<tensorflow::GraphDef> graph_defs;
+  std::vector<ModelMetadata> metadata;
   bool inited;
   template<class VT> VT get_scalar(const std::string name) const;
   // VALUETYPE get_rcut () const;
   // int get_ntypes () const;
-  VALUETYPE rcut;
-  VALUETYPE cell_size;
+  double rcut;
+  double cell_size;
+  tensorflow::DataType dtype;
   std::string model_type;
   std::string model_version;
   int ntypes;
   int dfparam;
   int daparam;
+  template<typename VALUETYPE>
   void validate_fparam_aparam(const int & nloc,
 			      const std::vector<VALUETYPE> &fparam,
 			      const std::vector<VALUETYPE> &aparam)const ;
@@ -420,13 +569,17 @@ private:
   // copy neighbor list info from host
   bool init_nbor;
   std::vector<std::vector<int> > sec;
-  deepmd::AtomMap<VALUETYPE> atommap;
+  deepmd::AtomMap atommap;
   NeighborListData nlist_data;
   InputNlist nlist;
 
   // function used for nborlist copy
   std::vector<std::vector<int> > get_sel() const;
   void cum_sum(const std::vector<std::vector<tensorflow::int32> > n_sel);
+
+  // the models being loaded by reload_async
+  std::future<std::unique_ptr<DeepPotModelDevi> > reload_job;
+  void swap_model (DeepPotModelDevi & dp);
 };
 }
 
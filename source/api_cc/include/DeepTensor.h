@@ -1,11 +1,15 @@
 #pragma once
 
+#include <map>
+#include <mutex>
+#include <memory>
 #include "common.h"
 #include "neighbor_list.h"
 
 namespace deepmd{
 /**
 * @brief Deep Tensor.
+* @details As for DeepPot, VALUETYPE of the interfaces is independent of the precision of the model.
 **/
 class DeepTensor
 {
@@ -23,6 +27,7 @@ public:
   DeepTensor(const std::string & model, 
 	     const int & gpu_rank = 0, 
 	     const std::string &name_scope = "");
+  ~DeepTensor();
   /**
   * @brief Initialize the Deep Tensor.
   * @param[in] model The name of the frozen model file.
@@ -37,6 +42,19 @@ public:
   * @param[in] pre The prefix to each line.
   **/
   void print_summary(const std::string &pre) const;
+  /**
+  * @brief The outputs of the full evaluation, combined by bitwise or into an output mask.
+  * @details Only the masked outputs are fetched from the model, so the backward passes of
+  * the component-wise force and virial are skipped when they are not requested.
+  **/
+  enum Output {
+    OUTPUT_GLOBAL = 1,
+    OUTPUT_FORCE = 2,
+    OUTPUT_VIRIAL = 4,
+    OUTPUT_ATOM = 8,
+    OUTPUT_ATOM_VIRIAL = 16,
+    OUTPUT_ALL = 31
+  };
 public:
   /**
   * @brief Evaluate the value by using this model.
@@ -45,6 +63,7 @@ public:
   * @param[in] atype The atom types. The list should contain natoms ints.
   * @param[in] box The cell of the region. The array should be of size 9.
   **/
+  template<typename VALUETYPE>
   void compute (std::vector<VALUETYPE> &	value,
 		const std::vector<VALUETYPE> &	coord,
 		const std::vector<int> &	atype,
@@ -57,13 +76,16 @@ public:
   * @param[in] box The cell of the region. The array should be of size 9.
   * @param[in] nghost The number of ghost atoms.
   * @param[in] inlist The input neighbour list.
+  * @param[in] ago Update the internal neighbour list and the atom maps if ago is 0.
   **/
+  template<typename VALUETYPE>
   void compute (std::vector<VALUETYPE> &	value,
 		const std::vector<VALUETYPE> &	coord,
 		const std::vector<int> &	atype,
 		const std::vector<VALUETYPE> &	box, 
 		const int			nghost,
-		const InputNlist &	inlist);
+		const InputNlist &	inlist,
+		const int			ago = 0);
   /**
   * @brief Evaluate the global tensor and component-wise force and virial.
   * @param[out] global_tensor The global tensor to evalute.
@@ -73,6 +95,7 @@ public:
   * @param[in] atype The atom types. The list should contain natoms ints.
   * @param[in] box The cell of the region. The array should be of size 9.
   **/
+  template<typename VALUETYPE>
   void compute (std::vector<VALUETYPE> &	global_tensor,
 		std::vector<VALUETYPE> &	force,
 		std::vector<VALUETYPE> &	virial,
@@ -90,6 +113,7 @@ public:
   * @param[in] nghost The number of ghost atoms.
   * @param[in] inlist The input neighbour list.
   **/
+  template<typename VALUETYPE>
   void compute (std::vector<VALUETYPE> &	global_tensor,
 		std::vector<VALUETYPE> &	force,
 		std::vector<VALUETYPE> &	virial,
@@ -108,7 +132,9 @@ public:
   * @param[in] coord The coordinates of atoms. The array should be of size natoms x 3.
   * @param[in] atype The atom types. The list should contain natoms ints.
   * @param[in] box The cell of the region. The array should be of size 9.
+  * @param[in] output_mask The outputs to evaluate, a combination of Output. The outputs that are not masked are cleared.
   **/
+  template<typename VALUETYPE>
   void compute (std::vector<VALUETYPE> &	global_tensor,
 		std::vector<VALUETYPE> &	force,
 		std::vector<VALUETYPE> &	virial,
@@ -116,7 +142,8 @@ public:
 		std::vector<VALUETYPE> &	atom_virial,
 		const std::vector<VALUETYPE> &	coord,
 		const std::vector<int> &	atype,
-		const std::vector<VALUETYPE> &	box);
+		const std::vector<VALUETYPE> &	box,
+		const int			output_mask = OUTPUT_ALL);
   /**
   * @brief Evaluate the global tensor and component-wise force and virial.
   * @param[out] global_tensor The global tensor to evalute.
@@ -129,7 +156,9 @@ public:
   * @param[in] box The cell of the region. The array should be of size 9.
   * @param[in] nghost The number of ghost atoms.
   * @param[in] inlist The input neighbour list.
+  * @param[in] output_mask The outputs to evaluate, a combination of Output. The outputs that are not masked are cleared.
   **/
+  template<typename VALUETYPE>
   void compute (std::vector<VALUETYPE> &	global_tensor,
 		std::vector<VALUETYPE> &	force,
 		std::vector<VALUETYPE> &	virial,
@@ -139,12 +168,13 @@ public:
 		const std::vector<int> &	atype,
 		const std::vector<VALUETYPE> &	box, 
 		const int			nghost,
-		const InputNlist &	inlist);
+		const InputNlist &	inlist,
+		const int			output_mask = OUTPUT_ALL);
   /**
   * @brief Get the cutoff radius.
   * @return The cutoff radius.
   **/
-  VALUETYPE cutoff () const {assert(inited); return rcut;};
+  double cutoff () const {assert(inited); return rcut;};
   /**
   * @brief Get the number of types.
   * @return The number of types.
@@ -158,25 +188,41 @@ public:
   const std::vector<int> & sel_types () const {assert(inited); return sel_type;};
 private:
   tensorflow::Session* session;
+  std::unique_ptr<tensorflow::MemmappedEnv> mmap_env;
+  SessionCallable callable_tensor;
+  // the callables of the full evaluation, made on first use of each output mask
+  std::map<int, SessionCallable> callables_full;
+  std::mutex callables_mutex;
   std::string name_scope;
   int num_intra_nthreads, num_inter_nthreads;
   tensorflow::GraphDef graph_def;
   bool inited;
-  VALUETYPE rcut;
-  VALUETYPE cell_size;
+  double rcut;
+  double cell_size;
+  tensorflow::DataType dtype;
   int ntypes;
   std::string model_type;
   std::string model_version;
   int odim;
   std::vector<int> sel_type;
+  // the maps of the atoms in the neighbour list evaluation, rebuilt only when the neighbour list is (ago == 0)
+  std::vector<int> real_fwd_map, real_bkw_map, sel_fwd_map;
+  int nghost_real;
+  std::vector<int> datype_real;
+  NeighborListData nlist_data;
+  InputNlist nlist;
+  AtomMap atommap;
   template<class VT> VT get_scalar(const std::string & name) const;
   template<class VT> void get_vector (std::vector<VT> & vec, const std::string & name) const;
+  const SessionCallable & get_callable_full (const int output_mask);
+  template<typename MODELTYPE, typename VALUETYPE>
   void run_model (std::vector<VALUETYPE> &		d_tensor_,
 		  tensorflow::Session *			session, 
 		  const std::vector<std::pair<std::string, tensorflow::Tensor>> & input_tensors,
-		  const AtomMap<VALUETYPE> &		atommap, 
+		  const AtomMap &		atommap, 
 		  const std::vector<int> &		sel_fwd,
 		  const int				nghost = 0);
+  template<typename MODELTYPE, typename VALUETYPE>
   void run_model (std::vector<VALUETYPE> &		dglobal_tensor_,
 		  std::vector<VALUETYPE> &	dforce_,
 		  std::vector<VALUETYPE> &	dvirial_,
@@ -184,19 +230,23 @@ private:
 		  std::vector<VALUETYPE> &	datom_virial_,
 		  tensorflow::Session *			session, 
 		  const std::vector<std::pair<std::string, tensorflow::Tensor>> & input_tensors,
-		  const AtomMap<VALUETYPE> &		atommap, 
+		  const AtomMap &		atommap, 
 		  const std::vector<int> &		sel_fwd,
-		  const int				nghost = 0);
+		  const int				nghost,
+		  const int				output_mask);
+  template<typename VALUETYPE>
   void compute_inner (std::vector<VALUETYPE> &		value,
 		      const std::vector<VALUETYPE> &	coord,
 		      const std::vector<int> &		atype,
 		      const std::vector<VALUETYPE> &	box);
+  template<typename VALUETYPE>
   void compute_inner (std::vector<VALUETYPE> &		value,
 		      const std::vector<VALUETYPE> &	coord,
 		      const std::vector<int> &		atype,
 		      const std::vector<VALUETYPE> &	box, 
 		      const int				nghost,
 		      const InputNlist&			inlist);
+  template<typename VALUETYPE>
   void compute_inner (std::vector<VALUETYPE> &		global_tensor,
 		      std::vector<VALUETYPE> &	force,
 		      std::vector<VALUETYPE> &	virial,
@@ -204,7 +254,9 @@ private:
 		      std::vector<VALUETYPE> &	atom_virial,
 		      const std::vector<VALUETYPE> &	coord,
 		      const std::vector<int> &		atype,
-		      const std::vector<VALUETYPE> &	box);
+		      const std::vector<VALUETYPE> &	box,
+		      const int				output_mask);
+  template<typename VALUETYPE>
   void compute_inner (std::vector<VALUETYPE> &		global_tensor,
 		      std::vector<VALUETYPE> &	force,
 		      std::vector<VALUETYPE> &	virial,
@@ -214,7 +266,8 @@ private:
 		      const std::vector<int> &		atype,
 		      const std::vector<VALUETYPE> &	box, 
 		      const int				nghost,
-		      const InputNlist&			inlist);
+		      const InputNlist&			inlist,
+		      const int				output_mask);
 };
 }
 
@@ -12,6 +12,7 @@
 #include "tensorflow/core/public/version.h"
 #include <tensorflow/core/graph/default_device.h>
 #include <tensorflow/core/graph/graph_def_builder.h>
+#include <tensorflow/core/util/memmapped_file_system.h>
 
 
 namespace deepmd{
@@ -22,13 +23,9 @@ typedef tensorflow::tstring STRINGTYPE;
 typedef std::string STRINGTYPE;
 #endif
 
-#ifdef HIGH_PREC
-typedef double VALUETYPE;
+// the energy is always evaluated in double precision, the precision of 
+// the other inputs and outputs is a template parameter of the interfaces
 typedef double ENERGYTYPE;
-#else 
-typedef float  VALUETYPE;
-typedef double ENERGYTYPE;
-#endif
 
 struct NeighborListData 
 {
@@ -43,7 +40,7 @@ struct NeighborListData
 public:
   void copy_from_nlist(const InputNlist & inlist);
   void shuffle(const std::vector<int> & fwd_map);
-  void shuffle(const deepmd::AtomMap<VALUETYPE> & map);
+  void shuffle(const deepmd::AtomMap & map);
   void shuffle_exclude_empty(const std::vector<int> & fwd_map);
   void make_inlist(InputNlist & inlist);
 };
@@ -51,6 +48,46 @@ public:
 /** @struct deepmd::InputNlist
  **/
 
+/**
+* @brief The descriptor attributes of a model, read once from the graph.
+**/
+struct ModelMetadata
+{
+  /// The number of atom types
+  int ntypes;
+  /// The cutoff radius
+  double rcut;
+  /// The radius where the smooth switching of the environment matrix starts
+  double rcut_smth;
+  /// The maximal number of neighbors of each type. Empty if the descriptor is not se_a or se_r.
+  std::vector<int> sel;
+  /// Whether the embedding net is compressed into tables
+  bool compressed;
+};
+
+/**
+* @brief Read the model metadata from the descrpt_attr constants and the attributes of the descriptor op.
+* @param[out] metadata The model metadata.
+* @param[in] graph_def The graph of the model.
+* @param[in] scope The name scope of the model.
+**/
+void
+read_model_metadata(
+    ModelMetadata & metadata,
+    const tensorflow::GraphDef & graph_def,
+    const std::string scope = "");
+
+/**
+* @brief Get the floating point precision of a model, i.e. the dtype of its coordinate placeholder.
+* @param[in] graph_def The graph of the model.
+* @param[in] scope The name scope of the model.
+* @return DT_DOUBLE or DT_FLOAT.
+**/
+tensorflow::DataType
+model_dtype(
+    const tensorflow::GraphDef & graph_def,
+    const std::string scope = "");
+
 /**
 * @brief Check if the model version is supported.
 * @param[in] model_version The model version.
@@ -60,6 +97,7 @@ bool
 model_compatable(
     std::string & model_version);
 
+template<typename VALUETYPE>
 void 
 select_by_type(std::vector<int> & fwd_map,
 	       std::vector<int> & bkw_map,
@@ -69,6 +107,7 @@ select_by_type(std::vector<int> & fwd_map,
 	       const int & nghost,
 	       const std::vector<int> & sel_type_);
 
+template<typename VALUETYPE>
 void
 select_real_atoms(std::vector<int> & fwd_map,
 		  std::vector<int> & bkw_map,
@@ -146,18 +185,145 @@ session_get_vector(
     const std::string name_, 
     const std::string scope = "");
 
+/**
+* @brief Check if the model is in the memmapped package format (see `dp convert-to-mmap`).
+* @param[in] model The name of the frozen model file.
+* @return Whether the model is memmapped (true or false).
+**/
+bool
+model_is_memmapped(
+    const std::string & model);
+
+/**
+* @brief Load the graph of a frozen model. 
+* The constants of a memmapped model are mapped read-only from the file instead of being read, 
+* so all the processes on a node share one copy. 
+* The session should then be created by the returned environment.
+* @param[out] graph_def The graph.
+* @param[out] mmap_env The environment that maps the model. Reset if the model is not memmapped.
+* @param[in,out] options The session options. Set to use mmap_env if the model is memmapped.
+* @param[in] model The name of the frozen model file.
+* @param[in] file_content The content of the model file. If it is not empty, the graph is parsed from the string instead of the file.
+**/
+void
+load_graph_def(
+    tensorflow::GraphDef & graph_def,
+    std::unique_ptr<tensorflow::MemmappedEnv> & mmap_env,
+    tensorflow::SessionOptions & options,
+    const std::string & model,
+    const std::string & file_content = "");
+
+/**
+* @brief A callable pre-compiled by the session for a fixed set of feeds and fetches.
+**/
+struct SessionCallable
+{
+  /// The handle returned by tensorflow::Session::MakeCallable
+  tensorflow::Session::CallableHandle handle;
+  /// The names of the fed tensors, in the order expected by the callable
+  std::vector<std::string> feeds;
+  /// The names of the fetched tensors
+  std::vector<std::string> fetches;
+};
+
+/**
+* @brief Get the names of the tensors fed by session_input_tensors.
+* @param[in] has_fparam Whether the frame parameter is fed.
+* @param[in] has_aparam Whether the atomic parameter is fed.
+* @param[in] scope The name scope of the model.
+* @return The names of the fed tensors.
+**/
+std::vector<std::string>
+session_input_names(
+    const bool has_fparam,
+    const bool has_aparam,
+    const std::string scope = "");
+
+/**
+* @brief Build a callable from the feed and fetch names. The names are resolved once by the session.
+* @param[out] callable The callable.
+* @param[in] session TensorFlow session.
+* @param[in] feeds The names of the fed tensors.
+* @param[in] fetches The names of the fetched tensors.
+**/
+void
+session_make_callable(
+    SessionCallable & callable,
+    tensorflow::Session* session,
+    const std::vector<std::string> & feeds,
+    const std::vector<std::string> & fetches);
+
+/**
+* @brief Run a callable. The input tensors are reordered to match the feeds of the callable.
+* @param[out] output_tensors The fetched tensors, in the order of the fetches of the callable.
+* @param[in] session TensorFlow session.
+* @param[in] callable The callable.
+* @param[in] input_tensors The input tensors, e.g. made by session_input_tensors.
+**/
+void
+session_run_callable(
+    std::vector<tensorflow::Tensor> & output_tensors,
+    tensorflow::Session* session,
+    const SessionCallable & callable,
+    const std::vector<std::pair<std::string, tensorflow::Tensor>> & input_tensors);
+
+/**
+* @brief Release a callable. Never throws, so it is safe to call in destructors.
+* @param[in] session TensorFlow session.
+* @param[in] callable The callable.
+**/
+void
+session_release_callable(
+    tensorflow::Session* session,
+    const SessionCallable & callable);
+
+/**
+* @brief Pack the inputs into the tensors fed to the model. The coordinates, box and parameters 
+* are converted from VALUETYPE to the precision of the model (MODELTYPE) here, once per evaluation.
+* @param[out] input_tensors The input tensors.
+* @param[in] dcoord_ The coordinates of atoms.
+* @param[in] ntypes The number of atom types.
+* @param[in] datype_ The atom types.
+* @param[in] dbox The cell of the region.
+* @param[in] cell_size The cell size used to build the neighbor list in the graph.
+* @param[in] fparam_ The frame parameter.
+* @param[in] aparam_ The atomic parameter.
+* @param[in] atommap The map that sorts the atoms by type.
+* @param[in] scope The name scope of the model.
+* @return The number of local atoms.
+**/
+template<typename MODELTYPE, typename VALUETYPE>
 int
 session_input_tensors (std::vector<std::pair<std::string, tensorflow::Tensor>> & input_tensors,
 		       const std::vector<VALUETYPE> &	dcoord_,
 		       const int &			ntypes,
 		       const std::vector<int> &		datype_,
 		       const std::vector<VALUETYPE> &	dbox, 
-		       const VALUETYPE &		cell_size,
+		       const double &			cell_size,
 		       const std::vector<VALUETYPE> &	fparam_,
 		       const std::vector<VALUETYPE> &	aparam_,
-		       const deepmd::AtomMap<VALUETYPE>&atommap,
+		       const deepmd::AtomMap &		atommap,
 		       const std::string		scope = "");
 
+/**
+* @brief Pack the inputs and the neighbor list into the tensors fed to the model. The coordinates, 
+* box and parameters are converted from VALUETYPE to the precision of the model (MODELTYPE) here, 
+* once per evaluation.
+* @param[out] input_tensors The input tensors.
+* @param[in] dcoord_ The coordinates of atoms.
+* @param[in] ntypes The number of atom types.
+* @param[in] datype_ The atom types.
+* @param[in] dbox The cell of the region.
+* @param[in] dlist The neighbor list.
+* @param[in] fparam_ The frame parameter.
+* @param[in] aparam_ The atomic parameter.
+* @param[in] atommap The map that sorts the atoms by type.
+* @param[in] nghost The number of ghost atoms.
+* @param[in] ago Update the neighbor list in the graph if ago is 0.
+* @param[in] scope The name scope of the model.
+* @return The number of local atoms.
+**/
+template<typename MODELTYPE, typename VALUETYPE>
 int
 session_input_tensors (std::vector<std::pair<std::string, tensorflow::Tensor>> & input_tensors,
 		       const std::vector<VALUETYPE> &	dcoord_,
@@ -167,9 +333,8 @@ session_input_tensors (std::vector<std::pair<std::string, tensorflow::Tensor>> &
 		       InputNlist &		dlist, 
 		       const std::vector<VALUETYPE> &	fparam_,
 		       const std::vector<VALUETYPE> &	aparam_,
-		       const deepmd::AtomMap<VALUETYPE>&atommap,
+		       const deepmd::AtomMap &		atommap,
 		       const int			nghost,
 		       const int			ago,
 		       const std::string		scope = "");
 }
-
@@ -5,12 +5,10 @@
 
 using namespace deepmd;
 
-template <typename VALUETYPE>
-AtomMap<VALUETYPE>::
+AtomMap::
 AtomMap() {}
 
-template <typename VALUETYPE>
-AtomMap<VALUETYPE>::
+AtomMap::
 AtomMap(const std::vector<int >::const_iterator in_begin, 
 	   const std::vector<int >::const_iterator in_end)
 {
@@ -33,7 +31,7 @@ AtomMap(const std::vector<int >::const_iterator in_begin,
 
 template <typename VALUETYPE>
 void
-AtomMap<VALUETYPE>::
+AtomMap::
 forward (typename std::vector<VALUETYPE >::iterator out,
 	 const typename std::vector<VALUETYPE >::const_iterator in, 
 	 const int stride) const 
@@ -50,7 +48,7 @@ forward (typename std::vector<VALUETYPE >::iterator out,
 
 template <typename VALUETYPE>
 void
-AtomMap<VALUETYPE>::
+AtomMap::
 backward (typename std::vector<VALUETYPE >::iterator out,
 	  const typename std::vector<VALUETYPE >::const_iterator in, 
 	  const int stride) const 
@@ -65,6 +63,35 @@ backward (typename std::vector<VALUETYPE >::iterator out,
   }
 }
 
-template class AtomMap<float>;
-template class AtomMap<double>;
+template
+void
+AtomMap::
+forward <float> (
+    std::vector<float >::iterator out,
+    const std::vector<float >::const_iterator in, 
+    const int stride) const ;
+
+template
+void
+AtomMap::
+forward <double> (
+    std::vector<double >::iterator out,
+    const std::vector<double >::const_iterator in, 
+    const int stride) const ;
+
+template
+void
+AtomMap::
+backward <float> (
+    std::vector<float >::iterator out,
+    const std::vector<float >::const_iterator in, 
+    const int stride) const ;
+
+template
+void
+AtomMap::
+backward <double> (
+    std::vector<double >::iterator out,
+    const std::vector<double >::const_iterator in, 
+    const int stride) const ;
 
@@ -3,6 +3,19 @@
 using namespace deepmd;
 using namespace tensorflow;
 
+template<typename MODELTYPE, typename VALUETYPE>
+static void
+select_extf (MODELTYPE *			out,
+	     const std::vector<VALUETYPE> &	delef_,
+	     const std::vector<int> &		extf_idx)
+{
+  for (int ii = 0; ii < extf_idx.size(); ++ii){
+    for (int dd = 0; dd < 3; ++dd){
+      out[ii*3+dd] = delef_[extf_idx[ii]*3+dd];
+    }
+  }
+}
+
 DipoleChargeModifier::
 DipoleChargeModifier()
     : inited (false)
@@ -18,6 +31,14 @@ DipoleChargeModifier(const std::string & model,
   init(model, gpu_rank);  
 }
 
+DipoleChargeModifier::
+~DipoleChargeModifier()
+{
+  if (inited) {
+    session_release_callable(session, callable);
+  }
+}
+
 void
 DipoleChargeModifier::
 init (const std::string & model, 
@@ -33,19 +54,26 @@ init (const std::string & model,
   get_env_nthreads(num_intra_nthreads, num_inter_nthreads);
   options.config.set_inter_op_parallelism_threads(num_inter_nthreads);
   options.config.set_intra_op_parallelism_threads(num_intra_nthreads);
+  load_graph_def(graph_def, mmap_env, options, model);
   deepmd::check_status(NewSession(options, &session));
-  deepmd::check_status(ReadBinaryProto(Env::Default(), model, &graph_def));
   deepmd::check_status(session->Create(graph_def));  
   // int nnodes = graph_def.node_size();
   // for (int ii = 0; ii < nnodes; ++ii){
   //   cout << ii << " \t " << graph_def.node(ii).name() << endl;
   // }
-  rcut = get_scalar<VALUETYPE>("descrpt_attr/rcut");
+  ModelMetadata metadata;
+  read_model_metadata(metadata, graph_def, name_scope);
+  dtype = model_dtype(graph_def, name_scope);
+  rcut = metadata.rcut;
   cell_size = rcut;
   ntypes = get_scalar<int>("descrpt_attr/ntypes");
   model_type = get_scalar<STRINGTYPE>("model_attr/model_type");
   get_vector<int>(sel_type, "model_attr/sel_type");
   sort(sel_type.begin(), sel_type.end());
+  // the external field is fed after the inputs of session_input_tensors
+  std::vector<std::string> feeds = session_input_names(false, false, name_scope);
+  feeds.push_back("t_ef");
+  session_make_callable(callable, session, feeds, {"o_dm_force", "o_dm_virial", "o_dm_av"});
   inited = true;
 }
 
@@ -65,13 +93,15 @@ get_vector (std::vector<VT> & vec, const std::string & name) const
   session_get_vector<VT>(vec, session, name, name_scope);
 }
 
+template<typename MODELTYPE, typename VALUETYPE>
 void 
 DipoleChargeModifier::
 run_model (std::vector<VALUETYPE> &		dforce,
 	   std::vector<VALUETYPE> &		dvirial,
 	   Session *				session, 
+	   const SessionCallable &		callable,
 	   const std::vector<std::pair<std::string, Tensor>> & input_tensors,
-	   const AtomMap<VALUETYPE> &	atommap, 
+	   const AtomMap &	atommap, 
 	   const int				nghost)
 {
   unsigned nloc = atommap.get_type().size();
@@ -83,10 +113,7 @@ run_model (std::vector<VALUETYPE> &		dforce,
   }
 
   std::vector<Tensor> output_tensors;
-  deepmd::check_status (session->Run(input_tensors, 
-			    {"o_dm_force", "o_dm_virial", "o_dm_av"},
-			    {}, 
-			    &output_tensors));
+  session_run_callable (output_tensors, session, callable, input_tensors);
   int cc = 0;
   Tensor output_f = output_tensors[cc++];
   Tensor output_v = output_tensors[cc++];
@@ -103,8 +130,8 @@ run_model (std::vector<VALUETYPE> &		dforce,
   assert (output_av.dim_size(0) == nframes), "nframes should match";
   assert (output_av.dim_size(1) == natoms * 9), "dof of atom virial should be 9 * natoms";  
 
-  auto of = output_f.flat<VALUETYPE> ();
-  auto ov = output_v.flat<VALUETYPE> ();
+  auto of = output_f.flat<MODELTYPE> ();
+  auto ov = output_v.flat<MODELTYPE> ();
 
   dforce.resize(nall*3);
   dvirial.resize(9);
@@ -118,6 +145,57 @@ run_model (std::vector<VALUETYPE> &		dforce,
 
 
 
+template<typename VALUETYPE>
+void
+DipoleChargeModifier::
+make_maps (const std::vector<VALUETYPE> &		dcoord_,
+	   const std::vector<int> &		datype_,
+	   const std::vector<std::pair<int,int>>&	pairs,
+	   const int				nghost,
+	   const InputNlist &			lmp_list)
+{
+  select_real_atoms(real_fwd_map, real_bkw_map, nghost_real, dcoord_, datype_, nghost, ntypes);
+  int nall_real = real_bkw_map.size();
+  int nloc_real = nall_real - nghost_real;
+  datype_real.resize(nall_real);
+  select_map<int>(datype_real, datype_, real_fwd_map, 1);
+  if (nloc_real == 0){
+    return;
+  }
+  // internal nlist of the sorted real atoms
+  nlist_data.copy_from_nlist(lmp_list);
+  nlist_data.shuffle_exclude_empty(real_fwd_map);  
+  atommap = AtomMap (datype_real.begin(), datype_real.begin() + nloc_real);
+  assert (nloc_real == atommap.get_type().size());
+  nlist_data.shuffle(atommap);
+  nlist_data.make_inlist(nlist);
+  // original index of the atoms in the model order
+  const std::vector<int> & sort_bkw_map(atommap.get_bkw_map());
+  out_idx.resize(nall_real);
+  for (int ii = 0; ii < nloc_real; ++ii){
+    out_idx[ii] = real_bkw_map[sort_bkw_map[ii]];
+  }
+  for (int ii = nloc_real; ii < nall_real; ++ii){
+    out_idx[ii] = real_bkw_map[ii];
+  }
+  // bond idx map
+  std::vector<int > bd_idx(datype_.size(), -1);
+  for (int ii = 0; ii < pairs.size(); ++ii){
+    bd_idx[pairs[ii].first] = pairs[ii].second;
+  }
+  // the external field of the selected atoms is taken from their bonded virtual atoms
+  const std::vector<int> & dtype_sort_loc = atommap.get_type();
+  extf_idx.clear();
+  for (int ii = 0; ii < nloc_real; ++ii){
+    if (binary_search(sel_type.begin(), sel_type.end(), dtype_sort_loc[ii])){
+      int second_idx = bd_idx[out_idx[ii]];
+      assert(second_idx >= 0);
+      extf_idx.push_back(second_idx);
+    }
+  }
+}
+
+template<typename VALUETYPE>
 void
 DipoleChargeModifier::
 compute (std::vector<VALUETYPE> &		dfcorr_,
@@ -128,14 +206,15 @@ compute (std::vector<VALUETYPE> &		dfcorr_,
 	 const std::vector<std::pair<int,int>>&	pairs,
 	 const std::vector<VALUETYPE> &		delef_, 
 	 const int				nghost,
-	 const InputNlist &		lmp_list)
+	 const InputNlist &		lmp_list,
+	 const int				ago)
 {
-  // firstly do selection
   int nall = datype_.size();
   int nloc = nall - nghost;
-  int nghost_real;
-  std::vector<int > real_fwd_map, real_bkw_map;
-  select_real_atoms(real_fwd_map, real_bkw_map, nghost_real, dcoord_, datype_, nghost, ntypes);  
+  // the selection, sorting and bond maps only change with the neighbor list
+  if (ago == 0 || real_fwd_map.size() != nall) {
+    make_maps(dcoord_, datype_, pairs, nghost, lmp_list);
+  }
   int nall_real = real_bkw_map.size();
   int nloc_real = nall_real - nghost_real;
   if (nloc_real == 0){
@@ -145,103 +224,59 @@ compute (std::vector<VALUETYPE> &		dfcorr_,
     fill(dvcorr_.begin(), dvcorr_.end(), 0.0);
     return;
   }
-  // resize to nall_real
-  std::vector<VALUETYPE> dcoord_real;
-  std::vector<VALUETYPE> delef_real;
-  std::vector<int> datype_real;
-  dcoord_real.resize(nall_real * 3);
-  delef_real.resize(nall_real * 3);
-  datype_real.resize(nall_real);
   // fwd map
+  std::vector<VALUETYPE> dcoord_real(nall_real * 3);
   select_map<VALUETYPE>(dcoord_real, dcoord_, real_fwd_map, 3);
-  select_map<VALUETYPE>(delef_real, delef_, real_fwd_map, 3);
-  select_map<int>(datype_real, datype_, real_fwd_map, 1);
-  // internal nlist
-  NeighborListData nlist_data;
-  nlist_data.copy_from_nlist(lmp_list);
-  nlist_data.shuffle_exclude_empty(real_fwd_map);  
-  // sort atoms
-  AtomMap<VALUETYPE> atommap (datype_real.begin(), datype_real.begin() + nloc_real);
-  assert (nloc_real == atommap.get_type().size());
-  const std::vector<int> & sort_fwd_map(atommap.get_fwd_map());
-  const std::vector<int> & sort_bkw_map(atommap.get_bkw_map());
-  // shuffle nlist
-  nlist_data.shuffle(atommap);
-  InputNlist nlist;
-  nlist_data.make_inlist(nlist);
   // make input tensors
   std::vector<std::pair<std::string, Tensor>> input_tensors;
-  int ret = session_input_tensors (input_tensors, dcoord_real, ntypes, datype_real, dbox, nlist, std::vector<VALUETYPE>(), std::vector<VALUETYPE>(), atommap, nghost_real, 0, name_scope);
-  assert (nloc_real == ret);
-  // make bond idx map
-  std::vector<int > bd_idx(nall, -1);
-  for (int ii = 0; ii < pairs.size(); ++ii){
-    bd_idx[pairs[ii].first] = pairs[ii].second;
+  int ret;
+  if (dtype == DT_DOUBLE) {
+    ret = session_input_tensors<double> (input_tensors, dcoord_real, ntypes, datype_real, dbox, nlist, std::vector<VALUETYPE>(), std::vector<VALUETYPE>(), atommap, nghost_real, ago, name_scope);
   }
-  // make extf by bond idx map
-  std::vector<int > dtype_sort_loc = atommap.get_type();
-  std::vector<VALUETYPE> dextf;
-  for(int ii = 0; ii < dtype_sort_loc.size(); ++ii){
-    if (binary_search(sel_type.begin(), sel_type.end(), dtype_sort_loc[ii])){
-      // selected atom
-      int first_idx = real_bkw_map[sort_bkw_map[ii]];
-      int second_idx = bd_idx[first_idx];
-      assert(second_idx >= 0);
-      dextf.push_back(delef_[second_idx*3+0]);
-      dextf.push_back(delef_[second_idx*3+1]);
-      dextf.push_back(delef_[second_idx*3+2]);
-    }
+  else {
+    ret = session_input_tensors<float> (input_tensors, dcoord_real, ntypes, datype_real, dbox, nlist, std::vector<VALUETYPE>(), std::vector<VALUETYPE>(), atommap, nghost_real, ago, name_scope);
   }
+  assert (nloc_real == ret);
   // dextf should be loc and virtual
-  assert(dextf.size() == (nloc - nloc_real)*3);
+  assert(extf_idx.size() == nloc - nloc_real);
   // make tensor for extf
   int nframes = 1;
   TensorShape extf_shape ;
   extf_shape.AddDim (nframes);
-  extf_shape.AddDim (dextf.size());
-#ifdef HIGH_PREC
-  Tensor extf_tensor	(DT_DOUBLE, extf_shape);
-#else
-  Tensor extf_tensor	(DT_FLOAT, extf_shape);
-#endif
-  auto extf = extf_tensor.matrix<VALUETYPE> ();
-  for (int ii = 0; ii < nframes; ++ii){
-    for (int jj = 0; jj < extf.size(); ++jj){
-      extf(ii,jj) = dextf[jj];
-    }
+  extf_shape.AddDim (extf_idx.size() * 3);
+  Tensor extf_tensor	(dtype, extf_shape);
+  if (dtype == DT_DOUBLE) {
+    select_extf(extf_tensor.flat<double>().data(), delef_, extf_idx);
+  }
+  else {
+    select_extf(extf_tensor.flat<float>().data(), delef_, extf_idx);
   }
   // append extf to input tensor
   input_tensors.push_back({"t_ef", extf_tensor});  
   // run model
   std::vector<VALUETYPE> dfcorr, dvcorr;
-  run_model (dfcorr, dvcorr, session, input_tensors, atommap, nghost_real);
+  if (dtype == DT_DOUBLE) {
+    run_model<double> (dfcorr, dvcorr, session, callable, input_tensors, atommap, nghost_real);
+  }
+  else {
+    run_model<float> (dfcorr, dvcorr, session, callable, input_tensors, atommap, nghost_real);
+  }
   assert(dfcorr.size() == nall_real * 3);
-  // back map force
-  std::vector<VALUETYPE> dfcorr_1 = dfcorr;
-  atommap.backward (dfcorr_1.begin(), dfcorr.begin(), 3);
-  assert(dfcorr_1.size() == nall_real * 3);
-  // resize to all and clear
-  std::vector<VALUETYPE> dfcorr_2(nall*3);
-  fill(dfcorr_2.begin(), dfcorr_2.end(), 0.0);
   // back map to original position
+  dfcorr_.resize(nall * 3);
+  fill(dfcorr_.begin(), dfcorr_.end(), 0.0);
   for (int ii = 0; ii < nall_real; ++ii){
     for (int dd = 0; dd < 3; ++dd){
-      dfcorr_2[real_bkw_map[ii]*3+dd] += dfcorr_1[ii*3+dd];
+      dfcorr_[out_idx[ii]*3+dd] += dfcorr[ii*3+dd];
     }
   }
   // self correction of bonded force
   for (int ii = 0; ii < pairs.size(); ++ii){
     for (int dd = 0; dd < 3; ++dd){
-      dfcorr_2[pairs[ii].first*3+dd] += delef_[pairs[ii].second*3+dd];
+      dfcorr_[pairs[ii].first*3+dd] += delef_[pairs[ii].second*3+dd];
     }    
   }
   // add ele contrinution
-  dfcorr_ = dfcorr_2;
-  // for (int ii = 0; ii < nloc; ++ii){
-  //   for (int dd = 0; dd < 3; ++dd){
-  //     dfcorr_[ii*3+dd] += delef_[ii*3+dd];
-  //   }
-  // }  
   for (int ii = 0; ii < nloc_real; ++ii){
     int oii = real_bkw_map[ii];
     for (int dd = 0; dd < 3; ++dd){
@@ -250,3 +285,31 @@ compute (std::vector<VALUETYPE> &		dfcorr_,
   }
   dvcorr_ = dvcorr;
 }
+
+template
+void
+DipoleChargeModifier::
+compute<double> (std::vector<double> &		dfcorr_,
+	 std::vector<double> &		dvcorr_,
+	 const std::vector<double> &		dcoord_,
+	 const std::vector<int> &		datype_,
+	 const std::vector<double> &		dbox, 
+	 const std::vector<std::pair<int,int>>&	pairs,
+	 const std::vector<double> &		delef_, 
+	 const int				nghost,
+	 const InputNlist &			lmp_list,
+	 const int				ago);
+
+template
+void
+DipoleChargeModifier::
+compute<float> (std::vector<float> &		dfcorr_,
+	 std::vector<float> &		dvcorr_,
+	 const std::vector<float> &		dcoord_,
+	 const std::vector<int> &		datype_,
+	 const std::vector<float> &		dbox, 
+	 const std::vector<std::pair<int,int>>&	pairs,
+	 const std::vector<float> &		delef_, 
+	 const int				nghost,
+	 const InputNlist &			lmp_list,
+	 const int				ago);
@@ -18,13 +18,15 @@ std::vector<int> cum_sum (const std::vector<int32> & n_sel) {
 }
 
 
+template<typename MODELTYPE, typename VALUETYPE>
 static void 
 run_model (ENERGYTYPE &			dener,
 	   std::vector<VALUETYPE> &	dforce_,
 	   std::vector<VALUETYPE> &	dvirial,
 	   Session *			session, 
+	   const SessionCallable &	callable,
 	   const std::vector<std::pair<std::string, Tensor>> & input_tensors,
-	   const AtomMap<VALUETYPE>&	atommap, 
+	   const AtomMap &	atommap, 
 	   const int			nghost = 0)
 {
   unsigned nloc = atommap.get_type().size();
@@ -41,19 +43,18 @@ run_model (ENERGYTYPE &			dener,
     return;
   }
 
+  // fetches: o_energy, o_force, o_virial
+  // the atomic virial is not fetched, so the graph skips computing it
   std::vector<Tensor> output_tensors;
-  check_status (session->Run(input_tensors, 
-			    {"o_energy", "o_force", "o_atom_energy", "o_atom_virial"}, 
-			    {}, 
-			    &output_tensors));
+  session_run_callable (output_tensors, session, callable, input_tensors);
   
   Tensor output_e = output_tensors[0];
   Tensor output_f = output_tensors[1];
-  Tensor output_av = output_tensors[3];
+  Tensor output_v = output_tensors[2];
 
   auto oe = output_e.flat <ENERGYTYPE> ();
-  auto of = output_f.flat <VALUETYPE> ();
-  auto oav = output_av.flat <VALUETYPE> ();
+  auto of = output_f.flat <MODELTYPE> ();
+  auto ov = output_v.flat <MODELTYPE> ();
 
   dener = oe(0);
   std::vector<VALUETYPE> dforce (3 * nall);
@@ -61,29 +62,23 @@ run_model (ENERGYTYPE &			dener,
   for (unsigned ii = 0; ii < nall * 3; ++ii){
     dforce[ii] = of(ii);
   }
-  for (int ii = 0; ii < nall; ++ii) {
-    dvirial[0] += 1.0 * oav(9*ii+0);
-    dvirial[1] += 1.0 * oav(9*ii+1);
-    dvirial[2] += 1.0 * oav(9*ii+2);
-    dvirial[3] += 1.0 * oav(9*ii+3);
-    dvirial[4] += 1.0 * oav(9*ii+4);
-    dvirial[5] += 1.0 * oav(9*ii+5);
-    dvirial[6] += 1.0 * oav(9*ii+6);
-    dvirial[7] += 1.0 * oav(9*ii+7);
-    dvirial[8] += 1.0 * oav(9*ii+8);
+  for (int ii = 0; ii < 9; ++ii) {
+    dvirial[ii] = ov(ii);
   }
   dforce_ = dforce;
-  atommap.backward (dforce_.begin(), dforce.begin(), 3);
+  atommap.backward<VALUETYPE> (dforce_.begin(), dforce.begin(), 3);
 }
 
+template<typename MODELTYPE, typename VALUETYPE>
 static void run_model (ENERGYTYPE   &		dener,
 		       std::vector<VALUETYPE>&	dforce_,
 		       std::vector<VALUETYPE>&	dvirial,	   
 		       std::vector<VALUETYPE>&	datom_energy_,
 		       std::vector<VALUETYPE>&	datom_virial_,
 		       Session*			session, 
+		       const SessionCallable &	callable,
 		       const std::vector<std::pair<std::string, Tensor>> & input_tensors,
-		       const deepmd::AtomMap<VALUETYPE> &   atommap, 
+		       const deepmd::AtomMap &   atommap, 
 		       const int&		nghost = 0)
 {
     unsigned nloc = atommap.get_type().size();
@@ -105,12 +100,9 @@ static void run_model (ENERGYTYPE   &		dener,
         fill(datom_virial_.begin(), datom_virial_.end(), 0.0);
         return;
     }
+    // fetches: o_energy, o_force, o_atom_energy, o_atom_virial
     std::vector<Tensor> output_tensors;
-
-    check_status (session->Run(input_tensors, 
-			    {"o_energy", "o_force", "o_atom_energy", "o_atom_virial"}, 
-			    {},
-			    &output_tensors));
+    session_run_callable (output_tensors, session, callable, input_tensors);
 
     Tensor output_e = output_tensors[0];
     Tensor output_f = output_tensors[1];
@@ -118,9 +110,9 @@ static void run_model (ENERGYTYPE   &		dener,
     Tensor output_av = output_tensors[3];
 
     auto oe = output_e.flat <ENERGYTYPE> ();
-    auto of = output_f.flat <VALUETYPE> ();
-    auto oae = output_ae.flat <VALUETYPE> ();
-    auto oav = output_av.flat <VALUETYPE> ();
+    auto of = output_f.flat <MODELTYPE> ();
+    auto oae = output_ae.flat <MODELTYPE> ();
+    auto oav = output_av.flat <MODELTYPE> ();
 
     dener = oe(0);
     std::vector<VALUETYPE> dforce (3 * nall);
@@ -150,28 +142,39 @@ static void run_model (ENERGYTYPE   &		dener,
     dforce_ = dforce;
     datom_energy_ = datom_energy;
     datom_virial_ = datom_virial;
-    atommap.backward (dforce_.begin(), dforce.begin(), 3);
-    atommap.backward (datom_energy_.begin(), datom_energy.begin(), 1);
-    atommap.backward (datom_virial_.begin(), datom_virial.begin(), 9);
+    atommap.backward<VALUETYPE> (dforce_.begin(), dforce.begin(), 3);
+    atommap.backward<VALUETYPE> (datom_energy_.begin(), datom_energy.begin(), 1);
+    atommap.backward<VALUETYPE> (datom_virial_.begin(), datom_virial.begin(), 9);
 }
 
 
 DeepPot::
 DeepPot ()
-    : inited (false), init_nbor (false)
+    : inited (false), init_nbor (false),
+      pad_bucket (0), nlist_pad_bucket (0), phantom_ready (false)
 {
   get_env_nthreads(num_intra_nthreads, num_inter_nthreads);
 }
 
 DeepPot::
 DeepPot (const std::string & model, const int & gpu_rank, const std::string & file_content)
-    : inited (false), init_nbor (false)
+    : inited (false), init_nbor (false),
+      pad_bucket (0), nlist_pad_bucket (0), phantom_ready (false)
 {
   get_env_nthreads(num_intra_nthreads, num_inter_nthreads);
   init(model, gpu_rank, file_content);  
 }
 
-DeepPot::~DeepPot() {}
+DeepPot::~DeepPot() 
+{
+  // the posted evaluations use the session
+  async_worker.reset();
+  if (inited) {
+    session_release_callable(session, callable);
+    session_release_callable(session, callable_atomic);
+    delete session;
+  }
+}
 
 void
 DeepPot::
@@ -186,10 +189,7 @@ init (const std::string & model, const int & gpu_rank, const std::string & file_
   options.config.set_inter_op_parallelism_threads(num_inter_nthreads);
   options.config.set_intra_op_parallelism_threads(num_intra_nthreads);
 
-  if(file_content.size() == 0)
-    check_status (ReadBinaryProto(Env::Default(), model, &graph_def));
-  else
-    graph_def.ParseFromString(file_content);
+  load_graph_def(graph_def, mmap_env, options, model, file_content);
   int gpu_num = -1;
   #if GOOGLE_CUDA || TENSORFLOW_USE_ROCM
   DPGetDeviceCount(gpu_num); // check current device environment
@@ -205,9 +205,11 @@ init (const std::string & model, const int & gpu_rank, const std::string & file_
   #endif // GOOGLE_CUDA || TENSORFLOW_USE_ROCM
   check_status (NewSession(options, &session));
   check_status (session->Create(graph_def));
-  rcut = get_scalar<VALUETYPE>("descrpt_attr/rcut");
+  read_model_metadata(metadata, graph_def);
+  dtype = model_dtype(graph_def);
+  rcut = metadata.rcut;
   cell_size = rcut;
-  ntypes = get_scalar<int>("descrpt_attr/ntypes");
+  ntypes = metadata.ntypes;
   dfparam = get_scalar<int>("fitting_attr/dfparam");
   daparam = get_scalar<int>("fitting_attr/daparam");
   if (dfparam < 0) dfparam = 0;
@@ -225,11 +227,112 @@ init (const std::string & model, const int & gpu_rank, const std::string & file_
 	+ " in graph, but version " + global_model_version 
 	+ " supported ");
   }
+  // resolve the feeds and fetches once, the steps only run the callables
+  std::vector<std::string> feeds = session_input_names(dfparam > 0, daparam > 0);
+  session_make_callable(callable, session, feeds, {"o_energy", "o_force", "o_virial"});
+  session_make_callable(callable_atomic, session, feeds, {"o_energy", "o_force", "o_atom_energy", "o_atom_virial"});
+  async_worker.reset(new thread::ThreadPool(Env::Default(), "deepmd_async", 1));
   inited = true;
   
   init_nbor = false;
 }
 
+void
+DeepPot::
+reload_async (const std::string & model, const int & gpu_rank, const std::string & file_content)
+{
+  // a model still being loaded by the last call is waited for and discarded
+  reload_job = std::async(std::launch::async, [model, gpu_rank, file_content] () {
+    return std::unique_ptr<DeepPot> (new DeepPot(model, gpu_rank, file_content));
+  });
+}
+
+bool
+DeepPot::
+reload_ready () const
+{
+  return reload_job.valid() && reload_job.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+bool
+DeepPot::
+commit_reload (const bool wait)
+{
+  if (! reload_job.valid()) return false;
+  if (! wait && ! reload_ready()) return false;
+  std::unique_ptr<DeepPot> dp = reload_job.get();
+  if (inited && (dp->rcut != rcut || dp->ntypes != ntypes || dp->dfparam != dfparam || dp->daparam != daparam)) {
+    throw std::runtime_error("the reloaded model should have the same cutoff radius, number of types and dims of fparam and aparam");
+  }
+  // the old model is released with dp
+  swap_model(*dp);
+  return true;
+}
+
+void
+DeepPot::
+swap_model (DeepPot & dp)
+{
+  // join the evaluations posted to both models, the new worker runs the swapped model
+  async_worker.reset(new thread::ThreadPool(Env::Default(), "deepmd_async", 1));
+  dp.async_worker.reset();
+  std::swap(session, dp.session);
+  mmap_env.swap(dp.mmap_env);
+  std::swap(callable, dp.callable);
+  std::swap(callable_atomic, dp.callable_atomic);
+  graph_def.Swap(&dp.graph_def);
+  std::swap(metadata, dp.metadata);
+  std::swap(inited, dp.inited);
+  std::swap(rcut, dp.rcut);
+  std::swap(cell_size, dp.cell_size);
+  std::swap(dtype, dp.dtype);
+  std::swap(model_type, dp.model_type);
+  std::swap(model_version, dp.model_version);
+  std::swap(ntypes, dp.ntypes);
+  std::swap(dfparam, dp.dfparam);
+  std::swap(daparam, dp.daparam);
+  // the neighbor list and atom map do not depend on the model, they are kept
+  phantom_ready = false;
+  dp.phantom_ready = false;
+}
+
+void
+DeepPot::
+set_padding (const int bucket)
+{
+  if (bucket < 0) {
+    throw std::runtime_error("the padding bucket should be >= 0");
+  }
+  pad_bucket = bucket;
+}
+
+ENERGYTYPE
+DeepPot::
+get_phantom_energy ()
+{
+  if (! phantom_ready) {
+    // a phantom atom has no neighbor, so its energy is the one of an isolated atom of type 0
+    std::vector<double> coord (3, 0.), box (9, 0.), force, virial;
+    box[0] = box[4] = box[8] = 100.;
+    std::vector<int> atype (1, 0);
+    int ilist = 0, numneigh = 0;
+    int * firstneigh = NULL;
+    InputNlist inlist (1, &ilist, &numneigh, &firstneigh);
+    AtomMap map (atype.begin(), atype.end());
+    std::vector<std::pair<std::string, Tensor>> input_tensors;
+    if (dtype == DT_DOUBLE) {
+      session_input_tensors<double> (input_tensors, coord, ntypes, atype, box, inlist, std::vector<double>(), std::vector<double>(), map, 0, 0);
+      run_model<double> (phantom_ener, force, virial, session, callable, input_tensors, map);
+    }
+    else {
+      session_input_tensors<float> (input_tensors, coord, ntypes, atype, box, inlist, std::vector<double>(), std::vector<double>(), map, 0, 0);
+      run_model<float> (phantom_ener, force, virial, session, callable, input_tensors, map);
+    }
+    phantom_ready = true;
+  }
+  return phantom_ener;
+}
+
 void 
 DeepPot::
 print_summary(const std::string &pre) const
@@ -255,51 +358,14 @@ get_scalar (const std::string & name) const
   return session_get_scalar<VT>(session, name);
 }
 
-std::string graph_info(const GraphDef & graph_def) {
-    // std::stringstream buffer;
-    // std::streambuf * old = std::cout.rdbuf(buffer.rdbuf());
-    std::string str = "";
-    for (int ii = 0; ii < graph_def.node_size(); ii++) {
-        if (graph_def.node(ii).name() == "DescrptSeA") {
-            // str = graph_def.node(ii).PrintDebugString();
-            str = graph_def.node(ii).DebugString();
-            return str;
-            // std::cout << str << std::endl;
-        }
-        if (graph_def.node(ii).name() == "DescrptSeR") {
-            // str = graph_def.node(ii).PrintDebugString();
-            str = graph_def.node(ii).DebugString();
-            return str;
-            // std::cout << str << std::endl;
-        }
-    }
-    return str;
-}
-
-// init the tmp array data
-std::vector<int> DeepPot::get_sel_a () const {
-    std::vector<int> sel_a;
-    std::istringstream is(graph_info(graph_def));
-    std::string line = "";
-    while(is >> line) {
-        if (line.find("sel_a") != line.npos) {
-            while (std::getline(is, line) && line != "}") {
-                if (line.find("i:") != line.npos) {
-                    sel_a.push_back(atoi((line.substr(line.find("i:") + 2)).c_str()));
-                }
-            } break;
-        }
-        if (line.find("sel") != line.npos) {
-            while (std::getline(is, line) && line != "}") {
-                if (line.find("i:") != line.npos) {
-                    sel_a.push_back(atoi((line.substr(line.find("i:") + 2)).c_str()));
-                }
-            } break;
-        }
-    }
-    return sel_a;
+std::vector<int> 
+DeepPot::
+get_sel_a () const 
+{
+  return metadata.sel;
 }
 
+template<typename VALUETYPE>
 void
 DeepPot::
 validate_fparam_aparam(const int & nloc,
@@ -314,6 +380,7 @@ validate_fparam_aparam(const int & nloc,
   }  
 }
 
+template<typename VALUETYPE>
 void
 DeepPot::
 compute (ENERGYTYPE &			dener,
@@ -327,17 +394,24 @@ compute (ENERGYTYPE &			dener,
 {
   int nall = dcoord_.size() / 3;
   int nloc = nall;
-  atommap = deepmd::AtomMap<VALUETYPE> (datype_.begin(), datype_.begin() + nloc);
+  atommap = deepmd::AtomMap (datype_.begin(), datype_.begin() + nloc);
   assert (nloc == atommap.get_type().size());
   validate_fparam_aparam(nloc, fparam, aparam);
 
   std::vector<std::pair<std::string, Tensor>> input_tensors;
-  int ret = session_input_tensors (input_tensors, dcoord_, ntypes, datype_, dbox, cell_size, fparam, aparam, atommap);
-  assert (ret == nloc);
-
-  run_model (dener, dforce_, dvirial, session, input_tensors, atommap);
+  if (dtype == DT_DOUBLE) {
+    int ret = session_input_tensors<double> (input_tensors, dcoord_, ntypes, datype_, dbox, cell_size, fparam, aparam, atommap);
+    assert (ret == nloc);
+    run_model<double> (dener, dforce_, dvirial, session, callable, input_tensors, atommap);
+  }
+  else {
+    int ret = session_input_tensors<float> (input_tensors, dcoord_, ntypes, datype_, dbox, cell_size, fparam, aparam, atommap);
+    assert (ret == nloc);
+    run_model<float> (dener, dforce_, dvirial, session, callable, input_tensors, atommap);
+  }
 }
 
+template<typename VALUETYPE>
 void
 DeepPot::
 compute (ENERGYTYPE &			dener,
@@ -352,64 +426,153 @@ compute (ENERGYTYPE &			dener,
 	 const std::vector<VALUETYPE> &	fparam,
 	 const std::vector<VALUETYPE> &	aparam_)
 {
-  std::vector<VALUETYPE> dcoord, dforce, aparam;
-  std::vector<int> datype, fwd_map, bkw_map;
-  int nghost_real;
-  select_real_atoms(fwd_map, bkw_map, nghost_real, dcoord_, datype_, nghost, ntypes);
-  // resize to nall_real
-  dcoord.resize(bkw_map.size() * 3);
-  datype.resize(bkw_map.size());
-  // fwd map
-  select_map<VALUETYPE>(dcoord, dcoord_, fwd_map, 3);
-  select_map<int>(datype, datype_, fwd_map, 1);
-  // aparam
-  if (daparam > 0){
-    aparam.resize(bkw_map.size());
-    select_map<VALUETYPE>(aparam, aparam_, fwd_map, daparam);
+  std::vector<std::pair<std::string, Tensor>> input_tensors;
+  std::vector<int> bkw_map;
+  int nphantom;
+  int nghost_real = make_input_tensors(input_tensors, bkw_map, nphantom, dcoord_, datype_, dbox, nghost, lmp_list, ago, fparam, aparam_);
+  std::vector<VALUETYPE> dforce;
+  if (dtype == DT_DOUBLE) {
+    run_model<double> (dener, dforce, dvirial, session, callable, input_tensors, atommap, nghost_real);
   }
-  // internal nlist
-  if (ago == 0){
-    nlist_data.copy_from_nlist(lmp_list);
-    nlist_data.shuffle_exclude_empty(fwd_map);  
+  else {
+    run_model<float> (dener, dforce, dvirial, session, callable, input_tensors, atommap, nghost_real);
+  }
+  if (nphantom > 0) {
+    dener -= nphantom * get_phantom_energy();
   }
-  compute_inner(dener, dforce, dvirial, dcoord, datype, dbox, nghost_real, ago, fparam, aparam);
   // bkw map
-  dforce_.resize(fwd_map.size() * 3);
+  dforce_.resize(dcoord_.size());
   select_map<VALUETYPE>(dforce_, dforce, bkw_map, 3);
 }
 
-void
+template<typename VALUETYPE>
+std::future<void>
 DeepPot::
-compute_inner (ENERGYTYPE &			dener,
+compute_async (ENERGYTYPE &			dener,
 	       std::vector<VALUETYPE> &		dforce_,
 	       std::vector<VALUETYPE> &		dvirial,
 	       const std::vector<VALUETYPE> &	dcoord_,
 	       const std::vector<int> &		datype_,
 	       const std::vector<VALUETYPE> &	dbox, 
 	       const int			nghost,
+	       const InputNlist &		lmp_list,
 	       const int&			ago,
 	       const std::vector<VALUETYPE> &	fparam,
-	       const std::vector<VALUETYPE> &	aparam)
+	       const std::vector<VALUETYPE> &	aparam_)
 {
+  // the inputs are copied into the tensors here, only the session runs on the other thread
+  std::vector<std::pair<std::string, Tensor>> input_tensors;
+  std::vector<int> bkw_map;
+  int nphantom;
+  int nghost_real = make_input_tensors(input_tensors, bkw_map, nphantom, dcoord_, datype_, dbox, nghost, lmp_list, ago, fparam, aparam_);
   int nall = dcoord_.size() / 3;
-  int nloc = nall - nghost;
-
-    validate_fparam_aparam(nloc, fparam, aparam);
-    std::vector<std::pair<std::string, Tensor>> input_tensors;
+  ENERGYTYPE phantom_ener = nphantom > 0 ? nphantom * get_phantom_energy() : 0.;
+  std::shared_ptr<std::packaged_task<void()> > task (new std::packaged_task<void()> ([this, &dener, &dforce_, &dvirial, input_tensors, bkw_map, nghost_real, nall, phantom_ener] () {
+    std::vector<VALUETYPE> dforce;
+    if (dtype == DT_DOUBLE) {
+      run_model<double> (dener, dforce, dvirial, session, callable, input_tensors, atommap, nghost_real);
+    }
+    else {
+      run_model<float> (dener, dforce, dvirial, session, callable, input_tensors, atommap, nghost_real);
+    }
+    dener -= phantom_ener;
+    dforce_.resize(nall * 3);
+    select_map<VALUETYPE>(dforce_, dforce, bkw_map, 3);
+  }));
+  std::future<void> job = task->get_future();
+  // the exceptions of the evaluation are rethrown by the future
+  async_worker->Schedule([task] () { (*task)(); });
+  return job;
+}
 
-    // agp == 0 means that the LAMMPS nbor list has been updated
-    if (ago == 0) {
-      atommap = deepmd::AtomMap<VALUETYPE> (datype_.begin(), datype_.begin() + nloc);
-      assert (nloc == atommap.get_type().size());
-      nlist_data.shuffle(atommap);
-      nlist_data.make_inlist(nlist);
+template<typename VALUETYPE>
+int
+DeepPot::
+make_input_tensors (std::vector<std::pair<std::string, Tensor>> & input_tensors,
+		    std::vector<int> &			bkw_map,
+		    int &				nphantom,
+		    const std::vector<VALUETYPE> &	dcoord_,
+		    const std::vector<int> &		datype_,
+		    const std::vector<VALUETYPE> &	dbox, 
+		    const int				nghost,
+		    const InputNlist &			lmp_list,
+		    const int&				ago,
+		    const std::vector<VALUETYPE> &	fparam,
+		    const std::vector<VALUETYPE> &	aparam_)
+{
+  std::vector<VALUETYPE> dcoord, aparam;
+  std::vector<int> datype, fwd_map;
+  int nghost_real;
+  select_real_atoms(fwd_map, bkw_map, nghost_real, dcoord_, datype_, nghost, ntypes);
+  if (ago == 0) {
+    nlist_pad_bucket = (dfparam == 0 && daparam == 0) ? pad_bucket : 0;
+  }
+  nphantom = 0;
+  int nall_real = bkw_map.size();
+  int nloc_real = nall_real - nghost_real;
+  if (nlist_pad_bucket > 0 && nloc_real > 0) {
+    // the phantom locals follow the real locals, and the phantom ghosts follow the real ghosts.
+    // They are of type 0 at the origin, and are left out of the neighbor lists.
+    const int bucket = nlist_pad_bucket;
+    nphantom = (nloc_real + bucket - 1) / bucket * bucket - nloc_real;
+    int nall_pad = (nall_real + nphantom + bucket - 1) / bucket * bucket;
+    std::vector<int> pad_bkw_map (nall_pad, -1);
+    for (int ii = 0; ii < nall_real; ++ii) {
+      pad_bkw_map[ii < nloc_real ? ii : ii + nphantom] = bkw_map[ii];
     }
-    int ret = session_input_tensors (input_tensors, dcoord_, ntypes, datype_, dbox, nlist, fparam, aparam, atommap, nghost, ago);
-    assert (nloc == ret);
-    run_model (dener, dforce_, dvirial, session, input_tensors, atommap, nghost);
+    bkw_map.swap(pad_bkw_map);
+    for (unsigned ii = 0; ii < fwd_map.size(); ++ii) {
+      if (fwd_map[ii] >= nloc_real) fwd_map[ii] += nphantom;
+    }
+    nghost_real = nall_pad - nloc_real - nphantom;
+    // the descriptors count the phantom locals as center atoms without neighbors
+    if (nlist_stat_enabled()) {
+      nlist_stat_add_phantom(nphantom);
+    }
+  }
+  // resize to the atoms fed to the model
+  dcoord.resize(bkw_map.size() * 3);
+  datype.resize(bkw_map.size());
+  // fwd map
+  select_map<VALUETYPE>(dcoord, dcoord_, fwd_map, 3);
+  select_map<int>(datype, datype_, fwd_map, 1);
+  // aparam
+  if (daparam > 0){
+    aparam.resize(nloc_real * daparam);
+    select_map<VALUETYPE>(aparam, aparam_, fwd_map, daparam);
+  }
+  // internal nlist
+  if (ago == 0){
+    nlist_data.copy_from_nlist(lmp_list);
+    nlist_data.shuffle_exclude_empty(fwd_map);  
+    for (int ii = nloc_real; ii < nloc_real + nphantom; ++ii) {
+      nlist_data.ilist.push_back(ii);
+      nlist_data.jlist.push_back(std::vector<int>());
+    }
+  }
+  int nall = dcoord.size() / 3;
+  int nloc = nall - nghost_real;
+  validate_fparam_aparam(nloc, fparam, aparam);
+  // agp == 0 means that the LAMMPS nbor list has been updated
+  if (ago == 0) {
+    atommap = deepmd::AtomMap (datype.begin(), datype.begin() + nloc);
+    assert (nloc == atommap.get_type().size());
+    nlist_data.shuffle(atommap);
+    nlist_data.make_inlist(nlist);
+  }
+  int ret;
+  if (dtype == DT_DOUBLE) {
+    ret = session_input_tensors<double> (input_tensors, dcoord, ntypes, datype, dbox, nlist, fparam, aparam, atommap, nghost_real, ago);
+  }
+  else {
+    ret = session_input_tensors<float> (input_tensors, dcoord, ntypes, datype, dbox, nlist, fparam, aparam, atommap, nghost_real, ago);
+  }
+  assert (nloc == ret);
+  return nghost_real;
 }
 
 
+template<typename VALUETYPE>
 void
 DeepPot::
 compute (ENERGYTYPE &			dener,
@@ -423,17 +586,23 @@ compute (ENERGYTYPE &			dener,
 	 const std::vector<VALUETYPE> &	fparam,
 	 const std::vector<VALUETYPE> &	aparam)
 {
-  atommap = deepmd::AtomMap<VALUETYPE> (datype_.begin(), datype_.end());
+  atommap = deepmd::AtomMap (datype_.begin(), datype_.end());
   validate_fparam_aparam(atommap.get_type().size(), fparam, aparam);
 
   std::vector<std::pair<std::string, Tensor>> input_tensors;
-  int nloc = session_input_tensors (input_tensors, dcoord_, ntypes, datype_, dbox, cell_size, fparam, aparam, atommap);
-
-  run_model (dener, dforce_, dvirial, datom_energy_, datom_virial_, session, input_tensors, atommap);
+  if (dtype == DT_DOUBLE) {
+    session_input_tensors<double> (input_tensors, dcoord_, ntypes, datype_, dbox, cell_size, fparam, aparam, atommap);
+    run_model<double> (dener, dforce_, dvirial, datom_energy_, datom_virial_, session, callable_atomic, input_tensors, atommap);
+  }
+  else {
+    session_input_tensors<float> (input_tensors, dcoord_, ntypes, datype_, dbox, cell_size, fparam, aparam, atommap);
+    run_model<float> (dener, dforce_, dvirial, datom_energy_, datom_virial_, session, callable_atomic, input_tensors, atommap);
+  }
 }
 
 
 
+template<typename VALUETYPE>
 void
 DeepPot::
 compute (ENERGYTYPE &			dener,
@@ -448,25 +617,30 @@ compute (ENERGYTYPE &			dener,
 	 const InputNlist &	lmp_list,
 	 const int               &	ago,
 	 const std::vector<VALUETYPE> &	fparam,
-	 const std::vector<VALUETYPE> &	aparam)
+	 const std::vector<VALUETYPE> &	aparam_)
 {
+  std::vector<std::pair<std::string, Tensor>> input_tensors;
+  std::vector<int> bkw_map;
+  int nphantom;
+  int nghost_real = make_input_tensors(input_tensors, bkw_map, nphantom, dcoord_, datype_, dbox, nghost, lmp_list, ago, fparam, aparam_);
+  std::vector<VALUETYPE> dforce, datom_energy, datom_virial;
+  if (dtype == DT_DOUBLE) {
+    run_model<double> (dener, dforce, dvirial, datom_energy, datom_virial, session, callable_atomic, input_tensors, atommap, nghost_real);
+  }
+  else {
+    run_model<float> (dener, dforce, dvirial, datom_energy, datom_virial, session, callable_atomic, input_tensors, atommap, nghost_real);
+  }
+  if (nphantom > 0) {
+    dener -= nphantom * get_phantom_energy();
+  }
+  // bkw map, the phantom atoms are dropped
   int nall = dcoord_.size() / 3;
-  int nloc = nall - nghost;
-    validate_fparam_aparam(nloc, fparam, aparam);
-    std::vector<std::pair<std::string, Tensor>> input_tensors;
-
-    if (ago == 0) {
-        atommap = AtomMap<VALUETYPE> (datype_.begin(), datype_.begin() + nloc);
-        assert (nloc == atommap.get_type().size());
-
-        nlist_data.copy_from_nlist(lmp_list);
-        nlist_data.shuffle(atommap);
-	nlist_data.make_inlist(nlist);
-    }
-
-    int ret = session_input_tensors (input_tensors, dcoord_, ntypes, datype_, dbox, nlist, fparam, aparam, atommap, nghost, ago);
-    assert (nloc == ret);
-    run_model (dener, dforce_, dvirial, datom_energy_, datom_virial_, session, input_tensors, atommap, nghost);
+  dforce_.resize(nall * 3);
+  datom_energy_.resize(nall);
+  datom_virial_.resize(nall * 9);
+  select_map<VALUETYPE>(dforce_, dforce, bkw_map, 3);
+  select_map<VALUETYPE>(datom_energy_, datom_energy, bkw_map, 1);
+  select_map<VALUETYPE>(datom_virial_, datom_virial, bkw_map, 9);
 }
 
 void
@@ -496,7 +670,16 @@ DeepPotModelDevi (const std::vector<std::string> & models, const int & gpu_rank,
   init(models, gpu_rank, file_contents);
 }
 
-DeepPotModelDevi::~DeepPotModelDevi() {}
+DeepPotModelDevi::~DeepPotModelDevi() 
+{
+  if (inited) {
+    for (unsigned ii = 0; ii < numb_models; ++ii){
+      session_release_callable(sessions[ii], callables[ii]);
+      session_release_callable(sessions[ii], callables_atomic[ii]);
+      delete sessions[ii];
+    }
+  }
+}
 
 void
 DeepPotModelDevi::
@@ -518,12 +701,6 @@ init (const std::vector<std::string> & models, const int & gpu_rank, const std::
   SessionOptions options;
   options.config.set_inter_op_parallelism_threads(num_inter_nthreads);
   options.config.set_intra_op_parallelism_threads(num_intra_nthreads);
-  for (unsigned ii = 0; ii < numb_models; ++ii){
-    if (file_contents.size() == 0)
-      check_status (ReadBinaryProto(Env::Default(), models[ii], &graph_defs[ii]));
-    else
-      graph_defs[ii].ParseFromString(file_contents[ii]);
-  }
   #if GOOGLE_CUDA || TENSORFLOW_USE_ROCM
   if (gpu_num > 0) {
       options.config.set_allow_soft_placement(true);
@@ -532,6 +709,15 @@ init (const std::vector<std::string> & models, const int & gpu_rank, const std::
       DPErrcheck(DPSetDevice(gpu_rank % gpu_num));
   }
   #endif // GOOGLE_CUDA || TENSORFLOW_USE_ROCM
+  // each memmapped model is mapped by its own environment
+  mmap_envs.resize(numb_models);
+  std::vector<SessionOptions> model_options(numb_models, options);
+  for (unsigned ii = 0; ii < numb_models; ++ii){
+    if (file_contents.size() == 0)
+      load_graph_def(graph_defs[ii], mmap_envs[ii], model_options[ii], models[ii]);
+    else
+      load_graph_def(graph_defs[ii], mmap_envs[ii], model_options[ii], models[ii], file_contents[ii]);
+  }
   
   for (unsigned ii = 0; ii < numb_models; ++ii) {
     if (gpu_num > 0) {
@@ -539,10 +725,20 @@ init (const std::vector<std::string> & models, const int & gpu_rank, const std::
       str += std::to_string(gpu_rank % gpu_num);
       graph::SetDefaultDevice(str, &graph_defs[ii]);
     }
-    check_status (NewSession(options, &(sessions[ii])));
+    check_status (NewSession(model_options[ii], &(sessions[ii])));
     check_status (sessions[ii]->Create(graph_defs[ii]));
   }
-  rcut = get_scalar<VALUETYPE>("descrpt_attr/rcut");
+  metadata.resize(numb_models);
+  for (unsigned ii = 0; ii < numb_models; ++ii) {
+    read_model_metadata(metadata[ii], graph_defs[ii]);
+  }
+  dtype = model_dtype(graph_defs[0]);
+  rcut = metadata[0].rcut;
+  for (unsigned ii = 1; ii < numb_models; ++ii) {
+    if (model_dtype(graph_defs[ii]) != dtype || metadata[ii].rcut != rcut) {
+      throw std::runtime_error("the models should have the same precision and cutoff radius");
+    }
+  }
   cell_size = rcut;
   ntypes = get_scalar<int>("descrpt_attr/ntypes");
   dfparam = get_scalar<int>("fitting_attr/dfparam");
@@ -560,11 +756,73 @@ init (const std::vector<std::string> & models, const int & gpu_rank, const std::
   // rcut = get_rcut();
   // cell_size = rcut;
   // ntypes = get_ntypes();
+  std::vector<std::string> feeds = session_input_names(dfparam > 0, daparam > 0);
+  callables.resize(numb_models);
+  callables_atomic.resize(numb_models);
+  for (unsigned ii = 0; ii < numb_models; ++ii) {
+    session_make_callable(callables[ii], sessions[ii], feeds, {"o_energy", "o_force", "o_virial"});
+    session_make_callable(callables_atomic[ii], sessions[ii], feeds, {"o_energy", "o_force", "o_atom_energy", "o_atom_virial"});
+  }
   inited = true;
   
   init_nbor = false;
 }
 
+void
+DeepPotModelDevi::
+reload_async (const std::vector<std::string> & models, const int & gpu_rank, const std::vector<std::string> & file_contents)
+{
+  // the models still being loaded by the last call are waited for and discarded
+  reload_job = std::async(std::launch::async, [models, gpu_rank, file_contents] () {
+    return std::unique_ptr<DeepPotModelDevi> (new DeepPotModelDevi(models, gpu_rank, file_contents));
+  });
+}
+
+bool
+DeepPotModelDevi::
+reload_ready () const
+{
+  return reload_job.valid() && reload_job.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+bool
+DeepPotModelDevi::
+commit_reload (const bool wait)
+{
+  if (! reload_job.valid()) return false;
+  if (! wait && ! reload_ready()) return false;
+  std::unique_ptr<DeepPotModelDevi> dp = reload_job.get();
+  if (inited && (dp->rcut != rcut || dp->ntypes != ntypes || dp->dfparam != dfparam || dp->daparam != daparam)) {
+    throw std::runtime_error("the reloaded models should have the same cutoff radius, number of types and dims of fparam and aparam");
+  }
+  // the old models are released with dp
+  swap_model(*dp);
+  return true;
+}
+
+void
+DeepPotModelDevi::
+swap_model (DeepPotModelDevi & dp)
+{
+  std::swap(numb_models, dp.numb_models);
+  sessions.swap(dp.sessions);
+  mmap_envs.swap(dp.mmap_envs);
+  callables.swap(dp.callables);
+  callables_atomic.swap(dp.callables_atomic);
+  graph_defs.swap(dp.graph_defs);
+  metadata.swap(dp.metadata);
+  std::swap(inited, dp.inited);
+  std::swap(rcut, dp.rcut);
+  std::swap(cell_size, dp.cell_size);
+  std::swap(dtype, dp.dtype);
+  std::swap(model_type, dp.model_type);
+  std::swap(model_version, dp.model_version);
+  std::swap(ntypes, dp.ntypes);
+  std::swap(dfparam, dp.dfparam);
+  std::swap(daparam, dp.daparam);
+  // the neighbor list and atom map do not depend on the models, they are kept
+}
+
 template<class VT>
 VT
 DeepPotModelDevi::
@@ -583,35 +841,15 @@ get_scalar(const std::string name) const
   return myrcut;
 }
 
-// init the tmp array data
 std::vector<std::vector<int> > 
 DeepPotModelDevi::
 get_sel () const 
 {
-    std::vector<std::vector<int> > sec;
-    for (int ii = 0; ii < numb_models; ii++) {
-        std::vector<int> sel;
-        std::istringstream is(graph_info(graph_defs[ii]));
-        std::string line = "";
-        while(is >> line) {
-            if (line.find("sel") != line.npos) {
-                while (std::getline(is, line) && line != "}") {
-                    if (line.find("i:") != line.npos) {
-                        sel.push_back(atoi((line.substr(line.find("i:") + 2)).c_str()));
-                    }
-                } break;
-            }
-            if (line.find("sel_a") != line.npos) {
-                while (std::getline(is, line) && line != "}") {
-                    if (line.find("i:") != line.npos) {
-                        sel.push_back(atoi((line.substr(line.find("i:") + 2)).c_str()));
-                    }
-                } break;
-            }
-        }
-        sec.push_back(sel);
-    }
-    return sec;
+  std::vector<std::vector<int> > sec;
+  for (unsigned ii = 0; ii < numb_models; ++ii) {
+    sec.push_back(metadata[ii].sel);
+  }
+  return sec;
 }
 
 void  
@@ -629,6 +867,7 @@ cum_sum (const std::vector<std::vector<int32> > n_sel)
     }
 }
 
+template<typename VALUETYPE>
 void
 DeepPotModelDevi::
 validate_fparam_aparam(const int & nloc,
@@ -657,7 +896,7 @@ validate_fparam_aparam(const int & nloc,
 // {
 //   if (numb_models == 0) return;
 
-//   atommap = AtomMap<VALUETYPE> (datype_.begin(), datype_.end());
+//   atommap = AtomMap (datype_.begin(), datype_.end());
 //   validate_fparam_aparam(atommap.get_type().size(), fparam, aparam);
 
 //   std::vector<std::pair<std::string, Tensor>> input_tensors;
@@ -690,6 +929,7 @@ validate_fparam_aparam(const int & nloc,
 //   //      << model_devi[191] << endl;
 // }
 
+template<typename VALUETYPE>
 void
 DeepPotModelDevi::
 compute (std::vector<ENERGYTYPE> &		all_energy,
@@ -712,24 +952,36 @@ compute (std::vector<ENERGYTYPE> &		all_energy,
 
     // agp == 0 means that the LAMMPS nbor list has been updated
     if (ago == 0) {
-        atommap = AtomMap<VALUETYPE> (datype_.begin(), datype_.begin() + nloc);
+        atommap = AtomMap (datype_.begin(), datype_.begin() + nloc);
         assert (nloc == atommap.get_type().size());
 
         nlist_data.copy_from_nlist(lmp_list);
         nlist_data.shuffle(atommap);
 	nlist_data.make_inlist(nlist);
     }
-    int ret = session_input_tensors (input_tensors, dcoord_, ntypes, datype_, dbox, nlist, fparam, aparam, atommap, nghost, ago);
+    int ret;
+    if (dtype == DT_DOUBLE) {
+      ret = session_input_tensors<double> (input_tensors, dcoord_, ntypes, datype_, dbox, nlist, fparam, aparam, atommap, nghost, ago);
+    }
+    else {
+      ret = session_input_tensors<float> (input_tensors, dcoord_, ntypes, datype_, dbox, nlist, fparam, aparam, atommap, nghost, ago);
+    }
 
     all_energy.resize (numb_models);
     all_force.resize (numb_models);
     all_virial.resize (numb_models);
     assert (nloc == ret);
     for (unsigned ii = 0; ii < numb_models; ++ii) {
-        run_model (all_energy[ii], all_force[ii], all_virial[ii], sessions[ii], input_tensors, atommap, nghost);
+      if (dtype == DT_DOUBLE) {
+        run_model<double> (all_energy[ii], all_force[ii], all_virial[ii], sessions[ii], callables[ii], input_tensors, atommap, nghost);
+      }
+      else {
+        run_model<float> (all_energy[ii], all_force[ii], all_virial[ii], sessions[ii], callables[ii], input_tensors, atommap, nghost);
+      }
     }
 }
 
+template<typename VALUETYPE>
 void
 DeepPotModelDevi::
 compute (std::vector<ENERGYTYPE> &		all_energy,
@@ -754,14 +1006,20 @@ compute (std::vector<ENERGYTYPE> &		all_energy,
 
     // agp == 0 means that the LAMMPS nbor list has been updated
     if (ago == 0) {
-        atommap = AtomMap<VALUETYPE> (datype_.begin(), datype_.begin() + nloc);
+        atommap = AtomMap (datype_.begin(), datype_.begin() + nloc);
         assert (nloc == atommap.get_type().size());
 
         nlist_data.copy_from_nlist(lmp_list);
         nlist_data.shuffle(atommap);
 	nlist_data.make_inlist(nlist);
     }
-    int ret = session_input_tensors (input_tensors, dcoord_, ntypes, datype_, dbox, nlist, fparam, aparam, atommap, nghost, ago);
+    int ret;
+    if (dtype == DT_DOUBLE) {
+      ret = session_input_tensors<double> (input_tensors, dcoord_, ntypes, datype_, dbox, nlist, fparam, aparam, atommap, nghost, ago);
+    }
+    else {
+      ret = session_input_tensors<float> (input_tensors, dcoord_, ntypes, datype_, dbox, nlist, fparam, aparam, atommap, nghost, ago);
+    }
 
     all_energy.resize (numb_models);
     all_force .resize (numb_models);
@@ -770,10 +1028,16 @@ compute (std::vector<ENERGYTYPE> &		all_energy,
     all_atom_virial.resize (numb_models); 
     assert (nloc == ret);
     for (unsigned ii = 0; ii < numb_models; ++ii) {
-        run_model (all_energy[ii], all_force[ii], all_virial[ii], all_atom_energy[ii], all_atom_virial[ii], sessions[ii], input_tensors, atommap, nghost);
+      if (dtype == DT_DOUBLE) {
+        run_model<double> (all_energy[ii], all_force[ii], all_virial[ii], all_atom_energy[ii], all_atom_virial[ii], sessions[ii], callables_atomic[ii], input_tensors, atommap, nghost);
+      }
+      else {
+        run_model<float> (all_energy[ii], all_force[ii], all_virial[ii], all_atom_energy[ii], all_atom_virial[ii], sessions[ii], callables_atomic[ii], input_tensors, atommap, nghost);
+      }
     }
 }
 
+template<typename VALUETYPE>
 void
 DeepPotModelDevi::
 compute_avg (VALUETYPE &		dener, 
@@ -789,23 +1053,7 @@ compute_avg (VALUETYPE &		dener,
   dener /= (VALUETYPE)(numb_models);  
 }
 
-#ifndef HIGH_PREC
-void
-DeepPotModelDevi::
-compute_avg (ENERGYTYPE &		dener, 
-	     const std::vector<ENERGYTYPE >&	all_energy) 
-{
-  assert (all_energy.size() == numb_models);
-  if (numb_models == 0) return;
-
-  dener = 0;
-  for (unsigned ii = 0; ii < numb_models; ++ii){
-    dener += all_energy[ii];
-  }
-  dener /= (ENERGYTYPE)(numb_models);  
-}
-#endif
-
+template<typename VALUETYPE>
 void
 DeepPotModelDevi::
 compute_avg (std::vector<VALUETYPE> &		avg, 
@@ -829,6 +1077,7 @@ compute_avg (std::vector<VALUETYPE> &		avg,
 }
 
 
+template<typename VALUETYPE>
 void
 DeepPotModelDevi::
 compute_std (
@@ -864,6 +1113,7 @@ compute_std (
 }
 
 
+template<typename VALUETYPE>
 void
 DeepPotModelDevi::
 compute_std_e (std::vector<VALUETYPE> &		std, 
@@ -873,6 +1123,7 @@ compute_std_e (std::vector<VALUETYPE> &		std,
   compute_std(std, avg, xx, 1);
 }
 
+template<typename VALUETYPE>
 void
 DeepPotModelDevi::
 compute_std_f (std::vector<VALUETYPE> &		std, 
@@ -882,6 +1133,7 @@ compute_std_f (std::vector<VALUETYPE> &		std,
   compute_std(std, avg, xx, 3);
 }
 
+template<typename VALUETYPE>
 void
 DeepPotModelDevi::
 compute_relative_std (
@@ -905,6 +1157,7 @@ compute_relative_std (
   }
 }
 
+template<typename VALUETYPE>
 void
 DeepPotModelDevi::
 compute_relative_std_f (std::vector<VALUETYPE> &std,
@@ -914,3 +1167,314 @@ compute_relative_std_f (std::vector<VALUETYPE> &std,
   compute_relative_std(std, avg, eps, 3);
 }
 
+template
+void
+DeepPot::
+compute<double> (ENERGYTYPE &			dener,
+	 std::vector<double> &		dforce_,
+	 std::vector<double> &		dvirial,
+	 const std::vector<double> &	dcoord_,
+	 const std::vector<int> &	datype_,
+	 const std::vector<double> &	dbox, 
+	 const std::vector<double> &	fparam,
+	 const std::vector<double> &	aparam);
+
+template
+void
+DeepPot::
+compute<double> (ENERGYTYPE &			dener,
+	 std::vector<double> &		dforce_,
+	 std::vector<double> &		dvirial,
+	 const std::vector<double> &	dcoord_,
+	 const std::vector<int> &	datype_,
+	 const std::vector<double> &	dbox, 
+	 const int			nghost,
+	 const InputNlist &		lmp_list,
+	 const int&			ago,
+	 const std::vector<double> &	fparam,
+	 const std::vector<double> &	aparam_);
+
+template
+std::future<void>
+DeepPot::
+compute_async<double> (ENERGYTYPE &			dener,
+	       std::vector<double> &		dforce_,
+	       std::vector<double> &		dvirial,
+	       const std::vector<double> &	dcoord_,
+	       const std::vector<int> &		datype_,
+	       const std::vector<double> &	dbox, 
+	       const int			nghost,
+	       const InputNlist &		lmp_list,
+	       const int&			ago,
+	       const std::vector<double> &	fparam,
+	       const std::vector<double> &	aparam_);
+
+template
+void
+DeepPot::
+compute<double> (ENERGYTYPE &			dener,
+	 std::vector<double> &		dforce_,
+	 std::vector<double> &		dvirial,
+	 std::vector<double> &		datom_energy_,
+	 std::vector<double> &		datom_virial_,
+	 const std::vector<double> &	dcoord_,
+	 const std::vector<int> &	datype_,
+	 const std::vector<double> &	dbox,
+	 const std::vector<double> &	fparam,
+	 const std::vector<double> &	aparam);
+
+template
+void
+DeepPot::
+compute<double> (ENERGYTYPE &			dener,
+	 std::vector<double> &		dforce_,
+	 std::vector<double> &		dvirial,
+	 std::vector<double> &		datom_energy_,
+	 std::vector<double> &		datom_virial_,
+	 const std::vector<double> &	dcoord_,
+	 const std::vector<int> &	datype_,
+	 const std::vector<double> &	dbox, 
+	 const int			nghost, 
+	 const InputNlist &		lmp_list,
+	 const int &			ago,
+	 const std::vector<double> &	fparam,
+	 const std::vector<double> &	aparam);
+
+template
+void
+DeepPotModelDevi::
+compute<double> (std::vector<ENERGYTYPE> &		all_energy,
+	 std::vector<std::vector<double>> &	all_force,
+	 std::vector<std::vector<double>> &	all_virial,
+	 const std::vector<double> &		dcoord_,
+	 const std::vector<int> &		datype_,
+	 const std::vector<double> &		dbox,
+	 const int				nghost,
+	 const InputNlist &			lmp_list,
+	 const int &				ago,
+	 const std::vector<double> &		fparam,
+	 const std::vector<double> &		aparam);
+
+template
+void
+DeepPotModelDevi::
+compute<double> (std::vector<ENERGYTYPE> &		all_energy,
+	 std::vector<std::vector<double>> &	all_force,
+	 std::vector<std::vector<double>> &	all_virial,
+	 std::vector<std::vector<double>> &	all_atom_energy,
+	 std::vector<std::vector<double>> &	all_atom_virial,
+	 const std::vector<double> &		dcoord_,
+	 const std::vector<int> &		datype_,
+	 const std::vector<double> &		dbox,
+	 const int				nghost,
+	 const InputNlist &			lmp_list,
+	 const int &				ago,
+	 const std::vector<double> &		fparam,
+	 const std::vector<double> &		aparam);
+
+template
+void
+DeepPotModelDevi::
+compute_avg<double> (double &		dener, 
+	     const std::vector<double > &	all_energy);
+
+template
+void
+DeepPotModelDevi::
+compute_avg<double> (std::vector<double> &		avg, 
+	     const std::vector<std::vector<double> > &	xx);
+
+template
+void
+DeepPotModelDevi::
+compute_std<double> (
+    std::vector<double> &		std, 
+    const std::vector<double> &	avg, 
+    const std::vector<std::vector<double> >&xx,
+    const int & stride);
+
+template
+void
+DeepPotModelDevi::
+compute_std_e<double> (std::vector<double> &		std, 
+	       const std::vector<double> &	avg, 
+	       const std::vector<std::vector<double> >&xx);
+
+template
+void
+DeepPotModelDevi::
+compute_std_f<double> (std::vector<double> &		std, 
+	       const std::vector<double> &	avg, 
+	       const std::vector<std::vector<double> >&xx);
+
+template
+void
+DeepPotModelDevi::
+compute_relative_std<double> (
+    std::vector<double> &std,
+    const std::vector<double> &avg,
+    const double eps, 
+    const int & stride);
+
+template
+void
+DeepPotModelDevi::
+compute_relative_std_f<double> (std::vector<double> &std,
+			const std::vector<double> &avg,
+			const double eps);
+
+template
+void
+DeepPot::
+compute<float> (ENERGYTYPE &			dener,
+	 std::vector<float> &		dforce_,
+	 std::vector<float> &		dvirial,
+	 const std::vector<float> &	dcoord_,
+	 const std::vector<int> &	datype_,
+	 const std::vector<float> &	dbox, 
+	 const std::vector<float> &	fparam,
+	 const std::vector<float> &	aparam);
+
+template
+void
+DeepPot::
+compute<float> (ENERGYTYPE &			dener,
+	 std::vector<float> &		dforce_,
+	 std::vector<float> &		dvirial,
+	 const std::vector<float> &	dcoord_,
+	 const std::vector<int> &	datype_,
+	 const std::vector<float> &	dbox, 
+	 const int			nghost,
+	 const InputNlist &		lmp_list,
+	 const int&			ago,
+	 const std::vector<float> &	fparam,
+	 const std::vector<float> &	aparam_);
+
+template
+std::future<void>
+DeepPot::
+compute_async<float> (ENERGYTYPE &			dener,
+	       std::vector<float> &		dforce_,
+	       std::vector<float> &		dvirial,
+	       const std::vector<float> &	dcoord_,
+	       const std::vector<int> &		datype_,
+	       const std::vector<float> &	dbox, 
+	       const int			nghost,
+	       const InputNlist &		lmp_list,
+	       const int&			ago,
+	       const std::vector<float> &	fparam,
+	       const std::vector<float> &	aparam_);
+
+template
+void
+DeepPot::
+compute<float> (ENERGYTYPE &			dener,
+	 std::vector<float> &		dforce_,
+	 std::vector<float> &		dvirial,
+	 std::vector<float> &		datom_energy_,
+	 std::vector<float> &		datom_virial_,
+	 const std::vector<float> &	dcoord_,
+	 const std::vector<int> &	datype_,
+	 const std::vector<float> &	dbox,
+	 const std::vector<float> &	fparam,
+	 const std::vector<float> &	aparam);
+
+template
+void
+DeepPot::
+compute<float> (ENERGYTYPE &			dener,
+	 std::vector<float> &		dforce_,
+	 std::vector<float> &		dvirial,
+	 std::vector<float> &		datom_energy_,
+	 std::vector<float> &		datom_virial_,
+	 const std::vector<float> &	dcoord_,
+	 const std::vector<int> &	datype_,
+	 const std::vector<float> &	dbox, 
+	 const int			nghost, 
+	 const InputNlist &		lmp_list,
+	 const int &			ago,
+	 const std::vector<float> &	fparam,
+	 const std::vector<float> &	aparam);
+
+template
+void
+DeepPotModelDevi::
+compute<float> (std::vector<ENERGYTYPE> &		all_energy,
+	 std::vector<std::vector<float>> &	all_force,
+	 std::vector<std::vector<float>> &	all_virial,
+	 const std::vector<float> &		dcoord_,
+	 const std::vector<int> &		datype_,
+	 const std::vector<float> &		dbox,
+	 const int				nghost,
+	 const InputNlist &			lmp_list,
+	 const int &				ago,
+	 const std::vector<float> &		fparam,
+	 const std::vector<float> &		aparam);
+
+template
+void
+DeepPotModelDevi::
+compute<float> (std::vector<ENERGYTYPE> &		all_energy,
+	 std::vector<std::vector<float>> &	all_force,
+	 std::vector<std::vector<float>> &	all_virial,
+	 std::vector<std::vector<float>> &	all_atom_energy,
+	 std::vector<std::vector<float>> &	all_atom_virial,
+	 const std::vector<float> &		dcoord_,
+	 const std::vector<int> &		datype_,
+	 const std::vector<float> &		dbox,
+	 const int				nghost,
+	 const InputNlist &			lmp_list,
+	 const int &				ago,
+	 const std::vector<float> &		fparam,
+	 const std::vector<float> &		aparam);
+
+template
+void
+DeepPotModelDevi::
+compute_avg<float> (float &		dener, 
+	     const std::vector<float > &	all_energy);
+
+template
+void
+DeepPotModelDevi::
+compute_avg<float> (std::vector<float> &		avg, 
+	     const std::vector<std::vector<float> > &	xx);
+
+template
+void
+DeepPotModelDevi::
+compute_std<float> (
+    std::vector<float> &		std, 
+    const std::vector<float> &	avg, 
+    const std::vector<std::vector<float> >&xx,
+    const int & stride);
+
+template
+void
+DeepPotModelDevi::
+compute_std_e<float> (std::vector<float> &		std, 
+	       const std::vector<float> &	avg, 
+	       const std::vector<std::vector<float> >&xx);
+
+template
+void
+DeepPotModelDevi::
+compute_std_f<float> (std::vector<float> &		std, 
+	       const std::vector<float> &	avg, 
+	       const std::vector<std::vector<float> >&xx);
+
+template
+void
+DeepPotModelDevi::
+compute_relative_std<float> (
+    std::vector<float> &std,
+    const std::vector<float> &avg,
+    const float eps, 
+    const int & stride);
+
+template
+void
+DeepPotModelDevi::
+compute_relative_std_f<float> (std::vector<float> &std,
+			const std::vector<float> &avg,
+			const float eps);
@@ -18,6 +18,17 @@ DeepTensor(const std::string & model,
   init(model, gpu_rank);  
 }
 
+DeepTensor::
+~DeepTensor()
+{
+  if (inited) {
+    session_release_callable(session, callable_tensor);
+    for (std::map<int, SessionCallable>::const_iterator it = callables_full.begin(); it != callables_full.end(); ++it) {
+      session_release_callable(session, it->second);
+    }
+  }
+}
+
 void
 DeepTensor::
 init (const std::string & model, 
@@ -33,10 +44,13 @@ init (const std::string & model,
   get_env_nthreads(num_intra_nthreads, num_inter_nthreads);
   options.config.set_inter_op_parallelism_threads(num_inter_nthreads);
   options.config.set_intra_op_parallelism_threads(num_intra_nthreads);
+  load_graph_def(graph_def, mmap_env, options, model);
   deepmd::check_status (NewSession(options, &session));
-  deepmd::check_status (ReadBinaryProto(Env::Default(), model, &graph_def));
   deepmd::check_status (session->Create(graph_def));  
-  rcut = get_scalar<VALUETYPE>("descrpt_attr/rcut");
+  ModelMetadata metadata;
+  read_model_metadata(metadata, graph_def, name_scope);
+  dtype = model_dtype(graph_def, name_scope);
+  rcut = metadata.rcut;
   cell_size = rcut;
   ntypes = get_scalar<int>("descrpt_attr/ntypes");
   odim = get_scalar<int>("model_attr/output_dim");
@@ -49,6 +63,9 @@ init (const std::string & model,
 	+ " in graph, but version " + global_model_version 
 	+ " supported ");
   }
+  std::vector<std::string> feeds = session_input_names(false, false, name_scope);
+  session_make_callable(callable_tensor, session, feeds, 
+			{name_prefix(name_scope) + "o_" + model_type});
   inited = true;
 }
 
@@ -85,12 +102,34 @@ get_vector (std::vector<VT> & vec, const std::string & name) const
   session_get_vector<VT>(vec, session, name, name_scope);
 }
 
+const SessionCallable &
+DeepTensor::
+get_callable_full (const int output_mask)
+{
+  std::lock_guard<std::mutex> lock(callables_mutex);
+  std::map<int, SessionCallable>::iterator it = callables_full.find(output_mask);
+  if (it != callables_full.end()) {
+    return it->second;
+  }
+  // the fetches are in the order of the bits of the mask
+  std::vector<std::string> fetches;
+  if (output_mask & OUTPUT_GLOBAL) fetches.push_back(name_prefix(name_scope) + "o_global_" + model_type);
+  if (output_mask & OUTPUT_FORCE) fetches.push_back(name_prefix(name_scope) + "o_force");
+  if (output_mask & OUTPUT_VIRIAL) fetches.push_back(name_prefix(name_scope) + "o_virial");
+  if (output_mask & OUTPUT_ATOM) fetches.push_back(name_prefix(name_scope) + "o_" + model_type);
+  if (output_mask & OUTPUT_ATOM_VIRIAL) fetches.push_back(name_prefix(name_scope) + "o_atom_virial");
+  SessionCallable & callable = callables_full[output_mask];
+  session_make_callable(callable, session, session_input_names(false, false, name_scope), fetches);
+  return callable;
+}
+
+template<typename MODELTYPE, typename VALUETYPE>
 void 
 DeepTensor::
 run_model (std::vector<VALUETYPE> &	d_tensor_,
 		  Session *			session, 
 		  const std::vector<std::pair<std::string, Tensor>> & input_tensors,
-		  const AtomMap<VALUETYPE> &atommap, 
+		  const AtomMap &atommap, 
 		  const std::vector<int> &	sel_fwd,
 		  const int			nghost)
 {
@@ -103,15 +142,12 @@ run_model (std::vector<VALUETYPE> &	d_tensor_,
   }
 
   std::vector<Tensor> output_tensors;
-  deepmd::check_status (session->Run(input_tensors, 
-			    {name_prefix(name_scope) + "o_" + model_type},
-			    {}, 
-			    &output_tensors));
+  session_run_callable (output_tensors, session, callable_tensor, input_tensors);
   
   Tensor output_t = output_tensors[0];
   // Yixiao: newer model may output rank 2 tensor [nframes x (natoms x noutdim)]
   // assert (output_t.dims() == 1), "dim of output tensor should be 1";
-  auto ot = output_t.flat<VALUETYPE> ();
+  auto ot = output_t.flat<MODELTYPE> ();
   // this is an Eigen Tensor
   int o_size = ot.size();
 
@@ -130,6 +166,7 @@ run_model (std::vector<VALUETYPE> &	d_tensor_,
   select_map<VALUETYPE>(d_tensor_, d_tensor, sel_srt, odim);
 }
 
+template<typename MODELTYPE, typename VALUETYPE>
 void
 DeepTensor::
 run_model (std::vector<VALUETYPE> &		dglobal_tensor_,
@@ -139,105 +176,111 @@ run_model (std::vector<VALUETYPE> &		dglobal_tensor_,
 		  std::vector<VALUETYPE> &	datom_virial_,
 		  tensorflow::Session *			session, 
 		  const std::vector<std::pair<std::string, tensorflow::Tensor>> & input_tensors,
-		  const AtomMap<VALUETYPE> &		atommap, 
+		  const AtomMap &		atommap, 
 		  const std::vector<int> &		sel_fwd,
-		  const int				nghost)
+		  const int				nghost,
+		  const int				output_mask)
 {
   unsigned nloc = atommap.get_type().size();
   unsigned nall = nloc + nghost;
   unsigned nsel = nloc - std::count(sel_fwd.begin(), sel_fwd.end(), -1);
-  if (nloc == 0) {
+  // the outputs that are not requested are left empty
+  dglobal_tensor_.clear();
+  dforce_.clear();
+  dvirial_.clear();
+  datom_tensor_.clear();
+  datom_virial_.clear();
+  if (nloc == 0 || output_mask == 0) {
     // return empty
-    dglobal_tensor_.clear();
-    dforce_.clear();
-    dvirial_.clear();
     return;
   }
 
   std::vector<Tensor> output_tensors;
-  deepmd::check_status (session->Run(input_tensors, 
-			    {name_prefix(name_scope) + "o_global_" + model_type, 
-			     name_prefix(name_scope) + "o_force", 
-			     name_prefix(name_scope) + "o_virial", 
-			     name_prefix(name_scope) + "o_" + model_type,
-			     name_prefix(name_scope) + "o_atom_virial"},
-			    {}, 
-			    &output_tensors));
-
-  Tensor output_gt = output_tensors[0];
-  Tensor output_f = output_tensors[1];
-  Tensor output_v = output_tensors[2];
-  Tensor output_at = output_tensors[3];
-  Tensor output_av = output_tensors[4];
-  // this is the new model, output has to be rank 2 tensor
-  assert (output_gt.dims() == 2), "dim of output tensor should be 2";
-  assert (output_f.dims() == 2), "dim of output tensor should be 2";
-  assert (output_v.dims() == 2), "dim of output tensor should be 2";
-  assert (output_at.dims() == 2), "dim of output tensor should be 2";
-  assert (output_av.dims() == 2), "dim of output tensor should be 2";
-  // also check the tensor shapes
-  assert (output_gt.dim_size(0) == 1), "nframes should match";
-  assert (output_gt.dim_size(1) == odim), "dof of global tensor should be odim";  
-  assert (output_f.dim_size(0) == 1), "nframes should match";
-  assert (output_f.dim_size(1) == odim * nall * 3), "dof of force should be odim * nall * 3";
-  assert (output_v.dim_size(0) == 1), "nframes should match";
-  assert (output_v.dim_size(1) == odim * 9), "dof of virial should be odim * 9";
-  assert (output_at.dim_size(0) == 1), "nframes should match";
-  assert (output_at.dim_size(1) == nsel * odim), "dof of atomic tensor should be nsel * odim";  
-  assert (output_av.dim_size(0) == 1), "nframes should match";
-  assert (output_av.dim_size(1) == odim * nall * 9), "dof of atomic virial should be odim * nall * 9";  
-
-  auto ogt = output_gt.flat <ENERGYTYPE> ();
-  auto of = output_f.flat <VALUETYPE> ();
-  auto ov = output_v.flat <VALUETYPE> ();
-  auto oat = output_at.flat<VALUETYPE> ();
-  auto oav = output_av.flat<VALUETYPE> ();
+  session_run_callable (output_tensors, session, get_callable_full(output_mask), input_tensors);
+  int out_idx = 0;
 
   // global tensor
-  dglobal_tensor_.resize(odim);
-  for (unsigned ii = 0; ii < odim; ++ii){
-    dglobal_tensor_[ii] = ogt(ii);
+  if (output_mask & OUTPUT_GLOBAL) {
+    Tensor output_gt = output_tensors[out_idx++];
+    // this is the new model, output has to be rank 2 tensor
+    assert (output_gt.dims() == 2), "dim of output tensor should be 2";
+    assert (output_gt.dim_size(0) == 1), "nframes should match";
+    assert (output_gt.dim_size(1) == odim), "dof of global tensor should be odim";  
+    auto ogt = output_gt.flat <ENERGYTYPE> ();
+    dglobal_tensor_.resize(odim);
+    for (unsigned ii = 0; ii < odim; ++ii){
+      dglobal_tensor_[ii] = ogt(ii);
+    }
   }
 
   // component-wise force
-  std::vector<VALUETYPE> dforce (3 * nall * odim);
-  for (unsigned ii = 0; ii < odim * nall * 3; ++ii){
-    dforce[ii] = of(ii);
-  }
-  dforce_ = dforce;
-  for (unsigned dd = 0; dd < odim; ++dd){
-    atommap.backward (dforce_.begin() + (dd * nall * 3), dforce.begin() + (dd * nall * 3), 3);
+  if (output_mask & OUTPUT_FORCE) {
+    Tensor output_f = output_tensors[out_idx++];
+    assert (output_f.dims() == 2), "dim of output tensor should be 2";
+    assert (output_f.dim_size(0) == 1), "nframes should match";
+    assert (output_f.dim_size(1) == odim * nall * 3), "dof of force should be odim * nall * 3";
+    auto of = output_f.flat <MODELTYPE> ();
+    std::vector<VALUETYPE> dforce (3 * nall * odim);
+    for (unsigned ii = 0; ii < odim * nall * 3; ++ii){
+      dforce[ii] = of(ii);
+    }
+    dforce_ = dforce;
+    for (unsigned dd = 0; dd < odim; ++dd){
+      atommap.backward<VALUETYPE> (dforce_.begin() + (dd * nall * 3), dforce.begin() + (dd * nall * 3), 3);
+    }
   }
 
   // component-wise virial
-  dvirial_.resize(odim * 9);
-  for (unsigned ii = 0; ii < odim * 9; ++ii){
-    dvirial_[ii] = ov(ii);
+  if (output_mask & OUTPUT_VIRIAL) {
+    Tensor output_v = output_tensors[out_idx++];
+    assert (output_v.dims() == 2), "dim of output tensor should be 2";
+    assert (output_v.dim_size(0) == 1), "nframes should match";
+    assert (output_v.dim_size(1) == odim * 9), "dof of virial should be odim * 9";
+    auto ov = output_v.flat <MODELTYPE> ();
+    dvirial_.resize(odim * 9);
+    for (unsigned ii = 0; ii < odim * 9; ++ii){
+      dvirial_[ii] = ov(ii);
+    }
   }
   
   // atomic tensor
-  std::vector<VALUETYPE> datom_tensor (nsel * odim);
-  for (unsigned ii = 0; ii < nsel * odim; ++ii){
-    datom_tensor[ii] = oat(ii);
+  if (output_mask & OUTPUT_ATOM) {
+    Tensor output_at = output_tensors[out_idx++];
+    assert (output_at.dims() == 2), "dim of output tensor should be 2";
+    assert (output_at.dim_size(0) == 1), "nframes should match";
+    assert (output_at.dim_size(1) == nsel * odim), "dof of atomic tensor should be nsel * odim";  
+    auto oat = output_at.flat<MODELTYPE> ();
+    std::vector<VALUETYPE> datom_tensor (nsel * odim);
+    for (unsigned ii = 0; ii < nsel * odim; ++ii){
+      datom_tensor[ii] = oat(ii);
+    }
+    std::vector<int> sel_srt = sel_fwd;
+    select_map<int>(sel_srt, sel_fwd, atommap.get_fwd_map(), 1);
+    std::remove(sel_srt.begin(), sel_srt.end(), -1);
+    datom_tensor_.resize(nsel * odim);
+    select_map<VALUETYPE>(datom_tensor_, datom_tensor, sel_srt, odim);
   }
-  std::vector<int> sel_srt = sel_fwd;
-  select_map<int>(sel_srt, sel_fwd, atommap.get_fwd_map(), 1);
-  std::remove(sel_srt.begin(), sel_srt.end(), -1);
-  datom_tensor_.resize(nsel * odim);
-  select_map<VALUETYPE>(datom_tensor_, datom_tensor, sel_srt, odim);
 
   // component-wise atomic virial
-  std::vector<VALUETYPE> datom_virial (9 * nall * odim);
-  for (unsigned ii = 0; ii < odim * nall * 9; ++ii){
-    datom_virial[ii] = oav(ii);
-  }
-  datom_virial_ = datom_virial;
-  for (unsigned dd = 0; dd < odim; ++dd){
-    atommap.backward (datom_virial_.begin() + (dd * nall * 9), datom_virial.begin() + (dd * nall * 9), 9);
+  if (output_mask & OUTPUT_ATOM_VIRIAL) {
+    Tensor output_av = output_tensors[out_idx++];
+    assert (output_av.dims() == 2), "dim of output tensor should be 2";
+    assert (output_av.dim_size(0) == 1), "nframes should match";
+    assert (output_av.dim_size(1) == odim * nall * 9), "dof of atomic virial should be odim * nall * 9";  
+    auto oav = output_av.flat<MODELTYPE> ();
+    std::vector<VALUETYPE> datom_virial (9 * nall * odim);
+    for (unsigned ii = 0; ii < odim * nall * 9; ++ii){
+      datom_virial[ii] = oav(ii);
+    }
+    datom_virial_ = datom_virial;
+    for (unsigned dd = 0; dd < odim; ++dd){
+      atommap.backward<VALUETYPE> (datom_virial_.begin() + (dd * nall * 9), datom_virial.begin() + (dd * nall * 9), 9);
+    }
   }
 }
 
 
+template<typename VALUETYPE>
 void
 DeepTensor::
 compute (std::vector<VALUETYPE> &	dtensor_,
@@ -259,6 +302,7 @@ compute (std::vector<VALUETYPE> &	dtensor_,
   compute_inner(dtensor_, dcoord, datype, dbox);
 }
 
+template<typename VALUETYPE>
 void
 DeepTensor::
 compute (std::vector<VALUETYPE> &	dtensor_,
@@ -266,27 +310,49 @@ compute (std::vector<VALUETYPE> &	dtensor_,
 	 const std::vector<int> &	datype_,
 	 const std::vector<VALUETYPE> &	dbox, 
 	 const int			nghost,
-	 const InputNlist &	lmp_list)
+	 const InputNlist &	lmp_list,
+	 const int			ago)
 {
-  std::vector<VALUETYPE> dcoord;
-  std::vector<int> datype, fwd_map, bkw_map;
-  int nghost_real;
-  select_real_atoms(fwd_map, bkw_map, nghost_real, dcoord_, datype_, nghost, ntypes);
-  // resize to nall_real
-  dcoord.resize(bkw_map.size() * 3);
-  datype.resize(bkw_map.size());
+  // the selection and sorting maps only change with the neighbour list
+  bool rebuild = (ago == 0 || real_fwd_map.size() != datype_.size());
+  if (rebuild) {
+    select_real_atoms(real_fwd_map, real_bkw_map, nghost_real, dcoord_, datype_, nghost, ntypes);
+    datype_real.resize(real_bkw_map.size());
+    select_map<int>(datype_real, datype_, real_fwd_map, 1);
+  }
+  int nall = real_bkw_map.size();
+  int nloc = nall - nghost_real;
   // fwd map
-  select_map<VALUETYPE>(dcoord, dcoord_, fwd_map, 3);
-  select_map<int>(datype, datype_, fwd_map, 1);
-  // internal nlist
-  NeighborListData nlist_data;
-  nlist_data.copy_from_nlist(lmp_list);
-  nlist_data.shuffle_exclude_empty(fwd_map);  
-  InputNlist nlist;
-  nlist_data.make_inlist(nlist);
-  compute_inner(dtensor_, dcoord, datype, dbox, nghost_real, nlist);
+  std::vector<VALUETYPE> dcoord(nall * 3);
+  select_map<VALUETYPE>(dcoord, dcoord_, real_fwd_map, 3);
+  if (rebuild) {
+    atommap = AtomMap (datype_real.begin(), datype_real.begin() + nloc);
+    assert (nloc == atommap.get_type().size());
+    std::vector<int> sel_bkw;
+    int nghost_sel;
+    // this gives the raw selection map, will pass to run model
+    select_by_type(sel_fwd_map, sel_bkw, nghost_sel, dcoord, datype_real, nghost_real, sel_type);
+    sel_fwd_map.resize(nloc);
+    // internal nlist
+    nlist_data.copy_from_nlist(lmp_list);
+    nlist_data.shuffle_exclude_empty(real_fwd_map);  
+    nlist_data.shuffle(atommap);
+    nlist_data.make_inlist(nlist);
+  }
+  std::vector<std::pair<std::string, Tensor>> input_tensors;
+  if (dtype == DT_DOUBLE) {
+    int ret = session_input_tensors<double> (input_tensors, dcoord, ntypes, datype_real, dbox, nlist, std::vector<VALUETYPE>(), std::vector<VALUETYPE>(), atommap, nghost_real, ago, name_scope);
+    assert (nloc == ret);
+    run_model<double> (dtensor_, session, input_tensors, atommap, sel_fwd_map, nghost_real);
+  }
+  else {
+    int ret = session_input_tensors<float> (input_tensors, dcoord, ntypes, datype_real, dbox, nlist, std::vector<VALUETYPE>(), std::vector<VALUETYPE>(), atommap, nghost_real, ago, name_scope);
+    assert (nloc == ret);
+    run_model<float> (dtensor_, session, input_tensors, atommap, sel_fwd_map, nghost_real);
+  }
 }
 
+template<typename VALUETYPE>
 void
 DeepTensor::
 compute (std::vector<VALUETYPE> &	dglobal_tensor_,
@@ -297,9 +363,10 @@ compute (std::vector<VALUETYPE> &	dglobal_tensor_,
 	 const std::vector<VALUETYPE> &	dbox)
 {
   std::vector<VALUETYPE> tmp_at_, tmp_av_;
-  compute(dglobal_tensor_, dforce_, dvirial_, tmp_at_, tmp_av_, dcoord_, datype_, dbox);
+  compute(dglobal_tensor_, dforce_, dvirial_, tmp_at_, tmp_av_, dcoord_, datype_, dbox, OUTPUT_GLOBAL | OUTPUT_FORCE | OUTPUT_VIRIAL);
 }
 
+template<typename VALUETYPE>
 void
 DeepTensor::
 compute (std::vector<VALUETYPE> &	dglobal_tensor_,
@@ -312,9 +379,10 @@ compute (std::vector<VALUETYPE> &	dglobal_tensor_,
 	 const InputNlist &	lmp_list)
 {
   std::vector<VALUETYPE> tmp_at_, tmp_av_;
-  compute(dglobal_tensor_, dforce_, dvirial_, tmp_at_, tmp_av_, dcoord_, datype_, dbox, nghost, lmp_list);
+  compute(dglobal_tensor_, dforce_, dvirial_, tmp_at_, tmp_av_, dcoord_, datype_, dbox, nghost, lmp_list, OUTPUT_GLOBAL | OUTPUT_FORCE | OUTPUT_VIRIAL);
 }
 
+template<typename VALUETYPE>
 void
 DeepTensor::
 compute (std::vector<VALUETYPE> &	dglobal_tensor_,
@@ -324,7 +392,8 @@ compute (std::vector<VALUETYPE> &	dglobal_tensor_,
 	 std::vector<VALUETYPE> &	datom_virial_,
 	 const std::vector<VALUETYPE> &	dcoord_,
 	 const std::vector<int> &	datype_,
-	 const std::vector<VALUETYPE> &	dbox)
+	 const std::vector<VALUETYPE> &	dbox,
+	 const int			output_mask)
 {
   std::vector<VALUETYPE> dcoord, dforce, datom_virial;
   std::vector<int> datype, fwd_map, bkw_map;
@@ -337,18 +406,25 @@ compute (std::vector<VALUETYPE> &	dglobal_tensor_,
   // fwd map
   select_map<VALUETYPE>(dcoord, dcoord_, fwd_map, 3);
   select_map<int>(datype, datype_, fwd_map, 1);
-  compute_inner(dglobal_tensor_, dforce, dvirial_, datom_tensor_, datom_virial, dcoord, datype, dbox);
+  compute_inner(dglobal_tensor_, dforce, dvirial_, datom_tensor_, datom_virial, dcoord, datype, dbox, output_mask);
   // bkw map
-  dforce_.resize(odim * fwd_map.size() * 3);
-  for(int kk = 0; kk < odim; ++kk){
-    select_map<VALUETYPE>(dforce_.begin() + kk * fwd_map.size() * 3, dforce.begin() + kk * bkw_map.size() * 3, bkw_map, 3);
+  dforce_.clear();
+  if (output_mask & OUTPUT_FORCE) {
+    dforce_.resize(odim * fwd_map.size() * 3);
+    for(int kk = 0; kk < odim; ++kk){
+      select_map<VALUETYPE>(dforce_.begin() + kk * fwd_map.size() * 3, dforce.begin() + kk * bkw_map.size() * 3, bkw_map, 3);
+    }
   }
-  datom_virial_.resize(odim * fwd_map.size() * 9);
-  for(int kk = 0; kk < odim; ++kk){
-    select_map<VALUETYPE>(datom_virial_.begin() + kk * fwd_map.size() * 9, datom_virial.begin() + kk * bkw_map.size() * 9, bkw_map, 9);
+  datom_virial_.clear();
+  if (output_mask & OUTPUT_ATOM_VIRIAL) {
+    datom_virial_.resize(odim * fwd_map.size() * 9);
+    for(int kk = 0; kk < odim; ++kk){
+      select_map<VALUETYPE>(datom_virial_.begin() + kk * fwd_map.size() * 9, datom_virial.begin() + kk * bkw_map.size() * 9, bkw_map, 9);
+    }
   }
 }
 
+template<typename VALUETYPE>
 void
 DeepTensor::
 compute (std::vector<VALUETYPE> &	dglobal_tensor_,
@@ -360,7 +436,8 @@ compute (std::vector<VALUETYPE> &	dglobal_tensor_,
 	 const std::vector<int> &	datype_,
 	 const std::vector<VALUETYPE> &	dbox, 
 	 const int			nghost,
-	 const InputNlist &	lmp_list)
+	 const InputNlist &	lmp_list,
+	 const int			output_mask)
 {
   std::vector<VALUETYPE> dcoord, dforce, datom_virial;
   std::vector<int> datype, fwd_map, bkw_map;
@@ -378,19 +455,26 @@ compute (std::vector<VALUETYPE> &	dglobal_tensor_,
   nlist_data.shuffle_exclude_empty(fwd_map);  
   InputNlist nlist;
   nlist_data.make_inlist(nlist);
-  compute_inner(dglobal_tensor_, dforce, dvirial_, datom_tensor_, datom_virial, dcoord, datype, dbox, nghost_real, nlist);
+  compute_inner(dglobal_tensor_, dforce, dvirial_, datom_tensor_, datom_virial, dcoord, datype, dbox, nghost_real, nlist, output_mask);
   // bkw map
-  dforce_.resize(odim * fwd_map.size() * 3);
-  for(int kk = 0; kk < odim; ++kk){
-    select_map<VALUETYPE>(dforce_.begin() + kk * fwd_map.size() * 3, dforce.begin() + kk * bkw_map.size() * 3, bkw_map, 3);
+  dforce_.clear();
+  if (output_mask & OUTPUT_FORCE) {
+    dforce_.resize(odim * fwd_map.size() * 3);
+    for(int kk = 0; kk < odim; ++kk){
+      select_map<VALUETYPE>(dforce_.begin() + kk * fwd_map.size() * 3, dforce.begin() + kk * bkw_map.size() * 3, bkw_map, 3);
+    }
   }
-  datom_virial_.resize(odim * fwd_map.size() * 9);
-  for(int kk = 0; kk < odim; ++kk){
-    select_map<VALUETYPE>(datom_virial_.begin() + kk * fwd_map.size() * 9, datom_virial.begin() + kk * bkw_map.size() * 9, bkw_map, 9);
+  datom_virial_.clear();
+  if (output_mask & OUTPUT_ATOM_VIRIAL) {
+    datom_virial_.resize(odim * fwd_map.size() * 9);
+    for(int kk = 0; kk < odim; ++kk){
+      select_map<VALUETYPE>(datom_virial_.begin() + kk * fwd_map.size() * 9, datom_virial.begin() + kk * bkw_map.size() * 9, bkw_map, 9);
+    }
   }
 }
 
 
+template<typename VALUETYPE>
 void
 DeepTensor::
 compute_inner (std::vector<VALUETYPE> &		dtensor_,
@@ -400,7 +484,7 @@ compute_inner (std::vector<VALUETYPE> &		dtensor_,
 {
   int nall = dcoord_.size() / 3;
   int nloc = nall;
-  AtomMap<VALUETYPE> atommap (datype_.begin(), datype_.begin() + nloc);
+  AtomMap atommap (datype_.begin(), datype_.begin() + nloc);
   assert (nloc == atommap.get_type().size());
   
   std::vector<int> sel_fwd, sel_bkw;
@@ -409,12 +493,19 @@ compute_inner (std::vector<VALUETYPE> &		dtensor_,
   select_by_type(sel_fwd, sel_bkw, nghost_sel, dcoord_, datype_, 0, sel_type);
 
   std::vector<std::pair<std::string, Tensor>> input_tensors;
-  int ret = session_input_tensors (input_tensors, dcoord_, ntypes, datype_, dbox, cell_size, std::vector<VALUETYPE>(), std::vector<VALUETYPE>(), atommap, name_scope);
-  assert (ret == nloc);
-
-  run_model (dtensor_, session, input_tensors, atommap, sel_fwd);
+  if (dtype == DT_DOUBLE) {
+    int ret = session_input_tensors<double> (input_tensors, dcoord_, ntypes, datype_, dbox, cell_size, std::vector<VALUETYPE>(), std::vector<VALUETYPE>(), atommap, name_scope);
+    assert (ret == nloc);
+    run_model<double> (dtensor_, session, input_tensors, atommap, sel_fwd);
+  }
+  else {
+    int ret = session_input_tensors<float> (input_tensors, dcoord_, ntypes, datype_, dbox, cell_size, std::vector<VALUETYPE>(), std::vector<VALUETYPE>(), atommap, name_scope);
+    assert (ret == nloc);
+    run_model<float> (dtensor_, session, input_tensors, atommap, sel_fwd);
+  }
 }
 
+template<typename VALUETYPE>
 void
 DeepTensor::
 compute_inner (std::vector<VALUETYPE> &		dtensor_,
@@ -426,7 +517,7 @@ compute_inner (std::vector<VALUETYPE> &		dtensor_,
 {
   int nall = dcoord_.size() / 3;
   int nloc = nall - nghost;
-  AtomMap<VALUETYPE> atommap (datype_.begin(), datype_.begin() + nloc);
+  AtomMap atommap (datype_.begin(), datype_.begin() + nloc);
   assert (nloc == atommap.get_type().size());
 
   std::vector<int> sel_fwd, sel_bkw;
@@ -442,12 +533,19 @@ compute_inner (std::vector<VALUETYPE> &		dtensor_,
   nlist_data.make_inlist(nlist);
 
   std::vector<std::pair<std::string, Tensor>> input_tensors;
-  int ret = session_input_tensors (input_tensors, dcoord_, ntypes, datype_, dbox, nlist, std::vector<VALUETYPE>(), std::vector<VALUETYPE>(), atommap, nghost, 0, name_scope);
-  assert (nloc == ret);
-
-  run_model (dtensor_, session, input_tensors, atommap, sel_fwd, nghost);
+  if (dtype == DT_DOUBLE) {
+    int ret = session_input_tensors<double> (input_tensors, dcoord_, ntypes, datype_, dbox, nlist, std::vector<VALUETYPE>(), std::vector<VALUETYPE>(), atommap, nghost, 0, name_scope);
+    assert (nloc == ret);
+    run_model<double> (dtensor_, session, input_tensors, atommap, sel_fwd, nghost);
+  }
+  else {
+    int ret = session_input_tensors<float> (input_tensors, dcoord_, ntypes, datype_, dbox, nlist, std::vector<VALUETYPE>(), std::vector<VALUETYPE>(), atommap, nghost, 0, name_scope);
+    assert (nloc == ret);
+    run_model<float> (dtensor_, session, input_tensors, atommap, sel_fwd, nghost);
+  }
 }
 
+template<typename VALUETYPE>
 void
 DeepTensor::
 compute_inner (std::vector<VALUETYPE> &		dglobal_tensor_,
@@ -457,11 +555,12 @@ compute_inner (std::vector<VALUETYPE> &		dglobal_tensor_,
 	       std::vector<VALUETYPE> &	datom_virial_,
 	       const std::vector<VALUETYPE> &	dcoord_,
 	       const std::vector<int> &		datype_,
-	       const std::vector<VALUETYPE> &	dbox)
+	       const std::vector<VALUETYPE> &	dbox,
+	       const int			output_mask)
 {
   int nall = dcoord_.size() / 3;
   int nloc = nall;
-  AtomMap<VALUETYPE> atommap (datype_.begin(), datype_.begin() + nloc);
+  AtomMap atommap (datype_.begin(), datype_.begin() + nloc);
   assert (nloc == atommap.get_type().size());
   
   std::vector<int> sel_fwd, sel_bkw;
@@ -470,12 +569,19 @@ compute_inner (std::vector<VALUETYPE> &		dglobal_tensor_,
   select_by_type(sel_fwd, sel_bkw, nghost_sel, dcoord_, datype_, 0, sel_type);
 
   std::vector<std::pair<std::string, Tensor>> input_tensors;
-  int ret = session_input_tensors (input_tensors, dcoord_, ntypes, datype_, dbox, cell_size, std::vector<VALUETYPE>(), std::vector<VALUETYPE>(), atommap, name_scope);
-  assert (ret == nloc);
-
-  run_model (dglobal_tensor_, dforce_, dvirial_, datom_tensor_, datom_virial_, session, input_tensors, atommap, sel_fwd);
+  if (dtype == DT_DOUBLE) {
+    int ret = session_input_tensors<double> (input_tensors, dcoord_, ntypes, datype_, dbox, cell_size, std::vector<VALUETYPE>(), std::vector<VALUETYPE>(), atommap, name_scope);
+    assert (ret == nloc);
+    run_model<double> (dglobal_tensor_, dforce_, dvirial_, datom_tensor_, datom_virial_, session, input_tensors, atommap, sel_fwd, 0, output_mask);
+  }
+  else {
+    int ret = session_input_tensors<float> (input_tensors, dcoord_, ntypes, datype_, dbox, cell_size, std::vector<VALUETYPE>(), std::vector<VALUETYPE>(), atommap, name_scope);
+    assert (ret == nloc);
+    run_model<float> (dglobal_tensor_, dforce_, dvirial_, datom_tensor_, datom_virial_, session, input_tensors, atommap, sel_fwd, 0, output_mask);
+  }
 }
 
+template<typename VALUETYPE>
 void
 DeepTensor::
 compute_inner (std::vector<VALUETYPE> &		dglobal_tensor_,
@@ -487,11 +593,12 @@ compute_inner (std::vector<VALUETYPE> &		dglobal_tensor_,
 	       const std::vector<int> &		datype_,
 	       const std::vector<VALUETYPE> &	dbox, 
 	       const int			nghost,
-	       const InputNlist &	nlist_)
+	       const InputNlist &	nlist_,
+	       const int			output_mask)
 {
   int nall = dcoord_.size() / 3;
   int nloc = nall - nghost;
-  AtomMap<VALUETYPE> atommap (datype_.begin(), datype_.begin() + nloc);
+  AtomMap atommap (datype_.begin(), datype_.begin() + nloc);
   assert (nloc == atommap.get_type().size());
 
   std::vector<int> sel_fwd, sel_bkw;
@@ -507,9 +614,152 @@ compute_inner (std::vector<VALUETYPE> &		dglobal_tensor_,
   nlist_data.make_inlist(nlist);
 
   std::vector<std::pair<std::string, Tensor>> input_tensors;
-  int ret = session_input_tensors (input_tensors, dcoord_, ntypes, datype_, dbox, nlist, std::vector<VALUETYPE>(), std::vector<VALUETYPE>(), atommap, nghost, 0, name_scope);
-  assert (nloc == ret);
-
-  run_model (dglobal_tensor_, dforce_, dvirial_, datom_tensor_, datom_virial_, session, input_tensors, atommap, sel_fwd, nghost);
+  if (dtype == DT_DOUBLE) {
+    int ret = session_input_tensors<double> (input_tensors, dcoord_, ntypes, datype_, dbox, nlist, std::vector<VALUETYPE>(), std::vector<VALUETYPE>(), atommap, nghost, 0, name_scope);
+    assert (nloc == ret);
+    run_model<double> (dglobal_tensor_, dforce_, dvirial_, datom_tensor_, datom_virial_, session, input_tensors, atommap, sel_fwd, nghost, output_mask);
+  }
+  else {
+    int ret = session_input_tensors<float> (input_tensors, dcoord_, ntypes, datype_, dbox, nlist, std::vector<VALUETYPE>(), std::vector<VALUETYPE>(), atommap, nghost, 0, name_scope);
+    assert (nloc == ret);
+    run_model<float> (dglobal_tensor_, dforce_, dvirial_, datom_tensor_, datom_virial_, session, input_tensors, atommap, sel_fwd, nghost, output_mask);
+  }
 }
 
+template
+void
+DeepTensor::
+compute<double> (std::vector<double> &	dtensor_,
+	 const std::vector<double> &	dcoord_,
+	 const std::vector<int> &	datype_,
+	 const std::vector<double> &	dbox);
+
+template
+void
+DeepTensor::
+compute<double> (std::vector<double> &	dtensor_,
+	 const std::vector<double> &	dcoord_,
+	 const std::vector<int> &	datype_,
+	 const std::vector<double> &	dbox, 
+	 const int			nghost,
+	 const InputNlist &		lmp_list,
+	 const int			ago);
+
+template
+void
+DeepTensor::
+compute<double> (std::vector<double> &	dglobal_tensor_,
+	 std::vector<double> &	dforce_,
+	 std::vector<double> &	dvirial_,
+	 const std::vector<double> &	dcoord_,
+	 const std::vector<int> &	datype_,
+	 const std::vector<double> &	dbox);
+
+template
+void
+DeepTensor::
+compute<double> (std::vector<double> &	dglobal_tensor_,
+	 std::vector<double> &	dforce_,
+	 std::vector<double> &	dvirial_,
+	 const std::vector<double> &	dcoord_,
+	 const std::vector<int> &	datype_,
+	 const std::vector<double> &	dbox, 
+	 const int			nghost,
+	 const InputNlist &		lmp_list);
+
+template
+void
+DeepTensor::
+compute<double> (std::vector<double> &	dglobal_tensor_,
+	 std::vector<double> &	dforce_,
+	 std::vector<double> &	dvirial_,
+	 std::vector<double> &	datom_tensor_,
+	 std::vector<double> &	datom_virial_,
+	 const std::vector<double> &	dcoord_,
+	 const std::vector<int> &	datype_,
+	 const std::vector<double> &	dbox,
+	 const int			output_mask);
+
+template
+void
+DeepTensor::
+compute<double> (std::vector<double> &	dglobal_tensor_,
+	 std::vector<double> &	dforce_,
+	 std::vector<double> &	dvirial_,
+	 std::vector<double> &	datom_tensor_,
+	 std::vector<double> &	datom_virial_,
+	 const std::vector<double> &	dcoord_,
+	 const std::vector<int> &	datype_,
+	 const std::vector<double> &	dbox, 
+	 const int			nghost,
+	 const InputNlist &		lmp_list,
+	 const int			output_mask);
+
+template
+void
+DeepTensor::
+compute<float> (std::vector<float> &	dtensor_,
+	 const std::vector<float> &	dcoord_,
+	 const std::vector<int> &	datype_,
+	 const std::vector<float> &	dbox);
+
+template
+void
+DeepTensor::
+compute<float> (std::vector<float> &	dtensor_,
+	 const std::vector<float> &	dcoord_,
+	 const std::vector<int> &	datype_,
+	 const std::vector<float> &	dbox, 
+	 const int			nghost,
+	 const InputNlist &		lmp_list,
+	 const int			ago);
+
+template
+void
+DeepTensor::
+compute<float> (std::vector<float> &	dglobal_tensor_,
+	 std::vector<float> &	dforce_,
+	 std::vector<float> &	dvirial_,
+	 const std::vector<float> &	dcoord_,
+	 const std::vector<int> &	datype_,
+	 const std::vector<float> &	dbox);
+
+template
+void
+DeepTensor::
+compute<float> (std::vector<float> &	dglobal_tensor_,
+	 std::vector<float> &	dforce_,
+	 std::vector<float> &	dvirial_,
+	 const std::vector<float> &	dcoord_,
+	 const std::vector<int> &	datype_,
+	 const std::vector<float> &	dbox, 
+	 const int			nghost,
+	 const InputNlist &		lmp_list);
+
+template
+void
+DeepTensor::
+compute<float> (std::vector<float> &	dglobal_tensor_,
+	 std::vector<float> &	dforce_,
+	 std::vector<float> &	dvirial_,
+	 std::vector<float> &	datom_tensor_,
+	 std::vector<float> &	datom_virial_,
+	 const std::vector<float> &	dcoord_,
+	 const std::vector<int> &	datype_,
+	 const std::vector<float> &	dbox,
+	 const int			output_mask);
+
+template
+void
+DeepTensor::
+compute<float> (std::vector<float> &	dglobal_tensor_,
+	 std::vector<float> &	dforce_,
+	 std::vector<float> &	dvirial_,
+	 std::vector<float> &	datom_tensor_,
+	 std::vector<float> &	datom_virial_,
+	 const std::vector<float> &	dcoord_,
+	 const std::vector<int> &	datype_,
+	 const std::vector<float> &	dbox, 
+	 const int			nghost,
+	 const InputNlist &		lmp_list,
+	 const int			output_mask);
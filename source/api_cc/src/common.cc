@@ -45,12 +45,100 @@ model_compatable(
   }
 }
 
+static double
+const_node_scalar(
+    const NodeDef & node)
+{
+  Tensor tensor;
+  if (node.op() != "Const" || !tensor.FromProto(node.attr().at("value").tensor())) {
+    throw std::runtime_error("cannot read the scalar of node " + node.name());
+  }
+  switch (tensor.dtype()) {
+  case DT_DOUBLE:
+    return tensor.flat<double>()(0);
+  case DT_FLOAT:
+    return tensor.flat<float>()(0);
+  case DT_INT32:
+    return tensor.flat<int32>()(0);
+  default:
+    throw std::runtime_error("unsupported dtype of node " + node.name());
+  }
+}
+
+void
+deepmd::
+read_model_metadata(
+    ModelMetadata & metadata,
+    const GraphDef & graph_def,
+    const std::string scope)
+{
+  const std::string prefix = name_prefix(scope);
+  bool found_ntypes = false, found_rcut = false, found_descrpt = false;
+  metadata.rcut_smth = 0.;
+  metadata.sel.clear();
+  metadata.compressed = false;
+  // one pass over the nodes, the attributes are read by the protobuf API
+  for (int ii = 0; ii < graph_def.node_size(); ++ii) {
+    const NodeDef & node = graph_def.node(ii);
+    if (node.name() == prefix + "descrpt_attr/ntypes") {
+      metadata.ntypes = int(const_node_scalar(node));
+      found_ntypes = true;
+    }
+    else if (node.name() == prefix + "descrpt_attr/rcut") {
+      metadata.rcut = const_node_scalar(node);
+      found_rcut = true;
+    }
+    else if (!found_descrpt && 
+	     (node.op() == "ProdEnvMatA" || node.op() == "DescrptSeA" || node.op() == "ProdEnvMatATabulate")) {
+      const auto & sel_a = node.attr().at("sel_a").list().i();
+      metadata.sel.assign(sel_a.begin(), sel_a.end());
+      metadata.rcut_smth = node.attr().at("rcut_r_smth").f();
+      found_descrpt = true;
+    }
+    else if (!found_descrpt && 
+	     (node.op() == "ProdEnvMatR" || node.op() == "DescrptSeR")) {
+      const auto & sel = node.attr().at("sel").list().i();
+      metadata.sel.assign(sel.begin(), sel.end());
+      metadata.rcut_smth = node.attr().at("rcut_smth").f();
+      found_descrpt = true;
+    }
+    // the model compressed with --fuse-env-mat only has ProdEnvMatATabulate
+    if (node.op() == "TabulateFusion" || node.op() == "ProdEnvMatATabulate") {
+      metadata.compressed = true;
+    }
+  }
+  if (!found_ntypes || !found_rcut) {
+    throw std::runtime_error("cannot find " + prefix + "descrpt_attr/ntypes or " + prefix + "descrpt_attr/rcut in the graph");
+  }
+}
+
+tensorflow::DataType
+deepmd::
+model_dtype(
+    const GraphDef & graph_def,
+    const std::string scope)
+{
+  const std::string name = name_prefix(scope) + "t_coord";
+  for (int ii = 0; ii < graph_def.node_size(); ++ii) {
+    const NodeDef & node = graph_def.node(ii);
+    if (node.name() == name) {
+      DataType dtype = node.attr().at("dtype").type();
+      if (dtype != DT_DOUBLE && dtype != DT_FLOAT) {
+	throw std::runtime_error("unsupported dtype of " + name);
+      }
+      return dtype;
+    }
+  }
+  throw std::runtime_error("cannot find " + name + " in the graph");
+}
+
+template<typename VALUETYPE>
 void 
 deepmd::
 select_by_type(std::vector<int> & fwd_map,
 	       std::vector<int> & bkw_map,
 	       int & nghost_real, 
-	       const std::vector<deepmd::VALUETYPE> & dcoord_, 
+	       const std::vector<VALUETYPE> & dcoord_, 
 	       const std::vector<int> & datype_,
 	       const int & nghost,
 	       const std::vector<int> & sel_type_)
@@ -87,12 +175,13 @@ select_by_type(std::vector<int> & fwd_map,
 }	       
 
 
+template<typename VALUETYPE>
 void
 deepmd::
 select_real_atoms(std::vector<int> & fwd_map,
 		  std::vector<int> & bkw_map,
 		  int & nghost_real,
-		  const std::vector<deepmd::VALUETYPE> & dcoord_, 
+		  const std::vector<VALUETYPE> & dcoord_, 
 		  const std::vector<int> & datype_,
 		  const int & nghost,
 		  const int & ntypes)
@@ -123,7 +212,7 @@ copy_from_nlist(const InputNlist & inlist)
 
 void
 deepmd::NeighborListData::
-shuffle(const AtomMap<deepmd::VALUETYPE> & map)
+shuffle(const AtomMap & map)
 {
   const std::vector<int> & fwd_map = map.get_fwd_map();
   shuffle(fwd_map);
@@ -239,18 +328,140 @@ name_prefix(const std::string & scope)
   return prefix;
 }
 
+bool
+deepmd::
+model_is_memmapped(
+    const std::string & model)
+{
+  MemmappedEnv mmap_env(Env::Default());
+  if (!mmap_env.InitializeFromFile(model).ok()) {
+    return false;
+  }
+  return mmap_env.FileExists(MemmappedFileSystem::kMemmappedPackageDefaultGraphDef).ok();
+}
+
+void
+deepmd::
+load_graph_def(
+    GraphDef & graph_def,
+    std::unique_ptr<MemmappedEnv> & mmap_env,
+    SessionOptions & options,
+    const std::string & model,
+    const std::string & file_content)
+{
+  mmap_env.reset();
+  if (file_content.size() != 0) {
+    graph_def.ParseFromString(file_content);
+    return;
+  }
+  if (!model_is_memmapped(model)) {
+    check_status (ReadBinaryProto(Env::Default(), model, &graph_def));
+    return;
+  }
+  mmap_env.reset(new MemmappedEnv(Env::Default()));
+  check_status (mmap_env->InitializeFromFile(model));
+  check_status (ReadBinaryProto(mmap_env.get(), MemmappedFileSystem::kMemmappedPackageDefaultGraphDef, &graph_def));
+  options.env = mmap_env.get();
+  // constant folding would copy the mapped tensors into the private memory of the process
+  options.config.mutable_graph_options()->mutable_optimizer_options()->set_opt_level(OptimizerOptions::L0);
+}
+
+std::vector<std::string>
+deepmd::
+session_input_names(
+    const bool has_fparam,
+    const bool has_aparam,
+    const std::string scope)
+{
+  std::string prefix = name_prefix(scope);
+  std::vector<std::string> names = {
+    prefix+"t_coord",
+    prefix+"t_type",
+    prefix+"t_box",
+    prefix+"t_mesh",
+    prefix+"t_natoms",
+  };
+  if (has_fparam) {
+    names.push_back(prefix+"t_fparam");
+  }
+  if (has_aparam) {
+    names.push_back(prefix+"t_aparam");
+  }
+  return names;
+}
+
+void
+deepmd::
+session_make_callable(
+    SessionCallable & callable,
+    Session* session,
+    const std::vector<std::string> & feeds,
+    const std::vector<std::string> & fetches)
+{
+  CallableOptions options;
+  for (unsigned ii = 0; ii < feeds.size(); ++ii){
+    options.add_feed(feeds[ii]);
+  }
+  for (unsigned ii = 0; ii < fetches.size(); ++ii){
+    options.add_fetch(fetches[ii]);
+  }
+  deepmd::check_status (session->MakeCallable(options, &callable.handle));
+  callable.feeds = feeds;
+  callable.fetches = fetches;
+}
+
+void
+deepmd::
+session_run_callable(
+    std::vector<Tensor> & output_tensors,
+    Session* session,
+    const SessionCallable & callable,
+    const std::vector<std::pair<std::string, Tensor>> & input_tensors)
+{
+  if (input_tensors.size() != callable.feeds.size()) {
+    throw std::runtime_error("the number of input tensors is not consistent with the feeds of the callable");
+  }
+  std::vector<Tensor> feed_tensors;
+  feed_tensors.reserve(callable.feeds.size());
+  for (unsigned ii = 0; ii < callable.feeds.size(); ++ii){
+    // session_input_tensors fills the feeds in the same order, so the search stops at jj == ii
+    unsigned jj = 0;
+    for (; jj < input_tensors.size(); ++jj){
+      if (input_tensors[jj].first == callable.feeds[ii]) break;
+    }
+    if (jj == input_tensors.size()) {
+      throw std::runtime_error("the feed " + callable.feeds[ii] + " of the callable is not found in the input tensors");
+    }
+    feed_tensors.push_back(input_tensors[jj].second);
+  }
+  output_tensors.clear();
+  output_tensors.reserve(callable.fetches.size());
+  deepmd::check_status (session->RunCallable(callable.handle, feed_tensors, &output_tensors, nullptr));
+}
+
+void
+deepmd::
+session_release_callable(
+    Session* session,
+    const SessionCallable & callable)
+{
+  // called by destructors, so the status is not checked
+  session->ReleaseCallable(callable.handle);
+}
+
+template<typename MODELTYPE, typename VALUETYPE>
 int
 deepmd::
 session_input_tensors (
     std::vector<std::pair<std::string, Tensor>> & input_tensors,
-    const std::vector<deepmd::VALUETYPE> &	dcoord_,
+    const std::vector<VALUETYPE> &	dcoord_,
     const int &					ntypes,
     const std::vector<int> &			datype_,
-    const std::vector<deepmd::VALUETYPE> &	dbox, 
-    const deepmd::VALUETYPE &			cell_size,
-    const std::vector<deepmd::VALUETYPE> &	fparam_,
-    const std::vector<deepmd::VALUETYPE> &	aparam_,
-    const deepmd::AtomMap<deepmd::VALUETYPE>&	atommap,
+    const std::vector<VALUETYPE> &	dbox, 
+    const double &				cell_size,
+    const std::vector<VALUETYPE> &	fparam_,
+    const std::vector<VALUETYPE> &	aparam_,
+    const deepmd::AtomMap &	atommap,
     const std::string				scope)
 {
   bool b_pbc = (dbox.size() == 9);
@@ -292,31 +503,25 @@ session_input_tensors (
   aparam_shape.AddDim (nframes);
   aparam_shape.AddDim (aparam_.size());
   
-#ifdef HIGH_PREC
-  Tensor coord_tensor	(DT_DOUBLE, coord_shape);
-  Tensor box_tensor	(DT_DOUBLE, box_shape);
-  Tensor fparam_tensor  (DT_DOUBLE, fparam_shape);
-  Tensor aparam_tensor  (DT_DOUBLE, aparam_shape);
-#else
-  Tensor coord_tensor	(DT_FLOAT, coord_shape);
-  Tensor box_tensor	(DT_FLOAT, box_shape);
-  Tensor fparam_tensor  (DT_FLOAT, fparam_shape);
-  Tensor aparam_tensor  (DT_FLOAT, aparam_shape);
-#endif
+  DataType dtype = DataTypeToEnum<MODELTYPE>::v();
+  Tensor coord_tensor	(dtype, coord_shape);
+  Tensor box_tensor	(dtype, box_shape);
+  Tensor fparam_tensor  (dtype, fparam_shape);
+  Tensor aparam_tensor  (dtype, aparam_shape);
   Tensor type_tensor	(DT_INT32, type_shape);
   Tensor mesh_tensor	(DT_INT32, mesh_shape);
   Tensor natoms_tensor	(DT_INT32, natoms_shape);
 
-  auto coord = coord_tensor.matrix<deepmd::VALUETYPE> ();
+  auto coord = coord_tensor.matrix<MODELTYPE> ();
   auto type = type_tensor.matrix<int> ();
-  auto box = box_tensor.matrix<deepmd::VALUETYPE> ();
+  auto box = box_tensor.matrix<MODELTYPE> ();
   auto mesh = mesh_tensor.flat<int> ();
   auto natoms = natoms_tensor.flat<int> ();  
-  auto fparam = fparam_tensor.matrix<deepmd::VALUETYPE> ();
-  auto aparam = aparam_tensor.matrix<deepmd::VALUETYPE> ();
+  auto fparam = fparam_tensor.matrix<MODELTYPE> ();
+  auto aparam = aparam_tensor.matrix<MODELTYPE> ();
 
-  std::vector<deepmd::VALUETYPE> dcoord (dcoord_);
-  atommap.forward (dcoord.begin(), dcoord_.begin(), 3);
+  std::vector<VALUETYPE> dcoord (dcoord_);
+  atommap.forward<VALUETYPE> (dcoord.begin(), dcoord_.begin(), 3);
   
   for (int ii = 0; ii < nframes; ++ii){
     for (int jj = 0; jj < nall * 3; ++jj){
@@ -374,18 +579,19 @@ session_input_tensors (
   return nloc;
 }
 
+template<typename MODELTYPE, typename VALUETYPE>
 int
 deepmd::
 session_input_tensors (
     std::vector<std::pair<std::string, Tensor>> & input_tensors,
-    const std::vector<deepmd::VALUETYPE> &	dcoord_,
+    const std::vector<VALUETYPE> &	dcoord_,
     const int &					ntypes,
     const std::vector<int> &			datype_,
-    const std::vector<deepmd::VALUETYPE> &	dbox,		    
+    const std::vector<VALUETYPE> &	dbox,		    
     InputNlist &				dlist, 
-    const std::vector<deepmd::VALUETYPE> &	fparam_,
-    const std::vector<deepmd::VALUETYPE> &	aparam_,
-    const deepmd::AtomMap<deepmd::VALUETYPE>&	atommap,
+    const std::vector<VALUETYPE> &	fparam_,
+    const std::vector<VALUETYPE> &	aparam_,
+    const deepmd::AtomMap &	atommap,
     const int					nghost,
     const int					ago,
     const std::string				scope)
@@ -424,31 +630,25 @@ session_input_tensors (
   aparam_shape.AddDim (nframes);
   aparam_shape.AddDim (aparam_.size());
   
-#ifdef HIGH_PREC
-  Tensor coord_tensor	(DT_DOUBLE, coord_shape);
-  Tensor box_tensor	(DT_DOUBLE, box_shape);
-  Tensor fparam_tensor  (DT_DOUBLE, fparam_shape);
-  Tensor aparam_tensor  (DT_DOUBLE, aparam_shape);
-#else
-  Tensor coord_tensor	(DT_FLOAT, coord_shape);
-  Tensor box_tensor	(DT_FLOAT, box_shape);
-  Tensor fparam_tensor  (DT_FLOAT, fparam_shape);
-  Tensor aparam_tensor  (DT_FLOAT, aparam_shape);
-#endif
+  DataType dtype = DataTypeToEnum<MODELTYPE>::v();
+  Tensor coord_tensor	(dtype, coord_shape);
+  Tensor box_tensor	(dtype, box_shape);
+  Tensor fparam_tensor  (dtype, fparam_shape);
+  Tensor aparam_tensor  (dtype, aparam_shape);
   Tensor type_tensor	(DT_INT32, type_shape);
   Tensor mesh_tensor	(DT_INT32, mesh_shape);
   Tensor natoms_tensor	(DT_INT32, natoms_shape);
 
-  auto coord = coord_tensor.matrix<deepmd::VALUETYPE> ();
+  auto coord = coord_tensor.matrix<MODELTYPE> ();
   auto type = type_tensor.matrix<int> ();
-  auto box = box_tensor.matrix<deepmd::VALUETYPE> ();
+  auto box = box_tensor.matrix<MODELTYPE> ();
   auto mesh = mesh_tensor.flat<int> ();
   auto natoms = natoms_tensor.flat<int> ();
-  auto fparam = fparam_tensor.matrix<deepmd::VALUETYPE> ();
-  auto aparam = aparam_tensor.matrix<deepmd::VALUETYPE> ();
+  auto fparam = fparam_tensor.matrix<MODELTYPE> ();
+  auto aparam = aparam_tensor.matrix<MODELTYPE> ();
 
-  std::vector<deepmd::VALUETYPE> dcoord (dcoord_);
-  atommap.forward (dcoord.begin(), dcoord_.begin(), 3);
+  std::vector<VALUETYPE> dcoord (dcoord_);
+  atommap.forward<VALUETYPE> (dcoord.begin(), dcoord_.begin(), 3);
   
   for (int ii = 0; ii < nframes; ++ii){
     for (int jj = 0; jj < nall * 3; ++jj){
@@ -823,3 +1023,179 @@ select_map_inv<deepmd::STRINGTYPE >(
     const typename std::vector<deepmd::STRINGTYPE >::const_iterator in, 
     const std::vector<int > & idx_map, 
     const int & stride);
+
+template
+void 
+deepmd::
+select_by_type<float>(
+    std::vector<int> & fwd_map,
+    std::vector<int> & bkw_map,
+    int & nghost_real, 
+    const std::vector<float> & dcoord_, 
+    const std::vector<int> & datype_,
+    const int & nghost,
+    const std::vector<int> & sel_type_);
+
+template
+void
+deepmd::
+select_real_atoms<float>(
+    std::vector<int> & fwd_map,
+    std::vector<int> & bkw_map,
+    int & nghost_real,
+    const std::vector<float> & dcoord_, 
+    const std::vector<int> & datype_,
+    const int & nghost,
+    const int & ntypes);
+
+template
+void 
+deepmd::
+select_by_type<double>(
+    std::vector<int> & fwd_map,
+    std::vector<int> & bkw_map,
+    int & nghost_real, 
+    const std::vector<double> & dcoord_, 
+    const std::vector<int> & datype_,
+    const int & nghost,
+    const std::vector<int> & sel_type_);
+
+template
+void
+deepmd::
+select_real_atoms<double>(
+    std::vector<int> & fwd_map,
+    std::vector<int> & bkw_map,
+    int & nghost_real,
+    const std::vector<double> & dcoord_, 
+    const std::vector<int> & datype_,
+    const int & nghost,
+    const int & ntypes);
+
+template
+int
+deepmd::
+session_input_tensors<double, double> (
+    std::vector<std::pair<std::string, Tensor>> & input_tensors,
+    const std::vector<double> &	dcoord_,
+    const int &			ntypes,
+    const std::vector<int> &		datype_,
+    const std::vector<double> &	dbox, 
+    const double &			cell_size,
+    const std::vector<double> &	fparam_,
+    const std::vector<double> &	aparam_,
+    const deepmd::AtomMap &		atommap,
+    const std::string			scope);
+
+template
+int
+deepmd::
+session_input_tensors<double, double> (
+    std::vector<std::pair<std::string, Tensor>> & input_tensors,
+    const std::vector<double> &	dcoord_,
+    const int &			ntypes,
+    const std::vector<int> &		datype_,
+    const std::vector<double> &	dbox,		    
+    InputNlist &			dlist, 
+    const std::vector<double> &	fparam_,
+    const std::vector<double> &	aparam_,
+    const deepmd::AtomMap &		atommap,
+    const int				nghost,
+    const int				ago,
+    const std::string			scope);
+
+template
+int
+deepmd::
+session_input_tensors<double, float> (
+    std::vector<std::pair<std::string, Tensor>> & input_tensors,
+    const std::vector<float> &	dcoord_,
+    const int &			ntypes,
+    const std::vector<int> &		datype_,
+    const std::vector<float> &	dbox, 
+    const double &			cell_size,
+    const std::vector<float> &	fparam_,
+    const std::vector<float> &	aparam_,
+    const deepmd::AtomMap &		atommap,
+    const std::string			scope);
+
+template
+int
+deepmd::
+session_input_tensors<double, float> (
+    std::vector<std::pair<std::string, Tensor>> & input_tensors,
+    const std::vector<float> &	dcoord_,
+    const int &			ntypes,
+    const std::vector<int> &		datype_,
+    const std::vector<float> &	dbox,		    
+    InputNlist &			dlist, 
+    const std::vector<float> &	fparam_,
+    const std::vector<float> &	aparam_,
+    const deepmd::AtomMap &		atommap,
+    const int				nghost,
+    const int				ago,
+    const std::string			scope);
+
+template
+int
+deepmd::
+session_input_tensors<float, double> (
+    std::vector<std::pair<std::string, Tensor>> & input_tensors,
+    const std::vector<double> &	dcoord_,
+    const int &			ntypes,
+    const std::vector<int> &		datype_,
+    const std::vector<double> &	dbox, 
+    const double &			cell_size,
+    const std::vector<double> &	fparam_,
+    const std::vector<double> &	aparam_,
+    const deepmd::AtomMap &		atommap,
+    const std::string			scope);
+
+template
+int
+deepmd::
+session_input_tensors<float, double> (
+    std::vector<std::pair<std::string, Tensor>> & input_tensors,
+    const std::vector<double> &	dcoord_,
+    const int &			ntypes,
+    const std::vector<int> &		datype_,
+    const std::vector<double> &	dbox,		    
+    InputNlist &			dlist, 
+    const std::vector<double> &	fparam_,
+    const std::vector<double> &	aparam_,
+    const deepmd::AtomMap &		atommap,
+    const int				nghost,
+    const int				ago,
+    const std::string			scope);
+
+template
+int
+deepmd::
+session_input_tensors<float, float> (
+    std::vector<std::pair<std::string, Tensor>> & input_tensors,
+    const std::vector<float> &	dcoord_,
+    const int &			ntypes,
+    const std::vector<int> &		datype_,
+    const std::vector<float> &	dbox, 
+    const double &			cell_size,
+    const std::vector<float> &	fparam_,
+    const std::vector<float> &	aparam_,
+    const deepmd::AtomMap &		atommap,
+    const std::string			scope);
+
+template
+int
+deepmd::
+session_input_tensors<float, float> (
+    std::vector<std::pair<std::string, Tensor>> & input_tensors,
+    const std::vector<float> &	dcoord_,
+    const int &			ntypes,
+    const std::vector<int> &		datype_,
+    const std::vector<float> &	dbox,		    
+    InputNlist &			dlist, 
+    const std::vector<float> &	fparam_,
+    const std::vector<float> &	aparam_,
+    const deepmd::AtomMap &		atommap,
+    const int				nghost,
+    const int				ago,
+    const std::string			scope);
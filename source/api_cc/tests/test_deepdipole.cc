@@ -313,6 +313,63 @@ TEST_F(TestInferDeepDipoleNew, cpu_lmp_nlist)
 }
 
 
+TEST_F(TestInferDeepDipoleNew, cpu_lmp_nlist_output_mask)
+{
+  float rc = dp.cutoff();
+  int nloc = coord.size() / 3;  
+  std::vector<double> coord_cpy;
+  std::vector<int> atype_cpy, mapping;  
+  std::vector<int> ilist(nloc), numneigh(nloc);
+  std::vector<int*> firstneigh(nloc);
+  std::vector<std::vector<int > > nlist_data;
+  deepmd::InputNlist inlist(nloc, &ilist[0], &numneigh[0], &firstneigh[0]);
+  _build_nlist(nlist_data, coord_cpy, atype_cpy, mapping,
+	       coord, atype, box, rc);
+  int nall = coord_cpy.size() / 3;
+  convert_nlist(inlist, nlist_data);  
+
+  std::vector<double> gt, ff, vv, at, av;
+
+  // only the atomic tensor
+  dp.compute(gt, ff, vv, at, av, coord_cpy, atype_cpy, box, nall-nloc, inlist, deepmd::DeepTensor::OUTPUT_ATOM);
+  EXPECT_EQ(gt.size(), 0);
+  EXPECT_EQ(ff.size(), 0);
+  EXPECT_EQ(vv.size(), 0);
+  EXPECT_EQ(av.size(), 0);
+  EXPECT_EQ(at.size(), expected_t.size());
+  for(int ii = 0; ii < expected_t.size(); ++ii){
+    EXPECT_LT(fabs(at[ii] - expected_t[ii]), 1e-10);
+  }
+
+  // the global tensor and the atomic virial
+  dp.compute(gt, ff, vv, at, av, coord_cpy, atype_cpy, box, nall-nloc, inlist, 
+	     deepmd::DeepTensor::OUTPUT_GLOBAL | deepmd::DeepTensor::OUTPUT_ATOM_VIRIAL);
+  EXPECT_EQ(ff.size(), 0);
+  EXPECT_EQ(vv.size(), 0);
+  EXPECT_EQ(at.size(), 0);
+  EXPECT_EQ(gt.size(), expected_gt.size());
+  for(int ii = 0; ii < expected_gt.size(); ++ii){
+    EXPECT_LT(fabs(gt[ii] - expected_gt[ii]), 1e-10);
+  }
+  std::vector<double> rav (odim * nloc * 9);
+  for(int kk = 0; kk < odim; ++kk){
+    _fold_back(rav.begin() + kk * nloc * 9, av.begin() + kk * nall * 9, mapping, nloc, nall, 9);
+  }
+  EXPECT_EQ(rav.size(), expected_v.size());
+  for(int ii = 0; ii < expected_v.size(); ++ii){
+    EXPECT_LT(fabs(rav[ii] - expected_v[ii]), 1e-10);
+  }
+
+  // the component-wise force
+  dp.compute(gt, ff, vv, at, av, coord, atype, box, deepmd::DeepTensor::OUTPUT_FORCE);
+  EXPECT_EQ(gt.size(), 0);
+  EXPECT_EQ(av.size(), 0);
+  EXPECT_EQ(ff.size(), expected_f.size());
+  for(int ii = 0; ii < expected_f.size(); ++ii){
+    EXPECT_LT(fabs(ff[ii] - expected_f[ii]), 1e-10);
+  }
+}
+
 
 class TestInferDeepDipoleFake : public ::testing::Test
 {  
@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 #include <cmath>
 #include <algorithm>
+#include <chrono>
 #include <fstream>
 #include <vector>
 #include "DeepPot.h"
@@ -9,6 +10,8 @@
 
 #include "google/protobuf/text_format.h"
 #include "google/protobuf/io/zero_copy_stream_impl.h"
+#include "tensorflow/core/util/memmapped_file_system.h"
+#include "tensorflow/core/util/memmapped_file_system_writer.h"
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>  
@@ -99,6 +102,26 @@ TEST_F(TestInferDeepPotA, cpu_build_nlist)
   }
 }
 
+TEST_F(TestInferDeepPotA, cpu_build_nlist_float)
+{
+  // float inputs and outputs with the double precision model
+  std::vector<float> coord_(coord.begin(), coord.end()), box_(box.begin(), box.end());
+  double ener;
+  std::vector<float> force, virial;
+  dp.compute(ener, force, virial, coord_, atype, box_);
+
+  EXPECT_EQ(force.size(), natoms*3);
+  EXPECT_EQ(virial.size(), 9);
+
+  EXPECT_LT(fabs(ener - expected_tot_e), 1e-4);
+  for(int ii = 0; ii < natoms*3; ++ii){
+    EXPECT_LT(fabs(force[ii] - expected_f[ii]), 1e-5);
+  }
+  for(int ii = 0; ii < 3*3; ++ii){
+    EXPECT_LT(fabs(virial[ii] - expected_tot_v[ii]), 1e-5);
+  }
+}
+
 TEST_F(TestInferDeepPotA, cpu_build_nlist_numfv)
 {
   class MyModel : public EnergyModelTest<double>
@@ -222,6 +245,270 @@ TEST_F(TestInferDeepPotA, cpu_lmp_nlist)
 }
 
 
+TEST_F(TestInferDeepPotA, cpu_lmp_nlist_async)
+{
+  float rc = dp.cutoff();
+  int nloc = coord.size() / 3;  
+  std::vector<double> coord_cpy;
+  std::vector<int> atype_cpy, mapping;  
+  std::vector<std::vector<int > > nlist_data;
+  _build_nlist(nlist_data, coord_cpy, atype_cpy, mapping,
+	       coord, atype, box, rc);
+  int nall = coord_cpy.size() / 3;
+  std::vector<int> ilist(nloc), numneigh(nloc);
+  std::vector<int*> firstneigh(nloc);
+  deepmd::InputNlist inlist(nloc, &ilist[0], &numneigh[0], &firstneigh[0]);
+  convert_nlist(inlist, nlist_data);  
+  
+  double ener;
+  std::vector<double> force_, virial;
+  std::future<void> job = dp.compute_async(ener, force_, virial, coord_cpy, atype_cpy, box, nall-nloc, inlist, 0);
+  // the inputs are consumed at launch
+  std::fill(coord_cpy.begin(), coord_cpy.end(), 0.0);
+  std::fill(numneigh.begin(), numneigh.end(), 0);
+  job.get();
+  std::vector<double> force;
+  _fold_back(force, force_, mapping, nloc, nall, 3);
+
+  EXPECT_EQ(force.size(), natoms*3);
+  EXPECT_EQ(virial.size(), 9);
+
+  EXPECT_LT(fabs(ener - expected_tot_e), 1e-10);
+  for(int ii = 0; ii < natoms*3; ++ii){
+    EXPECT_LT(fabs(force[ii] - expected_f[ii]), 1e-10);    
+  }
+  for(int ii = 0; ii < 3*3; ++ii){
+    EXPECT_LT(fabs(virial[ii] - expected_tot_v[ii]), 1e-10);
+  }
+}
+
+TEST_F(TestInferDeepPotA, cpu_lmp_nlist_reload)
+{
+  // another model with the same cutoff radius and number of types
+  {
+    std::string file_name = "../../tests/infer/deeppot-1.pbtxt";
+    int fd = open(file_name.c_str(), O_RDONLY);
+    tensorflow::protobuf::io::ZeroCopyInputStream* input = new tensorflow::protobuf::io::FileInputStream(fd);
+    tensorflow::GraphDef graph_def;
+    tensorflow::protobuf::TextFormat::Parse(input, &graph_def);
+    delete input;
+    std::fstream output("deeppot-1.pb", std::ios::out | std::ios::trunc | std::ios::binary);
+    graph_def.SerializeToOstream(&output);
+  }
+  deepmd::DeepPot dp1("deeppot-1.pb");
+
+  float rc = dp.cutoff();
+  int nloc = coord.size() / 3;  
+  std::vector<double> coord_cpy;
+  std::vector<int> atype_cpy, mapping;  
+  std::vector<std::vector<int > > nlist_data;
+  _build_nlist(nlist_data, coord_cpy, atype_cpy, mapping,
+	       coord, atype, box, rc);
+  int nall = coord_cpy.size() / 3;
+  std::vector<int> ilist(nloc), numneigh(nloc);
+  std::vector<int*> firstneigh(nloc);
+  deepmd::InputNlist inlist(nloc, &ilist[0], &numneigh[0], &firstneigh[0]);
+  convert_nlist(inlist, nlist_data);  
+  
+  double ener1;
+  std::vector<double> force1_, virial1;
+  dp1.compute(ener1, force1_, virial1, coord_cpy, atype_cpy, box, nall-nloc, inlist, 0);
+  std::vector<double> force1;
+  _fold_back(force1, force1_, mapping, nloc, nall, 3);
+  // the two models give different results
+  EXPECT_GT(fabs(ener1 - expected_tot_e), 1e-6);
+
+  double ener;
+  std::vector<double> force_, virial;
+  EXPECT_FALSE(dp.commit_reload());
+  dp.reload_async("deeppot-1.pb");
+  // the current model is evaluated while the new one is loaded
+  dp.compute(ener, force_, virial, coord_cpy, atype_cpy, box, nall-nloc, inlist, 0);
+  EXPECT_LT(fabs(ener - expected_tot_e), 1e-10);
+  EXPECT_TRUE(dp.commit_reload(true));
+  EXPECT_FALSE(dp.commit_reload(true));
+  // the neighbor list is kept across the reload
+  ener = 0.;
+  std::fill(force_.begin(), force_.end(), 0.0);
+  std::fill(virial.begin(), virial.end(), 0.0);
+  dp.compute(ener, force_, virial, coord_cpy, atype_cpy, box, nall-nloc, inlist, 1);
+  std::vector<double> force;
+  _fold_back(force, force_, mapping, nloc, nall, 3);
+
+  EXPECT_EQ(force.size(), natoms*3);
+  EXPECT_EQ(virial.size(), 9);
+
+  // the results are those of the new model
+  EXPECT_LT(fabs(ener - ener1), 1e-10);
+  for(int ii = 0; ii < natoms*3; ++ii){
+    EXPECT_LT(fabs(force[ii] - force1[ii]), 1e-10);    
+  }
+  for(int ii = 0; ii < 3*3; ++ii){
+    EXPECT_LT(fabs(virial[ii] - virial1[ii]), 1e-10);
+  }
+  // the asynchronous evaluation runs the new model
+  ener = 0.;
+  dp.compute_async(ener, force_, virial, coord_cpy, atype_cpy, box, nall-nloc, inlist, 1).get();
+  _fold_back(force, force_, mapping, nloc, nall, 3);
+  EXPECT_LT(fabs(ener - ener1), 1e-10);
+  for(int ii = 0; ii < natoms*3; ++ii){
+    EXPECT_LT(fabs(force[ii] - force1[ii]), 1e-10);    
+  }
+  remove( "deeppot-1.pb" ) ;
+}
+
+TEST_F(TestInferDeepPotA, cpu_reload_mismatch)
+{
+  // the models that differ from deeppot.pb in the cutoff radius or the number of types
+  std::vector<std::string> attr_names = {"descrpt_attr/rcut", "descrpt_attr/ntypes"};
+  for (unsigned kk = 0; kk < attr_names.size(); ++kk){
+    {
+      std::string file_name = "../../tests/infer/deeppot.pbtxt";
+      int fd = open(file_name.c_str(), O_RDONLY);
+      tensorflow::protobuf::io::ZeroCopyInputStream* input = new tensorflow::protobuf::io::FileInputStream(fd);
+      tensorflow::GraphDef graph_def;
+      tensorflow::protobuf::TextFormat::Parse(input, &graph_def);
+      delete input;
+      int nfound = 0;
+      for (int ii = 0; ii < graph_def.node_size(); ++ii){
+	tensorflow::NodeDef * node = graph_def.mutable_node(ii);
+	if (node->name() != attr_names[kk]) continue;
+	tensorflow::TensorProto * tensor = (*node->mutable_attr())["value"].mutable_tensor();
+	if (kk == 0) tensor->set_double_val(0, 5.0);
+	else tensor->set_int_val(0, 3);
+	nfound ++;
+      }
+      EXPECT_EQ(nfound, 1);
+      std::fstream output("deeppot-mismatch.pb", std::ios::out | std::ios::trunc | std::ios::binary);
+      graph_def.SerializeToOstream(&output);
+    }
+    dp.reload_async("deeppot-mismatch.pb");
+    EXPECT_THROW(dp.commit_reload(true), std::runtime_error);
+    EXPECT_FALSE(dp.commit_reload(true));
+    // the current model is kept
+    double ener;
+    std::vector<double> force, virial;
+    dp.compute(ener, force, virial, coord, atype, box);
+    EXPECT_DOUBLE_EQ(dp.cutoff(), 6.0);
+    EXPECT_EQ(dp.numb_types(), 2);
+    EXPECT_LT(fabs(ener - expected_tot_e), 1e-10);
+    for(int ii = 0; ii < natoms*3; ++ii){
+      EXPECT_LT(fabs(force[ii] - expected_f[ii]), 1e-10);    
+    }
+  }
+  remove( "deeppot-mismatch.pb" ) ;
+}
+
+TEST_F(TestInferDeepPotA, cpu_lmp_nlist_padding)
+{
+  float rc = dp.cutoff();
+  int nloc = coord.size() / 3;  
+  std::vector<double> coord_cpy;
+  std::vector<int> atype_cpy, mapping;  
+  std::vector<std::vector<int > > nlist_data;
+  _build_nlist(nlist_data, coord_cpy, atype_cpy, mapping,
+	       coord, atype, box, rc);
+  int nall = coord_cpy.size() / 3;
+  std::vector<int> ilist(nloc), numneigh(nloc);
+  std::vector<int*> firstneigh(nloc);
+  deepmd::InputNlist inlist(nloc, &ilist[0], &numneigh[0], &firstneigh[0]);
+  convert_nlist(inlist, nlist_data);  
+
+  // the phantom atoms change neither the energy nor the forces and virial of the real atoms
+  std::vector<int> buckets = {4, 16, 0};
+  for (unsigned bb = 0; bb < buckets.size(); ++bb){
+    dp.set_padding(buckets[bb]);
+    for (int ago = 0; ago < 2; ++ago){
+      double ener;
+      std::vector<double> force_, virial;
+      if (ago == 0) {
+	dp.compute(ener, force_, virial, coord_cpy, atype_cpy, box, nall-nloc, inlist, ago);
+      }
+      else {
+	dp.compute_async(ener, force_, virial, coord_cpy, atype_cpy, box, nall-nloc, inlist, ago).get();
+      }
+      std::vector<double> force;
+      _fold_back(force, force_, mapping, nloc, nall, 3);
+
+      EXPECT_EQ(force_.size(), nall*3);
+      EXPECT_EQ(force.size(), natoms*3);
+      EXPECT_EQ(virial.size(), 9);
+
+      EXPECT_LT(fabs(ener - expected_tot_e), 1e-10);
+      for(int ii = 0; ii < natoms*3; ++ii){
+	EXPECT_LT(fabs(force[ii] - expected_f[ii]), 1e-10);    
+      }
+      for(int ii = 0; ii < 3*3; ++ii){
+	EXPECT_LT(fabs(virial[ii] - expected_tot_v[ii]), 1e-10);
+      }
+    }
+    // the atomic outputs of the phantom atoms are dropped
+    double ener;
+    std::vector<double> force_, virial, atom_ener_, atom_vir_, atom_ener;
+    dp.compute(ener, force_, virial, atom_ener_, atom_vir_, coord_cpy, atype_cpy, box, nall-nloc, inlist, 1);
+    _fold_back(atom_ener, atom_ener_, mapping, nloc, nall, 1);
+    EXPECT_EQ(atom_ener_.size(), nall);
+    EXPECT_LT(fabs(ener - expected_tot_e), 1e-10);
+    for(int ii = 0; ii < natoms; ++ii){
+      EXPECT_LT(fabs(atom_ener[ii] - expected_e[ii]), 1e-10);
+    }
+  }
+  EXPECT_THROW(dp.set_padding(-1), std::runtime_error);
+}
+
+// run by --gtest_also_run_disabled_tests, the atoms migrate in and out of the local region 
+// at every neighbor list update, so the number of atoms changes between the updates
+TEST_F(TestInferDeepPotA, DISABLED_cpu_lmp_nlist_padding_bench)
+{
+  float rc = dp.cutoff();
+  const int nrep = 4, nsteps = 200, nevery = 10;
+  std::vector<double> coord_rep, box_rep(box);
+  std::vector<int> atype_rep;
+  for (int rr = 0; rr < nrep; ++rr){
+    for (int ii = 0; ii < natoms; ++ii){
+      coord_rep.push_back(coord[ii*3+0] + rr * box[0]);
+      coord_rep.push_back(coord[ii*3+1]);
+      coord_rep.push_back(coord[ii*3+2]);
+      atype_rep.push_back(atype[ii]);
+    }
+  }
+  box_rep[0] *= nrep;
+  std::vector<int> buckets = {0, 64};
+  for (unsigned bb = 0; bb < buckets.size(); ++bb){
+    dp.set_padding(buckets[bb]);
+    double elapsed = 0.;
+    std::vector<double> coord_cpy;
+    std::vector<int> atype_cpy, mapping, ilist, numneigh;
+    std::vector<int*> firstneigh;
+    std::vector<std::vector<int > > nlist_data;
+    deepmd::InputNlist inlist;
+    int nloc = 0, nall = 0;
+    for (int step = 0; step < nsteps; ++step){
+      int ago = step % nevery;
+      if (ago == 0) {
+	// the local region holds a varying number of the replicas
+	nloc = natoms * (1 + (step / nevery) % nrep);
+	std::vector<double> coord_loc(coord_rep.begin(), coord_rep.begin() + nloc * 3);
+	std::vector<int> atype_loc(atype_rep.begin(), atype_rep.begin() + nloc);
+	_build_nlist(nlist_data, coord_cpy, atype_cpy, mapping,
+		     coord_loc, atype_loc, box_rep, rc);
+	nall = coord_cpy.size() / 3;
+	ilist.resize(nloc);
+	numneigh.resize(nloc);
+	firstneigh.resize(nloc);
+	inlist = deepmd::InputNlist(nloc, &ilist[0], &numneigh[0], &firstneigh[0]);
+	convert_nlist(inlist, nlist_data);
+      }
+      double ener;
+      std::vector<double> force_, virial;
+      auto start = std::chrono::steady_clock::now();
+      dp.compute(ener, force_, virial, coord_cpy, atype_cpy, box_rep, nall-nloc, inlist, ago);
+      elapsed += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    std::cout << "padding bucket " << buckets[bb] << ": " << elapsed / nsteps * 1e3 << " ms per step" << std::endl;
+  }
+}
+
 TEST_F(TestInferDeepPotA, cpu_lmp_nlist_atomic)
 {
   float rc = dp.cutoff();
@@ -398,6 +685,161 @@ TEST_F(TestInferDeepPotA, cpu_lmp_nlist_type_sel)
 
 
 
+TEST_F(TestInferDeepPotA, cpu_lmp_nlist_stat)
+{
+  float rc = dp.cutoff();
+  int nloc = coord.size() / 3;  
+  std::vector<double> coord_cpy;
+  std::vector<int> atype_cpy, mapping;  
+  std::vector<std::vector<int > > nlist_data;
+  _build_nlist(nlist_data, coord_cpy, atype_cpy, mapping,
+	       coord, atype, box, rc);
+  int nall = coord_cpy.size() / 3;
+  std::vector<int> ilist(nloc), numneigh(nloc);
+  std::vector<int*> firstneigh(nloc);
+  deepmd::InputNlist inlist(nloc, &ilist[0], &numneigh[0], &firstneigh[0]);
+  convert_nlist(inlist, nlist_data);  
+
+  deepmd::NlistStat stat;
+  deepmd::DeepPot::get_nlist_stat(stat);
+  deepmd::DeepPot::enable_nlist_stat();
+  double ener;
+  std::vector<double> force_, virial;
+  dp.compute(ener, force_, virial, coord_cpy, atype_cpy, box, nall-nloc, inlist, 0);
+  dp.compute(ener, force_, virial, coord_cpy, atype_cpy, box, nall-nloc, inlist, 1);
+  deepmd::DeepPot::enable_nlist_stat(false);
+  deepmd::DeepPot::get_nlist_stat(stat);
+
+  EXPECT_EQ(stat.natoms, 2 * nloc);
+  EXPECT_EQ(stat.sel, dp.model_metadata().sel);
+  int max_nbor_size = 0;
+  long long nnei_sum = 0, tot_nnei = 0;
+  for(int ii = 0; ii < nloc; ++ii){
+    max_nbor_size = std::max(max_nbor_size, int(nlist_data[ii].size()));
+    tot_nnei += nlist_data[ii].size();
+  }
+  for(int tt = 0; tt < stat.ntypes(); ++tt){
+    EXPECT_EQ(stat.noverflow[tt], 0);
+    EXPECT_LE(stat.nnei_max[tt], max_nbor_size);
+    nnei_sum += stat.nnei_sum[tt];
+  }
+  // the input neighbor list is built with the cutoff, so all the neighbors are counted
+  EXPECT_EQ(stat.max_nbor_size, max_nbor_size);
+  EXPECT_EQ(nnei_sum, 2 * tot_nnei);
+
+  // the phantom atoms of the padding are recorded, and left out of the mean
+  const int bucket = 16;
+  int nphantom = (nloc + bucket - 1) / bucket * bucket - nloc;
+  dp.set_padding(bucket);
+  deepmd::DeepPot::enable_nlist_stat();
+  dp.compute(ener, force_, virial, coord_cpy, atype_cpy, box, nall-nloc, inlist, 0);
+  deepmd::DeepPot::enable_nlist_stat(false);
+  deepmd::DeepPot::get_nlist_stat(stat);
+  dp.set_padding(0);
+  EXPECT_GT(nphantom, 0);
+  EXPECT_EQ(stat.nphantom, nphantom);
+  EXPECT_EQ(stat.natoms - stat.nphantom, nloc);
+  double nnei_mean = 0;
+  for(int tt = 0; tt < stat.ntypes(); ++tt){
+    nnei_mean += stat.nnei_mean(tt);
+  }
+  EXPECT_LT(fabs(nnei_mean - double(tot_nnei) / nloc), 1e-10);
+}
+
+TEST_F(TestInferDeepPotA, model_metadata)
+{
+  const deepmd::ModelMetadata & metadata = dp.model_metadata();
+  EXPECT_EQ(metadata.ntypes, 2);
+  EXPECT_LT(fabs(metadata.rcut - 6.0), 1e-10);
+  EXPECT_LT(fabs(metadata.rcut_smth - 0.5), 1e-6);
+  std::vector<int> expected_sel = {46, 92};
+  EXPECT_EQ(metadata.sel, expected_sel);
+  EXPECT_FALSE(metadata.compressed);
+}
+
+TEST_F(TestInferDeepPotA, cpu_build_nlist_mmap)
+{
+  // write deeppot.pbtxt in the memmapped package format as dp convert-to-mmap does: the
+  // constants of at least 64 bytes, except the scalars, are replaced by ImmutableConst
+  {
+    std::string file_name = "../../tests/infer/deeppot.pbtxt";
+    int fd = open(file_name.c_str(), O_RDONLY);
+    tensorflow::protobuf::io::ZeroCopyInputStream* input = new tensorflow::protobuf::io::FileInputStream(fd);
+    tensorflow::GraphDef graph_def;
+    tensorflow::protobuf::TextFormat::Parse(input, &graph_def);
+    delete input;
+    tensorflow::MemmappedFileSystemWriter writer;
+    TF_CHECK_OK(writer.InitializeToFile(tensorflow::Env::Default(), "deeppot-mmap.pb"));
+    int nconverted = 0;
+    for (int ii = 0; ii < graph_def.node_size(); ++ii){
+      tensorflow::NodeDef * node = graph_def.mutable_node(ii);
+      if (node->op() != "Const") continue;
+      const tensorflow::TensorProto & proto = node->attr().at("value").tensor();
+      tensorflow::Tensor tensor;
+      if (proto.dtype() == tensorflow::DT_STRING || !tensor.FromProto(proto)) continue;
+      if (tensor.dims() == 0 || tensor.TotalBytes() < 64) continue;
+      std::string region_name = tensorflow::MemmappedFileSystem::kMemmappedPackagePrefix + std::string("c") + std::to_string(nconverted);
+      TF_CHECK_OK(writer.SaveTensor(tensor, region_name));
+      tensorflow::TensorShapeProto shape = proto.tensor_shape();
+      node->set_op("ImmutableConst");
+      node->mutable_attr()->erase("value");
+      *(*node->mutable_attr())["shape"].mutable_shape() = shape;
+      (*node->mutable_attr())["memory_region_name"].set_s(region_name);
+      nconverted ++;
+    }
+    EXPECT_GT(nconverted, 0);
+    TF_CHECK_OK(writer.SaveProtobuf(graph_def, tensorflow::MemmappedFileSystem::kMemmappedPackageDefaultGraphDef));
+    TF_CHECK_OK(writer.FlushAndClose());
+  }
+  EXPECT_TRUE(deepmd::model_is_memmapped("deeppot-mmap.pb"));
+  EXPECT_FALSE(deepmd::model_is_memmapped("deeppot.pb"));
+  deepmd::DeepPot dp_mmap("deeppot-mmap.pb");
+
+  double ener;
+  std::vector<double> force, virial;
+  dp_mmap.compute(ener, force, virial, coord, atype, box);
+
+  EXPECT_EQ(force.size(), natoms*3);
+  EXPECT_EQ(virial.size(), 9);
+
+  EXPECT_LT(fabs(ener - expected_tot_e), 1e-10);
+  for(int ii = 0; ii < natoms*3; ++ii){
+    EXPECT_LT(fabs(force[ii] - expected_f[ii]), 1e-10);    
+  }
+  for(int ii = 0; ii < 3*3; ++ii){
+    EXPECT_LT(fabs(virial[ii] - expected_tot_v[ii]), 1e-10);
+  }
+  remove( "deeppot-mmap.pb" ) ;
+}
+
+TEST_F(TestInferDeepPotA, model_metadata_fused)
+{
+  // the graph of dp compress --fuse-env-mat, where ProdEnvMatATabulate replaces ProdEnvMatA
+  std::string file_name = "../../tests/infer/deeppot.pbtxt";
+  int fd = open(file_name.c_str(), O_RDONLY);
+  tensorflow::protobuf::io::ZeroCopyInputStream* input = new tensorflow::protobuf::io::FileInputStream(fd);
+  tensorflow::GraphDef graph_def;
+  tensorflow::protobuf::TextFormat::Parse(input, &graph_def);
+  delete input;
+  int nfound = 0;
+  for (int ii = 0; ii < graph_def.node_size(); ++ii){
+    tensorflow::NodeDef * node = graph_def.mutable_node(ii);
+    if (node->op() != "ProdEnvMatA") continue;
+    node->set_op("ProdEnvMatATabulate");
+    nfound ++;
+  }
+  EXPECT_EQ(nfound, 1);
+  deepmd::ModelMetadata metadata;
+  deepmd::read_model_metadata(metadata, graph_def);
+  EXPECT_EQ(metadata.ntypes, 2);
+  EXPECT_LT(fabs(metadata.rcut - 6.0), 1e-10);
+  EXPECT_LT(fabs(metadata.rcut_smth - 0.5), 1e-6);
+  std::vector<int> expected_sel = {46, 92};
+  EXPECT_EQ(metadata.sel, expected_sel);
+  EXPECT_TRUE(metadata.compressed);
+}
+
+
 class TestInferDeepPotANoPbc : public ::testing::Test
 {  
 protected:  
@@ -101,6 +101,22 @@ _in_vec(const int & value,
   return false;
 }
 
+// displace the local atoms and their ghost images by the same small
+// amount, so the neighbor list stays valid
+static void
+_perturb_coord(std::vector<double> & coord_p,
+	       const std::vector<double> & coord_cpy,
+	       const std::vector<int> & mapping)
+{
+  coord_p = coord_cpy;
+  for(int ii = 0; ii < mapping.size(); ++ii){
+    int jj = mapping[ii];
+    for(int dd = 0; dd < 3; ++dd){
+      coord_p[ii*3+dd] += 0.01 * ((jj*3+dd) % 5 - 2);
+    }
+  }
+}
+
 TEST_F(TestDipoleCharge, cpu_lmp_nlist)
 {
   // build nlist
@@ -122,6 +138,21 @@ TEST_F(TestDipoleCharge, cpu_lmp_nlist)
   // evaluate dipole
   std::vector<double> dipole, dipole_recd(nloc*3, 0.0);
   dp.compute(dipole, coord_cpy, atype_cpy, box, nall-nloc, inlist);
+  // the maps of the atoms are reused if the nlist is not updated,
+  // the atoms are moved so that stale cached values would be detected
+  std::vector<double> coord_cpy_p, dipole_1, dipole_p;
+  _perturb_coord(coord_cpy_p, coord_cpy, mapping);
+  dp.compute(dipole_1, coord_cpy_p, atype_cpy, box, nall-nloc, inlist, 1);
+  dp.compute(dipole_p, coord_cpy_p, atype_cpy, box, nall-nloc, inlist, 0);
+  EXPECT_EQ(dipole_1.size(), dipole_p.size());
+  for(int ii = 0; ii < dipole_p.size(); ++ii){
+    EXPECT_LT(fabs(dipole_1[ii] - dipole_p[ii]), 1e-10);
+  }
+  double dipole_diff = 0;
+  for(int ii = 0; ii < dipole.size(); ++ii){
+    dipole_diff = std::max(dipole_diff, fabs(dipole_p[ii] - dipole[ii]));
+  }
+  EXPECT_GT(dipole_diff, 1e-6);
 
   // add virtual atoms to the system
   // // a lot of mappings
@@ -205,6 +236,22 @@ TEST_F(TestDipoleCharge, cpu_lmp_nlist)
   // compute force and virial
   std::vector<double > force_, force, virial;
   dm.compute(force_, virial, coord_cpy, atype_cpy, box, pairs, eforce, nghost, inlist);
+  std::vector<double > force_1, virial_1, force_p, virial_p;
+  _perturb_coord(coord_cpy_p, coord_cpy, mapping);
+  dm.compute(force_1, virial_1, coord_cpy_p, atype_cpy, box, pairs, eforce, nghost, inlist, 1);
+  dm.compute(force_p, virial_p, coord_cpy_p, atype_cpy, box, pairs, eforce, nghost, inlist, 0);
+  EXPECT_EQ(force_1.size(), force_p.size());
+  for(int ii = 0; ii < force_p.size(); ++ii){
+    EXPECT_LT(fabs(force_1[ii] - force_p[ii]), 1e-10);
+  }
+  for(int ii = 0; ii < 9; ++ii){
+    EXPECT_LT(fabs(virial_1[ii] - virial_p[ii]), 1e-10);
+  }
+  double force_diff = 0;
+  for(int ii = 0; ii < force_.size(); ++ii){
+    force_diff = std::max(force_diff, fabs(force_p[ii] - force_[ii]));
+  }
+  EXPECT_GT(force_diff, 1e-6);
   // for(int ii = 0; ii < force_.size(); ++ii){
   //   std::cout << force_[ii] << " " ;
   // }
@@ -1,10 +1,20 @@
 #ifndef _GMX_PLUGIN_H_
 #define _GMX_PLUGIN_H_
+#include <future>
 #include "DeepPot.h"
 
 namespace deepmd
 {
 
+/* 
+ * Each PP rank evaluates the DP atoms among its home atoms:
+ *   1. gather_home: put the coordinates of the home DP atoms in a buffer of all the DP atoms,
+ *      which is then summed over the PP ranks, so every rank sees the whole DP region as its halo.
+ *   2. compute_async: evaluate the home DP atoms on a helper thread, the other DP atoms and
+ *      their periodic images are the ghosts.
+ *   3. wait: join the helper thread. The forces on all the DP atoms are summed over the PP ranks.
+ *   4. scatter_home: add the forces on the home DP atoms to the GROMACS force buffer.
+ */
 class DeepmdPlugin
 {
     public:
@@ -12,12 +22,31 @@ class DeepmdPlugin
         DeepmdPlugin(char*);
         ~DeepmdPlugin();  
         void              init_from_json(char*);
+        /* x: the coordinates of the home atoms in nm, nhome x 3; global_index: NULL without domain decomposition */
+        template<typename REAL>
+        void              gather_home(std::vector<double >& dcoord_all, const REAL* x, const int nhome, const int* global_index);
+        /* dcoord_all: the coordinates of all the DP atoms summed over the PP ranks, dbox: the box in DP unit */
+        void              compute_async(const std::vector<double >& dcoord_all, const std::vector<double >& dbox);
+        /* dener: the energy of the home DP atoms, dforce_all: the forces on all the DP atoms, to be summed over the PP ranks */
+        void              wait(double& dener, std::vector<double >& dforce_all);
+        /* f: the GROMACS force buffer of the local atoms */
+        template<typename REAL>
+        void              scatter_home(REAL* f, const std::vector<double >& dforce_all) const;
         deepmd::DeepPot*  nnp;
         std::vector<int > dtype;
         std::vector<int > dindex;
         bool              pbc;
         float             lmd;
         int               natom;
+    private:
+        void              compute_home(const std::vector<double >& dcoord_all, const std::vector<double >& dbox);
+        /* the DP index of the global atoms, -1 if not a DP atom */
+        std::vector<int > dp_of_global;
+        /* the DP and local indices of the home DP atoms */
+        std::vector<int > home_dp, home_local;
+        std::future<void> job;
+        double            job_ener;
+        std::vector<double > job_force;
 };
 
 }
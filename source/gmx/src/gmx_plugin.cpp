@@ -1,7 +1,12 @@
 #include "gmx_plugin.h"
 #include "json.hpp"
+#include "coord.h"
+#include "region.h"
+#include "neighbor_list.h"
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <algorithm>
 
 using namespace deepmd;
 
@@ -18,6 +23,10 @@ DeepmdPlugin::DeepmdPlugin (char* json_file)
 
 DeepmdPlugin::~DeepmdPlugin()
 {
+    if (job.valid())
+    {
+        job.wait();
+    }
     delete nnp;
 }
 
@@ -98,6 +107,12 @@ void DeepmdPlugin::init_from_json(char* json_file)
                 std::cerr << "Number of atoms in index file (" << DeepmdPlugin::dindex.size() << ") does not match type file (" << DeepmdPlugin::natom << ")!" << std::endl;
                 exit(1);
             }
+            int max_index = *std::max_element(DeepmdPlugin::dindex.begin(), DeepmdPlugin::dindex.end());
+            DeepmdPlugin::dp_of_global.assign(max_index + 1, -1);
+            for (int i = 0; i < DeepmdPlugin::natom; i++)
+            {
+                DeepmdPlugin::dp_of_global[DeepmdPlugin::dindex[i]] = i;
+            }
         }
         else
         {
@@ -125,4 +140,164 @@ void DeepmdPlugin::init_from_json(char* json_file)
         std::cerr << "Invaild json file: " << json_file << std::endl;
         exit(1);
     }
-}
\ No newline at end of file
+}
+
+template<typename REAL>
+void DeepmdPlugin::gather_home(std::vector<double >& dcoord_all, const REAL* x, const int nhome, const int* global_index)
+{
+    dcoord_all.assign(natom * 3, 0.);
+    home_dp.clear();
+    home_local.clear();
+    for (int i = 0; i < nhome; i++)
+    {
+        int global = global_index ? global_index[i] : i;
+        if (global >= dp_of_global.size() || dp_of_global[global] < 0)
+        {
+            continue;
+        }
+        int idx = dp_of_global[global];
+        home_dp.push_back(idx);
+        home_local.push_back(i);
+        for (int j = 0; j < 3; j++)
+        {
+            dcoord_all[idx * 3 + j] = x[i * 3 + j] / c_dp2gmx;
+        }
+    }
+}
+
+void DeepmdPlugin::compute_async(const std::vector<double >& dcoord_all, const std::vector<double >& dbox)
+{
+    /* the inputs are copied, the caller may reuse its buffers while the model runs */
+    job = std::async(std::launch::async, [this, dcoord_all, dbox] () {
+        this->compute_home(dcoord_all, dbox);
+    });
+}
+
+void DeepmdPlugin::wait(double& dener, std::vector<double >& dforce_all)
+{
+    job.get();
+    dener = job_ener;
+    dforce_all = job_force;
+}
+
+void DeepmdPlugin::compute_home(const std::vector<double >& dcoord_all, const std::vector<double >& dbox)
+{
+    const int nhome = home_dp.size();
+    job_ener = 0.;
+    job_force.assign(natom * 3, 0.);
+    if (nhome == 0)
+    {
+        return;
+    }
+    /* the home DP atoms come first, followed by the other DP atoms */
+    std::vector<int > order(home_dp);
+    std::vector<bool > is_home(natom, false);
+    for (int i = 0; i < nhome; i++)
+    {
+        is_home[home_dp[i]] = true;
+    }
+    for (int i = 0; i < natom; i++)
+    {
+        if (!is_home[i])
+        {
+            order.push_back(i);
+        }
+    }
+    std::vector<double > dcoord(natom * 3);
+    std::vector<int > datype(natom);
+    for (int i = 0; i < natom; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            dcoord[i * 3 + j] = dcoord_all[order[i] * 3 + j];
+        }
+        datype[i] = dtype[order[i]];
+    }
+    /* the periodic images of the DP region within the cutoff are added as ghosts */
+    const float rcut = nnp->cutoff();
+    std::vector<double > dcoord_cpy;
+    std::vector<int > datype_cpy, mapping;
+    int nall = natom;
+    if (pbc)
+    {
+        deepmd::Region<double > region;
+        deepmd::init_region_cpu(region, &dbox[0]);
+        deepmd::normalize_coord_cpu(&dcoord[0], natom, region);
+        int mem_cpy = natom * 2;
+        while (true)
+        {
+            dcoord_cpy.resize(mem_cpy * 3);
+            datype_cpy.resize(mem_cpy);
+            mapping.resize(mem_cpy);
+            if (deepmd::copy_coord_cpu(&dcoord_cpy[0], &datype_cpy[0], &mapping[0], &nall, &dcoord[0], &datype[0], natom, mem_cpy, rcut, region) == 0)
+            {
+                break;
+            }
+            mem_cpy *= 2;
+        }
+        dcoord_cpy.resize(nall * 3);
+        datype_cpy.resize(nall);
+        mapping.resize(nall);
+    }
+    else
+    {
+        dcoord_cpy = dcoord;
+        datype_cpy = datype;
+        mapping.resize(natom);
+        for (int i = 0; i < natom; i++)
+        {
+            mapping[i] = i;
+        }
+    }
+    /* the neighbor list of the home DP atoms */
+    std::vector<int > ilist(nhome), numneigh(nhome);
+    std::vector<int* > firstneigh(nhome);
+    std::vector<std::vector<int > > jlist(nhome);
+    int mem_nnei = 256;
+    while (true)
+    {
+        for (int i = 0; i < nhome; i++)
+        {
+            jlist[i].resize(mem_nnei);
+            firstneigh[i] = &jlist[i][0];
+        }
+        deepmd::InputNlist inlist(nhome, &ilist[0], &numneigh[0], &firstneigh[0]);
+        int max_nnei;
+        if (deepmd::build_nlist_cpu(inlist, &max_nnei, &dcoord_cpy[0], nhome, nall, mem_nnei, rcut) == 0)
+        {
+            break;
+        }
+        mem_nnei = max_nnei;
+    }
+    deepmd::InputNlist inlist(nhome, &ilist[0], &numneigh[0], &firstneigh[0]);
+    std::vector<double > dforce, dvirial;
+    ENERGYTYPE dener;
+    nnp->compute(dener, dforce, dvirial, dcoord_cpy, datype_cpy, dbox, nall - nhome, inlist, 0);
+    job_ener = dener;
+    /* fold the forces on the ghosts back to the DP atoms */
+    for (int i = 0; i < nall; i++)
+    {
+        int idx = order[mapping[i]];
+        for (int j = 0; j < 3; j++)
+        {
+            job_force[idx * 3 + j] += dforce[i * 3 + j];
+        }
+    }
+}
+
+template<typename REAL>
+void DeepmdPlugin::scatter_home(REAL* f, const std::vector<double >& dforce_all) const
+{
+    for (int i = 0; i < home_dp.size(); i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            f[home_local[i] * 3 + j] += dforce_all[home_dp[i] * 3 + j] * f_dp2gmx * lmd;
+        }
+    }
+}
+
+template void DeepmdPlugin::gather_home<float>(std::vector<double >& dcoord_all, const float* x, const int nhome, const int* global_index);
+template void DeepmdPlugin::gather_home<double>(std::vector<double >& dcoord_all, const double* x, const int nhome, const int* global_index);
+template void DeepmdPlugin::scatter_home<float>(float* f, const std::vector<double >& dforce_all) const;
+template void DeepmdPlugin::scatter_home<double>(double* f, const std::vector<double >& dforce_all) const;
@@ -16,6 +16,17 @@ make -j${NPROC}
 #------------------
 ${BUILD_TMP_DIR}/runUnitTests
 
+#------------------
+
+BUILD_TMP_DIR=${SCRIPT_PATH}/../build_md_tests
+mkdir -p ${BUILD_TMP_DIR}
+cd ${BUILD_TMP_DIR}
+cmake ../md/tests
+make -j${NPROC}
+
+#------------------
+${BUILD_TMP_DIR}/runUnitTests
+
 
 #------------------
 
@@ -17,6 +17,20 @@ void format_nlist_cpu(
     const float rcut, 
     const std::vector<int> sec);
 
+// the number of the valid neighbors in a section of nsel slots of a formatted nlist,
+// the valid neighbors come first in the section and the padded slots are -1
+inline int
+count_nlist_valid(
+    const int * nlist,
+    const int nsel)
+{
+  int nvalid = 0;
+  while (nvalid < nsel && nlist[nvalid] >= 0) {
+    nvalid++;
+  }
+  return nvalid;
+}
+
 #if GOOGLE_CUDA
 template <typename FPTYPE>
 void format_nbor_list_gpu_cuda(    
@@ -97,6 +111,9 @@ int format_nlist_i_fill_a (
     const std::vector<int > &		sec_r);
 
 
+// return:	-1	OK
+//		>= 0	the last type whose neighbors overflow sel
+// nei_count:	if not NULL, the number of neighbors of each type within rcut, before they are truncated to sel
 template<typename FPTYPE> 
 int format_nlist_i_cpu (
     std::vector<int > &			fmt_nei_idx_a,
@@ -105,7 +122,8 @@ int format_nlist_i_cpu (
     const int &				i_idx,
     const std::vector<int > &		nei_idx_a, 
     const float &			rcut,
-    const std::vector<int > &		sec_a);
+    const std::vector<int > &		sec_a,
+    int *				nei_count = NULL);
 
 
 
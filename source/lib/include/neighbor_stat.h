@@ -0,0 +1,28 @@
+#pragma once
+
+namespace deepmd{
+
+// reduce the neighbor statistics of one frame with a cell list
+// outputs:
+//	min_nbor_dist: the minimal distance between an atom and its neighbors, rcut if no pair is found
+//	max_nbor_size: ntypes, the maximal number of neighbors of each type
+//	dist_hist: nbins, the number of pairs in each of the equal bins on [0, rcut). Not computed if nbins is 0.
+// inputs:
+//	coord, type: nall, the coordinates and types of the atoms.
+//		     The periodic images should already be copied, the neighbors are searched without pbc.
+//	nloc: the statistics are taken over the neighbors of the first nloc atoms
+template <typename FPTYPE>
+void
+neighbor_stat_cpu(
+    FPTYPE & min_nbor_dist,
+    int * max_nbor_size,
+    int * dist_hist,
+    const FPTYPE * coord,
+    const int * type,
+    const int & nloc,
+    const int & nall,
+    const int & ntypes,
+    const float & rcut,
+    const int & nbins);
+
+}
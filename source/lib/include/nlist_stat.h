@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+
+namespace deepmd{
+
+// the statistics of the neighbor lists, collected by the environment matrices
+// of all the descriptors in the process while the collection is enabled
+struct NlistStat
+{
+  // the number of center atoms counted
+  long long natoms;
+  // the number of the counted center atoms that are phantom atoms padded by
+  // DeepPot::set_padding, they have no neighbors
+  long long nphantom;
+  // of each neighbor type: the max and the sum over the center atoms of the numbers
+  // of neighbors within the cutoff, and the number of center atoms whose neighbors overflow sel
+  std::vector<int> nnei_max;
+  std::vector<long long> nnei_sum;
+  std::vector<long long> noverflow;
+  // the max sel of each neighbor type
+  std::vector<int> sel;
+  // the number of neighbor lists built by the descriptors, and of the retries with larger buffers
+  long long nbuild;
+  long long nretry;
+  // the max number of neighbors in the input neighbor lists
+  int max_nbor_size;
+  NlistStat (const int ntypes = 0);
+  int ntypes () const {return sel.size();};
+  // the mean number of neighbors of type tt, the phantom atoms are excluded
+  double nnei_mean (const int tt) const;
+  // accumulate the statistics of another collection, the types are extended if needed
+  void merge (const NlistStat & stat);
+};
+
+// enable or disable the collection, it is disabled by default
+void nlist_stat_enable (const bool enable);
+bool nlist_stat_enabled ();
+// add the statistics to the ones of the process, thread-safe
+void nlist_stat_add (const NlistStat & stat);
+// add a neighbor list built with nretry retries and the max number of neighbors max_nbor_size
+void nlist_stat_add_build (const int nretry, const int max_nbor_size);
+// add nphantom phantom center atoms to the counted ones
+void nlist_stat_add_phantom (const int nphantom);
+// get the statistics collected since the last reset
+void nlist_stat_get (NlistStat & stat, const bool reset = true);
+
+}
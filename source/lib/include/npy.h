@@ -0,0 +1,73 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <random>
+
+namespace deepmd{
+
+// a read-only memory map of a little-endian, C-ordered npy file of float32 or float64
+// the first dimension is the frame, a 1-d array is taken as a single frame
+class NpyFile
+{
+public:
+  NpyFile (const std::string & path);
+  ~NpyFile ();
+  int nframes () const {return nframes_;};
+  int frame_size () const {return frame_size_;};
+  // view the data as nframes frames, e.g. the energies of a set saved as a 1-d array
+  void reshape (const int nframes);
+  // gather frames from the file and convert them to FPTYPE
+  // outputs:
+  //	out: nsel x frame_size
+  // inputs:
+  //	frames: nsel, the indexes of the frames
+  //	idx_map: natoms, the atoms of the output frame are read from atoms idx_map of the file frame.
+  //		 The frame is copied as is if idx_map is NULL.
+  //	natoms: the frame is natoms x (frame_size / natoms)
+  template<typename FPTYPE>
+  void gather (
+      FPTYPE * out,
+      const int * frames,
+      const int nsel,
+      const int * idx_map,
+      const int natoms) const;
+private:
+  NpyFile (const NpyFile &);
+  NpyFile & operator= (const NpyFile &);
+  void * map;
+  size_t map_size;
+  const char * data;
+  bool is_double;
+  int nframes_;
+  int frame_size_;
+};
+
+// plan the frames of the batches as DeepmdData.get_batch does: the sets are visited in turn, 
+// the frames of a set are shuffled when the set is entered and taken batch_size at a time.
+// The next set is entered when fewer than batch_size frames are left, so a batch is only short
+// if the set has fewer than batch_size frames.
+class FrameSampler
+{
+public:
+  FrameSampler (const std::vector<int> & set_nframes,
+		const int batch_size,
+		const unsigned seed,
+		const bool shuffle = true);
+  // outputs:
+  //	set_idx: the set of the batch
+  //	frames: the frames of the batch in the set
+  void next (int & set_idx,
+	     std::vector<int> & frames);
+private:
+  std::vector<int> set_nframes;
+  int batch_size;
+  bool shuffle;
+  std::mt19937 generator;
+  int set_count;
+  int cur_set;
+  int iterator;
+  std::vector<int> perm;
+};
+
+}
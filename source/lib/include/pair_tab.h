@@ -2,13 +2,15 @@
 
 namespace deepmd{
   
+// the pairs closer than the lower boundary of the table are evaluated at
+// the boundary, their number is returned.
 template<typename FPTYPE>
-void pair_tab_cpu(
+int pair_tab_cpu(
     FPTYPE * energy,
     FPTYPE * force,
     FPTYPE * virial,
     const double * table_info,
-    const double * table_data,
+    const FPTYPE * table_data,
     const FPTYPE * rij,
     const FPTYPE * scale,
     const int * type,
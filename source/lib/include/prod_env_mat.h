@@ -23,6 +23,56 @@ void prod_env_mat_a_cpu(
     const float rcut_smth, 
     const std::vector<int> sec);
 
+// the environment matrices of nframes frames with the same nloc, evaluated in one parallel loop over
+// the atoms of all the frames. The outputs of the frames are contiguous, the inputs are given per frame.
+template<typename FPTYPE>
+void prod_env_mat_a_batch_cpu(
+    FPTYPE * em, 
+    FPTYPE * em_deriv, 
+    FPTYPE * rij, 
+    int * nlist, 
+    const FPTYPE * const * coord, 
+    const int * const * type, 
+    const InputNlist * inlist,
+    const int * nall,
+    const int nframes,
+    const int max_nbor_size,
+    const FPTYPE * avg, 
+    const FPTYPE * std, 
+    const int nloc, 
+    const float rcut, 
+    const float rcut_smth, 
+    const std::vector<int> sec);
+
+// prod_env_mat_a_batch_cpu fused with the tabulated embedding of model compression. The descriptor
+// (nframes x nloc x 4 x last_layer_size) of each atom is evaluated from its environment matrix while
+// it is in cache, see tabulate_fusion_se_a_grad_cpu for the layout of the table. The descriptor
+// is not evaluated if it is NULL.
+template<typename FPTYPE>
+void prod_env_mat_a_tabulate_batch_cpu(
+    FPTYPE * descriptor, 
+    FPTYPE * em, 
+    FPTYPE * em_deriv, 
+    FPTYPE * rij, 
+    int * nlist, 
+    const FPTYPE * const * coord, 
+    const int * const * type, 
+    const InputNlist * inlist,
+    const int * nall,
+    const int nframes,
+    const int max_nbor_size,
+    const FPTYPE * avg, 
+    const FPTYPE * std, 
+    const FPTYPE * table, 
+    const FPTYPE * table_info, 
+    const int nloc, 
+    const float rcut, 
+    const float rcut_smth, 
+    const std::vector<int> sec,
+    const int nspline,
+    const int last_layer_size,
+    const bool type_one_side);
+
 template<typename FPTYPE>
 void prod_env_mat_r_cpu(
     FPTYPE * em, 
@@ -41,6 +91,30 @@ void prod_env_mat_r_cpu(
     const float rcut_smth, 
     const std::vector<int> sec);
 
+// the se_a environment matrix with the neighbor vectors projected on the external field ef (nloc x 3).
+// ef_proj selects the four components of each neighbor:
+//	0: (r.e/r^2, r_perp/r^2), 1: (1/r, r_para/r^2), 2: (1/r, r_perp/r^2)
+// where r_para and r_perp are the components of r parallel and perpendicular to e.
+template<typename FPTYPE>
+void prod_env_mat_a_ef_cpu(
+    FPTYPE * em, 
+    FPTYPE * em_deriv, 
+    FPTYPE * rij, 
+    int * nlist, 
+    const FPTYPE * coord, 
+    const int * type, 
+    const FPTYPE * ef, 
+    const InputNlist & inlist,
+    const int max_nbor_size,
+    const FPTYPE * avg, 
+    const FPTYPE * std, 
+    const int nloc, 
+    const int nall, 
+    const float rcut, 
+    const float rcut_smth, 
+    const std::vector<int> sec,
+    const int ef_proj);
+
 #if GOOGLE_CUDA
 template<typename FPTYPE> 
 void prod_env_mat_a_gpu_cuda(    
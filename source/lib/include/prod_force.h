@@ -1,7 +1,10 @@
 #pragma once
+#include <vector>
 
 namespace deepmd{
 
+// If the sections sec of the types in nlist are given, the neighbors of each type
+// are only visited up to the first padded slot of the section.
 template<typename FPTYPE>
 void prod_force_a_cpu(
     FPTYPE * force, 
@@ -10,7 +13,8 @@ void prod_force_a_cpu(
     const int * nlist, 
     const int nloc, 
     const int nall, 
-    const int nnei);
+    const int nnei,
+    const std::vector<int> & sec = std::vector<int>());
 
 template<typename FPTYPE>
 void prod_force_r_cpu(
@@ -1,7 +1,12 @@
 #pragma once
+#include <vector>
 
 namespace deepmd{
 
+// The atoms are distributed over the OpenMP threads, each accumulating its own virial.
+// atom_virial (9 * nall) is neither zeroed nor computed if it is NULL.
+// If the sections sec of the types in nlist are given, the neighbors of each type
+// are only visited up to the first padded slot of the section.
 template<typename FPTYPE>
 void prod_virial_a_cpu(
     FPTYPE * virial, 
@@ -12,8 +17,10 @@ void prod_virial_a_cpu(
     const int * nlist, 
     const int nloc, 
     const int nall, 
-    const int nnei);
+    const int nnei,
+    const std::vector<int> & sec = std::vector<int>());
 
+// See prod_virial_a_cpu.
 template<typename FPTYPE>
 void prod_virial_r_cpu(
     FPTYPE * virial, 
@@ -22,6 +22,19 @@ void prod_virial_grad_r_cpu(
     const int nloc,
     const int nnei);
 
+// the sum of prod_force_grad_a_cpu(grad_force) and prod_virial_grad_a_cpu(grad_virial),
+// computed in one pass over env_deriv, rij and nlist
+template<typename FPTYPE>
+void prod_force_virial_grad_a_cpu(
+    FPTYPE * grad_net,
+    const FPTYPE * grad_force,
+    const FPTYPE * grad_virial,
+    const FPTYPE * env_deriv,
+    const FPTYPE * rij,
+    const int * nlist,
+    const int nloc,
+    const int nnei);
+
 #if GOOGLE_CUDA
 template<typename FPTYPE>
 void prod_virial_grad_a_gpu_cuda(
@@ -1,4 +1,5 @@
 #pragma once
+#include <vector>
 
 namespace deepmd{
 
@@ -39,6 +40,112 @@ void tabulate_fusion_grad_grad_cpu(
     const int nnei,
     const int last_layer_size);
 
+// build the quintic spline tables of nnet embedding nets in the layout read by tabulate_fusion
+// outputs:
+//	table: nnet x nspline x (6 * layer_size[nlayer])
+// inputs:
+//	matrix: nlayer, the weights of layer ll are nnet x layer_size[ll] x layer_size[ll+1]
+//	bias: nlayer, the biases of layer ll are nnet x layer_size[ll+1]
+//	layer_size: nlayer + 1, the widths of the net with layer_size[0] = 1
+//	table_info: lower, upper, max, stride0, stride1 of the table
+//	functype: the activation function, 1 for tanh and 2 for gelu
+template<typename FPTYPE>
+void build_tabulate_table_cpu(
+    FPTYPE * table,
+    const FPTYPE * const * matrix,
+    const FPTYPE * const * bias,
+    const int * layer_size,
+    const FPTYPE * table_info,
+    const int nlayer,
+    const int nnet,
+    const int nspline,
+    const int functype);
+
+// the tabulated embedding of the neighbors of one atom contracted with their environment matrix,
+// accumulated to out (4 x last_layer_size). em is nnei x 4, its first column is the input of the table.
+// The first nvalid neighbors are real, the padded ones share one environment matrix and are evaluated once.
+template<typename FPTYPE>
+void tabulate_fusion_atom_cpu(
+    FPTYPE * out,
+    const FPTYPE * table,
+    const FPTYPE * table_info,
+    const FPTYPE * em,
+    const int nnei,
+    const int nvalid,
+    const int last_layer_size);
+
+// the gradient of tabulate_fusion_atom_cpu with respect to em (nnei x 4),
+// the gradient through the input of the table is added to the first column.
+// The gradient of the padded neighbors is put on the first of them.
+template<typename FPTYPE>
+void tabulate_fusion_grad_atom_cpu(
+    FPTYPE * dy_dem,
+    const FPTYPE * table,
+    const FPTYPE * table_info,
+    const FPTYPE * em,
+    const FPTYPE * dy,
+    const int nnei,
+    const int nvalid,
+    const int last_layer_size);
+
+// the gradient of tabulate_fusion_grad_atom_cpu with respect to dy, accumulated to dz_dy (4 x last_layer_size)
+template<typename FPTYPE>
+void tabulate_fusion_grad_grad_atom_cpu(
+    FPTYPE * dz_dy,
+    const FPTYPE * table,
+    const FPTYPE * table_info,
+    const FPTYPE * em,
+    const FPTYPE * dz_dy_dem,
+    const int nnei,
+    const int nvalid,
+    const int last_layer_size);
+
+// the gradient of the descriptor of prod_env_mat_a_tabulate_cpu with respect to the environment matrix
+// outputs:
+//	dy_dem: nloc x nnei x 4
+// inputs:
+//	table: nnet x nspline x (6 * last_layer_size), the neighbors of type tt of an atom of type ti
+//	       use the net tt if type_one_side, and the net ti * ntypes + tt otherwise
+//	em: nloc x nnei x 4, the neighbors of type tt are in [sec[tt], sec[tt+1])
+//	nlist: nloc x nnei, the formatted nlist of em, only its valid neighbors are visited
+//	type: the types of the local atoms
+//	dy: nloc x 4 x last_layer_size, the gradient with respect to the descriptor
+template<typename FPTYPE>
+void tabulate_fusion_se_a_grad_cpu(
+    FPTYPE * dy_dem,
+    const FPTYPE * table,
+    const FPTYPE * table_info,
+    const FPTYPE * em,
+    const int * nlist,
+    const int * type,
+    const FPTYPE * dy,
+    const int nloc,
+    const int nspline,
+    const int last_layer_size,
+    const std::vector<int> & sec,
+    const bool type_one_side);
+
+// the gradient of tabulate_fusion_se_a_grad_cpu with respect to dy, dy_dem is linear in dy
+// outputs:
+//	dz_dy: nloc x 4 x last_layer_size
+// inputs:
+//	dz_dy_dem: nloc x nnei x 4, the gradient with respect to dy_dem
+//	the others are the same as tabulate_fusion_se_a_grad_cpu
+template<typename FPTYPE>
+void tabulate_fusion_se_a_grad_grad_cpu(
+    FPTYPE * dz_dy,
+    const FPTYPE * table,
+    const FPTYPE * table_info,
+    const FPTYPE * em,
+    const int * nlist,
+    const int * type,
+    const FPTYPE * dz_dy_dem,
+    const int nloc,
+    const int nspline,
+    const int last_layer_size,
+    const std::vector<int> & sec,
+    const bool type_one_side);
+
 #if GOOGLE_CUDA
 template<typename FPTYPE>
 void tabulate_fusion_gpu_cuda(
@@ -110,7 +110,8 @@ int format_nlist_i_cpu (
     const int &			i_idx,
     const std::vector<int > &   nei_idx_a, 
     const float &		rcut,
-    const std::vector<int > &   sec_a)
+    const std::vector<int > &   sec_a,
+    int *			nei_count)
 {
     fmt_nei_idx_a.resize (sec_a.back());
     fill (fmt_nei_idx_a.begin(), fmt_nei_idx_a.end(), -1);
@@ -144,6 +145,12 @@ int format_nlist_i_cpu (
 	  overflowed = nei_type;
 	}
     }
+    if (nei_count != NULL) {
+      std::fill(nei_count, nei_count + sec_a.size() - 1, 0);
+      for (unsigned kk = 0; kk < sel_nei.size(); ++kk) {
+	nei_count[sel_nei[kk].type] ++;
+      }
+    }
     return overflowed;
 }
 
@@ -200,7 +207,8 @@ int format_nlist_i_cpu<double> (
     const int &			i_idx,
     const std::vector<int > &   nei_idx_a, 
     const float &		rcut,
-    const std::vector<int > &   sec_a);
+    const std::vector<int > &   sec_a,
+    int *			nei_count);
 
 
 template
@@ -211,7 +219,8 @@ int format_nlist_i_cpu<float> (
     const int &			i_idx,
     const std::vector<int > &   nei_idx_a, 
     const float &		rcut,
-    const std::vector<int > &   sec_a);
+    const std::vector<int > &   sec_a,
+    int *			nei_count);
 
 template
 void 
@@ -790,11 +790,11 @@ build_nlist_cpu(
   *max_list_size = 0;
   nlist.inum = nloc;
   FPTYPE rcut2 = rcut * rcut;  
-  std::vector<int> jlist;
-  jlist.reserve(mem_size);  
   for(int ii = 0; ii < nlist.inum; ++ii){
     nlist.ilist[ii] = ii;
-    jlist.clear();
+    // the neighbors are written in place, and only counted beyond mem_size
+    int * jlist = nlist.firstneigh[ii];
+    int list_size = 0;
     for(int jj = 0; jj < nall; ++jj){
       if(jj == ii) continue;
       FPTYPE diff[3];
@@ -803,18 +803,17 @@ build_nlist_cpu(
       }
       FPTYPE diff2 = deepmd::dot3(diff, diff);
       if(diff2 < rcut2){
-	jlist.push_back(jj);
+	if(list_size < mem_size) jlist[list_size] = jj;
+	list_size ++;
       }
     }
-    if(jlist.size() > mem_size){
-      *max_list_size = jlist.size();
+    if(list_size > mem_size){
+      *max_list_size = list_size;
       return 1;      
     }
     else {
-      int list_size = jlist.size();
       nlist.numneigh[ii] = list_size;
       if(list_size > *max_list_size) *max_list_size = list_size;
-      std::copy(jlist.begin(), jlist.end(), nlist.firstneigh[ii]);
     }
   }
   return 0;
@@ -0,0 +1,158 @@
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "neighbor_stat.h"
+
+template <typename FPTYPE>
+void
+deepmd::
+neighbor_stat_cpu(
+    FPTYPE & min_nbor_dist,
+    int * max_nbor_size,
+    int * dist_hist,
+    const FPTYPE * coord,
+    const int * type,
+    const int & nloc,
+    const int & nall,
+    const int & ntypes,
+    const float & rcut,
+    const int & nbins)
+{
+  const FPTYPE rcut2 = rcut * rcut;
+  min_nbor_dist = rcut;
+  std::fill(max_nbor_size, max_nbor_size + ntypes, 0);
+  if (nbins > 0) {
+    std::fill(dist_hist, dist_hist + nbins, 0);
+  }
+  if (nall == 0) return;
+
+  // the cells tile the bounding box of the atoms and are not smaller than rcut
+  FPTYPE lo[3], hi[3];
+  for (int dd = 0; dd < 3; ++dd) {
+    lo[dd] = hi[dd] = coord[dd];
+  }
+  for (int ii = 1; ii < nall; ++ii) {
+    for (int dd = 0; dd < 3; ++dd) {
+      lo[dd] = std::min(lo[dd], coord[ii * 3 + dd]);
+      hi[dd] = std::max(hi[dd], coord[ii * 3 + dd]);
+    }
+  }
+  int ncell[3];
+  for (int dd = 0; dd < 3; ++dd) {
+    ncell[dd] = std::max(1, int((hi[dd] - lo[dd]) / rcut));
+  }
+  // a sparse system should not allocate more cells than atoms
+  while ((long long)ncell[0] * ncell[1] * ncell[2] > 8LL * nall) {
+    int dmax = std::max_element(ncell, ncell + 3) - ncell;
+    ncell[dmax] = std::max(1, ncell[dmax] / 2);
+  }
+  FPTYPE cell_size[3];
+  for (int dd = 0; dd < 3; ++dd) {
+    cell_size[dd] = std::max((hi[dd] - lo[dd]) / ncell[dd], (FPTYPE)rcut);
+  }
+  const int total_cellnum = ncell[0] * ncell[1] * ncell[2];
+  std::vector<int> atom_cell(nall * 3);
+  std::vector<int> cell_start(total_cellnum + 1, 0);
+  for (int ii = 0; ii < nall; ++ii) {
+    for (int dd = 0; dd < 3; ++dd) {
+      int idx = (coord[ii * 3 + dd] - lo[dd]) / cell_size[dd];
+      atom_cell[ii * 3 + dd] = std::min(std::max(idx, 0), ncell[dd] - 1);
+    }
+    int cell_idx = (atom_cell[ii * 3 + 0] * ncell[1] + atom_cell[ii * 3 + 1]) * ncell[2] + atom_cell[ii * 3 + 2];
+    cell_start[cell_idx + 1] ++;
+  }
+  for (int cc = 0; cc < total_cellnum; ++cc) {
+    cell_start[cc + 1] += cell_start[cc];
+  }
+  std::vector<int> cell_atoms(nall);
+  {
+    std::vector<int> cell_fill(cell_start.begin(), cell_start.end() - 1);
+    for (int ii = 0; ii < nall; ++ii) {
+      int cell_idx = (atom_cell[ii * 3 + 0] * ncell[1] + atom_cell[ii * 3 + 1]) * ncell[2] + atom_cell[ii * 3 + 2];
+      cell_atoms[cell_fill[cell_idx] ++] = ii;
+    }
+  }
+
+  FPTYPE min_dist2 = rcut2;
+#pragma omp parallel
+  {
+    std::vector<int> nnei_type(ntypes);
+    std::vector<int> max_nnei_type(ntypes, 0);
+    std::vector<int> hist(nbins, 0);
+#pragma omp for schedule(static) reduction(min:min_dist2)
+    for (int ii = 0; ii < nloc; ++ii) {
+      std::fill(nnei_type.begin(), nnei_type.end(), 0);
+      int cstt[3], cend[3];
+      for (int dd = 0; dd < 3; ++dd) {
+	cstt[dd] = std::max(atom_cell[ii * 3 + dd] - 1, 0);
+	cend[dd] = std::min(atom_cell[ii * 3 + dd] + 2, ncell[dd]);
+      }
+      for (int c0 = cstt[0]; c0 < cend[0]; ++c0) {
+	for (int c1 = cstt[1]; c1 < cend[1]; ++c1) {
+	  for (int c2 = cstt[2]; c2 < cend[2]; ++c2) {
+	    int cell_idx = (c0 * ncell[1] + c1) * ncell[2] + c2;
+	    for (int kk = cell_start[cell_idx]; kk < cell_start[cell_idx + 1]; ++kk) {
+	      int jj = cell_atoms[kk];
+	      if (jj == ii) continue;
+	      FPTYPE diff[3];
+	      for (int dd = 0; dd < 3; ++dd) {
+		diff[dd] = coord[jj * 3 + dd] - coord[ii * 3 + dd];
+	      }
+	      FPTYPE rr2 = diff[0] * diff[0] + diff[1] * diff[1] + diff[2] * diff[2];
+	      if (rr2 >= rcut2) continue;
+	      nnei_type[type[jj]] ++;
+	      min_dist2 = std::min(min_dist2, rr2);
+	      if (nbins > 0) {
+		int bin = sqrt(rr2) / rcut * nbins;
+		hist[std::min(bin, nbins - 1)] ++;
+	      }
+	    }
+	  }
+	}
+      }
+      for (int tt = 0; tt < ntypes; ++tt) {
+	max_nnei_type[tt] = std::max(max_nnei_type[tt], nnei_type[tt]);
+      }
+    }
+#pragma omp critical
+    {
+      for (int tt = 0; tt < ntypes; ++tt) {
+	max_nbor_size[tt] = std::max(max_nbor_size[tt], max_nnei_type[tt]);
+      }
+      for (int bb = 0; bb < nbins; ++bb) {
+	dist_hist[bb] += hist[bb];
+      }
+    }
+  }
+  min_nbor_dist = sqrt(min_dist2);
+}
+
+template
+void
+deepmd::
+neighbor_stat_cpu<double>(
+    double & min_nbor_dist,
+    int * max_nbor_size,
+    int * dist_hist,
+    const double * coord,
+    const int * type,
+    const int & nloc,
+    const int & nall,
+    const int & ntypes,
+    const float & rcut,
+    const int & nbins);
+
+template
+void
+deepmd::
+neighbor_stat_cpu<float>(
+    float & min_nbor_dist,
+    int * max_nbor_size,
+    int * dist_hist,
+    const float * coord,
+    const int * type,
+    const int & nloc,
+    const int & nall,
+    const int & ntypes,
+    const float & rcut,
+    const int & nbins);
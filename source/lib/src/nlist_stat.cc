@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include "nlist_stat.h"
+
+using namespace deepmd;
+
+static std::atomic<bool> stat_enabled (false);
+static std::mutex stat_mutex;
+static NlistStat stat_total;
+
+NlistStat::
+NlistStat (const int ntypes)
+    : natoms (0), nphantom (0),
+      nnei_max (ntypes, 0), nnei_sum (ntypes, 0), noverflow (ntypes, 0), sel (ntypes, 0),
+      nbuild (0), nretry (0), max_nbor_size (0)
+{
+}
+
+double
+NlistStat::
+nnei_mean (const int tt) const
+{
+  const long long nreal = natoms - nphantom;
+  return nreal > 0 ? double(nnei_sum[tt]) / nreal : 0.;
+}
+
+void
+NlistStat::
+merge (const NlistStat & stat)
+{
+  if (stat.ntypes() > ntypes()) {
+    nnei_max.resize(stat.ntypes(), 0);
+    nnei_sum.resize(stat.ntypes(), 0);
+    noverflow.resize(stat.ntypes(), 0);
+    sel.resize(stat.ntypes(), 0);
+  }
+  natoms += stat.natoms;
+  nphantom += stat.nphantom;
+  for (int tt = 0; tt < stat.ntypes(); ++tt) {
+    nnei_max[tt] = std::max(nnei_max[tt], stat.nnei_max[tt]);
+    nnei_sum[tt] += stat.nnei_sum[tt];
+    noverflow[tt] += stat.noverflow[tt];
+    sel[tt] = std::max(sel[tt], stat.sel[tt]);
+  }
+  nbuild += stat.nbuild;
+  nretry += stat.nretry;
+  max_nbor_size = std::max(max_nbor_size, stat.max_nbor_size);
+}
+
+void
+deepmd::
+nlist_stat_enable (const bool enable)
+{
+  stat_enabled = enable;
+}
+
+bool
+deepmd::
+nlist_stat_enabled ()
+{
+  return stat_enabled;
+}
+
+void
+deepmd::
+nlist_stat_add (const NlistStat & stat)
+{
+  std::lock_guard<std::mutex> lock (stat_mutex);
+  stat_total.merge(stat);
+}
+
+void
+deepmd::
+nlist_stat_add_build (const int nretry, const int max_nbor_size)
+{
+  NlistStat stat;
+  stat.nbuild = 1;
+  stat.nretry = nretry;
+  stat.max_nbor_size = max_nbor_size;
+  nlist_stat_add(stat);
+}
+
+void
+deepmd::
+nlist_stat_add_phantom (const int nphantom)
+{
+  NlistStat stat;
+  stat.nphantom = nphantom;
+  nlist_stat_add(stat);
+}
+
+void
+deepmd::
+nlist_stat_get (NlistStat & stat, const bool reset)
+{
+  std::lock_guard<std::mutex> lock (stat_mutex);
+  stat = stat_total;
+  if (reset) {
+    stat_total = NlistStat();
+  }
+}
@@ -0,0 +1,253 @@
+#include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "npy.h"
+#include "errors.h"
+
+using namespace deepmd;
+
+// parse the value of key in the header dict, e.g. 'descr': '<f8'
+static std::string
+header_value (
+    const std::string & header,
+    const std::string & key)
+{
+  size_t pos = header.find("'" + key + "'");
+  if (pos == std::string::npos) {
+    throw deepmd::deepmd_exception("cannot find " + key + " in the npy header");
+  }
+  pos = header.find(':', pos);
+  size_t end;
+  pos = header.find_first_not_of(' ', pos + 1);
+  if (header[pos] == '(') {
+    end = header.find(')', pos) + 1;
+  }
+  else {
+    end = header.find_first_of(",}", pos);
+  }
+  return header.substr(pos, end - pos);
+}
+
+NpyFile::
+NpyFile (const std::string & path)
+    : map (NULL), map_size (0)
+{
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw deepmd::deepmd_exception("cannot open " + path);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < 10) {
+    close(fd);
+    throw deepmd::deepmd_exception(path + " is not an npy file");
+  }
+  map_size = st.st_size;
+  map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    map = NULL;
+    throw deepmd::deepmd_exception("cannot map " + path);
+  }
+  const char * buff = (const char *) map;
+  if (memcmp(buff, "\x93NUMPY", 6) != 0) {
+    munmap(map, map_size);
+    throw deepmd::deepmd_exception(path + " is not an npy file");
+  }
+  // the header length is 2 bytes in version 1, and 4 bytes since version 2
+  size_t header_len, header_start;
+  const unsigned char * ubuff = (const unsigned char *) buff;
+  if (ubuff[6] == 1) {
+    header_len = ubuff[8] | (ubuff[9] << 8);
+    header_start = 10;
+  }
+  else {
+    header_len = ubuff[8] | (ubuff[9] << 8) | (ubuff[10] << 16) | ((size_t)ubuff[11] << 24);
+    header_start = 12;
+  }
+  if (header_start + header_len > map_size) {
+    munmap(map, map_size);
+    throw deepmd::deepmd_exception(path + " has a broken header");
+  }
+  std::string header(buff + header_start, header_len);
+  data = buff + header_start + header_len;
+  try {
+    std::string descr = header_value(header, "descr");
+    if (descr == "'<f8'" || descr == "'=f8'") {
+      is_double = true;
+    }
+    else if (descr == "'<f4'" || descr == "'=f4'") {
+      is_double = false;
+    }
+    else {
+      throw deepmd::deepmd_exception("unsupported dtype " + descr + " of " + path + ", should be float32 or float64");
+    }
+    if (header_value(header, "fortran_order") != "False") {
+      throw deepmd::deepmd_exception(path + " should be in C order");
+    }
+    std::string shape = header_value(header, "shape");
+    std::vector<long> dims;
+    for (size_t pos = 1; pos < shape.size(); ) {
+      size_t end = shape.find_first_of(",)", pos);
+      std::string item = shape.substr(pos, end - pos);
+      if (item.find_first_not_of(' ') != std::string::npos) {
+	size_t nparsed = 0;
+	long dim = -1;
+	try {
+	  dim = std::stol(item, &nparsed);
+	}
+	catch (const std::exception &) {
+	}
+	if (dim < 0 || item.find_first_not_of(' ', nparsed) != std::string::npos) {
+	  throw deepmd::deepmd_exception(path + " has a broken shape " + shape);
+	}
+	dims.push_back(dim);
+      }
+      pos = end + 1;
+    }
+    long size = 1;
+    for (unsigned ii = 0; ii < dims.size(); ++ii) size *= dims[ii];
+    nframes_ = dims.size() > 1 ? dims[0] : 1;
+    frame_size_ = nframes_ > 0 ? size / nframes_ : 0;
+    if ((size_t)(data - buff) + size * (is_double ? 8 : 4) > map_size) {
+      throw deepmd::deepmd_exception(path + " is truncated");
+    }
+  }
+  catch (...) {
+    munmap(map, map_size);
+    throw;
+  }
+}
+
+NpyFile::
+~NpyFile ()
+{
+  if (map != NULL) {
+    munmap(map, map_size);
+  }
+}
+
+void
+NpyFile::
+reshape (const int nframes)
+{
+  const long size = (long)nframes_ * frame_size_;
+  if (nframes <= 0 || size % nframes != 0) {
+    throw deepmd::deepmd_exception("cannot reshape " + std::to_string(size) + " numbers to " + std::to_string(nframes) + " frames");
+  }
+  nframes_ = nframes;
+  frame_size_ = size / nframes;
+}
+
+template <typename FPTYPE, typename DTYPE>
+static void
+gather_frames (
+    FPTYPE * out,
+    const DTYPE * in,
+    const int * frames,
+    const int nsel,
+    const int frame_size,
+    const int * idx_map,
+    const int natoms)
+{
+  const int ndof = natoms > 0 ? frame_size / natoms : frame_size;
+  for (int ii = 0; ii < nsel; ++ii) {
+    const DTYPE * in_frame = in + (size_t)frames[ii] * frame_size;
+    FPTYPE * out_frame = out + (size_t)ii * frame_size;
+    if (idx_map == NULL) {
+      std::copy(in_frame, in_frame + frame_size, out_frame);
+    }
+    else {
+      for (int jj = 0; jj < natoms; ++jj) {
+	const DTYPE * in_atom = in_frame + idx_map[jj] * ndof;
+	std::copy(in_atom, in_atom + ndof, out_frame + jj * ndof);
+      }
+    }
+  }
+}
+
+template <typename FPTYPE>
+void
+NpyFile::
+gather (
+    FPTYPE * out,
+    const int * frames,
+    const int nsel,
+    const int * idx_map,
+    const int natoms) const
+{
+  for (int ii = 0; ii < nsel; ++ii) {
+    if (frames[ii] < 0 || frames[ii] >= nframes_) {
+      throw deepmd::deepmd_exception("frame index out of range");
+    }
+  }
+  if (idx_map != NULL && (natoms <= 0 || frame_size_ % natoms != 0)) {
+    throw deepmd::deepmd_exception("the frame size is not a multiple of the number of atoms");
+  }
+  // numpy pads the header to a multiple of 16 bytes, so the data can be read in place
+  if (is_double) {
+    gather_frames(out, (const double *) data, frames, nsel, frame_size_, idx_map, natoms);
+  }
+  else {
+    gather_frames(out, (const float *) data, frames, nsel, frame_size_, idx_map, natoms);
+  }
+}
+
+FrameSampler::
+FrameSampler (const std::vector<int> & set_nframes_,
+	      const int batch_size_,
+	      const unsigned seed,
+	      const bool shuffle_)
+    : set_nframes (set_nframes_), batch_size (batch_size_), shuffle (shuffle_),
+      generator (seed), set_count (0), cur_set (-1), iterator (0)
+{
+  if (set_nframes.size() == 0) {
+    throw deepmd::deepmd_exception("no set to sample");
+  }
+  if (batch_size <= 0) {
+    throw deepmd::deepmd_exception("the batch size should be positive");
+  }
+}
+
+void
+FrameSampler::
+next (int & set_idx,
+      std::vector<int> & frames)
+{
+  if (cur_set < 0 || iterator + batch_size > (int)perm.size()) {
+    cur_set = set_count % set_nframes.size();
+    set_count ++;
+    perm.resize(set_nframes[cur_set]);
+    for (unsigned ii = 0; ii < perm.size(); ++ii) perm[ii] = ii;
+    if (shuffle) {
+      std::shuffle(perm.begin(), perm.end(), generator);
+    }
+    iterator = 0;
+  }
+  int end = std::min(iterator + batch_size, (int)perm.size());
+  set_idx = cur_set;
+  frames.assign(perm.begin() + iterator, perm.begin() + end);
+  iterator += batch_size;
+}
+
+template
+void
+NpyFile::
+gather<double> (
+    double * out,
+    const int * frames,
+    const int nsel,
+    const int * idx_map,
+    const int natoms) const;
+
+template
+void
+NpyFile::
+gather<float> (
+    float * out,
+    const int * frames,
+    const int nsel,
+    const int * idx_map,
+    const int natoms) const;
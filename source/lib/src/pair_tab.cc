@@ -1,114 +1,89 @@
-#include <iostream>
 #include <cmath>
 #include <cassert>
 #include <vector>
 #include "pair_tab.h"
-#include "errors.h"
-
-inline 
-void _pair_tabulated_inter (
-    double & ener, 
-    double & fscale, 
-    const double * table_info,
-    const double * table_data,
-    const double * dr)
-{
-  // info size: 3
-  const double & rmin = table_info[0];
-  const double & hh = table_info[1];
-  const double hi = 1./hh;
-  const unsigned nspline = unsigned(table_info[2] + 0.1);
-  const unsigned ndata = nspline * 4;
-
-  double r2 = dr[0] * dr[0] + dr[1] * dr[1] + dr[2] * dr[2];
-  double rr = sqrt(r2);
-  double uu = (rr - rmin) * hi;
-  // std::cout << rr << " " << rmin << " " << hh << " " << uu << std::endl;
-  if (uu < 0) {
-    std::cerr << "coord go beyond table lower boundary" << std::endl;
-    throw deepmd::deepmd_exception();
-  }
-  int idx = uu;
-  if (idx >= nspline) {
-    fscale = ener = 0;
-    return;
-  }
-  uu -= idx;
-  assert(idx >= 0);
-  assert(uu >= 0 && uu < 1);
-
-  const double & a3 = table_data[4 * idx + 0];
-  const double & a2 = table_data[4 * idx + 1];
-  const double & a1 = table_data[4 * idx + 2];
-  const double & a0 = table_data[4 * idx + 3];
-  
-  double etmp = (a3 * uu + a2) * uu + a1;
-  ener = etmp * uu + a0;
-  fscale = (2. * a3 * uu + a2) * uu + etmp;
-  fscale *= -hi;
-}
 
+// evaluate the tabulated interaction of the neighbors of atom i_idx in
+// section [jstart, jend), all of them of one type that shares the table
+// cur_table_data. Returns the number of pairs closer than the table lower
+// boundary, which are evaluated at the boundary.
 template<typename FPTYPE>
-void _pair_tab_jloop(
+int _pair_tab_block(
     FPTYPE * energy,
     FPTYPE * force,
     FPTYPE * virial,
-    int & jiter,
+    FPTYPE * fscale_buff,
     const int & i_idx,
+    const int & jstart,
+    const int & jend,
     const int & nnei,
-    const int & i_type_shift,
-    const double * p_table_info,
-    const double * p_table_data,
-    const int & tab_stride,
+    const FPTYPE & rmin,
+    const FPTYPE & hi,
+    const int & nspline,
+    const FPTYPE * cur_table_data,
     const FPTYPE * rij,
     const FPTYPE * scale,
-    const int * type,
-    const int * nlist,
-    const int * natoms,
-    const std::vector<int> & sel
-    )
+    const int * nlist)
 {
+  const int * nlist_i = nlist + i_idx * nnei;
+  const FPTYPE * rij_i = rij + i_idx * nnei * 3;
   const FPTYPE i_scale = scale[i_idx];
-  for (int ss = 0; ss < sel.size(); ++ss){
-    int j_type = ss;
-    const double * cur_table_data = 
-	p_table_data + (i_type_shift + j_type) * tab_stride;
-    for (int jj = 0; jj < sel[ss]; ++jj){
-      int j_idx = nlist[i_idx * nnei + jiter];
-      if (j_idx < 0){
-	jiter++;
-	continue;
-      }
-      assert(j_type == type[j_idx]);
-      double dr[3];
-      for (int dd = 0; dd < 3; ++dd){
-	dr[dd] = rij[(i_idx * nnei + jiter) * 3 + dd];
-      }
-      double r2 = dr[0] * dr[0] + dr[1] * dr[1] + dr[2] * dr[2];
-      double ri = 1./sqrt(r2);
-      double ener, fscale;
-      _pair_tabulated_inter(
-	  ener,
-	  fscale, 
-	  p_table_info, 
-	  cur_table_data, 
-	  dr);
-      energy[i_idx] += 0.5 * ener;
-      for (int dd = 0; dd < 3; ++dd) {
-	force[i_idx * 3 + dd] -= fscale * dr[dd] * ri * 0.5 * i_scale;
-	force[j_idx * 3 + dd] += fscale * dr[dd] * ri * 0.5 * i_scale;
-      }
-      for (int dd0 = 0; dd0 < 3; ++dd0) {
-	for (int dd1 = 0; dd1 < 3; ++dd1) {
-	  virial[i_idx * 9 + dd0 * 3 + dd1]
-	      += 0.5 * fscale * dr[dd0] * dr[dd1] * ri * 0.5 * i_scale;
-	  virial[j_idx * 9 + dd0 * 3 + dd1]
-	      += 0.5 * fscale * dr[dd0] * dr[dd1] * ri * 0.5 * i_scale;
-	}
+  int nviolate = 0;
+  FPTYPE ener_i = 0;
+  // spline lookup, branch free: the padded and out of range pairs get zero weight
+#pragma omp simd reduction(+:nviolate,ener_i)
+  for (int jj = jstart; jj < jend; ++jj){
+    const FPTYPE r2 = rij_i[jj * 3 + 0] * rij_i[jj * 3 + 0]
+	+ rij_i[jj * 3 + 1] * rij_i[jj * 3 + 1]
+	+ rij_i[jj * 3 + 2] * rij_i[jj * 3 + 2];
+    const FPTYPE rr = sqrt(r2);
+    FPTYPE uu = (rr - rmin) * hi;
+    const bool valid = nlist_i[jj] >= 0;
+    nviolate += (valid && uu < (FPTYPE)0.) ? 1 : 0;
+    uu = uu < (FPTYPE)0. ? (FPTYPE)0. : uu;
+    int idx = uu < (FPTYPE)nspline ? int(uu) : nspline;
+    const FPTYPE ww = (valid && idx < nspline) ? (FPTYPE)1. : (FPTYPE)0.;
+    idx = idx < nspline ? idx : nspline - 1;
+    uu -= idx;
+    const FPTYPE a3 = cur_table_data[4 * idx + 0];
+    const FPTYPE a2 = cur_table_data[4 * idx + 1];
+    const FPTYPE a1 = cur_table_data[4 * idx + 2];
+    const FPTYPE a0 = cur_table_data[4 * idx + 3];
+    const FPTYPE etmp = (a3 * uu + a2) * uu + a1;
+    const FPTYPE ener = ww * (etmp * uu + a0);
+    // -dE/dr / r, the padded pairs have rr = 0
+    const FPTYPE ri = valid ? (FPTYPE)1. / rr : (FPTYPE)0.;
+    fscale_buff[jj] = -ww * ((2. * a3 * uu + a2) * uu + etmp) * hi * ri;
+    ener_i += ener;
+  }
+  energy[i_idx] += 0.5 * ener_i;
+  // fused force and virial accumulation, the neighbors are scattered
+  FPTYPE force_i[3] = {0, 0, 0};
+  FPTYPE virial_i[9] = {0, 0, 0, 0, 0, 0, 0, 0, 0};
+  for (int jj = jstart; jj < jend; ++jj){
+    const int j_idx = nlist_i[jj];
+    if (j_idx < 0) continue;
+    const FPTYPE * dr = rij_i + jj * 3;
+    const FPTYPE pref = fscale_buff[jj] * 0.5 * i_scale;
+    for (int dd = 0; dd < 3; ++dd) {
+      force_i[dd] -= pref * dr[dd];
+      force[j_idx * 3 + dd] += pref * dr[dd];
+    }
+    for (int dd0 = 0; dd0 < 3; ++dd0) {
+      for (int dd1 = 0; dd1 < 3; ++dd1) {
+	const FPTYPE vv = 0.5 * pref * dr[dd0] * dr[dd1];
+	virial_i[dd0 * 3 + dd1] += vv;
+	virial[j_idx * 9 + dd0 * 3 + dd1] += vv;
       }
-      jiter++;
     }
   }
+  for (int dd = 0; dd < 3; ++dd) {
+    force[i_idx * 3 + dd] += force_i[dd];
+  }
+  for (int dd = 0; dd < 9; ++dd) {
+    virial[i_idx * 9 + dd] += virial_i[dd];
+  }
+  return nviolate;
 }
 
 inline void
@@ -123,13 +98,13 @@ _cum_sum (
 }
 
 template<typename FPTYPE>
-void 
+int
 deepmd::pair_tab_cpu(
     FPTYPE * energy,
     FPTYPE * force,
     FPTYPE * virial,
     const double * p_table_info,
-    const double * p_table_data,
+    const FPTYPE * p_table_data,
     const FPTYPE * rij,
     const FPTYPE * scale,
     const int * type,
@@ -149,6 +124,8 @@ deepmd::pair_tab_cpu(
   const int ntypes = int(p_table_info[3]+0.1);
   const int nspline = p_table_info[2]+0.1;
   const int tab_stride = 4 * nspline;
+  const FPTYPE rmin = p_table_info[0];
+  const FPTYPE hi = 1. / p_table_info[1];
   
   // fill results with 0
   for (int ii = 0; ii < nloc; ++ii){
@@ -164,6 +141,20 @@ deepmd::pair_tab_cpu(
       virial[i_idx * 9 + dd] = 0;
     }
   }
+  // the type sections of the a and r neighbors, each of them uses one table
+  std::vector<int> sec_stt, sec_end, sec_type;
+  for (int ss = 0; ss < sel_a.size(); ++ss){
+    sec_stt.push_back(sec_a[ss]);
+    sec_end.push_back(sec_a[ss+1]);
+    sec_type.push_back(ss);
+  }
+  for (int ss = 0; ss < sel_r.size(); ++ss){
+    sec_stt.push_back(sec_a.back() + sec_r[ss]);
+    sec_end.push_back(sec_a.back() + sec_r[ss+1]);
+    sec_type.push_back(ss);
+  }
+  std::vector<FPTYPE> fscale_buff(nnei);
+  int nviolate = 0;
   // compute force of a frame
   int i_idx = 0;
   for (int tt = 0; tt < ntypes; ++tt) {
@@ -171,54 +162,28 @@ deepmd::pair_tab_cpu(
       int i_type = type[i_idx];
       assert(i_type == tt) ;
       const int i_type_shift = i_type * ntypes;
-      int jiter = 0;
-      // a neighbor
-      _pair_tab_jloop(energy,
-		      force,
-		      virial,
-		      jiter,
-		      i_idx, 
-		      nnei,
-		      i_type_shift,
-		      p_table_info,
-		      p_table_data,
-		      tab_stride,
-		      rij,
-		      scale,
-		      type, 
-		      nlist,
-		      natoms,
-		      sel_a);
-      // r neighbor
-      _pair_tab_jloop(energy,
-		      force,
-		      virial,
-		      jiter,
-		      i_idx, 
-		      nnei,
-		      i_type_shift,
-		      p_table_info,
-		      p_table_data,
-		      tab_stride,
-		      rij,
-		      scale,
-		      type, 
-		      nlist,
-		      natoms,
-		      sel_r);
+      for (int ss = 0; ss < sec_type.size(); ++ss){
+	nviolate += _pair_tab_block(
+	    energy, force, virial,
+	    &fscale_buff[0],
+	    i_idx, sec_stt[ss], sec_end[ss], nnei,
+	    rmin, hi, nspline,
+	    p_table_data + (i_type_shift + sec_type[ss]) * tab_stride,
+	    rij, scale, nlist);
+      }
       i_idx ++;
     }
   }
+  return nviolate;
 }
 
-
 template
-void deepmd::pair_tab_cpu<float>(
+int deepmd::pair_tab_cpu<float>(
     float * energy,
     float * force,
     float * virial,
     const double * table_info,
-    const double * table_data,
+    const float * table_data,
     const float * rij,
     const float * scale,
     const int * type,
@@ -229,7 +194,7 @@ void deepmd::pair_tab_cpu<float>(
     );
 
 template
-void deepmd::pair_tab_cpu<double>(
+int deepmd::pair_tab_cpu<double>(
     double * energy,
     double * force,
     double * virial,
@@ -1,9 +1,14 @@
 #include <cassert>
+#include <cmath>
 #include <iostream>
 #include <string.h>
+#include <algorithm>
 #include "prod_env_mat.h"
 #include "fmt_nlist.h"
 #include "env_mat.h"
+#include "switcher.h"
+#include "nlist_stat.h"
+#include "tabulate.h"
 
 using namespace deepmd;
 
@@ -26,67 +31,159 @@ prod_env_mat_a_cpu(
     const float rcut, 
     const float rcut_smth, 
     const std::vector<int> sec) 
+{
+  prod_env_mat_a_batch_cpu(
+      em, em_deriv, rij, nlist, 
+      &coord, &type, &inlist, &nall, 1, 
+      max_nbor_size, avg, std, nloc, rcut, rcut_smth, sec);
+}
+
+template<typename FPTYPE>
+void
+deepmd::
+prod_env_mat_a_batch_cpu(
+    FPTYPE * em, 
+    FPTYPE * em_deriv, 
+    FPTYPE * rij, 
+    int * nlist, 
+    const FPTYPE * const * coord, 
+    const int * const * type, 
+    const InputNlist * inlist,
+    const int * nall,
+    const int nframes,
+    const int max_nbor_size,
+    const FPTYPE * avg, 
+    const FPTYPE * std, 
+    const int nloc, 
+    const float rcut, 
+    const float rcut_smth, 
+    const std::vector<int> sec) 
+{
+  prod_env_mat_a_tabulate_batch_cpu(
+      (FPTYPE *)NULL, em, em_deriv, rij, nlist, 
+      coord, type, inlist, nall, nframes, 
+      max_nbor_size, avg, std, (const FPTYPE *)NULL, (const FPTYPE *)NULL, 
+      nloc, rcut, rcut_smth, sec, 0, 0, true);
+}
+
+template<typename FPTYPE>
+void
+deepmd::
+prod_env_mat_a_tabulate_batch_cpu(
+    FPTYPE * descriptor, 
+    FPTYPE * em, 
+    FPTYPE * em_deriv, 
+    FPTYPE * rij, 
+    int * nlist, 
+    const FPTYPE * const * coord, 
+    const int * const * type, 
+    const InputNlist * inlist,
+    const int * nall,
+    const int nframes,
+    const int max_nbor_size,
+    const FPTYPE * avg, 
+    const FPTYPE * std, 
+    const FPTYPE * table, 
+    const FPTYPE * table_info, 
+    const int nloc, 
+    const float rcut, 
+    const float rcut_smth, 
+    const std::vector<int> sec,
+    const int nspline,
+    const int last_layer_size,
+    const bool type_one_side) 
 {
   const int nnei = sec.back();
   const int nem = nnei * 4;
 
-  // set & normalize coord
-  std::vector<FPTYPE> d_coord3(nall * 3);
-  for (int ii = 0; ii < nall; ++ii) {
-    for (int dd = 0; dd < 3; ++dd) {
-      d_coord3[ii * 3 + dd] = coord[ii * 3 + dd];
+  // set coord, type and nlist of the frames
+  std::vector<std::vector<FPTYPE> > d_coord3(nframes);
+  std::vector<std::vector<int> > d_type(nframes);
+  std::vector<std::vector<std::vector<int > > > d_nlist_a(nframes);
+#pragma omp parallel for if (nframes > 1)
+  for (int ff = 0; ff < nframes; ++ff) {
+    d_coord3[ff].assign(coord[ff], coord[ff] + nall[ff] * 3);
+    d_type[ff].assign(type[ff], type[ff] + nall[ff]);
+    d_nlist_a[ff].resize(nloc);
+    assert(nloc == inlist[ff].inum);
+    for (unsigned ii = 0; ii < nloc; ++ii) {
+      d_nlist_a[ff][ii].reserve(max_nbor_size);
+    }
+    for (unsigned ii = 0; ii < nloc; ++ii) {
+      int i_idx = inlist[ff].ilist[ii];
+      for(unsigned jj = 0; jj < inlist[ff].numneigh[ii]; ++jj){
+	int j_idx = inlist[ff].firstneigh[ii][jj];
+	d_nlist_a[ff][i_idx].push_back (j_idx);
+      }
     }
   }
 
-  // set type
-  std::vector<int> d_type (nall);
-  for (int ii = 0; ii < nall; ++ii) {
-    d_type[ii] = type[ii];
-  }
-    
-  // build nlist
-  std::vector<std::vector<int > > d_nlist_a(nloc);
+  // the neighbor statistics are counted by the threads, and added once per thread
+  const int ntypes = sec.size() - 1;
+  const bool b_stat = nlist_stat_enabled();
 
-  assert(nloc == inlist.inum);
-  for (unsigned ii = 0; ii < nloc; ++ii) {
-    d_nlist_a[ii].reserve(max_nbor_size);
-  }
-  for (unsigned ii = 0; ii < nloc; ++ii) {
-    int i_idx = inlist.ilist[ii];
-    for(unsigned jj = 0; jj < inlist.numneigh[ii]; ++jj){
-      int j_idx = inlist.firstneigh[ii][jj];
-      d_nlist_a[i_idx].push_back (j_idx);
-    }
-  }
-    
-#pragma omp parallel for 
-  for (int ii = 0; ii < nloc; ++ii) {
+  // one parallel loop over the atoms of all the frames, the buffers are kept by the threads
+#pragma omp parallel
+  {
     std::vector<int> fmt_nlist_a;
-    int ret = format_nlist_i_cpu(fmt_nlist_a, d_coord3, d_type, ii, d_nlist_a[ii], rcut, sec);
     std::vector<FPTYPE> d_em_a;
     std::vector<FPTYPE> d_em_a_deriv;
-    std::vector<FPTYPE> d_em_r;
-    std::vector<FPTYPE> d_em_r_deriv;
     std::vector<FPTYPE> d_rij_a;
-    env_mat_a_cpu (d_em_a, d_em_a_deriv, d_rij_a, d_coord3, d_type, ii, fmt_nlist_a, sec, rcut_smth, rcut);
+    NlistStat stat (b_stat ? ntypes : 0);
+    std::vector<int> nei_count (ntypes);
+#pragma omp for
+    for (int kk = 0; kk < nframes * nloc; ++kk) {
+      const int ff = kk / nloc;
+      const int ii = kk % nloc;
+      const std::vector<int> & f_type = d_type[ff];
+      int ret = format_nlist_i_cpu(fmt_nlist_a, d_coord3[ff], f_type, ii, d_nlist_a[ff][ii], rcut, sec, b_stat ? &nei_count[0] : NULL);
+      if (b_stat) {
+	stat.natoms ++;
+	for (int tt = 0; tt < ntypes; ++tt) {
+	  stat.nnei_max[tt] = std::max(stat.nnei_max[tt], nei_count[tt]);
+	  stat.nnei_sum[tt] += nei_count[tt];
+	  stat.noverflow[tt] += (nei_count[tt] > sec[tt+1] - sec[tt]);
+	}
+      }
+      env_mat_a_cpu (d_em_a, d_em_a_deriv, d_rij_a, d_coord3[ff], f_type, ii, fmt_nlist_a, sec, rcut_smth, rcut);
 
-    // check sizes
-    assert (d_em_a.size() == nem);
-    assert (d_em_a_deriv.size() == nem * 3);
-    assert (d_rij_a.size() == nnei * 3);
-    assert (fmt_nlist_a.size() == nnei);
-    // record outputs
-    for (int jj = 0; jj < nem; ++jj) {
-      em[ii * nem + jj] = (d_em_a[jj] - avg[d_type[ii] * nem + jj]) / std[d_type[ii] * nem + jj];
-    }
-    for (int jj = 0; jj < nem * 3; ++jj) {
-      em_deriv[ii * nem * 3 + jj] = d_em_a_deriv[jj] / std[d_type[ii] * nem + jj / 3];
-    }
-    for (int jj = 0; jj < nnei * 3; ++jj) {
-      rij[ii * nnei * 3 + jj] = d_rij_a[jj];
+      // check sizes
+      assert (d_em_a.size() == nem);
+      assert (d_em_a_deriv.size() == nem * 3);
+      assert (d_rij_a.size() == nnei * 3);
+      assert (fmt_nlist_a.size() == nnei);
+      // record outputs
+      for (int jj = 0; jj < nem; ++jj) {
+	em[kk * nem + jj] = (d_em_a[jj] - avg[f_type[ii] * nem + jj]) / std[f_type[ii] * nem + jj];
+      }
+      for (int jj = 0; jj < nem * 3; ++jj) {
+	em_deriv[kk * nem * 3 + jj] = d_em_a_deriv[jj] / std[f_type[ii] * nem + jj / 3];
+      }
+      for (int jj = 0; jj < nnei * 3; ++jj) {
+	rij[kk * nnei * 3 + jj] = d_rij_a[jj];
+      }
+      for (int jj = 0; jj < nnei; ++jj) {
+	nlist[kk * nnei + jj] = fmt_nlist_a[jj];
+      }
+      if (descriptor != NULL) {
+	// the descriptor is evaluated from the environment matrix of the atom while it is in cache
+	FPTYPE * out = descriptor + (long long)kk * 4 * last_layer_size;
+	std::fill(out, out + 4 * last_layer_size, (FPTYPE)0.);
+	for (int tt = 0; tt < ntypes; ++tt) {
+	  const int net = type_one_side ? tt : f_type[ii] * ntypes + tt;
+	  const int nvalid = count_nlist_valid(&fmt_nlist_a[sec[tt]], sec[tt+1] - sec[tt]);
+	  tabulate_fusion_atom_cpu(
+	      out, table + (long long)net * nspline * 6 * last_layer_size, table_info, 
+	      em + kk * nem + sec[tt] * 4, sec[tt+1] - sec[tt], nvalid, last_layer_size);
+	}
+      }
     }
-    for (int jj = 0; jj < nnei; ++jj) {
-      nlist[ii * nnei + jj] = fmt_nlist_a[jj];
+    if (b_stat) {
+      for (int tt = 0; tt < ntypes; ++tt) {
+	stat.sel[tt] = sec[tt+1] - sec[tt];
+      }
+      stat.max_nbor_size = max_nbor_size;
+      nlist_stat_add(stat);
     }
   }
 }
@@ -176,6 +273,147 @@ prod_env_mat_r_cpu(
 }
 
 
+// the field direction, an undefined field falls back to the x axis
+template<typename FPTYPE>
+static void
+_ef_direction(
+    FPTYPE * ee,
+    const FPTYPE * ef)
+{
+  if (std::isnan(ef[0]) || std::isnan(ef[1]) || std::isnan(ef[2])) {
+    ee[0] = 1.;
+    ee[1] = ee[2] = 0.;
+  }
+  else {
+    for (int dd = 0; dd < 3; ++dd) {
+      ee[dd] = ef[dd];
+    }
+  }
+}
+
+template<typename FPTYPE>
+void 
+deepmd::
+prod_env_mat_a_ef_cpu(
+    FPTYPE * em, 
+    FPTYPE * em_deriv, 
+    FPTYPE * rij, 
+    int * nlist, 
+    const FPTYPE * coord, 
+    const int * type, 
+    const FPTYPE * ef, 
+    const InputNlist & inlist,
+    const int max_nbor_size,
+    const FPTYPE * avg, 
+    const FPTYPE * std, 
+    const int nloc, 
+    const int nall, 
+    const float rcut, 
+    const float rcut_smth, 
+    const std::vector<int> sec,
+    const int ef_proj) 
+{
+  const int nnei = sec.back();
+  const int nem = nnei * 4;
+
+  std::vector<FPTYPE> d_coord3(coord, coord + nall * 3);
+  std::vector<int> d_type(type, type + nall);
+
+  // build nlist
+  std::vector<std::vector<int > > d_nlist_a(nloc);
+
+  assert(nloc == inlist.inum);
+  for (unsigned ii = 0; ii < nloc; ++ii) {
+    d_nlist_a[ii].reserve(max_nbor_size);
+  }
+  for (unsigned ii = 0; ii < nloc; ++ii) {
+    int i_idx = inlist.ilist[ii];
+    for(unsigned jj = 0; jj < inlist.numneigh[ii]; ++jj){
+      int j_idx = inlist.firstneigh[ii][jj];
+      d_nlist_a[i_idx].push_back (j_idx);
+    }
+  }
+
+#pragma omp parallel
+  {
+    std::vector<int> fmt_nlist_a;
+#pragma omp for 
+    for (int ii = 0; ii < nloc; ++ii) {
+      format_nlist_i_cpu(fmt_nlist_a, d_coord3, d_type, ii, d_nlist_a[ii], rcut, sec);
+      FPTYPE ee[3];
+      _ef_direction(ee, ef + ii * 3);
+      // the projector on the field (ef_proj 1) or on the plane perpendicular to it
+      FPTYPE proj[9];
+      for (int d0 = 0; d0 < 3; ++d0) {
+	for (int d1 = 0; d1 < 3; ++d1) {
+	  proj[d0 * 3 + d1] = ef_proj == 1 ? ee[d0] * ee[d1] : (d0 == d1) - ee[d0] * ee[d1];
+	}
+      }
+      const FPTYPE * i_avg = avg + d_type[ii] * nem;
+      const FPTYPE * i_std = std + d_type[ii] * nem;
+      for (int jj = 0; jj < nnei; ++jj) {
+	const int j_idx = fmt_nlist_a[jj];
+	nlist[ii * nnei + jj] = j_idx;
+	FPTYPE * j_em = em + ii * nem + jj * 4;
+	FPTYPE * j_em_deriv = em_deriv + ii * nem * 3 + jj * 12;
+	FPTYPE * rr = rij + ii * nnei * 3 + jj * 3;
+	if (j_idx < 0) {
+	  for (int kk = 0; kk < 4; ++kk) {
+	    j_em[kk] = - i_avg[jj * 4 + kk] / i_std[jj * 4 + kk];
+	  }
+	  for (int kk = 0; kk < 12; ++kk) {
+	    j_em_deriv[kk] = 0.;
+	  }
+	  for (int dd = 0; dd < 3; ++dd) {
+	    rr[dd] = 0.;
+	  }
+	  continue;
+	}
+	for (int dd = 0; dd < 3; ++dd) {
+	  rr[dd] = d_coord3[j_idx * 3 + dd] - d_coord3[ii * 3 + dd];
+	}
+	FPTYPE nr2 = deepmd::dot3(rr, rr);
+	FPTYPE inr = 1./sqrt(nr2);
+	FPTYPE nr = nr2 * inr;
+	FPTYPE inr2 = inr * inr;
+	FPTYPE inr4 = inr2 * inr2;
+	FPTYPE inr3 = inr4 * nr;
+	FPTYPE sw, dsw;
+	deepmd::spline5_switch(sw, dsw, nr, rcut_smth, rcut);
+	// the values and their derivatives before switching
+	FPTYPE vv[4], dv[12];
+	if (ef_proj == 0) {
+	  FPTYPE rp = deepmd::dot3(rr, ee);
+	  vv[0] = rp * inr2;
+	  for (int d1 = 0; d1 < 3; ++d1) {
+	    dv[d1] = 2. * inr4 * rp * rr[d1] - inr2 * ee[d1];
+	  }
+	}
+	else {
+	  vv[0] = inr;
+	  for (int d1 = 0; d1 < 3; ++d1) {
+	    dv[d1] = rr[d1] * inr3;
+	  }
+	}
+	for (int d0 = 0; d0 < 3; ++d0) {
+	  FPTYPE prr = proj[d0 * 3 + 0] * rr[0] + proj[d0 * 3 + 1] * rr[1] + proj[d0 * 3 + 2] * rr[2];
+	  vv[1 + d0] = prr * inr2;
+	  for (int d1 = 0; d1 < 3; ++d1) {
+	    dv[3 + d0 * 3 + d1] = 2. * inr4 * prr * rr[d1] - inr2 * proj[d0 * 3 + d1];
+	  }
+	}
+	// record outputs
+	for (int kk = 0; kk < 4; ++kk) {
+	  for (int d1 = 0; d1 < 3; ++d1) {
+	    j_em_deriv[kk * 3 + d1] = (dv[kk * 3 + d1] * sw - vv[kk] * dsw * rr[d1] * inr) / i_std[jj * 4 + kk];
+	  }
+	  j_em[kk] = (vv[kk] * sw - i_avg[jj * 4 + kk]) / i_std[jj * 4 + kk];
+	}
+      }
+    }
+  }
+}
+
 template
 void 
 deepmd::
@@ -196,6 +434,27 @@ prod_env_mat_a_cpu<double>(
     const float rcut_smth, 
     const std::vector<int> sec);
 
+template
+void
+deepmd::
+prod_env_mat_a_batch_cpu<double>(
+    double * em, 
+    double * em_deriv, 
+    double * rij, 
+    int * nlist, 
+    const double * const * coord, 
+    const int * const * type, 
+    const InputNlist * inlist,
+    const int * nall,
+    const int nframes,
+    const int max_nbor_size,
+    const double * avg, 
+    const double * std, 
+    const int nloc, 
+    const float rcut, 
+    const float rcut_smth, 
+    const std::vector<int> sec);
+
 template
 void
 deepmd::
@@ -216,6 +475,81 @@ prod_env_mat_a_cpu<float>(
     const float rcut_smth, 
     const std::vector<int> sec);
 
+template
+void
+deepmd::
+prod_env_mat_a_batch_cpu<float>(
+    float * em, 
+    float * em_deriv, 
+    float * rij, 
+    int * nlist, 
+    const float * const * coord, 
+    const int * const * type, 
+    const InputNlist * inlist,
+    const int * nall,
+    const int nframes,
+    const int max_nbor_size,
+    const float * avg, 
+    const float * std, 
+    const int nloc, 
+    const float rcut, 
+    const float rcut_smth, 
+    const std::vector<int> sec);
+
+template
+void
+deepmd::
+prod_env_mat_a_tabulate_batch_cpu<double>(
+    double * descriptor, 
+    double * em, 
+    double * em_deriv, 
+    double * rij, 
+    int * nlist, 
+    const double * const * coord, 
+    const int * const * type, 
+    const InputNlist * inlist,
+    const int * nall,
+    const int nframes,
+    const int max_nbor_size,
+    const double * avg, 
+    const double * std, 
+    const double * table, 
+    const double * table_info, 
+    const int nloc, 
+    const float rcut, 
+    const float rcut_smth, 
+    const std::vector<int> sec,
+    const int nspline,
+    const int last_layer_size,
+    const bool type_one_side);
+
+template
+void
+deepmd::
+prod_env_mat_a_tabulate_batch_cpu<float>(
+    float * descriptor, 
+    float * em, 
+    float * em_deriv, 
+    float * rij, 
+    int * nlist, 
+    const float * const * coord, 
+    const int * const * type, 
+    const InputNlist * inlist,
+    const int * nall,
+    const int nframes,
+    const int max_nbor_size,
+    const float * avg, 
+    const float * std, 
+    const float * table, 
+    const float * table_info, 
+    const int nloc, 
+    const float rcut, 
+    const float rcut_smth, 
+    const std::vector<int> sec,
+    const int nspline,
+    const int last_layer_size,
+    const bool type_one_side);
+
 template
 void
 deepmd::
@@ -256,6 +590,50 @@ prod_env_mat_r_cpu<float>(
     const float rcut_smth, 
     const std::vector<int> sec);
 
+template
+void 
+deepmd::
+prod_env_mat_a_ef_cpu<double>(
+    double * em, 
+    double * em_deriv, 
+    double * rij, 
+    int * nlist, 
+    const double * coord, 
+    const int * type, 
+    const double * ef, 
+    const InputNlist & inlist,
+    const int max_nbor_size,
+    const double * avg, 
+    const double * std, 
+    const int nloc, 
+    const int nall, 
+    const float rcut, 
+    const float rcut_smth, 
+    const std::vector<int> sec,
+    const int ef_proj);
+
+template
+void 
+deepmd::
+prod_env_mat_a_ef_cpu<float>(
+    float * em, 
+    float * em_deriv, 
+    float * rij, 
+    int * nlist, 
+    const float * coord, 
+    const int * type, 
+    const float * ef, 
+    const InputNlist & inlist,
+    const int max_nbor_size,
+    const float * avg, 
+    const float * std, 
+    const int nloc, 
+    const int nall, 
+    const float rcut, 
+    const float rcut_smth, 
+    const std::vector<int> sec,
+    const int ef_proj);
+
 #if GOOGLE_CUDA || TENSORFLOW_USE_ROCM
 void deepmd::env_mat_nbor_update(
     InputNlist &inlist,
@@ -283,7 +661,8 @@ void deepmd::env_mat_nbor_update(
     }
     memcpy_host_to_device(gpu_inlist.ilist, inlist.ilist, inum);
     memcpy_host_to_device(gpu_inlist.numneigh, inlist.numneigh, inum);
-    int _max_nbor_size = max_numneigh(inlist);
+    const int nbor_size = max_numneigh(inlist);
+    int _max_nbor_size = nbor_size;
     if (_max_nbor_size <= 1024) {
       _max_nbor_size = 1024;
     }
@@ -293,6 +672,10 @@ void deepmd::env_mat_nbor_update(
     else {
       _max_nbor_size = 4096;
     }
+    if (nlist_stat_enabled()) {
+      // a growth of the device buffer of the nlist is counted as a retry
+      nlist_stat_add_build(nbor_list_dev != NULL && _max_nbor_size > max_nbor_size, nbor_size);
+    }
     if ( nbor_list_dev == NULL 
       || _max_nbor_size > max_nbor_size 
       || inum > gpu_inlist.inum) 
@@ -1,6 +1,7 @@
 #include <stdexcept>
 #include <cstring>
 #include "prod_force.h"
+#include "fmt_nlist.h"
 #include "errors.h"
 
 inline void
@@ -30,29 +31,44 @@ prod_force_a_cpu(
     const int * nlist, 
     const int nloc, 
     const int nall, 
-    const int nnei) 
+    const int nnei,
+    const std::vector<int> & sec) 
 {
   const int ndescrpt = 4 * nnei;
+  // with the sections of the types, only the valid neighbors of each type are visited
+  const bool b_sec = sec.size() > 1;
+  const int nsec = b_sec ? sec.size() - 1 : 1;
 
   memset(force, 0.0, sizeof(FPTYPE) * nall * 3);
   // compute force of a frame
   for (int i_idx = 0; i_idx < nloc; ++i_idx) {
-    // deriv wrt center atom
-    for (int aa = 0; aa < ndescrpt; ++aa) {
-      force[i_idx * 3 + 0] -= net_deriv[i_idx * ndescrpt + aa] * env_deriv[i_idx * ndescrpt * 3 + aa * 3 + 0];
-      force[i_idx * 3 + 1] -= net_deriv[i_idx * ndescrpt + aa] * env_deriv[i_idx * ndescrpt * 3 + aa * 3 + 1];
-      force[i_idx * 3 + 2] -= net_deriv[i_idx * ndescrpt + aa] * env_deriv[i_idx * ndescrpt * 3 + aa * 3 + 2];
+    // deriv wrt center atom, the env deriv of the padded neighbors is zero
+    if (!b_sec) {
+      for (int aa = 0; aa < ndescrpt; ++aa) {
+	force[i_idx * 3 + 0] -= net_deriv[i_idx * ndescrpt + aa] * env_deriv[i_idx * ndescrpt * 3 + aa * 3 + 0];
+	force[i_idx * 3 + 1] -= net_deriv[i_idx * ndescrpt + aa] * env_deriv[i_idx * ndescrpt * 3 + aa * 3 + 1];
+	force[i_idx * 3 + 2] -= net_deriv[i_idx * ndescrpt + aa] * env_deriv[i_idx * ndescrpt * 3 + aa * 3 + 2];
+      }
     }
     // deriv wrt neighbors
-    for (int jj = 0; jj < nnei; ++jj) {
-      int j_idx = nlist[i_idx * nnei + jj];
-      if (j_idx < 0) continue;
-      int aa_start, aa_end;
-      make_index_range (aa_start, aa_end, jj, nnei);
-      for (int aa = aa_start; aa < aa_end; ++aa) {
-	force[j_idx * 3 + 0] += net_deriv[i_idx * ndescrpt + aa] * env_deriv[i_idx * ndescrpt * 3 + aa * 3 + 0];
-	force[j_idx * 3 + 1] += net_deriv[i_idx * ndescrpt + aa] * env_deriv[i_idx * ndescrpt * 3 + aa * 3 + 1];
-	force[j_idx * 3 + 2] += net_deriv[i_idx * ndescrpt + aa] * env_deriv[i_idx * ndescrpt * 3 + aa * 3 + 2];
+    for (int ss = 0; ss < nsec; ++ss) {
+      const int jj_start = b_sec ? sec[ss] : 0;
+      const int jj_end = b_sec ? sec[ss] + count_nlist_valid(nlist + i_idx * nnei + sec[ss], sec[ss+1] - sec[ss]) : nnei;
+      for (int jj = jj_start; jj < jj_end; ++jj) {
+	int j_idx = nlist[i_idx * nnei + jj];
+	if (j_idx < 0) continue;
+	int aa_start, aa_end;
+	make_index_range (aa_start, aa_end, jj, nnei);
+	for (int aa = aa_start; aa < aa_end; ++aa) {
+	  force[j_idx * 3 + 0] += net_deriv[i_idx * ndescrpt + aa] * env_deriv[i_idx * ndescrpt * 3 + aa * 3 + 0];
+	  force[j_idx * 3 + 1] += net_deriv[i_idx * ndescrpt + aa] * env_deriv[i_idx * ndescrpt * 3 + aa * 3 + 1];
+	  force[j_idx * 3 + 2] += net_deriv[i_idx * ndescrpt + aa] * env_deriv[i_idx * ndescrpt * 3 + aa * 3 + 2];
+	  if (b_sec) {
+	    force[i_idx * 3 + 0] -= net_deriv[i_idx * ndescrpt + aa] * env_deriv[i_idx * ndescrpt * 3 + aa * 3 + 0];
+	    force[i_idx * 3 + 1] -= net_deriv[i_idx * ndescrpt + aa] * env_deriv[i_idx * ndescrpt * 3 + aa * 3 + 1];
+	    force[i_idx * 3 + 2] -= net_deriv[i_idx * ndescrpt + aa] * env_deriv[i_idx * ndescrpt * 3 + aa * 3 + 2];
+	  }
+	}
       }
     }
   }
@@ -68,7 +84,8 @@ prod_force_a_cpu<double>(
     const int * nlist, 
     const int nloc, 
     const int nall, 
-    const int nnei);
+    const int nnei,
+    const std::vector<int> & sec);
 
 template
 void 
@@ -80,7 +97,8 @@ prod_force_a_cpu<float>(
     const int * nlist, 
     const int nloc, 
     const int nall, 
-    const int nnei);
+    const int nnei,
+    const std::vector<int> & sec);
 
 
 template<typename FPTYPE>
@@ -1,8 +1,13 @@
 #include <iostream>
 #include <stdexcept>
 #include <cstring>
+#include <vector>
 #include "prod_virial.h"
+#include "fmt_nlist.h"
 #include "errors.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 inline void 
 make_index_range (
@@ -20,6 +25,44 @@ make_index_range (
   }
 }
 
+inline int
+get_virial_nthreads ()
+{
+#ifdef _OPENMP
+  return omp_get_max_threads();
+#else
+  return 1;
+#endif
+}
+
+inline int
+get_virial_thread_id ()
+{
+#ifdef _OPENMP
+  return omp_get_thread_num();
+#else
+  return 0;
+#endif
+}
+
+// sum the per-thread accumulators in the thread order, so the result does not depend on the scheduling
+template<typename FPTYPE>
+inline void
+reduce_thread_virial (
+    FPTYPE * virial,
+    const std::vector<FPTYPE> & thread_virial,
+    const int nthreads)
+{
+  for (int ii = 0; ii < 9; ++ ii){
+    virial[ii] = 0.;
+  }
+  for (int tt = 0; tt < nthreads; ++tt){
+    for (int ii = 0; ii < 9; ++ ii){
+      virial[ii] += thread_virial[tt * 9 + ii];
+    }
+  }
+}
+
 template<typename FPTYPE>
 void 
 deepmd::
@@ -32,39 +75,61 @@ prod_virial_a_cpu(
     const int * nlist, 
     const int nloc, 
     const int nall, 
-    const int nnei)
+    const int nnei,
+    const std::vector<int> & sec)
 {
   const int ndescrpt = 4 * nnei;
+  // with the sections of the types, only the valid neighbors of each type are visited
+  const bool b_sec = sec.size() > 1;
+  const int nsec = b_sec ? sec.size() - 1 : 1;
+  const int nthreads = get_virial_nthreads();
+  std::vector<FPTYPE> thread_virial(nthreads * 9, (FPTYPE)0.);
 
-  for (int ii = 0; ii < 9; ++ ii){
-    virial[ii] = 0.;
-  }
-  for (int ii = 0; ii < 9 * nall; ++ ii){
-    atom_virial[ii] = 0.;
+  if (atom_virial != NULL) {
+    for (int ii = 0; ii < 9 * nall; ++ ii){
+      atom_virial[ii] = 0.;
+    }
   }
 
   // compute virial of a frame
-  for (int ii = 0; ii < nloc; ++ii){
-    int i_idx = ii;
-
-    // deriv wrt neighbors
-    for (int jj = 0; jj < nnei; ++jj){
-      int j_idx = nlist[i_idx * nnei + jj];
-      if (j_idx < 0) continue;
-      int aa_start, aa_end;
-      make_index_range (aa_start, aa_end, jj, nnei);
-      for (int aa = aa_start; aa < aa_end; ++aa) {
-	FPTYPE pref = -1.0 * net_deriv[i_idx * ndescrpt + aa];
-	for (int dd0 = 0; dd0 < 3; ++dd0){
-	  for (int dd1 = 0; dd1 < 3; ++dd1){
-	    FPTYPE tmp_v = pref * rij[i_idx * nnei * 3 + jj * 3 + dd1] *  env_deriv[i_idx * ndescrpt * 3 + aa * 3 + dd0];
-	    virial[dd0 * 3 + dd1] -= tmp_v;
-	    atom_virial[j_idx * 9 + dd0 * 3 + dd1] -= tmp_v;
+#pragma omp parallel num_threads(nthreads)
+  {
+    FPTYPE vv[9] = {0.};
+#pragma omp for schedule(static)
+    for (int ii = 0; ii < nloc; ++ii){
+      int i_idx = ii;
+
+      // deriv wrt neighbors
+      for (int ss = 0; ss < nsec; ++ss){
+	const int jj_start = b_sec ? sec[ss] : 0;
+	const int jj_end = b_sec ? sec[ss] + count_nlist_valid(nlist + i_idx * nnei + sec[ss], sec[ss+1] - sec[ss]) : nnei;
+	for (int jj = jj_start; jj < jj_end; ++jj){
+	  int j_idx = nlist[i_idx * nnei + jj];
+	  if (j_idx < 0) continue;
+	  int aa_start, aa_end;
+	  make_index_range (aa_start, aa_end, jj, nnei);
+	  for (int aa = aa_start; aa < aa_end; ++aa) {
+	    FPTYPE pref = -1.0 * net_deriv[i_idx * ndescrpt + aa];
+	    for (int dd0 = 0; dd0 < 3; ++dd0){
+	      for (int dd1 = 0; dd1 < 3; ++dd1){
+		FPTYPE tmp_v = pref * rij[i_idx * nnei * 3 + jj * 3 + dd1] *  env_deriv[i_idx * ndescrpt * 3 + aa * 3 + dd0];
+		vv[dd0 * 3 + dd1] -= tmp_v;
+		if (atom_virial != NULL) {
+		  // the neighbors of different atoms may coincide
+#pragma omp atomic
+		  atom_virial[j_idx * 9 + dd0 * 3 + dd1] -= tmp_v;
+		}
+	      }
+	    }
 	  }
 	}
       }
     }
-  }  
+    for (int dd = 0; dd < 9; ++dd){
+      thread_virial[get_virial_thread_id() * 9 + dd] = vv[dd];
+    }
+  }
+  reduce_thread_virial (virial, thread_virial, nthreads);
 }
 
 template
@@ -79,7 +144,8 @@ prod_virial_a_cpu<double>(
     const int * nlist, 
     const int nloc, 
     const int nall, 
-    const int nnei) ;
+    const int nnei,
+    const std::vector<int> & sec) ;
 
 template
 void 
@@ -93,7 +159,8 @@ prod_virial_a_cpu<float>(
     const int * nlist, 
     const int nloc, 
     const int nall, 
-    const int nnei) ;
+    const int nnei,
+    const std::vector<int> & sec) ;
 
 
 template<typename FPTYPE>
@@ -111,32 +178,46 @@ prod_virial_r_cpu(
     const int nnei)
 {
   const int ndescrpt = nnei;
+  const int nthreads = get_virial_nthreads();
+  std::vector<FPTYPE> thread_virial(nthreads * 9, (FPTYPE)0.);
 
-  for (int ii = 0; ii < 9; ++ ii){
-    virial[ii] = 0.;
-  }
-  for (int ii = 0; ii < 9 * nall; ++ ii){
-    atom_virial[ii] = 0.;
+  if (atom_virial != NULL) {
+    for (int ii = 0; ii < 9 * nall; ++ ii){
+      atom_virial[ii] = 0.;
+    }
   }
 
   // compute virial of a frame
-  for (int ii = 0; ii < nloc; ++ii){
-    int i_idx = ii;
-
-    // deriv wrt neighbors
-    for (int jj = 0; jj < nnei; ++jj){
-      int j_idx = nlist[i_idx * nnei + jj];
-      if (j_idx < 0) continue;
-      FPTYPE pref = -1.0 * net_deriv[i_idx * ndescrpt + jj];
-      for (int dd0 = 0; dd0 < 3; ++dd0){
-	for (int dd1 = 0; dd1 < 3; ++dd1){
-	  FPTYPE tmp_v = pref * rij[i_idx * nnei * 3 + jj * 3 + dd1] *  env_deriv[i_idx * ndescrpt * 3 + jj * 3 + dd0];
-	  virial[dd0 * 3 + dd1] -= tmp_v;
-	  atom_virial[j_idx * 9 + dd0 * 3 + dd1] -= tmp_v;
+#pragma omp parallel num_threads(nthreads)
+  {
+    FPTYPE vv[9] = {0.};
+#pragma omp for schedule(static)
+    for (int ii = 0; ii < nloc; ++ii){
+      int i_idx = ii;
+
+      // deriv wrt neighbors
+      for (int jj = 0; jj < nnei; ++jj){
+	int j_idx = nlist[i_idx * nnei + jj];
+	if (j_idx < 0) continue;
+	FPTYPE pref = -1.0 * net_deriv[i_idx * ndescrpt + jj];
+	for (int dd0 = 0; dd0 < 3; ++dd0){
+	  for (int dd1 = 0; dd1 < 3; ++dd1){
+	    FPTYPE tmp_v = pref * rij[i_idx * nnei * 3 + jj * 3 + dd1] *  env_deriv[i_idx * ndescrpt * 3 + jj * 3 + dd0];
+	    vv[dd0 * 3 + dd1] -= tmp_v;
+	    if (atom_virial != NULL) {
+	      // the neighbors of different atoms may coincide
+#pragma omp atomic
+	      atom_virial[j_idx * 9 + dd0 * 3 + dd1] -= tmp_v;
+	    }
+	  }
 	}
       }
     }
+    for (int dd = 0; dd < 9; ++dd){
+      thread_virial[get_virial_thread_id() * 9 + dd] = vv[dd];
+    }
   }
+  reduce_thread_virial (virial, thread_virial, nthreads);
 }
 
 template
@@ -159,3 +159,83 @@ prod_virial_grad_r_cpu<float>(
     const int nloc,
     const int nnei);
 
+
+template<typename FPTYPE>
+void 
+deepmd::
+prod_force_virial_grad_a_cpu(
+    FPTYPE * grad_net,
+    const FPTYPE * grad_force,
+    const FPTYPE * grad_virial,
+    const FPTYPE * env_deriv,
+    const FPTYPE * rij,
+    const int * nlist,
+    const int nloc,
+    const int nnei)
+{
+  const int ndescrpt = nnei * 4;
+
+  // compute grad of one frame, each atom only writes its own grad_net
+#pragma omp parallel for schedule(static)
+  for (int ii = 0; ii < nloc; ++ii){
+    int i_idx = ii;
+    FPTYPE * grad_net_i = grad_net + i_idx * ndescrpt;
+    const FPTYPE * env_deriv_i = env_deriv + i_idx * ndescrpt * 3;
+    const FPTYPE * grad_force_i = grad_force + i_idx * 3;
+
+    for (int jj = 0; jj < nnei; ++jj){
+      int j_idx = nlist[i_idx * nnei + jj];
+      if (j_idx >= nloc) j_idx = j_idx % nloc;
+      // the deriv wrt center atom applies to all the neighbors, 
+      // the deriv wrt the neighbor and the virial only to the real ones
+      FPTYPE gg[3] = {
+	- grad_force_i[0], 
+	- grad_force_i[1], 
+	- grad_force_i[2]
+      };
+      if (j_idx >= 0) {
+	const FPTYPE * rij_j = rij + i_idx * nnei * 3 + jj * 3;
+	for (int dd0 = 0; dd0 < 3; ++dd0){
+	  gg[dd0] += grad_force[j_idx * 3 + dd0];
+	  for (int dd1 = 0; dd1 < 3; ++dd1){
+	    gg[dd0] += grad_virial[dd0 * 3 + dd1] * rij_j[dd1];
+	  }
+	}
+      }
+      int aa_start, aa_end;
+      make_index_range (aa_start, aa_end, jj, nnei);
+      for (int aa = aa_start; aa < aa_end; ++aa){
+	grad_net_i[aa] = 
+	    gg[0] * env_deriv_i[aa * 3 + 0] 
+	    + gg[1] * env_deriv_i[aa * 3 + 1] 
+	    + gg[2] * env_deriv_i[aa * 3 + 2];
+      }
+    }
+  }
+}
+
+template
+void 
+deepmd::
+prod_force_virial_grad_a_cpu<double>(
+    double * grad_net,
+    const double * grad_force,
+    const double * grad_virial,
+    const double * env_deriv,
+    const double * rij,
+    const int * nlist,
+    const int nloc,
+    const int nnei);
+
+template
+void 
+deepmd::
+prod_force_virial_grad_a_cpu<float>(
+    float * grad_net,
+    const float * grad_force,
+    const float * grad_virial,
+    const float * env_deriv,
+    const float * rij,
+    const int * nlist,
+    const int nloc,
+    const int nnei);
@@ -1,5 +1,6 @@
 #include <iostream>
 #include <cmath>
+#include <vector>
 #include "soft_min_switch.h"
 #include "switcher.h"
 
@@ -15,66 +16,56 @@ void deepmd::soft_min_switch_cpu(
     const FPTYPE & rmin,
     const FPTYPE & rmax)
 {
-  // fill results with 0
-  for (int ii = 0; ii < nloc; ++ii){
-    sw_value[ii] = 0;
-  }
-  for (int ii = 0; ii < nloc * nnei; ++ii){
-    sw_deriv[ii * 3 + 0] = 0;
-    sw_deriv[ii * 3 + 1] = 0;
-    sw_deriv[ii * 3 + 2] = 0;
-  }
   // compute force of a frame      
-  for (int ii = 0; ii < nloc; ++ii){
-    int i_idx = ii;
-    FPTYPE aa = 0;
-    FPTYPE bb = 0;
-    for (int jj = 0; jj < nnei; ++jj){
-      int j_idx = nlist [i_idx * nnei + jj];
-      if (j_idx < 0) continue;
-      int rij_idx_shift = (i_idx * nnei + jj) * 3;
-      FPTYPE dr[3] = {
-	rij[rij_idx_shift + 0],
-	rij[rij_idx_shift + 1],
-	rij[rij_idx_shift + 2]
-      };
-      FPTYPE rr2 = dr[0] * dr[0] + dr[1] * dr[1] + dr[2] * dr[2];
-      FPTYPE rr = sqrt(rr2);
-      FPTYPE ee = exp(-rr / alpha);
-      aa += ee;
-      bb += rr * ee;
-    }
-    FPTYPE smin = bb / aa;
-    FPTYPE vv, dd;
-    spline5_switch(vv, dd, smin, rmin, rmax);
-    // value of switch
-    sw_value[i_idx] = vv;
-    // deriv of switch distributed as force
-    for (int jj = 0; jj < nnei; ++jj){
-      int j_idx = nlist [i_idx * nnei + jj];
-      if (j_idx < 0) continue;
-      int rij_idx_shift = (ii * nnei + jj) * 3;
-      FPTYPE dr[3] = {
-	rij[rij_idx_shift + 0],
-	rij[rij_idx_shift + 1],
-	rij[rij_idx_shift + 2]
-      };
-      FPTYPE rr2 = dr[0] * dr[0] + dr[1] * dr[1] + dr[2] * dr[2];
-      FPTYPE rr = sqrt(rr2);
-      FPTYPE ee = exp(-rr / alpha);
-      FPTYPE pref_c = (1./rr - 1./alpha) * ee ;
-      FPTYPE pref_d = 1./(rr * alpha) * ee;
-      FPTYPE ts;
-      ts = dd / (aa * aa) * (aa * pref_c + bb * pref_d);
-      sw_deriv[rij_idx_shift + 0] += ts * dr[0];
-      sw_deriv[rij_idx_shift + 1] += ts * dr[1];
-      sw_deriv[rij_idx_shift + 2] += ts * dr[2];
-      // std::cout << ii << " "  << jj << " " << j_idx << "   "
-      //      << vv << " " 
-      //      << sw_deriv[rij_idx_shift+0) << " " 
-      //      << sw_deriv[rij_idx_shift+1) << " " 
-      //      << sw_deriv[rij_idx_shift+2) << " " 
-      //      << std::endl;
+#pragma omp parallel
+  {
+    // rr and exp(-rr/alpha) of the neighbors of one atom, 
+    // computed once and reused by the derivative
+    std::vector<FPTYPE> rr_buff(nnei), ee_buff(nnei);
+    FPTYPE * rr_ = &rr_buff[0];
+    FPTYPE * ee_ = &ee_buff[0];
+#pragma omp for schedule(static)
+    for (int ii = 0; ii < nloc; ++ii){
+      int i_idx = ii;
+      const int * nlist_i = nlist + i_idx * nnei;
+      const FPTYPE * rij_i = rij + i_idx * nnei * 3;
+      FPTYPE * sw_deriv_i = sw_deriv + i_idx * nnei * 3;
+      FPTYPE aa = 0;
+      FPTYPE bb = 0;
+#pragma omp simd reduction(+:aa,bb)
+      for (int jj = 0; jj < nnei; ++jj){
+	FPTYPE rr2 = rij_i[jj * 3 + 0] * rij_i[jj * 3 + 0] 
+	    + rij_i[jj * 3 + 1] * rij_i[jj * 3 + 1] 
+	    + rij_i[jj * 3 + 2] * rij_i[jj * 3 + 2];
+	FPTYPE rr = sqrt(rr2);
+	// padded neighbors do not contribute
+	FPTYPE ee = nlist_i[jj] < 0 ? (FPTYPE)0. : exp(-rr / alpha);
+	rr_[jj] = rr;
+	ee_[jj] = ee;
+	aa += ee;
+	bb += rr * ee;
+      }
+      FPTYPE smin = bb / aa;
+      FPTYPE vv, dd;
+      spline5_switch(vv, dd, smin, rmin, rmax);
+      // value of switch
+      sw_value[i_idx] = vv;
+      // deriv of switch distributed as force
+      const FPTYPE pref = dd / (aa * aa);
+#pragma omp simd
+      for (int jj = 0; jj < nnei; ++jj){
+	FPTYPE ts = 0;
+	if (nlist_i[jj] >= 0) {
+	  FPTYPE rr = rr_[jj];
+	  FPTYPE ee = ee_[jj];
+	  FPTYPE pref_c = (1./rr - 1./alpha) * ee ;
+	  FPTYPE pref_d = 1./(rr * alpha) * ee;
+	  ts = pref * (aa * pref_c + bb * pref_d);
+	}
+	sw_deriv_i[jj * 3 + 0] = ts * rij_i[jj * 3 + 0];
+	sw_deriv_i[jj * 3 + 1] = ts * rij_i[jj * 3 + 1];
+	sw_deriv_i[jj * 3 + 2] = ts * rij_i[jj * 3 + 2];
+      }
     }
   }
 }
@@ -24,18 +24,25 @@ void deepmd::soft_min_switch_force_cpu(
     force[i_idx * 3 + 2] = 0;
   }
   // compute force of a frame
+#pragma omp parallel for schedule(static)
   for (int ii = 0; ii < nloc; ++ii){
     int i_idx = ii;	
+    FPTYPE fi[3] = {0, 0, 0};
     for (int jj = 0; jj < nnei; ++jj){	  
       int j_idx = nlist[i_idx * nnei + jj];
       if (j_idx < 0) continue;
       int rij_idx_shift = (ii * nnei + jj) * 3;
-      force[i_idx * 3 + 0] += du[i_idx] * sw_deriv[rij_idx_shift + 0];
-      force[i_idx * 3 + 1] += du[i_idx] * sw_deriv[rij_idx_shift + 1];
-      force[i_idx * 3 + 2] += du[i_idx] * sw_deriv[rij_idx_shift + 2];
-      force[j_idx * 3 + 0] -= du[i_idx] * sw_deriv[rij_idx_shift + 0];
-      force[j_idx * 3 + 1] -= du[i_idx] * sw_deriv[rij_idx_shift + 1];
-      force[j_idx * 3 + 2] -= du[i_idx] * sw_deriv[rij_idx_shift + 2];
+      for (int dd = 0; dd < 3; ++dd){
+	FPTYPE tmp_f = du[i_idx] * sw_deriv[rij_idx_shift + dd];
+	fi[dd] += tmp_f;
+	// the neighbors of different atoms may coincide
+#pragma omp atomic
+	force[j_idx * 3 + dd] -= tmp_f;
+      }
+    }
+    for (int dd = 0; dd < 3; ++dd){
+#pragma omp atomic
+      force[i_idx * 3 + dd] += fi[dd];
     }
   }  
 }
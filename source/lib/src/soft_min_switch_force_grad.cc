@@ -21,7 +21,8 @@ void deepmd::soft_min_switch_force_grad_cpu(
     grad_net[ii] = 0;
   }      
 
-  // compute grad of one frame
+  // compute grad of one frame, each atom only writes its own grad_net
+#pragma omp parallel for schedule(static)
   for (int ii = 0; ii < nloc; ++ii){
     int i_idx = ii;
     // deriv wrt center atom	
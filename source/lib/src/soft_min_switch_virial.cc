@@ -19,14 +19,12 @@ void deepmd::soft_min_switch_virial_cpu(
 //	sw_deriv :	nloc * nnei * 3
 //
 {
-  for (int ii = 0; ii < 9; ++ ii){
-    virial[ii] = 0.;
-  }
   for (int ii = 0; ii < 9 * nall; ++ ii){
     atom_virial[ii] = 0.;
   }
-
+  FPTYPE vv[9] = {0.};
   // compute virial of a frame
+#pragma omp parallel for schedule(static) reduction(+:vv[:9])
   for (int ii = 0; ii < nloc; ++ii){
     int i_idx = ii;
     // loop over neighbors
@@ -37,15 +35,19 @@ void deepmd::soft_min_switch_virial_cpu(
       for (int dd0 = 0; dd0 < 3; ++dd0){
 	for (int dd1 = 0; dd1 < 3; ++dd1){
 	  FPTYPE tmp_v = du[i_idx] * sw_deriv[rij_idx_shift + dd0] * rij[rij_idx_shift + dd1];
-	  virial[dd0 * 3 + dd1] -= tmp_v;		  
+	  vv[dd0 * 3 + dd1] -= tmp_v;		  
+	  // the neighbors of different atoms may coincide
+#pragma omp atomic
 	  atom_virial[j_idx * 9 + dd0 * 3 + dd1] -= tmp_v;
 	}
       }
     }
   }  
+  for (int ii = 0; ii < 9; ++ ii){
+    virial[ii] = vv[ii];
+  }
 }
 
-
 template
 void deepmd::soft_min_switch_virial_cpu<double>(
     double * virial, 
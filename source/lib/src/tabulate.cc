@@ -2,7 +2,13 @@
 #include <cassert>
 #include <iostream>
 #include <string.h>
+#include <cmath>
+#include <algorithm>
 #include "tabulate.h"
+#include "fmt_nlist.h"
+#include "device.h"
+
+#define GGELU 0.044715
 /*
     This inline function was designed to get the table info and bias value for current input xx!
     lower:      indicate the lower boundary of the first table;
@@ -256,9 +262,397 @@ void deepmd::tabulate_fusion_grad_grad_cpu(
   }
 }
 
+template<typename FPTYPE>
+void deepmd::tabulate_fusion_atom_cpu(
+    FPTYPE * out,
+    const FPTYPE * table,
+    const FPTYPE * table_info,
+    const FPTYPE * em,
+    const int nnei,
+    const int nvalid,
+    const int last_layer_size)
+{
+  const FPTYPE lower   = table_info[0];
+  const FPTYPE upper   = table_info[1];
+  const FPTYPE _max    = table_info[2];
+  const FPTYPE stride0 = table_info[3];
+  const FPTYPE stride1 = table_info[4];
+  // the padded neighbors share the environment matrix of the first one, they are evaluated once
+  const int nloop = std::min(nvalid + 1, nnei);
+  for (int jj = 0; jj < nloop; jj++) {
+    const FPTYPE * ll = em + jj * 4;
+    FPTYPE xx = ll[0];
+    const FPTYPE scale = (jj == nvalid) ? (FPTYPE)(nnei - jj) : (FPTYPE)1.;
+    int table_idx = 0;
+    locate_xx(lower, upper, _max, stride0, stride1, xx, table_idx);
+    const FPTYPE * coef = table + table_idx * last_layer_size * 6;
+    for (int kk = 0; kk < last_layer_size; kk++) {
+      const FPTYPE * aa = coef + 6 * kk;
+      FPTYPE var = scale * (aa[0] + (aa[1] + (aa[2] + (aa[3] + (aa[4] + aa[5] * xx) * xx) * xx) * xx) * xx);
+      out[0 * last_layer_size + kk] += var * ll[0];
+      out[1 * last_layer_size + kk] += var * ll[1];
+      out[2 * last_layer_size + kk] += var * ll[2];
+      out[3 * last_layer_size + kk] += var * ll[3];
+    }
+  }
+}
+
+template<typename FPTYPE>
+void deepmd::tabulate_fusion_grad_atom_cpu(
+    FPTYPE * dy_dem,
+    const FPTYPE * table,
+    const FPTYPE * table_info,
+    const FPTYPE * em,
+    const FPTYPE * dy,
+    const int nnei,
+    const int nvalid,
+    const int last_layer_size)
+{
+  memset(dy_dem, 0.0, sizeof(FPTYPE) * nnei * 4);
+  const FPTYPE lower   = table_info[0];
+  const FPTYPE upper   = table_info[1];
+  const FPTYPE _max    = table_info[2];
+  const FPTYPE stride0 = table_info[3];
+  const FPTYPE stride1 = table_info[4];
+  FPTYPE ll[4];
+  FPTYPE rr[4];
+  // the gradient of the padded neighbors is put on the first one
+  const int nloop = std::min(nvalid + 1, nnei);
+  for (int jj = 0; jj < nloop; jj++) {
+    ll[0] = em[jj * 4 + 0];
+    ll[1] = em[jj * 4 + 1];
+    ll[2] = em[jj * 4 + 2];
+    ll[3] = em[jj * 4 + 3];
+    FPTYPE xx = ll[0];
+    const FPTYPE scale = (jj == nvalid) ? (FPTYPE)(nnei - jj) : (FPTYPE)1.;
+    int table_idx = 0;
+    locate_xx(lower, upper, _max, stride0, stride1, xx, table_idx);
+    const FPTYPE * coef = table + table_idx * last_layer_size * 6;
+    FPTYPE grad = 0.0;
+    FPTYPE * dd = dy_dem + jj * 4;
+    for (int kk = 0; kk < last_layer_size; kk++) {
+      rr[0] = dy[0 * last_layer_size + kk];
+      rr[1] = dy[1 * last_layer_size + kk];
+      rr[2] = dy[2 * last_layer_size + kk];
+      rr[3] = dy[3 * last_layer_size + kk];
+      const FPTYPE * aa = coef + 6 * kk;
+      FPTYPE res = aa[0] + (aa[1] + (aa[2] + (aa[3] + (aa[4] + aa[5] * xx) * xx) * xx) * xx) * xx;
+      grad += (aa[1] + (2 * aa[2] + (3 * aa[3] + (4 * aa[4] + 5 * aa[5] * xx) * xx) * xx) * xx) * dot(ll, rr);
+      dd[0] += res * rr[0];
+      dd[1] += res * rr[1];
+      dd[2] += res * rr[2];
+      dd[3] += res * rr[3];
+    }
+    for (int dd_idx = 0; dd_idx < 4; dd_idx++) {
+      dd[dd_idx] *= scale;
+    }
+    dd[0] += scale * grad;
+  }
+}
+
+template<typename FPTYPE>
+void deepmd::tabulate_fusion_grad_grad_atom_cpu(
+    FPTYPE * dz_dy,
+    const FPTYPE * table,
+    const FPTYPE * table_info,
+    const FPTYPE * em,
+    const FPTYPE * dz_dy_dem,
+    const int nnei,
+    const int nvalid,
+    const int last_layer_size)
+{
+  const FPTYPE lower   = table_info[0];
+  const FPTYPE upper   = table_info[1];
+  const FPTYPE _max    = table_info[2];
+  const FPTYPE stride0 = table_info[3];
+  const FPTYPE stride1 = table_info[4];
+  // only the first padded neighbor carries a gradient in tabulate_fusion_grad_atom_cpu
+  const int nloop = std::min(nvalid + 1, nnei);
+  for (int jj = 0; jj < nloop; jj++) {
+    const FPTYPE * ll = em + jj * 4;
+    const FPTYPE * hh = dz_dy_dem + jj * 4;
+    FPTYPE xx = ll[0];
+    const FPTYPE scale = (jj == nvalid) ? (FPTYPE)(nnei - jj) : (FPTYPE)1.;
+    int table_idx = 0;
+    locate_xx(lower, upper, _max, stride0, stride1, xx, table_idx);
+    const FPTYPE * coef = table + table_idx * last_layer_size * 6;
+    for (int kk = 0; kk < last_layer_size; kk++) {
+      const FPTYPE * aa = coef + 6 * kk;
+      FPTYPE var = scale * (aa[0] + (aa[1] + (aa[2] + (aa[3] + (aa[4] + aa[5] * xx) * xx) * xx) * xx) * xx);
+      FPTYPE var_grad = scale * hh[0] * (aa[1] + (2 * aa[2] + (3 * aa[3] + (4 * aa[4] + 5 * aa[5] * xx) * xx) * xx) * xx);
+      dz_dy[0 * last_layer_size + kk] += var * hh[0] + var_grad * ll[0];
+      dz_dy[1 * last_layer_size + kk] += var * hh[1] + var_grad * ll[1];
+      dz_dy[2 * last_layer_size + kk] += var * hh[2] + var_grad * ll[2];
+      dz_dy[3 * last_layer_size + kk] += var * hh[3] + var_grad * ll[3];
+    }
+  }
+}
+
+template<typename FPTYPE>
+void deepmd::tabulate_fusion_se_a_grad_cpu(
+    FPTYPE * dy_dem,
+    const FPTYPE * table,
+    const FPTYPE * table_info,
+    const FPTYPE * em,
+    const int * nlist,
+    const int * type,
+    const FPTYPE * dy,
+    const int nloc,
+    const int nspline,
+    const int last_layer_size,
+    const std::vector<int> & sec,
+    const bool type_one_side)
+{
+  const int ntypes = sec.size() - 1;
+  const int nnei = sec.back();
+  const long long table_size = (long long)nspline * 6 * last_layer_size;
+  #pragma omp parallel for
+  for (int ii = 0; ii < nloc; ii++) {
+    for (int tt = 0; tt < ntypes; tt++) {
+      const int net = type_one_side ? tt : type[ii] * ntypes + tt;
+      const int nvalid = count_nlist_valid(nlist + ii * nnei + sec[tt], sec[tt + 1] - sec[tt]);
+      tabulate_fusion_grad_atom_cpu(
+          dy_dem + (ii * nnei + sec[tt]) * 4,
+          table + net * table_size, table_info,
+          em + (ii * nnei + sec[tt]) * 4,
+          dy + ii * 4 * last_layer_size,
+          sec[tt + 1] - sec[tt], nvalid, last_layer_size);
+    }
+  }
+}
+
+template<typename FPTYPE>
+void deepmd::tabulate_fusion_se_a_grad_grad_cpu(
+    FPTYPE * dz_dy,
+    const FPTYPE * table,
+    const FPTYPE * table_info,
+    const FPTYPE * em,
+    const int * nlist,
+    const int * type,
+    const FPTYPE * dz_dy_dem,
+    const int nloc,
+    const int nspline,
+    const int last_layer_size,
+    const std::vector<int> & sec,
+    const bool type_one_side)
+{
+  memset(dz_dy, 0.0, sizeof(FPTYPE) * nloc * 4 * last_layer_size);
+  const int ntypes = sec.size() - 1;
+  const int nnei = sec.back();
+  const long long table_size = (long long)nspline * 6 * last_layer_size;
+  #pragma omp parallel for
+  for (int ii = 0; ii < nloc; ii++) {
+    for (int tt = 0; tt < ntypes; tt++) {
+      const int net = type_one_side ? tt : type[ii] * ntypes + tt;
+      const int nvalid = count_nlist_valid(nlist + ii * nnei + sec[tt], sec[tt + 1] - sec[tt]);
+      tabulate_fusion_grad_grad_atom_cpu(
+          dz_dy + ii * 4 * last_layer_size,
+          table + net * table_size, table_info,
+          em + (ii * nnei + sec[tt]) * 4,
+          dz_dy_dem + (ii * nnei + sec[tt]) * 4,
+          sec[tt + 1] - sec[tt], nvalid, last_layer_size);
+    }
+  }
+}
+
+template <typename FPTYPE>
+inline FPTYPE activation(
+    const FPTYPE xbar, 
+    const int functype)
+{
+  switch (functype) {
+    case 1:
+      return tanh(xbar);
+    case 2:
+      return xbar * 0.5 * (1.0 + tanh(SQRT_2_PI * (xbar + GGELU * xbar * xbar * xbar)));
+    default:
+      return 0;
+  }
+}
+
+// the derivatives of the activation, yy is the activation of xbar
+template <typename FPTYPE>
+inline FPTYPE activation_grad(
+    const FPTYPE xbar, 
+    const FPTYPE yy, 
+    const int functype)
+{
+  switch (functype) {
+    case 1:
+      return 1 - yy * yy;
+    case 2: {
+      const FPTYPE var = tanh(SQRT_2_PI * (xbar + GGELU * xbar * xbar * xbar));
+      return 0.5 * SQRT_2_PI * xbar * (1 - var * var) * (3 * GGELU * xbar * xbar + 1) + 0.5 * var + 0.5;
+    }
+    default:
+      return -1;
+  }
+}
+
+template <typename FPTYPE>
+inline FPTYPE activation_grad_grad(
+    const FPTYPE xbar, 
+    const FPTYPE yy, 
+    const int functype)
+{
+  switch (functype) {
+    case 1:
+      return -2 * yy * (1 - yy * yy);
+    case 2: {
+      const FPTYPE var1 = tanh(SQRT_2_PI * (xbar + GGELU * xbar * xbar * xbar));
+      const FPTYPE var2 = SQRT_2_PI * (1 - var1 * var1) * (3 * GGELU * xbar * xbar + 1);
+      return 3 * GGELU * SQRT_2_PI * xbar * xbar * (1 - var1 * var1) - SQRT_2_PI * xbar * var2 * (3 * GGELU * xbar * xbar + 1) * var1 + var2;
+    }
+    default:
+      return -1;
+  }
+}
+
+/*
+    Evaluate the embedding net `net` and its first and second derivatives at the input xx.
+    out:        3 x layer_size[nlayer], the value, the first and the second derivatives
+    buff:       6 x the maximal layer size, the scratch of the layers
+*/
+template <typename FPTYPE>
+static void tabulate_node(
+    FPTYPE * out,
+    FPTYPE * buff,
+    const FPTYPE xx,
+    const FPTYPE * const * matrix,
+    const FPTYPE * const * bias,
+    const int * layer_size,
+    const int nlayer,
+    const int max_size,
+    const int net,
+    const int functype)
+{
+  FPTYPE * yy = buff, * dy = buff + max_size, * dy2 = buff + 2 * max_size;
+  FPTYPE * zz = buff + 3 * max_size, * dz = buff + 4 * max_size, * dz2 = buff + 5 * max_size;
+  yy[0] = xx;
+  dy[0] = 1;
+  dy2[0] = 0;
+  for (int ll = 0; ll < nlayer; ll++) {
+    const int size = layer_size[ll];
+    const int width = layer_size[ll + 1];
+    const FPTYPE * ww = matrix[ll] + net * size * width;
+    const FPTYPE * bb = bias[ll] + net * width;
+    for (int ii = 0; ii < width; ii++) {
+      zz[ii] = bb[ii];
+      dz[ii] = 0;
+      dz2[ii] = 0;
+    }
+    for (int jj = 0; jj < size; jj++) {
+      for (int ii = 0; ii < width; ii++) {
+        zz[ii] += yy[jj] * ww[jj * width + ii];
+        dz[ii] += dy[jj] * ww[jj * width + ii];
+        dz2[ii] += dy2[jj] * ww[jj * width + ii];
+      }
+    }
+    for (int ii = 0; ii < width; ii++) {
+      const FPTYPE act = activation(zz[ii], functype);
+      const FPTYPE grad = activation_grad(zz[ii], act, functype);
+      const FPTYPE grad_grad = activation_grad_grad(zz[ii], act, functype);
+      dz2[ii] = grad_grad * dz[ii] * dz[ii] + grad * dz2[ii];
+      dz[ii] = grad * dz[ii];
+      zz[ii] = act;
+    }
+    // the resnet of the embedding net
+    if (width == size || width == 2 * size) {
+      for (int ii = 0; ii < width; ii++) {
+        zz[ii] += yy[ii % size];
+        dz[ii] += dy[ii % size];
+        dz2[ii] += dy2[ii % size];
+      }
+    }
+    std::swap(yy, zz);
+    std::swap(dy, dz);
+    std::swap(dy2, dz2);
+  }
+  const int last_layer_size = layer_size[nlayer];
+  for (int ii = 0; ii < last_layer_size; ii++) {
+    out[ii] = yy[ii];
+    out[last_layer_size + ii] = dy[ii];
+    out[2 * last_layer_size + ii] = dy2[ii];
+  }
+}
+
+template<typename FPTYPE>
+void deepmd::build_tabulate_table_cpu(
+    FPTYPE * table,
+    const FPTYPE * const * matrix,
+    const FPTYPE * const * bias,
+    const int * layer_size,
+    const FPTYPE * table_info,
+    const int nlayer,
+    const int nnet,
+    const int nspline,
+    const int functype)
+{
+  const FPTYPE lower   = table_info[0];
+  const FPTYPE upper   = table_info[1];
+  const FPTYPE stride0 = table_info[3];
+  const FPTYPE stride1 = table_info[4];
+  // the nodes are placed as they are located by locate_xx
+  const int first_stride = int((upper - lower) / stride0);
+  const int last_layer_size = layer_size[nlayer];
+  const int max_size = *std::max_element(layer_size, layer_size + nlayer + 1);
+  #pragma omp parallel
+  {
+    std::vector<FPTYPE> buff(6 * max_size);
+    std::vector<FPTYPE> nodes(6 * last_layer_size);
+    FPTYPE * node_lo = &nodes[0];
+    FPTYPE * node_hi = &nodes[3 * last_layer_size];
+    // the static schedule hands out consecutive intervals,
+    // so the upper node of an interval is the lower node of the next one
+    long long cached_node = -1;
+    #pragma omp for schedule(static) collapse(2)
+    for (int nn = 0; nn < nnet; nn++) {
+      for (int jj = 0; jj < nspline; jj++) {
+        const long long node_idx = (long long)nn * (nspline + 1) + jj;
+        if (node_idx == cached_node) {
+          std::swap(node_lo, node_hi);
+        }
+        else {
+          const FPTYPE xx = jj < first_stride ? lower + jj * stride0 : upper + (jj - first_stride) * stride1;
+          tabulate_node(node_lo, &buff[0], xx, matrix, bias, layer_size, nlayer, max_size, nn, functype);
+        }
+        const FPTYPE xx = jj + 1 < first_stride ? lower + (jj + 1) * stride0 : upper + (jj + 1 - first_stride) * stride1;
+        tabulate_node(node_hi, &buff[0], xx, matrix, bias, layer_size, nlayer, max_size, nn, functype);
+        cached_node = node_idx + 1;
+        const FPTYPE tt = jj < first_stride ? stride0 : stride1;
+        FPTYPE * coef = table + ((long long)nn * nspline + jj) * last_layer_size * 6;
+        for (int kk = 0; kk < last_layer_size; kk++) {
+          const FPTYPE v0 = node_lo[kk], v1 = node_hi[kk];
+          const FPTYPE d0 = node_lo[last_layer_size + kk], d1 = node_hi[last_layer_size + kk];
+          const FPTYPE s0 = node_lo[2 * last_layer_size + kk], s1 = node_hi[2 * last_layer_size + kk];
+          const FPTYPE hh = v1 - v0;
+          coef[kk * 6 + 0] = v0;
+          coef[kk * 6 + 1] = d0;
+          coef[kk * 6 + 2] = 0.5 * s0;
+          coef[kk * 6 + 3] = (1 / (2 * tt * tt * tt)) * (20 * hh - (8 * d1 + 12 * d0) * tt - (3 * s0 - s1) * tt * tt);
+          coef[kk * 6 + 4] = (1 / (2 * tt * tt * tt * tt)) * (-30 * hh + (14 * d1 + 16 * d0) * tt + (3 * s0 - 2 * s1) * tt * tt);
+          coef[kk * 6 + 5] = (1 / (2 * tt * tt * tt * tt * tt)) * (12 * hh - 6 * (d1 + d0) * tt + (s1 - s0) * tt * tt);
+        }
+      }
+    }
+  }
+}
+
 template void deepmd::tabulate_fusion_cpu<float>(float * out, const float * table, const float * table_info, const float * em_x, const float * em, const int nloc, const int nnei, const int last_layer_size);
 template void deepmd::tabulate_fusion_cpu<double>(double * out, const double * table, const double * table_info, const double * em_x, const double * em, const int nloc, const int nnei, const int last_layer_size);
 template void deepmd::tabulate_fusion_grad_cpu<float> (float * dy_dem_x, float * dy_dem, const float * table, const float * table_info, const float * em_x, const float * em, const float * dy, const int nloc, const int nnei, const int last_layer_size); 
 template void deepmd::tabulate_fusion_grad_cpu<double> (double * dy_dem_x, double * dy_dem, const double * table, const double * table_info, const double * em_x, const double * em, const double * dy, const int nloc, const int nnei, const int last_layer_size);
 template void deepmd::tabulate_fusion_grad_grad_cpu<float>(float * dz_dy, const float * table, const float * table_info, const float * em_x, const float * em, const float * dz_dy_dem_x, const float * dz_dy_dem, const int nloc, const int nnei, const int last_layer_size);
 template void deepmd::tabulate_fusion_grad_grad_cpu<double>(double * dz_dy, const double * table, const double * table_info, const double * em_x, const double * em, const double * dz_dy_dem_x, const double * dz_dy_dem, const int nloc, const int nnei, const int last_layer_size);
+template void deepmd::build_tabulate_table_cpu<float>(float * table, const float * const * matrix, const float * const * bias, const int * layer_size, const float * table_info, const int nlayer, const int nnet, const int nspline, const int functype);
+template void deepmd::build_tabulate_table_cpu<double>(double * table, const double * const * matrix, const double * const * bias, const int * layer_size, const double * table_info, const int nlayer, const int nnet, const int nspline, const int functype);
+template void deepmd::tabulate_fusion_atom_cpu<float>(float * out, const float * table, const float * table_info, const float * em, const int nnei, const int nvalid, const int last_layer_size);
+template void deepmd::tabulate_fusion_atom_cpu<double>(double * out, const double * table, const double * table_info, const double * em, const int nnei, const int nvalid, const int last_layer_size);
+template void deepmd::tabulate_fusion_grad_atom_cpu<float>(float * dy_dem, const float * table, const float * table_info, const float * em, const float * dy, const int nnei, const int nvalid, const int last_layer_size);
+template void deepmd::tabulate_fusion_grad_atom_cpu<double>(double * dy_dem, const double * table, const double * table_info, const double * em, const double * dy, const int nnei, const int nvalid, const int last_layer_size);
+template void deepmd::tabulate_fusion_se_a_grad_cpu<float>(float * dy_dem, const float * table, const float * table_info, const float * em, const int * nlist, const int * type, const float * dy, const int nloc, const int nspline, const int last_layer_size, const std::vector<int> & sec, const bool type_one_side);
+template void deepmd::tabulate_fusion_se_a_grad_cpu<double>(double * dy_dem, const double * table, const double * table_info, const double * em, const int * nlist, const int * type, const double * dy, const int nloc, const int nspline, const int last_layer_size, const std::vector<int> & sec, const bool type_one_side);
+template void deepmd::tabulate_fusion_grad_grad_atom_cpu<float>(float * dz_dy, const float * table, const float * table_info, const float * em, const float * dz_dy_dem, const int nnei, const int nvalid, const int last_layer_size);
+template void deepmd::tabulate_fusion_grad_grad_atom_cpu<double>(double * dz_dy, const double * table, const double * table_info, const double * em, const double * dz_dy_dem, const int nnei, const int nvalid, const int last_layer_size);
+template void deepmd::tabulate_fusion_se_a_grad_grad_cpu<float>(float * dz_dy, const float * table, const float * table_info, const float * em, const int * nlist, const int * type, const float * dz_dy_dem, const int nloc, const int nspline, const int last_layer_size, const std::vector<int> & sec, const bool type_one_side);
+template void deepmd::tabulate_fusion_se_a_grad_grad_cpu<double>(double * dz_dy, const double * table, const double * table_info, const double * em, const int * nlist, const int * type, const double * dz_dy_dem, const int nloc, const int nspline, const int last_layer_size, const std::vector<int> & sec, const bool type_one_side);
@@ -0,0 +1,118 @@
+#include <vector>
+#include <cmath>
+#include <iostream>
+#include <gtest/gtest.h>
+#include "tabulate.h"
+
+class TestBuildTabulateTable : public ::testing::Test
+{
+protected:
+  // two nets of the shape 1 -> 2 -> 4 -> 4
+  std::vector<int> layer_size = {1, 2, 4, 4};
+  int nlayer = 3;
+  int nnet = 2;
+  std::vector<double> matrix_0 = {
+    0.3, -0.7,
+    -0.5, 0.2,
+  };
+  std::vector<double> bias_0 = {
+    0.1, -0.2,
+    0.05, 0.3,
+  };
+  std::vector<double> matrix_1 = {
+    0.2, -0.1, 0.4, 0.3,
+    -0.6, 0.5, 0.1, -0.2,
+    0.1, 0.3, -0.4, 0.2,
+    0.7, -0.2, 0.05, 0.6,
+  };
+  std::vector<double> bias_1 = {
+    -0.1, 0.2, 0.0, 0.1,
+    0.3, -0.3, 0.2, 0.0,
+  };
+  std::vector<double> matrix_2 = {
+    0.1, 0.2, -0.3, 0.4,
+    -0.2, 0.3, 0.1, 0.05,
+    0.3, -0.1, 0.2, -0.4,
+    0.05, 0.4, 0.3, 0.1,
+    -0.3, 0.1, 0.2, 0.2,
+    0.2, -0.4, 0.1, 0.3,
+    0.1, 0.2, 0.3, -0.1,
+    0.4, 0.1, -0.2, 0.05,
+  };
+  std::vector<double> bias_2 = {
+    0.1, 0.0, -0.1, 0.2,
+    -0.2, 0.1, 0.0, 0.3,
+  };
+  // lower, upper, max, stride0, stride1
+  std::vector<double> info = {-1, 2, 10, 0.05, 0.5};
+  int nspline = 60 + 16;
+  int last_layer_size = 4;
+
+  // the plain forward evaluation of the net
+  void forward(std::vector<double> & out, const double xx, const int net, const int functype) {
+    const double * matrix[3] = {&matrix_0[0], &matrix_1[0], &matrix_2[0]};
+    const double * bias[3] = {&bias_0[0], &bias_1[0], &bias_2[0]};
+    std::vector<double> yy(1, xx);
+    for (int ll = 0; ll < nlayer; ++ll){
+      int size = layer_size[ll], width = layer_size[ll+1];
+      std::vector<double> zz(width);
+      for (int ii = 0; ii < width; ++ii){
+	double xbar = bias[ll][net * width + ii];
+	for (int jj = 0; jj < size; ++jj){
+	  xbar += yy[jj] * matrix[ll][net * size * width + jj * width + ii];
+	}
+	zz[ii] = functype == 1 ? tanh(xbar) : xbar * 0.5 * (1.0 + tanh(0.7978845608028654 * (xbar + 0.044715 * xbar * xbar * xbar)));
+	if (width == size || width == 2 * size) {
+	  zz[ii] += yy[ii % size];
+	}
+      }
+      yy = zz;
+    }
+    out = yy;
+  }
+
+  void check_table(const int functype) {
+    const double * matrix[3] = {&matrix_0[0], &matrix_1[0], &matrix_2[0]};
+    const double * bias[3] = {&bias_0[0], &bias_1[0], &bias_2[0]};
+    std::vector<double> table(nnet * nspline * last_layer_size * 6);
+    deepmd::build_tabulate_table_cpu<double>(&table[0], matrix, bias, &layer_size[0], &info[0], nlayer, nnet, nspline, functype);
+    const double hh = 1e-5;
+    for (int nn = 0; nn < nnet; ++nn){
+      for (int jj = 0; jj < nspline; ++jj){
+	double xx = jj < 60 ? info[0] + jj * info[3] : info[1] + (jj - 60) * info[4];
+	double tt = jj < 60 ? info[3] : info[4];
+	std::vector<double> v0, vp, vm, v1;
+	forward(v0, xx, nn, functype);
+	forward(vp, xx + hh, nn, functype);
+	forward(vm, xx - hh, nn, functype);
+	forward(v1, xx + tt, nn, functype);
+	const double * coef = &table[(nn * nspline + jj) * last_layer_size * 6];
+	for (int kk = 0; kk < last_layer_size; ++kk){
+	  const double * cc = coef + kk * 6;
+	  // value and derivatives at the node
+	  EXPECT_LT(fabs(cc[0] - v0[kk]), 1e-10);
+	  EXPECT_LT(fabs(cc[1] - (vp[kk] - vm[kk]) / (2 * hh)), 1e-7);
+	  EXPECT_LT(fabs(2 * cc[2] - (vp[kk] - 2 * v0[kk] + vm[kk]) / (hh * hh)), 1e-4);
+	  // the spline hits the next node
+	  double var = cc[0] + (cc[1] + (cc[2] + (cc[3] + (cc[4] + cc[5] * tt) * tt) * tt) * tt) * tt;
+	  EXPECT_LT(fabs(var - v1[kk]), 1e-10);
+	}
+      }
+    }
+  }
+
+  void SetUp() override {
+  }
+  void TearDown() override {
+  }
+};
+
+TEST_F(TestBuildTabulateTable, cpu_tanh)
+{
+  check_table(1);
+}
+
+TEST_F(TestBuildTabulateTable, cpu_gelu)
+{
+  check_table(2);
+}
@@ -511,6 +511,62 @@ TEST_F(TestEnvMatA, prod_cpu_equal_cpu)
 }
 
 
+
+TEST_F(TestEnvMatA, prod_cpu_batch_equal_prod_cpu)
+{
+  int max_nbor_size = 0;
+  for(int ii = 0; ii < nlist_a_cpy.size(); ++ii){
+    if (nlist_a_cpy[ii].size() > max_nbor_size){
+      max_nbor_size = nlist_a_cpy[ii].size();
+    }
+  }
+  std::vector<int> ilist(nloc), numneigh(nloc);
+  std::vector<int*> firstneigh(nloc);
+  deepmd::InputNlist inlist(nloc, &ilist[0], &numneigh[0], &firstneigh[0]);
+  convert_nlist(inlist, nlist_a_cpy);
+  std::vector<double > avg(ntypes * ndescrpt, 0);
+  std::vector<double > std(ntypes * ndescrpt, 1);
+  // the second frame is a perturbation of the first one
+  int nframes = 2;
+  std::vector<std::vector<double > > posi_frames(nframes, posi_cpy);
+  for(int ii = 0; ii < nall * 3; ++ii){
+    posi_frames[1][ii] += 0.01 * (ii % 7) - 0.03;
+  }
+  std::vector<const double *> coords(nframes);
+  std::vector<const int *> types(nframes, &atype_cpy[0]);
+  std::vector<deepmd::InputNlist> inlists(nframes, inlist);
+  std::vector<int> nalls(nframes, nall);
+  for(int ff = 0; ff < nframes; ++ff){
+    coords[ff] = &posi_frames[ff][0];
+  }
+  std::vector<double > em(nframes * nloc * ndescrpt), em_deriv(nframes * nloc * ndescrpt * 3), rij(nframes * nloc * nnei * 3);
+  std::vector<int> nlist(nframes * nloc * nnei);
+  deepmd::prod_env_mat_a_batch_cpu(
+      &em[0], &em_deriv[0], &rij[0], &nlist[0],
+      &coords[0], &types[0], &inlists[0], &nalls[0], nframes,
+      max_nbor_size, &avg[0], &std[0], nloc, rc, rc_smth, sec_a);
+
+  for(int ff = 0; ff < nframes; ++ff){
+    std::vector<double > em_1(nloc * ndescrpt), em_deriv_1(nloc * ndescrpt * 3), rij_1(nloc * nnei * 3);
+    std::vector<int> nlist_1(nloc * nnei);
+    deepmd::prod_env_mat_a_cpu(
+	&em_1[0], &em_deriv_1[0], &rij_1[0], &nlist_1[0],
+	&posi_frames[ff][0], &atype_cpy[0], inlist, max_nbor_size,
+	&avg[0], &std[0], nloc, nall, rc, rc_smth, sec_a);
+    for (unsigned jj = 0; jj < em_1.size(); ++jj){
+      EXPECT_LT(fabs(em[ff*em_1.size()+jj] - em_1[jj]), 1e-10);
+    }
+    for (unsigned jj = 0; jj < em_deriv_1.size(); ++jj){
+      EXPECT_LT(fabs(em_deriv[ff*em_deriv_1.size()+jj] - em_deriv_1[jj]), 1e-10);
+    }
+    for (unsigned jj = 0; jj < rij_1.size(); ++jj){
+      EXPECT_LT(fabs(rij[ff*rij_1.size()+jj] - rij_1[jj]), 1e-10);
+    }
+    for (unsigned jj = 0; jj < nlist_1.size(); ++jj){
+      EXPECT_EQ(nlist[ff*nlist_1.size()+jj], nlist_1[jj]);
+    }
+  }
+}
 #if GOOGLE_CUDA
 TEST_F(TestEnvMatA, prod_gpu_cuda)
 {
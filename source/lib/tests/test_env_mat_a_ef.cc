@@ -0,0 +1,132 @@
+#include <iostream>
+#include <cmath>
+#include <gtest/gtest.h>
+#include "fmt_nlist.h"
+#include "prod_env_mat.h"
+#include "neighbor_list.h"
+#include "ComputeDescriptor.h"
+
+class TestEnvMatAEf : public ::testing::Test
+{
+protected:
+  std::vector<double > posi = {12.83, 2.56, 2.18,
+			       12.09, 2.87, 2.74,
+			       00.25, 3.32, 1.68,
+			       3.36, 3.00, 1.81,
+			       3.51, 2.51, 2.60,
+			       4.27, 3.22, 1.56
+  };
+  std::vector<int > atype = {0, 1, 1, 0, 1, 1};
+  // one undefined field, which falls back to the x axis
+  std::vector<double > efield = {0.6, 0.0, 0.8,
+				 0.0, 1.0, 0.0,
+				 NAN, NAN, NAN,
+				 -0.48, 0.6, 0.64,
+				 0.0, 0.0, 1.0,
+				 1.0, 0.0, 0.0
+  };
+  std::vector<double > posi_cpy;
+  std::vector<int > atype_cpy;
+  int nloc, nall;
+  double rc = 6;
+  double rc_smth = 0.8;
+  SimulationRegion<double > region;
+  std::vector<int> mapping, ncell, ngcell;
+  std::vector<int> sec_a = {0, 10, 20};
+  std::vector<int> nat_stt, ext_stt, ext_end;
+  std::vector<std::vector<int>> nlist_a_cpy, nlist_r_cpy;
+  int ntypes = sec_a.size()-1;
+  int nnei = sec_a.back();
+  int ndescrpt = nnei * 4;
+  std::vector<double > avg, std;
+
+  void SetUp() override {
+    double box[] = {13., 0., 0., 0., 13., 0., 0., 0., 13.};
+    region.reinitBox(box);
+    copy_coord(posi_cpy, atype_cpy, mapping, ncell, ngcell, posi, atype, rc, region);
+    nloc = posi.size() / 3;
+    nall = posi_cpy.size() / 3;
+    nat_stt.resize(3);
+    ext_stt.resize(3);
+    ext_end.resize(3);
+    for (int dd = 0; dd < 3; ++dd){
+      ext_stt[dd] = -ngcell[dd];
+      ext_end[dd] = ncell[dd] + ngcell[dd];
+    }
+    build_nlist(nlist_a_cpy, nlist_r_cpy, posi_cpy, nloc, rc, rc, nat_stt, ncell, ext_stt, ext_end, region, ncell);
+    avg.resize(ntypes * ndescrpt);
+    std.resize(ntypes * ndescrpt);
+    for (int ii = 0; ii < ntypes * ndescrpt; ++ii){
+      avg[ii] = 0.01 * (ii % 7);
+      std[ii] = 1. + 0.1 * (ii % 5);
+    }
+  }
+  void TearDown() override {
+  }
+
+  // compare with the legacy descriptors of the DescrptSeAEf ops
+  void check_prod_cpu(const int ef_proj) {
+    int max_nbor_size = 0;
+    for(int ii = 0; ii < nlist_a_cpy.size(); ++ii){
+      if (nlist_a_cpy[ii].size() > max_nbor_size){
+	max_nbor_size = nlist_a_cpy[ii].size();
+      }
+    }
+    std::vector<int> ilist(nloc), numneigh(nloc);
+    std::vector<int*> firstneigh(nloc);
+    deepmd::InputNlist inlist(nloc, &ilist[0], &numneigh[0], &firstneigh[0]);
+    deepmd::convert_nlist(inlist, nlist_a_cpy);
+
+    std::vector<double > em(nloc * ndescrpt), em_deriv(nloc * ndescrpt * 3), rij(nloc * nnei * 3);
+    std::vector<int> nlist(nloc * nnei);
+    deepmd::prod_env_mat_a_ef_cpu(
+	&em[0], &em_deriv[0], &rij[0], &nlist[0],
+	&posi_cpy[0], &atype_cpy[0], &efield[0], inlist, max_nbor_size,
+	&avg[0], &std[0], nloc, nall, rc, rc_smth, sec_a, ef_proj);
+
+    for(int ii = 0; ii < nloc; ++ii){
+      std::vector<int> fmt_nlist_a;
+      int ret = format_nlist_i_cpu(fmt_nlist_a, posi_cpy, atype_cpy, ii, nlist_a_cpy[ii], rc, sec_a);
+      EXPECT_EQ(ret, -1);
+      std::vector<double > env, env_deriv, rij_a;
+      if (ef_proj == 0) {
+	compute_descriptor_se_a_extf(env, env_deriv, rij_a, posi_cpy, ntypes, atype_cpy, region, false, efield, ii, fmt_nlist_a, sec_a, rc_smth, rc);
+      }
+      else if (ef_proj == 1) {
+	compute_descriptor_se_a_ef_para(env, env_deriv, rij_a, posi_cpy, ntypes, atype_cpy, region, false, efield, ii, fmt_nlist_a, sec_a, rc_smth, rc);
+      }
+      else {
+	compute_descriptor_se_a_ef_vert(env, env_deriv, rij_a, posi_cpy, ntypes, atype_cpy, region, false, efield, ii, fmt_nlist_a, sec_a, rc_smth, rc);
+      }
+      const double * i_avg = &avg[atype_cpy[ii] * ndescrpt];
+      const double * i_std = &std[atype_cpy[ii] * ndescrpt];
+      for (int jj = 0; jj < nnei; ++jj){
+	EXPECT_EQ(nlist[ii*nnei + jj], fmt_nlist_a[jj]);
+	for (int dd = 0; dd < 3; ++dd){
+	  EXPECT_LT(fabs(rij[ii*nnei*3 + jj*3 + dd] - rij_a[jj*3 + dd]), 1e-12);
+	}
+	for (int kk = 0; kk < 4; ++kk){
+	  EXPECT_LT(fabs(em[ii*ndescrpt + jj*4 + kk] - (env[jj*4 + kk] - i_avg[jj*4 + kk]) / i_std[jj*4 + kk]), 1e-12);
+	  for (int dd = 0; dd < 3; ++dd){
+	    EXPECT_LT(fabs(em_deriv[ii*ndescrpt*3 + jj*12 + kk*3 + dd] - env_deriv[jj*12 + kk*3 + dd] / i_std[jj*4 + kk]), 1e-12);
+	  }
+	}
+      }
+    }
+  }
+};
+
+TEST_F(TestEnvMatAEf, prod_cpu_extf)
+{
+  check_prod_cpu(0);
+}
+
+TEST_F(TestEnvMatAEf, prod_cpu_para)
+{
+  check_prod_cpu(1);
+}
+
+TEST_F(TestEnvMatAEf, prod_cpu_vert)
+{
+  check_prod_cpu(2);
+}
@@ -0,0 +1,98 @@
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+#include <gtest/gtest.h>
+#include "neighbor_list.h"
+#include "neighbor_stat.h"
+
+class TestNeighborStat : public ::testing::Test
+{
+protected:
+  std::vector<double > posi = {12.83, 2.56, 2.18,
+			       12.09, 2.87, 2.74,
+			       00.25, 3.32, 1.68,
+			       3.36, 3.00, 1.81,
+			       3.51, 2.51, 2.60,
+			       4.27, 3.22, 1.56
+  };
+  std::vector<int > atype = {0, 1, 1, 0, 1, 1};
+  std::vector<double > posi_cpy;
+  std::vector<int > atype_cpy;
+  int ntypes = 2;
+  int nloc, nall;
+  double rc = 6;
+  int nbins = 12;
+  SimulationRegion<double > region;
+  std::vector<int> mapping, ncell, ngcell;
+  double expected_min_dist;
+  std::vector<int> expected_max_nbor_size;
+  std::vector<int> expected_hist;
+
+  void SetUp() override {
+    double box[] = {13., 0., 0., 0., 13., 0., 0., 0., 13.};
+    region.reinitBox(box);
+    copy_coord(posi_cpy, atype_cpy, mapping, ncell, ngcell, posi, atype, rc, region);
+    nloc = posi.size() / 3;
+    nall = posi_cpy.size() / 3;
+    // brute force reference
+    expected_min_dist = rc;
+    expected_max_nbor_size.resize(ntypes, 0);
+    expected_hist.resize(nbins, 0);
+    for (int ii = 0; ii < nloc; ++ii){
+      std::vector<int> nnei(ntypes, 0);
+      for (int jj = 0; jj < nall; ++jj){
+	if (ii == jj) continue;
+	double rr = 0;
+	for (int dd = 0; dd < 3; ++dd){
+	  double diff = posi_cpy[jj*3+dd] - posi_cpy[ii*3+dd];
+	  rr += diff * diff;
+	}
+	rr = sqrt(rr);
+	if (rr >= rc) continue;
+	nnei[atype_cpy[jj]] ++;
+	expected_min_dist = std::min(expected_min_dist, rr);
+	expected_hist[int(rr / rc * nbins)] ++;
+      }
+      for (int tt = 0; tt < ntypes; ++tt){
+	expected_max_nbor_size[tt] = std::max(expected_max_nbor_size[tt], nnei[tt]);
+      }
+    }
+  }
+  void TearDown() override {
+  }
+};
+
+TEST_F(TestNeighborStat, cpu)
+{
+  double min_dist;
+  std::vector<int> max_nbor_size(ntypes);
+  std::vector<int> hist(nbins);
+  deepmd::neighbor_stat_cpu<double>(min_dist, &max_nbor_size[0], &hist[0], &posi_cpy[0], &atype_cpy[0], nloc, nall, ntypes, rc, nbins);
+  EXPECT_LT(fabs(min_dist - expected_min_dist), 1e-10);
+  EXPECT_EQ(max_nbor_size, expected_max_nbor_size);
+  EXPECT_EQ(hist, expected_hist);
+  // the test system has neighbors of both types
+  EXPECT_GT(max_nbor_size[0], 0);
+  EXPECT_GT(max_nbor_size[1], 0);
+}
+
+TEST_F(TestNeighborStat, cpu_no_hist)
+{
+  double min_dist;
+  std::vector<int> max_nbor_size(ntypes);
+  deepmd::neighbor_stat_cpu<double>(min_dist, &max_nbor_size[0], NULL, &posi_cpy[0], &atype_cpy[0], nloc, nall, ntypes, rc, 0);
+  EXPECT_LT(fabs(min_dist - expected_min_dist), 1e-10);
+  EXPECT_EQ(max_nbor_size, expected_max_nbor_size);
+}
+
+TEST_F(TestNeighborStat, cpu_no_nbor)
+{
+  double min_dist;
+  std::vector<int> max_nbor_size(ntypes);
+  std::vector<double> posi_far = {0., 0., 0., 10., 10., 10.};
+  std::vector<int> atype_far = {0, 1};
+  deepmd::neighbor_stat_cpu<double>(min_dist, &max_nbor_size[0], NULL, &posi_far[0], &atype_far[0], 2, 2, ntypes, rc, 0);
+  EXPECT_EQ(min_dist, rc);
+  EXPECT_EQ(max_nbor_size[0], 0);
+  EXPECT_EQ(max_nbor_size[1], 0);
+}
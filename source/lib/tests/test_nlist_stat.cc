@@ -0,0 +1,204 @@
+#include <iostream>
+#include <cmath>
+#include <gtest/gtest.h>
+#include "fmt_nlist.h"
+#include "prod_env_mat.h"
+#include "neighbor_list.h"
+#include "nlist_stat.h"
+
+class TestNlistStat : public ::testing::Test
+{
+protected:
+  std::vector<double > posi = {12.83, 2.56, 2.18, 
+			       12.09, 2.87, 2.74,
+			       00.25, 3.32, 1.68,
+			       3.36, 3.00, 1.81,
+			       3.51, 2.51, 2.60,
+			       4.27, 3.22, 1.56
+  };
+  std::vector<int > atype = {0, 1, 1, 0, 1, 1};
+  std::vector<double > posi_cpy;
+  std::vector<int > atype_cpy;
+  int nloc, nall;
+  double rc = 6;
+  double rc_smth = 0.8;
+  SimulationRegion<double > region;
+  std::vector<int> mapping, ncell, ngcell;
+  // the neighbors of type 1 overflow sel
+  std::vector<int> sec_a = {0, 5, 6};
+  std::vector<int> nat_stt, ext_stt, ext_end;
+  std::vector<std::vector<int>> nlist_a_cpy, nlist_r_cpy;
+  int ntypes = sec_a.size()-1;
+  int nnei = sec_a.back();
+  int ndescrpt = nnei * 4;
+  // the numbers of neighbors within rc of each atom and type
+  std::vector<std::vector<int> > expected_count;
+  
+  void SetUp() override {
+    double box[] = {13., 0., 0., 0., 13., 0., 0., 0., 13.};
+    region.reinitBox(box);
+    copy_coord(posi_cpy, atype_cpy, mapping, ncell, ngcell, posi, atype, rc, region);
+    nloc = posi.size() / 3;
+    nall = posi_cpy.size() / 3;
+    nat_stt.resize(3);
+    ext_stt.resize(3);
+    ext_end.resize(3);
+    for (int dd = 0; dd < 3; ++dd){
+      ext_stt[dd] = -ngcell[dd];
+      ext_end[dd] = ncell[dd] + ngcell[dd];
+    }
+    build_nlist(nlist_a_cpy, nlist_r_cpy, posi_cpy, nloc, rc, rc, nat_stt, ncell, ext_stt, ext_end, region, ncell);
+    expected_count.resize(nloc, std::vector<int>(ntypes, 0));
+    for (int ii = 0; ii < nloc; ++ii){
+      for (unsigned jj = 0; jj < nlist_a_cpy[ii].size(); ++jj){
+	int j_idx = nlist_a_cpy[ii][jj];
+	double rr = 0;
+	for (int dd = 0; dd < 3; ++dd){
+	  double diff = posi_cpy[j_idx*3+dd] - posi_cpy[ii*3+dd];
+	  rr += diff * diff;
+	}
+	if (sqrt(rr) <= rc) {
+	  expected_count[ii][atype_cpy[j_idx]] ++;
+	}
+      }
+    }
+    // drop the statistics left by other tests
+    deepmd::NlistStat stat;
+    deepmd::nlist_stat_get(stat);
+  }
+  void TearDown() override {
+    deepmd::nlist_stat_enable(false);
+  }
+  void run_prod_env_mat() {
+    int max_nbor_size = 0;
+    for(int ii = 0; ii < nlist_a_cpy.size(); ++ii){
+      if (nlist_a_cpy[ii].size() > max_nbor_size){
+	max_nbor_size = nlist_a_cpy[ii].size();
+      }
+    }
+    std::vector<int> ilist(nloc), numneigh(nloc);
+    std::vector<int*> firstneigh(nloc);
+    deepmd::InputNlist inlist(nloc, &ilist[0], &numneigh[0], &firstneigh[0]);
+    convert_nlist(inlist, nlist_a_cpy);
+    std::vector<double > em(nloc * ndescrpt), em_deriv(nloc * ndescrpt * 3), rij(nloc * nnei * 3);
+    std::vector<int> nlist(nloc * nnei);
+    std::vector<double > avg(ntypes * ndescrpt, 0);
+    std::vector<double > std(ntypes * ndescrpt, 1);
+    deepmd::prod_env_mat_a_cpu(
+	&em[0], &em_deriv[0], &rij[0], &nlist[0], 
+	&posi_cpy[0], &atype_cpy[0], inlist, max_nbor_size, 
+	&avg[0], &std[0], nloc, nall, rc, rc_smth, sec_a);
+  }
+};
+
+TEST_F(TestNlistStat, format_nlist_count)
+{
+  std::vector<int> fmt_nlist_a, nei_count(ntypes);
+  for (int ii = 0; ii < nloc; ++ii){
+    int ret = format_nlist_i_cpu<double>(fmt_nlist_a, posi_cpy, atype_cpy, ii, nlist_a_cpy[ii], rc, sec_a, &nei_count[0]);
+    bool overflowed = false;
+    for (int tt = 0; tt < ntypes; ++tt){
+      EXPECT_EQ(nei_count[tt], expected_count[ii][tt]);
+      overflowed = overflowed || (nei_count[tt] > sec_a[tt+1] - sec_a[tt]);
+    }
+    EXPECT_EQ(ret >= 0, overflowed);
+  }
+}
+
+TEST_F(TestNlistStat, prod_cpu)
+{
+  deepmd::nlist_stat_enable(true);
+  run_prod_env_mat();
+  run_prod_env_mat();
+  deepmd::NlistStat stat;
+  deepmd::nlist_stat_get(stat);
+  EXPECT_EQ(stat.natoms, 2 * nloc);
+  EXPECT_EQ(stat.ntypes(), ntypes);
+  int max_nbor_size = 0;
+  for(int ii = 0; ii < nloc; ++ii){
+    max_nbor_size = std::max(max_nbor_size, int(nlist_a_cpy[ii].size()));
+  }
+  EXPECT_EQ(stat.max_nbor_size, max_nbor_size);
+  for (int tt = 0; tt < ntypes; ++tt){
+    int nnei_max = 0;
+    long long nnei_sum = 0, noverflow = 0;
+    for (int ii = 0; ii < nloc; ++ii){
+      nnei_max = std::max(nnei_max, expected_count[ii][tt]);
+      nnei_sum += expected_count[ii][tt];
+      noverflow += expected_count[ii][tt] > sec_a[tt+1] - sec_a[tt];
+    }
+    EXPECT_EQ(stat.sel[tt], sec_a[tt+1] - sec_a[tt]);
+    EXPECT_EQ(stat.nnei_max[tt], nnei_max);
+    EXPECT_EQ(stat.nnei_sum[tt], 2 * nnei_sum);
+    EXPECT_EQ(stat.noverflow[tt], 2 * noverflow);
+    EXPECT_LT(fabs(stat.nnei_mean(tt) - double(nnei_sum) / nloc), 1e-12);
+  }
+  EXPECT_GT(stat.noverflow[1], 0);
+  EXPECT_EQ(stat.noverflow[0], 0);
+  // the statistics are reset by the read
+  deepmd::nlist_stat_get(stat);
+  EXPECT_EQ(stat.natoms, 0);
+}
+
+TEST_F(TestNlistStat, phantom)
+{
+  deepmd::nlist_stat_enable(true);
+  run_prod_env_mat();
+  // the phantom atoms are counted but have no neighbors
+  deepmd::nlist_stat_add_phantom(2);
+  deepmd::NlistStat stat;
+  deepmd::nlist_stat_get(stat);
+  EXPECT_EQ(stat.natoms, nloc);
+  EXPECT_EQ(stat.nphantom, 2);
+  for (int tt = 0; tt < ntypes; ++tt){
+    long long nnei_sum = 0;
+    for (int ii = 0; ii < nloc; ++ii){
+      nnei_sum += expected_count[ii][tt];
+    }
+    EXPECT_LT(fabs(stat.nnei_mean(tt) - double(nnei_sum) / (nloc - 2)), 1e-12);
+  }
+}
+
+TEST_F(TestNlistStat, disabled)
+{
+  run_prod_env_mat();
+  deepmd::nlist_stat_add_build(1, 10);
+  deepmd::NlistStat stat;
+  deepmd::nlist_stat_get(stat);
+  EXPECT_EQ(stat.natoms, 0);
+  EXPECT_EQ(stat.ntypes(), 0);
+  // nlist_stat_add does not check the switch, the callers do
+  EXPECT_EQ(stat.nbuild, 1);
+  EXPECT_EQ(stat.nretry, 1);
+  EXPECT_EQ(stat.max_nbor_size, 10);
+}
+
+TEST(TestNlistStatMerge, merge)
+{
+  deepmd::NlistStat s0(1), s1(2);
+  s0.natoms = 2;
+  s0.nnei_max[0] = 5;
+  s0.nnei_sum[0] = 8;
+  s0.sel[0] = 10;
+  s1.natoms = 3;
+  s1.nphantom = 1;
+  s1.nnei_max = {4, 7};
+  s1.nnei_sum = {9, 12};
+  s1.noverflow = {0, 1};
+  s1.sel = {10, 6};
+  s1.nbuild = 1;
+  s1.nretry = 2;
+  s1.max_nbor_size = 30;
+  s0.merge(s1);
+  EXPECT_EQ(s0.natoms, 5);
+  EXPECT_EQ(s0.nphantom, 1);
+  EXPECT_EQ(s0.ntypes(), 2);
+  EXPECT_EQ(s0.nnei_max, std::vector<int>({5, 7}));
+  EXPECT_EQ(s0.nnei_sum, std::vector<long long>({17, 12}));
+  EXPECT_EQ(s0.noverflow, std::vector<long long>({0, 1}));
+  EXPECT_EQ(s0.sel, std::vector<int>({10, 6}));
+  EXPECT_EQ(s0.nbuild, 1);
+  EXPECT_EQ(s0.nretry, 2);
+  EXPECT_EQ(s0.max_nbor_size, 30);
+  EXPECT_LT(fabs(s0.nnei_mean(0) - 17. / 4.), 1e-12);
+}
@@ -0,0 +1,186 @@
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <set>
+#include <gtest/gtest.h>
+#include "npy.h"
+#include "errors.h"
+
+// write a version 1 npy file as numpy.save does
+static void
+write_npy (const std::string & path,
+	   const std::string & descr,
+	   const std::string & shape,
+	   const char * data,
+	   const size_t size)
+{
+  std::string header = "{'descr': '" + descr + "', 'fortran_order': False, 'shape': " + shape + ", }";
+  size_t total = 10 + header.size() + 1;
+  header += std::string((64 - total % 64) % 64, ' ') + "\n";
+  unsigned short header_len = header.size();
+  std::ofstream fout(path.c_str(), std::ios::binary);
+  fout.write("\x93NUMPY\x01\x00", 8);
+  fout.put(header_len & 0xff);
+  fout.put(header_len >> 8);
+  fout.write(header.c_str(), header.size());
+  fout.write(data, size);
+}
+
+class TestNpy : public ::testing::Test
+{
+protected:
+  // 3 frames of 2 atoms with 3 dofs
+  int nframes = 3;
+  int natoms = 2;
+  int ndof = 3;
+  std::vector<double > data_d;
+  std::vector<float > data_f;
+  std::vector<double > energy = {1.5, -2.5, 3.5};
+
+  void SetUp() override {
+    for (int ii = 0; ii < nframes * natoms * ndof; ++ii){
+      data_d.push_back(0.1 * ii + 0.01);
+      data_f.push_back(0.1 * ii + 0.01);
+    }
+    write_npy("test_npy_d.npy", "<f8", "(3, 6)", (const char *) &data_d[0], data_d.size() * sizeof(double));
+    write_npy("test_npy_f.npy", "<f4", "(3, 6)", (const char *) &data_f[0], data_f.size() * sizeof(float));
+    write_npy("test_npy_1d.npy", "<f8", "(3,)", (const char *) &energy[0], energy.size() * sizeof(double));
+    write_npy("test_npy_i.npy", "<i8", "(3,)", (const char *) &energy[0], energy.size() * sizeof(double));
+    write_npy("test_npy_t.npy", "<f8", "(4, 6)", (const char *) &data_d[0], data_d.size() * sizeof(double));
+    write_npy("test_npy_s.npy", "<f8", "(3, x)", (const char *) &data_d[0], data_d.size() * sizeof(double));
+  }
+  void TearDown() override {
+    remove("test_npy_d.npy");
+    remove("test_npy_f.npy");
+    remove("test_npy_1d.npy");
+    remove("test_npy_i.npy");
+    remove("test_npy_t.npy");
+    remove("test_npy_s.npy");
+  }
+};
+
+TEST_F(TestNpy, shape)
+{
+  deepmd::NpyFile fd("test_npy_d.npy");
+  EXPECT_EQ(fd.nframes(), 3);
+  EXPECT_EQ(fd.frame_size(), 6);
+  deepmd::NpyFile f1("test_npy_1d.npy");
+  EXPECT_EQ(f1.nframes(), 1);
+  EXPECT_EQ(f1.frame_size(), 3);
+  f1.reshape(3);
+  EXPECT_EQ(f1.nframes(), 3);
+  EXPECT_EQ(f1.frame_size(), 1);
+  std::vector<int> frames = {2};
+  double ener;
+  f1.gather(&ener, &frames[0], 1, NULL, 0);
+  EXPECT_EQ(ener, energy[2]);
+  EXPECT_THROW(f1.reshape(2), deepmd::deepmd_exception);
+}
+
+TEST_F(TestNpy, gather)
+{
+  deepmd::NpyFile fd("test_npy_d.npy");
+  std::vector<int> frames = {2, 0};
+  std::vector<double > out(frames.size() * fd.frame_size());
+  fd.gather(&out[0], &frames[0], frames.size(), NULL, natoms);
+  for (unsigned ii = 0; ii < frames.size(); ++ii){
+    for (int jj = 0; jj < natoms * ndof; ++jj){
+      EXPECT_EQ(out[ii * natoms * ndof + jj], data_d[frames[ii] * natoms * ndof + jj]);
+    }
+  }
+}
+
+TEST_F(TestNpy, gather_idx_map)
+{
+  deepmd::NpyFile fd("test_npy_d.npy");
+  std::vector<int> frames = {1, 2};
+  std::vector<int> idx_map = {1, 0};
+  std::vector<double > out(frames.size() * fd.frame_size());
+  fd.gather(&out[0], &frames[0], frames.size(), &idx_map[0], natoms);
+  for (unsigned ii = 0; ii < frames.size(); ++ii){
+    for (int jj = 0; jj < natoms; ++jj){
+      for (int dd = 0; dd < ndof; ++dd){
+	EXPECT_EQ(out[(ii * natoms + jj) * ndof + dd], data_d[(frames[ii] * natoms + idx_map[jj]) * ndof + dd]);
+      }
+    }
+  }
+}
+
+TEST_F(TestNpy, gather_convert)
+{
+  deepmd::NpyFile ff("test_npy_f.npy");
+  std::vector<int> frames = {0, 1, 2};
+  std::vector<double > out_d(frames.size() * ff.frame_size());
+  ff.gather(&out_d[0], &frames[0], frames.size(), NULL, natoms);
+  for (unsigned ii = 0; ii < out_d.size(); ++ii){
+    EXPECT_EQ(out_d[ii], double(data_f[ii]));
+  }
+  deepmd::NpyFile fd("test_npy_d.npy");
+  std::vector<float > out_f(frames.size() * fd.frame_size());
+  fd.gather(&out_f[0], &frames[0], frames.size(), NULL, natoms);
+  for (unsigned ii = 0; ii < out_f.size(); ++ii){
+    EXPECT_EQ(out_f[ii], float(data_d[ii]));
+  }
+}
+
+TEST_F(TestNpy, error)
+{
+  EXPECT_THROW(deepmd::NpyFile("test_npy_none.npy"), deepmd::deepmd_exception);
+  EXPECT_THROW(deepmd::NpyFile("test_npy_i.npy"), deepmd::deepmd_exception);
+  EXPECT_THROW(deepmd::NpyFile("test_npy_t.npy"), deepmd::deepmd_exception);
+  // a broken shape is reported as deepmd_exception, which the ops turn into errors
+  EXPECT_THROW(deepmd::NpyFile("test_npy_s.npy"), deepmd::deepmd_exception);
+  deepmd::NpyFile fd("test_npy_d.npy");
+  std::vector<int> frames = {3};
+  std::vector<double > out(fd.frame_size());
+  EXPECT_THROW(fd.gather(&out[0], &frames[0], 1, NULL, natoms), deepmd::deepmd_exception);
+}
+
+TEST(TestFrameSampler, cycle)
+{
+  // the remaining frame of set 0 is skipped, and set 1 is smaller than the batch
+  std::vector<int> set_nframes = {5, 1};
+  deepmd::FrameSampler sampler(set_nframes, 2, 1);
+  int set_idx;
+  std::vector<int> frames;
+  std::set<int> seen;
+  sampler.next(set_idx, frames);
+  EXPECT_EQ(set_idx, 0);
+  EXPECT_EQ(frames.size(), 2);
+  seen.insert(frames.begin(), frames.end());
+  sampler.next(set_idx, frames);
+  EXPECT_EQ(set_idx, 0);
+  EXPECT_EQ(frames.size(), 2);
+  seen.insert(frames.begin(), frames.end());
+  EXPECT_EQ(seen.size(), 4);
+  EXPECT_LT(*seen.rbegin(), 5);
+  sampler.next(set_idx, frames);
+  EXPECT_EQ(set_idx, 1);
+  EXPECT_EQ(frames.size(), 1);
+  EXPECT_EQ(frames[0], 0);
+  sampler.next(set_idx, frames);
+  EXPECT_EQ(set_idx, 0);
+  EXPECT_EQ(frames.size(), 2);
+}
+
+TEST(TestFrameSampler, seed)
+{
+  std::vector<int> set_nframes = {7, 4};
+  deepmd::FrameSampler sampler0(set_nframes, 3, 10);
+  deepmd::FrameSampler sampler1(set_nframes, 3, 10);
+  deepmd::FrameSampler sampler2(set_nframes, 3, 10, false);
+  for (int ii = 0; ii < 10; ++ii){
+    int set0, set1, set2;
+    std::vector<int> frames0, frames1, frames2;
+    sampler0.next(set0, frames0);
+    sampler1.next(set1, frames1);
+    sampler2.next(set2, frames2);
+    EXPECT_EQ(set0, set1);
+    EXPECT_EQ(set0, set2);
+    EXPECT_EQ(frames0, frames1);
+    EXPECT_EQ(frames0.size(), frames2.size());
+    for (unsigned jj = 1; jj < frames2.size(); ++jj){
+      EXPECT_EQ(frames2[jj], frames2[jj-1] + 1);
+    }
+  }
+}
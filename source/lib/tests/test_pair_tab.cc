@@ -798,3 +798,69 @@ TEST_F(TestPairTabTriBox, cpu_v_num_deriv)
     }
   }
 }
+
+TEST_F(TestPairTab, cpu_float)
+{
+  std::vector<float > energy(nloc);
+  std::vector<float > force(nall * 3);
+  std::vector<float > virial(nall * 9);
+  std::vector<float > scale(nloc, 1.0);
+  std::vector<float > tab_data_f(tab_data.begin(), tab_data.end());
+  std::vector<float > rij_f(rij.begin(), rij.end());
+  std::vector<double > energy_d(nloc);
+  std::vector<double > force_d(nall * 3);
+  std::vector<double > virial_d(nall * 9);
+  std::vector<double > scale_d(nloc, 1.0);
+
+  deepmd::pair_tab_cpu(
+      &energy[0], &force[0], &virial[0],
+      &tab_info[0], &tab_data_f[0], &rij_f[0], &scale[0],
+      &atype_cpy[0], &nlist[0], &natoms[0], sel_a, sel_r);
+  deepmd::pair_tab_cpu(
+      &energy_d[0], &force_d[0], &virial_d[0],
+      &tab_info[0], &tab_data[0], &rij[0], &scale_d[0],
+      &atype_cpy[0], &nlist[0], &natoms[0], sel_a, sel_r);
+  for (int ii = 0; ii < nloc; ++ii){
+    EXPECT_LT(fabs(energy[ii] - expected_energy[ii]), 1e-5);
+  }
+  for (int ii = 0; ii < nall * 3; ++ii){
+    EXPECT_LT(fabs(force[ii] - force_d[ii]), 1e-5);
+  }
+  for (int ii = 0; ii < nall * 9; ++ii){
+    EXPECT_LT(fabs(virial[ii] - virial_d[ii]), 1e-5);
+  }
+}
+
+TEST_F(TestPairTab, cpu_lower_bound)
+{
+  std::vector<double > energy(nloc);
+  std::vector<double > force(nall * 3);
+  std::vector<double > virial(nall * 9);
+  std::vector<double > scale(nloc, 1.0);
+  // shift the table, so the pairs closer than 2 go beyond the lower boundary
+  std::vector<double > tab_info_shift(tab_info);
+  tab_info_shift[0] = 2.;
+  int expected_nviolate = 0;
+  for (int ii = 0; ii < nloc; ++ii){
+    for (int jj = 0; jj < nnei; ++jj){
+      if (nlist[ii*nnei + jj] < 0) continue;
+      const double * dr = &rij[(ii*nnei + jj)*3];
+      if (sqrt(dr[0]*dr[0] + dr[1]*dr[1] + dr[2]*dr[2]) < tab_info_shift[0]) expected_nviolate ++;
+    }
+  }
+  EXPECT_GT(expected_nviolate, 0);
+
+  int nviolate = deepmd::pair_tab_cpu(
+      &energy[0], &force[0], &virial[0],
+      &tab_info_shift[0], &tab_data[0], &rij[0], &scale[0],
+      &atype_cpy[0], &nlist[0], &natoms[0], sel_a, sel_r);
+  EXPECT_EQ(nviolate, expected_nviolate);
+  for (int ii = 0; ii < nloc; ++ii){
+    EXPECT_FALSE(std::isnan(energy[ii]));
+  }
+  nviolate = deepmd::pair_tab_cpu(
+      &energy[0], &force[0], &virial[0],
+      &tab_info[0], &tab_data[0], &rij[0], &scale[0],
+      &atype_cpy[0], &nlist[0], &natoms[0], sel_a, sel_r);
+  EXPECT_EQ(nviolate, 0);
+}
@@ -0,0 +1,259 @@
+#include <iostream>
+#include <cmath>
+#include <gtest/gtest.h>
+#include "fmt_nlist.h"
+#include "prod_env_mat.h"
+#include "neighbor_list.h"
+#include "tabulate.h"
+
+class TestProdEnvMatTabulate : public ::testing::Test
+{
+protected:
+  std::vector<double > posi = {12.83, 2.56, 2.18,
+			       12.09, 2.87, 2.74,
+			       00.25, 3.32, 1.68,
+			       3.36, 3.00, 1.81,
+			       3.51, 2.51, 2.60,
+			       4.27, 3.22, 1.56
+  };
+  std::vector<int > atype = {0, 1, 1, 0, 1, 1};
+  std::vector<double > posi_cpy;
+  std::vector<int > atype_cpy;
+  int nloc, nall;
+  double rc = 6;
+  double rc_smth = 0.8;
+  SimulationRegion<double > region;
+  std::vector<int> mapping, ncell, ngcell;
+  std::vector<int> sec_a = {0, 5, 10};
+  std::vector<int> nat_stt, ext_stt, ext_end;
+  std::vector<std::vector<int>> nlist_a_cpy, nlist_r_cpy;
+  int ntypes = sec_a.size()-1;
+  int nnei = sec_a.back();
+  int ndescrpt = nnei * 4;
+  std::vector<double> avg, std;
+  // the tables of ntypes x ntypes nets 1 -> 4 -> 8
+  std::vector<int> layer_size = {1, 4, 8};
+  int last_layer_size = 8;
+  std::vector<double> info = {-1, 2, 10, 0.01, 0.1, -1};
+  int nspline = 380;
+  int nnet = ntypes * ntypes;
+  std::vector<double> table;
+  // the inputs of the nlist
+  int max_nbor_size;
+  std::vector<int> ilist, numneigh;
+  std::vector<int*> firstneigh;
+
+  void SetUp() override {
+    double box[] = {13., 0., 0., 0., 13., 0., 0., 0., 13.};
+    region.reinitBox(box);
+    copy_coord(posi_cpy, atype_cpy, mapping, ncell, ngcell, posi, atype, rc, region);
+    nloc = posi.size() / 3;
+    nall = posi_cpy.size() / 3;
+    nat_stt.resize(3);
+    ext_stt.resize(3);
+    ext_end.resize(3);
+    for (int dd = 0; dd < 3; ++dd){
+      ext_stt[dd] = -ngcell[dd];
+      ext_end[dd] = ncell[dd] + ngcell[dd];
+    }
+    build_nlist(nlist_a_cpy, nlist_r_cpy, posi_cpy, nloc, rc, rc, nat_stt, ncell, ext_stt, ext_end, region, ncell);
+    max_nbor_size = 0;
+    ilist.resize(nloc);
+    numneigh.resize(nloc);
+    firstneigh.resize(nloc);
+    for (int ii = 0; ii < nloc; ++ii){
+      ilist[ii] = ii;
+      numneigh[ii] = nlist_a_cpy[ii].size();
+      firstneigh[ii] = &nlist_a_cpy[ii][0];
+      max_nbor_size = std::max(max_nbor_size, numneigh[ii]);
+    }
+    avg.resize(ntypes * ndescrpt);
+    std.resize(ntypes * ndescrpt);
+    for (int ii = 0; ii < ntypes * ndescrpt; ++ii){
+      avg[ii] = 0.01 * (ii % 4);
+      std[ii] = 1. + 0.1 * (ii % 4);
+    }
+    // the weights and biases of the nets, different for each net
+    std::vector<std::vector<double> > matrix(2), bias(2);
+    for (int ll = 0; ll < 2; ++ll){
+      matrix[ll].resize(nnet * layer_size[ll] * layer_size[ll+1]);
+      bias[ll].resize(nnet * layer_size[ll+1]);
+      for (unsigned jj = 0; jj < matrix[ll].size(); ++jj){
+	matrix[ll][jj] = sin(0.7 * jj + ll + 0.3);
+      }
+      for (unsigned jj = 0; jj < bias[ll].size(); ++jj){
+	bias[ll][jj] = 0.1 * cos(1.3 * jj + ll);
+      }
+    }
+    const double * p_matrix[] = {&matrix[0][0], &matrix[1][0]};
+    const double * p_bias[] = {&bias[0][0], &bias[1][0]};
+    table.resize(nnet * nspline * 6 * last_layer_size);
+    deepmd::build_tabulate_table_cpu(&table[0], p_matrix, p_bias, &layer_size[0], &info[0], 2, nnet, nspline, 1);
+  }
+  void TearDown() override {
+  }
+  // the net of the neighbors of type tt of the atom ii
+  int net_index(const int ii, const int tt, const bool type_one_side) {
+    return type_one_side ? tt : atype_cpy[ii] * ntypes + tt;
+  }
+};
+
+TEST_F(TestProdEnvMatTabulate, cpu)
+{
+  for (int type_one_side = 0; type_one_side < 2; ++type_one_side){
+    deepmd::InputNlist inlist(nloc, &ilist[0], &numneigh[0], &firstneigh[0]);
+    std::vector<double> em(nloc * ndescrpt), em_deriv(nloc * ndescrpt * 3), rij(nloc * nnei * 3);
+    std::vector<int> nlist(nloc * nnei);
+    std::vector<double> descriptor(nloc * 4 * last_layer_size);
+    const double * p_coord = &posi_cpy[0];
+    const int * p_type = &atype_cpy[0];
+    deepmd::prod_env_mat_a_tabulate_batch_cpu(
+	&descriptor[0], &em[0], &em_deriv[0], &rij[0], &nlist[0],
+	&p_coord, &p_type, &inlist, &nall, 1, max_nbor_size, &avg[0], &std[0],
+	&table[0], &info[0], nloc, rc, rc_smth, sec_a, nspline, last_layer_size, type_one_side);
+    // the environment matrix is the one of prod_env_mat_a_cpu
+    std::vector<double> em_1(nloc * ndescrpt), em_deriv_1(nloc * ndescrpt * 3), rij_1(nloc * nnei * 3);
+    std::vector<int> nlist_1(nloc * nnei);
+    deepmd::prod_env_mat_a_cpu(
+	&em_1[0], &em_deriv_1[0], &rij_1[0], &nlist_1[0],
+	&posi_cpy[0], &atype_cpy[0], inlist, max_nbor_size, &avg[0], &std[0], nloc, nall, rc, rc_smth, sec_a);
+    for (int jj = 0; jj < nloc * ndescrpt; ++jj){
+      EXPECT_EQ(em[jj], em_1[jj]);
+    }
+    for (int jj = 0; jj < nloc * ndescrpt * 3; ++jj){
+      EXPECT_EQ(em_deriv[jj], em_deriv_1[jj]);
+    }
+    for (int jj = 0; jj < nloc * nnei; ++jj){
+      EXPECT_EQ(nlist[jj], nlist_1[jj]);
+    }
+    // the descriptor is the sum of tabulate_fusion_cpu over the types of the neighbors
+    for (int ii = 0; ii < nloc; ++ii){
+      std::vector<double> expected(4 * last_layer_size, 0.);
+      for (int tt = 0; tt < ntypes; ++tt){
+	const int nsel = sec_a[tt+1] - sec_a[tt];
+	std::vector<double> em_sec(&em_1[ii * ndescrpt + sec_a[tt] * 4], &em_1[ii * ndescrpt + sec_a[tt+1] * 4]);
+	std::vector<double> em_x(nsel);
+	for (int jj = 0; jj < nsel; ++jj){
+	  em_x[jj] = em_sec[jj * 4];
+	}
+	std::vector<double> out(4 * last_layer_size);
+	deepmd::tabulate_fusion_cpu(&out[0], &table[net_index(ii, tt, type_one_side) * nspline * 6 * last_layer_size], &info[0], &em_x[0], &em_sec[0], 1, nsel, last_layer_size);
+	for (int kk = 0; kk < 4 * last_layer_size; ++kk){
+	  expected[kk] += out[kk];
+	}
+      }
+      for (int kk = 0; kk < 4 * last_layer_size; ++kk){
+	EXPECT_LT(fabs(descriptor[ii * 4 * last_layer_size + kk] - expected[kk]), 1e-12);
+      }
+    }
+  }
+}
+
+TEST_F(TestProdEnvMatTabulate, grad_cpu)
+{
+  for (int type_one_side = 0; type_one_side < 2; ++type_one_side){
+    deepmd::InputNlist inlist(nloc, &ilist[0], &numneigh[0], &firstneigh[0]);
+    std::vector<double> em(nloc * ndescrpt), em_deriv(nloc * ndescrpt * 3), rij(nloc * nnei * 3);
+    std::vector<int> nlist(nloc * nnei);
+    deepmd::prod_env_mat_a_cpu(
+	&em[0], &em_deriv[0], &rij[0], &nlist[0],
+	&posi_cpy[0], &atype_cpy[0], inlist, max_nbor_size, &avg[0], &std[0], nloc, nall, rc, rc_smth, sec_a);
+    std::vector<double> dy(nloc * 4 * last_layer_size);
+    for (unsigned jj = 0; jj < dy.size(); ++jj){
+      dy[jj] = cos(0.37 * jj);
+    }
+    std::vector<double> dy_dem(nloc * ndescrpt);
+    deepmd::tabulate_fusion_se_a_grad_cpu(
+	&dy_dem[0], &table[0], &info[0], &em[0], &nlist[0], &atype_cpy[0], &dy[0], nloc, nspline, last_layer_size, sec_a, type_one_side);
+    // the gradient of em_x of tabulate_fusion_grad_cpu is added to the first column
+    for (int ii = 0; ii < nloc; ++ii){
+      for (int tt = 0; tt < ntypes; ++tt){
+	const int nsel = sec_a[tt+1] - sec_a[tt];
+	std::vector<double> em_sec(&em[ii * ndescrpt + sec_a[tt] * 4], &em[ii * ndescrpt + sec_a[tt+1] * 4]);
+	std::vector<double> em_x(nsel);
+	for (int jj = 0; jj < nsel; ++jj){
+	  em_x[jj] = em_sec[jj * 4];
+	}
+	std::vector<double> dy_dem_x_1(nsel), dy_dem_1(nsel * 4);
+	deepmd::tabulate_fusion_grad_cpu(&dy_dem_x_1[0], &dy_dem_1[0], &table[net_index(ii, tt, type_one_side) * nspline * 6 * last_layer_size], &info[0], &em_x[0], &em_sec[0], &dy[ii * 4 * last_layer_size], 1, nsel, last_layer_size);
+	for (int jj = 0; jj < nsel; ++jj){
+	  for (int dd = 0; dd < 4; ++dd){
+	    double expected = dy_dem_1[jj * 4 + dd] + (dd == 0 ? dy_dem_x_1[jj] : 0.);
+	    EXPECT_LT(fabs(dy_dem[ii * ndescrpt + (sec_a[tt] + jj) * 4 + dd] - expected), 1e-12);
+	  }
+	}
+      }
+    }
+  }
+}
+
+TEST_F(TestProdEnvMatTabulate, grad_grad_cpu)
+{
+  // dy_dem is linear in dy, its gradient with respect to dy is the adjoint
+  for (int type_one_side = 0; type_one_side < 2; ++type_one_side){
+    deepmd::InputNlist inlist(nloc, &ilist[0], &numneigh[0], &firstneigh[0]);
+    std::vector<double> em(nloc * ndescrpt), em_deriv(nloc * ndescrpt * 3), rij(nloc * nnei * 3);
+    std::vector<int> nlist(nloc * nnei);
+    deepmd::prod_env_mat_a_cpu(
+	&em[0], &em_deriv[0], &rij[0], &nlist[0],
+	&posi_cpy[0], &atype_cpy[0], inlist, max_nbor_size, &avg[0], &std[0], nloc, nall, rc, rc_smth, sec_a);
+    std::vector<double> dy(nloc * 4 * last_layer_size), dz_dy_dem(nloc * ndescrpt);
+    for (unsigned jj = 0; jj < dy.size(); ++jj){
+      dy[jj] = cos(0.37 * jj);
+    }
+    for (unsigned jj = 0; jj < dz_dy_dem.size(); ++jj){
+      dz_dy_dem[jj] = sin(0.53 * jj);
+    }
+    std::vector<double> dy_dem(nloc * ndescrpt), dz_dy(nloc * 4 * last_layer_size);
+    deepmd::tabulate_fusion_se_a_grad_cpu(
+	&dy_dem[0], &table[0], &info[0], &em[0], &nlist[0], &atype_cpy[0], &dy[0], nloc, nspline, last_layer_size, sec_a, type_one_side);
+    deepmd::tabulate_fusion_se_a_grad_grad_cpu(
+	&dz_dy[0], &table[0], &info[0], &em[0], &nlist[0], &atype_cpy[0], &dz_dy_dem[0], nloc, nspline, last_layer_size, sec_a, type_one_side);
+    double lhs = 0, rhs = 0;
+    for (unsigned jj = 0; jj < dy_dem.size(); ++jj){
+      lhs += dz_dy_dem[jj] * dy_dem[jj];
+    }
+    for (unsigned jj = 0; jj < dy.size(); ++jj){
+      rhs += dz_dy[jj] * dy[jj];
+    }
+    EXPECT_LT(fabs(lhs - rhs), 1e-10 * (fabs(lhs) + 1.));
+  }
+}
+
+TEST_F(TestProdEnvMatTabulate, grad_finite_difference)
+{
+  // the gradient of the descriptor with respect to em, checked on a non-padded neighbor
+  const bool type_one_side = false;
+  deepmd::InputNlist inlist(nloc, &ilist[0], &numneigh[0], &firstneigh[0]);
+  std::vector<double> em(nloc * ndescrpt), em_deriv(nloc * ndescrpt * 3), rij(nloc * nnei * 3);
+  std::vector<int> nlist(nloc * nnei);
+  deepmd::prod_env_mat_a_cpu(
+      &em[0], &em_deriv[0], &rij[0], &nlist[0],
+      &posi_cpy[0], &atype_cpy[0], inlist, max_nbor_size, &avg[0], &std[0], nloc, nall, rc, rc_smth, sec_a);
+  std::vector<double> dy(4 * last_layer_size);
+  for (unsigned jj = 0; jj < dy.size(); ++jj){
+    dy[jj] = cos(0.37 * jj);
+  }
+  const int ii = 0, tt = 1, jj = 0;
+  const int nsel = sec_a[tt+1] - sec_a[tt];
+  const double * p_table = &table[net_index(ii, tt, type_one_side) * nspline * 6 * last_layer_size];
+  std::vector<double> em_sec(&em[ii * ndescrpt + sec_a[tt] * 4], &em[ii * ndescrpt + sec_a[tt+1] * 4]);
+  ASSERT_GE(nlist[ii * nnei + sec_a[tt] + jj], 0);
+  const int nvalid = deepmd::count_nlist_valid(&nlist[ii * nnei + sec_a[tt]], nsel);
+  std::vector<double> dy_dem(nsel * 4);
+  deepmd::tabulate_fusion_grad_atom_cpu(&dy_dem[0], p_table, &info[0], &em_sec[0], &dy[0], nsel, nvalid, last_layer_size);
+  const double hh = 1e-5;
+  for (int dd = 0; dd < 4; ++dd){
+    std::vector<double> em_p(em_sec), em_m(em_sec);
+    em_p[jj * 4 + dd] += hh;
+    em_m[jj * 4 + dd] -= hh;
+    std::vector<double> out_p(4 * last_layer_size, 0.), out_m(4 * last_layer_size, 0.);
+    deepmd::tabulate_fusion_atom_cpu(&out_p[0], p_table, &info[0], &em_p[0], nsel, nvalid, last_layer_size);
+    deepmd::tabulate_fusion_atom_cpu(&out_m[0], p_table, &info[0], &em_m[0], nsel, nvalid, last_layer_size);
+    double num = 0;
+    for (int kk = 0; kk < 4 * last_layer_size; ++kk){
+      num += dy[kk] * (out_p[kk] - out_m[kk]) / (2 * hh);
+    }
+    EXPECT_LT(fabs(dy_dem[jj * 4 + dd] - num), 1e-6);
+  }
+}
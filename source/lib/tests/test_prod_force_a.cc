@@ -98,6 +98,17 @@ TEST_F(TestProdForceA, cpu)
   // printf("\n");
 }
 
+TEST_F(TestProdForceA, cpu_sec)
+{
+  // only the valid neighbors of each type are visited
+  std::vector<double> force(nall * 3);
+  deepmd::prod_force_a_cpu<double> (&force[0], &net_deriv[0], &env_deriv[0], &nlist[0], nloc, nall, nnei, sec_a);
+  EXPECT_EQ(force.size(), expected_force.size());
+  for (int jj = 0; jj < force.size(); ++jj){
+    EXPECT_LT(fabs(force[jj] - expected_force[jj]) , 1e-5);
+  }  
+}
+
 #if GOOGLE_CUDA
 TEST_F(TestProdForceA, gpu_cuda)
 {
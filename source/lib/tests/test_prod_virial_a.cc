@@ -113,6 +113,30 @@ TEST_F(TestProdVirialA, cpu)
   // printf("\n");
 }
 
+TEST_F(TestProdVirialA, cpu_no_atom_virial)
+{
+  std::vector<double> virial(9);
+  deepmd::prod_virial_a_cpu<double> (&virial[0], NULL, &net_deriv[0], &env_deriv[0], &rij[0], &nlist[0], nloc, nall, nnei);
+  EXPECT_EQ(virial.size(), expected_virial.size());
+  for (int jj = 0; jj < virial.size(); ++jj){
+    EXPECT_LT(fabs(virial[jj] - expected_virial[jj]) , 1e-5);
+  }  
+}
+
+TEST_F(TestProdVirialA, cpu_sec)
+{
+  // only the valid neighbors of each type are visited
+  std::vector<double> virial(9);
+  std::vector<double> atom_virial(nall * 9);
+  deepmd::prod_virial_a_cpu<double> (&virial[0], &atom_virial[0], &net_deriv[0], &env_deriv[0], &rij[0], &nlist[0], nloc, nall, nnei, sec_a);
+  for (int jj = 0; jj < virial.size(); ++jj){
+    EXPECT_LT(fabs(virial[jj] - expected_virial[jj]) , 1e-5);
+  }  
+  for (int jj = 0; jj < atom_virial.size(); ++jj){
+    EXPECT_LT(fabs(atom_virial[jj] - expected_atom_virial[jj]) , 1e-5);
+  }  
+}
+
 #if GOOGLE_CUDA
 TEST_F(TestProdVirialA, gpu_cuda)
 {
@@ -4,6 +4,7 @@
 #include "env_mat.h"
 #include "neighbor_list.h"
 #include "prod_virial_grad.h"
+#include "prod_force_grad.h"
 #include "device.h"
 
 class TestProdVirialGradA : public ::testing::Test
@@ -101,6 +102,22 @@ TEST_F(TestProdVirialGradA, cpu)
   // printf("\n");
 }
 
+TEST_F(TestProdVirialGradA, cpu_fused_force)
+{
+  std::vector<double> grad_force(nloc * 3);
+  for (int ii = 0; ii < nloc * 3; ++ii){
+    grad_force[ii] = 1. - ii * 0.1;
+  }
+  std::vector<double> grad_net_f(nloc * ndescrpt), grad_net_v(nloc * ndescrpt);
+  deepmd::prod_force_grad_a_cpu<double> (&grad_net_f[0], &grad_force[0], &env_deriv[0], &nlist[0], nloc, nnei);
+  deepmd::prod_virial_grad_a_cpu<double> (&grad_net_v[0], &grad[0], &env_deriv[0], &rij[0], &nlist[0], nloc, nnei);
+  std::vector<double> grad_net(nloc * ndescrpt);
+  deepmd::prod_force_virial_grad_a_cpu<double> (&grad_net[0], &grad_force[0], &grad[0], &env_deriv[0], &rij[0], &nlist[0], nloc, nnei);
+  for (int jj = 0; jj < grad_net.size(); ++jj){
+    EXPECT_LT(fabs(grad_net[jj] - grad_net_f[jj] - grad_net_v[jj]) , 1e-10);
+  }  
+}
+
 #if GOOGLE_CUDA
 TEST_F(TestProdVirialGradA, gpu)
 {
@@ -113,6 +113,16 @@ TEST_F(TestProdVirialR, cpu)
   // printf("\n");
 }
 
+TEST_F(TestProdVirialR, cpu_no_atom_virial)
+{
+  std::vector<double> virial(9);
+  deepmd::prod_virial_r_cpu<double> (&virial[0], NULL, &net_deriv[0], &env_deriv[0], &rij[0], &nlist[0], nloc, nall, nnei);
+  EXPECT_EQ(virial.size(), expected_virial.size());
+  for (int jj = 0; jj < virial.size(); ++jj){
+    EXPECT_LT(fabs(virial[jj] - expected_virial[jj]) , 1e-5);
+  }  
+}
+
 #if GOOGLE_CUDA
 TEST_F(TestProdVirialR, gpu_cuda)
 {
@@ -20,12 +20,6 @@
 
 using namespace LAMMPS_NS;
 
-#ifdef HIGH_PREC
-#define VALUETYPE double
-#else
-#define VALUETYPE float
-#endif
-
 /* ---------------------------------------------------------------------- */
 
 ComputeDeeptensorAtom::ComputeDeeptensorAtom(LAMMPS *lmp, int narg, char **arg) :
@@ -103,8 +97,8 @@ void ComputeDeeptensorAtom::compute_peratom()
   int nall = nlocal + nghost;
   int newton_pair = force->newton_pair;
 
-  std::vector<VALUETYPE > dcoord (nall * 3, 0.);
-  std::vector<VALUETYPE > dbox (9, 0) ;
+  std::vector<double > dcoord (nall * 3, 0.);
+  std::vector<double > dbox (9, 0) ;
   std::vector<int > dtype (nall);
   // get type
   for (int ii = 0; ii < nall; ++ii){
@@ -129,11 +123,12 @@ void ComputeDeeptensorAtom::compute_peratom()
   deepmd::InputNlist lmp_list (list->inum, list->ilist, list->numneigh, list->firstneigh);
   
   // declare outputs
-  std::vector<VALUETYPE > gtensor, force, virial, atensor, avirial;
+  std::vector<double > gtensor, force, virial, atensor, avirial;
 
-  // compute tensors
+  // compute tensors, only the atomic tensor is used
   dt.compute (gtensor, force, virial, atensor, avirial,
-	      dcoord, dtype, dbox, nghost, lmp_list);
+	      dcoord, dtype, dbox, nghost, lmp_list,
+	      deepmd::DeepTensor::OUTPUT_ATOM);
   
   // store the result in tensor
   int iter_tensor = 0;
@@ -251,8 +251,8 @@ void FixDPLR::pre_force(int vflag)
   
   // declear inputs
   vector<int > dtype (nall);
-  vector<FLOAT_PREC > dbox (9, 0) ;
-  vector<FLOAT_PREC > dcoord (nall * 3, 0.);
+  vector<double > dbox (9, 0) ;
+  vector<double > dcoord (nall * 3, 0.);
   // get type
   for (int ii = 0; ii < nall; ++ii){
     dtype[ii] = type[ii] - 1;
@@ -274,9 +274,9 @@ void FixDPLR::pre_force(int vflag)
   NeighList * list = pair_deepmd->list;
   deepmd::InputNlist lmp_list (list->inum, list->ilist, list->numneigh, list->firstneigh);
   // declear output
-  vector<FLOAT_PREC> tensor;
+  vector<double> tensor;
   // compute
-  dpt.compute(tensor, dcoord, dtype, dbox, nghost, lmp_list);
+  dpt.compute(tensor, dcoord, dtype, dbox, nghost, lmp_list, neighbor->ago);
   // cout << "tensor of size " << tensor.size() << endl;
   // cout << "nghost " << nghost << endl;
   // cout << "nall " << dtype.size() << endl;
@@ -315,7 +315,7 @@ void FixDPLR::pre_force(int vflag)
   deepmd::select_map<int>(sel_type, dtype, sel_fwd, 1);
   
   // Yixiao: because the deeptensor already return the correct order, the following map is no longer needed
-  // deepmd::AtomMap<FLOAT_PREC> atom_map(sel_type.begin(), sel_type.begin() + sel_nloc);
+  // deepmd::AtomMap atom_map(sel_type.begin(), sel_type.begin() + sel_nloc);
   // const vector<int> & sort_fwd_map(atom_map.get_fwd_map());
 
   vector<pair<int,int> > valid_pairs;
@@ -370,7 +370,7 @@ void FixDPLR::post_force(int vflag)
   int nlocal = atom->nlocal;
   int nghost = atom->nghost;
   int nall = nlocal + nghost;
-  vector<FLOAT_PREC> dcoord(nall*3, 0.0), dbox(9, 0.0), dfele(nlocal*3, 0.0);
+  vector<double> dcoord(nall*3, 0.0), dbox(9, 0.0), dfele(nlocal*3, 0.0);
   vector<int> dtype(nall, 0);
   // set values for dcoord, dbox, dfele
   {
@@ -434,9 +434,9 @@ void FixDPLR::post_force(int vflag)
   vector<pair<int,int> > valid_pairs;
   get_valid_pairs(valid_pairs);  
   // output vects
-  vector<FLOAT_PREC> dfcorr, dvcorr;
+  vector<double> dfcorr, dvcorr;
   // compute
-  dtm.compute(dfcorr, dvcorr, dcoord, dtype, dbox, valid_pairs, dfele, nghost, lmp_list);
+  dtm.compute(dfcorr, dvcorr, dcoord, dtype, dbox, valid_pairs, dfele, nghost, lmp_list, neighbor->ago);
   assert(dfcorr.size() == dcoord.size());
   assert(dfcorr.size() == nall * 3);
   // backward communication of fcorr
@@ -18,12 +18,6 @@ FixStyle(dplr,FixDPLR)
 #include "deepmd/DataModifier.h"
 #endif
 
-#ifdef HIGH_PREC
-#define FLOAT_PREC double
-#else
-#define FLOAT_PREC float
-#endif
-
 namespace LAMMPS_NS {
   class FixDPLR : public Fix {
 public:
@@ -50,7 +44,7 @@ private:
     std::vector<int > bond_type;
     std::map<int,int > type_asso;
     std::map<int,int > bk_type_asso;
-    std::vector<FLOAT_PREC> dipole_recd;
+    std::vector<double> dipole_recd;
     std::vector<double> dfcorr_buff;
     std::vector<double> efield;
     std::vector<double> efield_fsum, efield_fsum_all;
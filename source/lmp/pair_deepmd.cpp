@@ -2,6 +2,8 @@
 #include <string.h>
 #include <iomanip>
 #include <limits>
+#include <algorithm>
+#include <sys/stat.h>
 #include "atom.h"
 #include "domain.h"
 #include "comm.h"
@@ -110,6 +112,16 @@ std::string PairDeepMD::get_file_content(const std::string & model) {
   MPI_Comm_rank(MPI_COMM_WORLD, &myrank);
   int nchar = 0;
   std::string file_content;
+  // a memmapped model is mapped from the node-local file by every rank, 
+  // so that the ranks on a node share one copy of the constants
+  int memmapped = 0;
+  if (myrank == root) {
+    memmapped = deepmd::model_is_memmapped(model);
+  }
+  MPI_Bcast(&memmapped, 1, MPI_INT, root, MPI_COMM_WORLD);
+  if (memmapped) {
+    return file_content;
+  }
   if (myrank == root) {
     deepmd::check_status(tensorflow::ReadFileToString(tensorflow::Env::Default(), model, &file_content));
     nchar = file_content.size();
@@ -156,15 +168,9 @@ ana_st (double & max,
 
 static void 
 make_uniform_aparam(
-#ifdef HIGH_PREC    
     vector<double > & daparam,
     const vector<double > & aparam,
     const int & nlocal
-#else
-    vector<float > & daparam,
-    const vector<float > & aparam,
-    const int & nlocal
-#endif
     )
 {
   unsigned dim_aparam = aparam.size();
@@ -178,11 +184,7 @@ make_uniform_aparam(
 
 #ifdef USE_TTM
 void PairDeepMD::make_ttm_aparam(
-#ifdef HIGH_PREC
     vector<double > & daparam
-#else
-    vector<float > & daparam
-#endif
     )
 {
   assert(do_ttm);
@@ -257,6 +259,9 @@ PairDeepMD::PairDeepMD(LAMMPS *lmp)
   multi_models_mod_devi = false;
   multi_models_no_mod_devi = false;
   is_restart = false;
+  async_flag = false;
+  reload_freq = 0;
+  reload_started = false;
   // set comm size needed by this Pair
   comm_reverse = 1;
 
@@ -276,7 +281,6 @@ PairDeepMD::print_summary(const string pre) const
     cout << pre << "source branch:      " << STR_GIT_BRANCH << endl;
     cout << pre << "source commit:      " << STR_GIT_HASH << endl;
     cout << pre << "source commit at:   " << STR_GIT_DATE << endl;
-    cout << pre << "build float prec:   " << STR_FLOAT_PREC << endl;
     cout << pre << "build with tf inc:  " << STR_TensorFlow_INCLUDE_DIRS << endl;
     cout << pre << "build with tf lib:  " << STR_TensorFlow_LIBRARY << endl;
   }
@@ -295,6 +299,12 @@ PairDeepMD::~PairDeepMD()
 void PairDeepMD::compute(int eflag, int vflag)
 {
   if (numb_models == 0) return;
+  if (async_job.valid()) {
+    error->all(FLERR,"The asynchronous evaluation of the last step is not joined");
+  }
+  if (reload_freq > 0) reload_models();
+  // the statistics of the steps evaluated so far, including the one joined by compute_join
+  if (stat_freq > 0 && update->ntimestep % stat_freq == 0) report_nlist_stat();
   if (eflag || vflag) ev_setup(eflag,vflag);
   bool do_ghost = true;
   
@@ -319,11 +329,7 @@ void PairDeepMD::compute(int eflag, int vflag)
   vector<double > dvirial (9, 0);
   vector<double > dcoord (nall * 3, 0.);
   vector<double > dbox (9, 0) ;
-#ifdef HIGH_PREC
   vector<double > daparam;
-#else 
-  vector<float > daparam;
-#endif
 
   // get box
   dbox[0] = domain->h[0];	// xx
@@ -368,46 +374,21 @@ void PairDeepMD::compute(int eflag, int vflag)
     deepmd::InputNlist lmp_list (list->inum, list->ilist, list->numneigh, list->firstneigh);
     if (single_model || multi_models_no_mod_devi) {
       //cvflag_atom is the right flag for the cvatom matrix 
+      if ( ! (eflag_atom || cvflag_atom) && async_flag && single_model) {
+	// the inputs are consumed at launch, the forces are added by compute_join
+	async_eflag = eflag;
+	async_vflag = vflag;
+	async_job = deep_pot.compute_async (async_ener, async_force, async_virial, dcoord, dtype, dbox, nghost, lmp_list, ago, fparam, daparam);
+	return;
+      }
       if ( ! (eflag_atom || cvflag_atom) ) {      
-#ifdef HIGH_PREC
 	deep_pot.compute (dener, dforce, dvirial, dcoord, dtype, dbox, nghost, lmp_list, ago, fparam, daparam);
-#else
-	vector<float> dcoord_(dcoord.size());
-	vector<float> dbox_(dbox.size());
-	for (unsigned dd = 0; dd < dcoord.size(); ++dd) dcoord_[dd] = dcoord[dd];
-	for (unsigned dd = 0; dd < dbox.size(); ++dd) dbox_[dd] = dbox[dd];
-	vector<float> dforce_(dforce.size(), 0);
-	vector<float> dvirial_(dvirial.size(), 0);
-	double dener_ = 0;
-	deep_pot.compute (dener_, dforce_, dvirial_, dcoord_, dtype, dbox_, nghost, lmp_list, ago, fparam, daparam);
-	for (unsigned dd = 0; dd < dforce.size(); ++dd) dforce[dd] = dforce_[dd];	
-	for (unsigned dd = 0; dd < dvirial.size(); ++dd) dvirial[dd] = dvirial_[dd];	
-	dener = dener_;
-#endif
       }
       // do atomic energy and virial
       else {
 	vector<double > deatom (nall * 1, 0);
 	vector<double > dvatom (nall * 9, 0);
-#ifdef HIGH_PREC
 	deep_pot.compute (dener, dforce, dvirial, deatom, dvatom, dcoord, dtype, dbox, nghost, lmp_list, ago, fparam, daparam);
-#else 
-	vector<float> dcoord_(dcoord.size());
-	vector<float> dbox_(dbox.size());
-	for (unsigned dd = 0; dd < dcoord.size(); ++dd) dcoord_[dd] = dcoord[dd];
-	for (unsigned dd = 0; dd < dbox.size(); ++dd) dbox_[dd] = dbox[dd];
-	vector<float> dforce_(dforce.size(), 0);
-	vector<float> dvirial_(dvirial.size(), 0);
-	vector<float> deatom_(dforce.size(), 0);
-	vector<float> dvatom_(dforce.size(), 0);
-	double dener_ = 0;
-	deep_pot.compute (dener_, dforce_, dvirial_, deatom_, dvatom_, dcoord_, dtype, dbox_, nghost, lmp_list, ago, fparam, daparam);
-	for (unsigned dd = 0; dd < dforce.size(); ++dd) dforce[dd] = dforce_[dd];	
-	for (unsigned dd = 0; dd < dvirial.size(); ++dd) dvirial[dd] = dvirial_[dd];	
-	for (unsigned dd = 0; dd < deatom.size(); ++dd) deatom[dd] = deatom_[dd];	
-	for (unsigned dd = 0; dd < dvatom.size(); ++dd) dvatom[dd] = dvatom_[dd];	
-	dener = dener_;
-#endif	
 	if (eflag_atom) {
 	  for (int ii = 0; ii < nlocal; ++ii) eatom[ii] += deatom[ii];
 	}
@@ -439,7 +420,6 @@ void PairDeepMD::compute(int eflag, int vflag)
       vector<double > deatom (nall * 1, 0);
       vector<double > dvatom (nall * 9, 0);
       vector<vector<double>> 	all_virial;	       
-#ifdef HIGH_PREC
       vector<double> 		all_energy;
       vector<vector<double>> 	all_atom_energy;
       vector<vector<double>> 	all_atom_virial;
@@ -454,52 +434,6 @@ void PairDeepMD::compute(int eflag, int vflag)
       dvirial = all_virial[0];
       deatom = all_atom_energy[0];
       dvatom = all_atom_virial[0];
-#else 
-      vector<float> dcoord_(dcoord.size());
-      vector<float> dbox_(dbox.size());
-      for (unsigned dd = 0; dd < dcoord.size(); ++dd) dcoord_[dd] = dcoord[dd];
-      for (unsigned dd = 0; dd < dbox.size(); ++dd) dbox_[dd] = dbox[dd];
-      vector<float> dforce_(dforce.size(), 0);
-      vector<float> dvirial_(dvirial.size(), 0);
-      vector<float> deatom_(dforce.size(), 0);
-      vector<float> dvatom_(dforce.size(), 0);
-      double dener_ = 0;
-      vector<double> 		all_energy_;
-      vector<vector<float>>	all_force_;
-      vector<vector<float>> 	all_virial_;	       
-      vector<vector<float>> 	all_atom_energy_;
-      vector<vector<float>> 	all_atom_virial_;
-      deep_pot_model_devi.compute(all_energy_, all_force_, all_virial_, all_atom_energy_, all_atom_virial_, dcoord_, dtype, dbox_, nghost, lmp_list, ago, fparam, daparam);
-      // deep_pot_model_devi.compute_avg (dener_, all_energy_);
-      // deep_pot_model_devi.compute_avg (dforce_, all_force_);
-      // deep_pot_model_devi.compute_avg (dvirial_, all_virial_);
-      // deep_pot_model_devi.compute_avg (deatom_, all_atom_energy_);
-      // deep_pot_model_devi.compute_avg (dvatom_, all_atom_virial_);
-      dener_ = all_energy_[0];
-      dforce_ = all_force_[0];
-      dvirial_ = all_virial_[0];
-      deatom_ = all_atom_energy_[0];
-      dvatom_ = all_atom_virial_[0];
-      dener = dener_;
-      for (unsigned dd = 0; dd < dforce.size(); ++dd) dforce[dd] = dforce_[dd];	
-      for (unsigned dd = 0; dd < dvirial.size(); ++dd) dvirial[dd] = dvirial_[dd];	
-      for (unsigned dd = 0; dd < deatom.size(); ++dd) deatom[dd] = deatom_[dd];	
-      for (unsigned dd = 0; dd < dvatom.size(); ++dd) dvatom[dd] = dvatom_[dd];	
-      all_force.resize(all_force_.size());
-      for (unsigned ii = 0; ii < all_force_.size(); ++ii){
-	all_force[ii].resize(all_force_[ii].size());
-	for (unsigned jj = 0; jj < all_force_[ii].size(); ++jj){
-	  all_force[ii][jj] = all_force_[ii][jj];
-	}
-      }
-      all_virial.resize(all_virial_.size());
-      for (unsigned ii = 0; ii < all_virial_.size(); ++ii){
-        all_virial[ii].resize(all_virial_[ii].size());
-        for (unsigned jj = 0; jj < all_virial_[ii].size(); ++jj){
-          all_virial[ii][jj] = all_virial_[ii][jj];
-        }
-      }
-#endif
       if (eflag_atom) {
 	for (int ii = 0; ii < nlocal; ++ii) eatom[ii] += deatom[ii];
       }
@@ -532,28 +466,12 @@ void PairDeepMD::compute(int eflag, int vflag)
 	  comm->reverse_comm_pair(this);
 	}
 	vector<double> std_f;
-#ifdef HIGH_PREC
 	vector<double> tmp_avg_f;
 	deep_pot_model_devi.compute_avg (tmp_avg_f, all_force);  
 	deep_pot_model_devi.compute_std_f (std_f, tmp_avg_f, all_force);
 	if (out_rel == 1){
 	    deep_pot_model_devi.compute_relative_std_f (std_f, tmp_avg_f, eps);
 	}
-#else 
-	vector<float> tmp_avg_f_, std_f_;
-	for (unsigned ii = 0; ii < all_force_.size(); ++ii){
-	  for (unsigned jj = 0; jj < all_force_[ii].size(); ++jj){
-	    all_force_[ii][jj] = all_force[ii][jj];
-	  }
-	}
-	deep_pot_model_devi.compute_avg (tmp_avg_f_, all_force_);  
-	deep_pot_model_devi.compute_std_f (std_f_, tmp_avg_f_, all_force_);
-	std_f.resize(std_f_.size());
-	if (out_rel == 1){
-	    deep_pot_model_devi.compute_relative_std_f (std_f_, tmp_avg_f_, eps);
-	}
-	for (int dd = 0; dd < std_f_.size(); ++dd) std_f[dd] = std_f_[dd];
-#endif
 	double min = numeric_limits<double>::max(), max = 0, avg = 0;
 	ana_st(max, min, avg, std_f, nlocal);
 	int all_nlocal = 0;
@@ -565,17 +483,9 @@ void PairDeepMD::compute(int eflag, int vflag)
 	all_f_avg /= double(all_nlocal);
 	// std energy
 	vector<double > std_e;
-#ifdef HIGH_PREC
 	vector<double > tmp_avg_e;
 	deep_pot_model_devi.compute_avg (tmp_avg_e, all_atom_energy);
 	deep_pot_model_devi.compute_std_e (std_e, tmp_avg_e, all_atom_energy);
-#else 
-	vector<float> tmp_avg_e_, std_e_;
-	deep_pot_model_devi.compute_avg (tmp_avg_e_, all_atom_energy_);
-	deep_pot_model_devi.compute_std_e (std_e_, tmp_avg_e_, all_atom_energy_);
-	std_e.resize(std_e_.size());
-	for (int dd = 0; dd < std_e_.size(); ++dd) std_e[dd] = std_e_[dd];
-#endif	
 	max = avg = 0;
 	min = numeric_limits<double>::max();
 	ana_st(max, min, avg, std_e, nlocal);
@@ -593,13 +503,8 @@ void PairDeepMD::compute(int eflag, int vflag)
 	  }
 	}
 	MPI_Reduce(&send_v[0], &recv_v[0], 9 * numb_models, MPI_DOUBLE, MPI_SUM, 0, world);
-#ifdef HIGH_PREC
 	std::vector<std::vector<double>> all_virial_1(numb_models);
 	std::vector<double> avg_virial, std_virial;
-#else
-	std::vector<std::vector<float>> all_virial_1(numb_models);
-	std::vector<float> avg_virial, std_virial;
-#endif
 	for(int kk = 0; kk < numb_models; ++kk){
 	  all_virial_1[kk].resize(9);
 	  for(int ii = 0; ii < 9; ++ii){
@@ -678,21 +583,7 @@ void PairDeepMD::compute(int eflag, int vflag)
   }
   else {
     if (numb_models == 1) {
-#ifdef HIGH_PREC
       deep_pot.compute (dener, dforce, dvirial, dcoord, dtype, dbox);
-#else
-      vector<float> dcoord_(dcoord.size());
-      vector<float> dbox_(dbox.size());
-      for (unsigned dd = 0; dd < dcoord.size(); ++dd) dcoord_[dd] = dcoord[dd];
-      for (unsigned dd = 0; dd < dbox.size(); ++dd) dbox_[dd] = dbox[dd];
-      vector<float> dforce_(dforce.size(), 0);
-      vector<float> dvirial_(dvirial.size(), 0);
-      double dener_ = 0;
-      deep_pot.compute (dener_, dforce_, dvirial_, dcoord_, dtype, dbox_);
-      for (unsigned dd = 0; dd < dforce.size(); ++dd) dforce[dd] = dforce_[dd];	
-      for (unsigned dd = 0; dd < dvirial.size(); ++dd) dvirial[dd] = dvirial_[dd];	
-      dener = dener_;      
-#endif
     }
     else {
       error->all(FLERR,"Serial version does not support model devi");
@@ -718,6 +609,127 @@ void PairDeepMD::compute(int eflag, int vflag)
   }
 }
 
+// wait for the model launched by compute and add its force, energy and virial,
+// must be called before the ghost forces are reverse communicated
+void PairDeepMD::compute_join()
+{
+  if (! async_job.valid()) return;
+  async_job.get();
+
+  double **f = atom->f;
+  int nall = atom->nlocal + atom->nghost;
+  for (int ii = 0; ii < nall; ++ii){
+    for (int dd = 0; dd < 3; ++dd){
+      f[ii][dd] += scale[1][1] * async_force[3*ii+dd];
+    }
+  }
+  if (async_eflag) eng_vdwl += scale[1][1] * async_ener;
+  if (async_vflag) {
+    virial[0] += 1.0 * async_virial[0] * scale[1][1];
+    virial[1] += 1.0 * async_virial[4] * scale[1][1];
+    virial[2] += 1.0 * async_virial[8] * scale[1][1];
+    virial[3] += 1.0 * async_virial[3] * scale[1][1];
+    virial[4] += 1.0 * async_virial[6] * scale[1][1];
+    virial[5] += 1.0 * async_virial[7] * scale[1][1];
+  }
+}
+
+static time_t
+get_mtime (const string & file)
+{
+  struct stat st;
+  if (stat(file.c_str(), &st) != 0) return 0;
+  return st.st_mtime;
+}
+
+void PairDeepMD::reload_models()
+{
+  if (! reload_started) {
+    // the root rank checks the model files every reload_freq steps
+    if (update->ntimestep % reload_freq != 0) return;
+    int modified = 0;
+    if (comm->me == 0) {
+      for (unsigned ii = 0; ii < model_files.size(); ++ii){
+	time_t mtime = get_mtime(model_files[ii]);
+	if (mtime != model_mtimes[ii]) {
+	  model_mtimes[ii] = mtime;
+	  modified = 1;
+	}
+      }
+    }
+    MPI_Bcast(&modified, 1, MPI_INT, 0, world);
+    if (! modified) return;
+    // the new models are loaded on a separate thread, the current ones keep serving the steps
+    deep_pot.reload_async(model_files[0], get_node_rank(), get_file_content(model_files[0]));
+    if (numb_models > 1) {
+      deep_pot_model_devi.reload_async(model_files, get_node_rank(), get_file_content(model_files));
+    }
+    reload_started = true;
+    if (comm->me == 0) {
+      cout << "  >>> reloading model(s) at step " << update->ntimestep << endl;
+    }
+    return;
+  }
+  // all the ranks switch at the same step, once all of them have loaded the new models
+  int ready = deep_pot.reload_ready() && (numb_models == 1 || deep_pot_model_devi.reload_ready());
+  int all_ready = 0;
+  MPI_Allreduce(&ready, &all_ready, 1, MPI_INT, MPI_MIN, world);
+  if (! all_ready) return;
+  try {
+    deep_pot.commit_reload(true);
+    if (numb_models > 1) {
+      deep_pot_model_devi.commit_reload(true);
+    }
+  }
+  catch (std::runtime_error & e) {
+    error->one(FLERR, e.what());
+  }
+  reload_started = false;
+  if (comm->me == 0) {
+    cout << "  >>> switched to the reloaded model(s) at step " << update->ntimestep << endl;
+  }
+}
+
+void PairDeepMD::report_nlist_stat()
+{
+  deepmd::NlistStat stat;
+  deepmd::DeepPot::get_nlist_stat(stat);
+  // the ranks without atoms have no types in the statistics
+  std::vector<long long> sum_send(4 + 2 * numb_types, 0), sum_recv(4 + 2 * numb_types, 0);
+  std::vector<int> max_send(1 + 2 * numb_types, 0), max_recv(1 + 2 * numb_types, 0);
+  sum_send[0] = stat.natoms;
+  sum_send[1] = stat.nbuild;
+  sum_send[2] = stat.nretry;
+  sum_send[3 + 2 * numb_types] = stat.nphantom;
+  max_send[0] = stat.max_nbor_size;
+  for (int tt = 0; tt < std::min(stat.ntypes(), numb_types); ++tt){
+    sum_send[3 + tt] = stat.nnei_sum[tt];
+    sum_send[3 + numb_types + tt] = stat.noverflow[tt];
+    max_send[1 + tt] = stat.nnei_max[tt];
+    max_send[1 + numb_types + tt] = stat.sel[tt];
+  }
+  MPI_Reduce(&sum_send[0], &sum_recv[0], sum_send.size(), MPI_LONG_LONG, MPI_SUM, 0, world);
+  MPI_Reduce(&max_send[0], &max_recv[0], max_send.size(), MPI_INT, MPI_MAX, 0, world);
+  // the phantom atoms of the padding have no neighbors, they would dilute the mean
+  long long natoms = sum_recv[0] - sum_recv[3 + 2 * numb_types];
+  if (comm->me != 0 || natoms <= 0) return;
+  cout << "  >>> nlist stat at step " << update->ntimestep 
+       << ": " << natoms << " atoms evaluated, " 
+       << sum_recv[1] << " builds, " << sum_recv[2] << " retries, max nbor size " << max_recv[0] << endl;
+  for (int tt = 0; tt < numb_types; ++tt){
+    long long noverflow = sum_recv[3 + numb_types + tt];
+    cout << "  >>>   type " << tt 
+	 << ": sel " << max_recv[1 + numb_types + tt]
+	 << " max " << max_recv[1 + tt]
+	 << " mean " << double(sum_recv[3 + tt]) / natoms
+	 << " overflow " << noverflow << endl;
+    if (noverflow > 0) {
+      char tmp[1024];
+      sprintf(tmp, "The neighbors of type %d of %lld atoms overflow sel, the farthest ones are dropped", tt, noverflow);
+      error->warning(FLERR, tmp);
+    }
+  }
+}
 
 void PairDeepMD::allocate()
 {
@@ -757,6 +769,9 @@ is_key (const string& input)
   keys.push_back("atomic");
   keys.push_back("relative");
   keys.push_back("relative_v");
+  keys.push_back("reload");
+  keys.push_back("pad");
+  keys.push_back("nlist_stat");
 
   for (int ii = 0; ii < keys.size(); ++ii){
     if (input == keys[ii]) {
@@ -808,6 +823,9 @@ void PairDeepMD::settings(int narg, char **arg)
   out_each = 0;
   out_rel = 0;
   eps = 0.;
+  reload_freq = 0;
+  pad_bucket = 0;
+  stat_freq = 0;
   fparam.clear();
   aparam.clear();
   while (iarg < narg) {
@@ -866,24 +884,43 @@ void PairDeepMD::settings(int narg, char **arg)
     }
     else if (string(arg[iarg]) == string("relative")) {
       out_rel = 1;
-#ifdef HIGH_PREC
       eps = atof(arg[iarg+1]);
-#else
-      eps = strtof(arg[iarg+1], NULL);
-#endif
       iarg += 2;
     }
     else if (string(arg[iarg]) == string("relative_v")) {
       out_rel_v = 1;
-#ifdef HIGH_PREC
       eps_v = atof(arg[iarg+1]);
-#else
-      eps_v = strtof(arg[iarg+1], NULL);
-#endif
+      iarg += 2;
+    }
+    else if (string(arg[iarg]) == string("reload")) {
+      if (iarg+1 >= narg) error->all(FLERR,"Illegal reload, not provided");
+      reload_freq = atoi(arg[iarg+1]);
+      iarg += 2;
+    }
+    else if (string(arg[iarg]) == string("pad")) {
+      if (iarg+1 >= narg) error->all(FLERR,"Illegal pad, not provided");
+      pad_bucket = atoi(arg[iarg+1]);
+      iarg += 2;
+    }
+    else if (string(arg[iarg]) == string("nlist_stat")) {
+      if (iarg+1 >= narg) error->all(FLERR,"Illegal nlist_stat, not provided");
+      stat_freq = atoi(arg[iarg+1]);
       iarg += 2;
     }
   }
   if (out_freq < 0) error->all(FLERR,"Illegal out_freq, should be >= 0");
+  if (reload_freq < 0) error->all(FLERR,"Illegal reload, should be >= 0");
+  if (pad_bucket < 0) error->all(FLERR,"Illegal pad, should be >= 0");
+  if (stat_freq < 0) error->all(FLERR,"Illegal nlist_stat, should be >= 0");
+  deepmd::DeepPot::enable_nlist_stat(stat_freq > 0);
+  // the padding is kept across the reloads of the model
+  deep_pot.set_padding(pad_bucket);
+  model_files = models;
+  model_mtimes.resize(models.size());
+  for (unsigned ii = 0; ii < models.size(); ++ii){
+    model_mtimes[ii] = comm->me == 0 ? get_mtime(models[ii]) : 0;
+  }
+  reload_started = false;
   if (do_ttm && aparam.size() > 0) {
     error->all(FLERR,"aparam and ttm should NOT be set simultaneously");
   }
@@ -990,6 +1027,9 @@ void PairDeepMD::coeff(int narg, char **arg)
 
 void PairDeepMD::init_style()
 {
+  // kspace is initialized before pair, so pppm/dplr, which joins the
+  // evaluation, has already enabled it. Otherwise nothing would join it.
+  if (force->kspace_match("pppm/dplr", 1) == NULL) async_flag = false;
   int irequest = neighbor->request(this,instance_me);
   neighbor->requests[irequest]->half = 0;
   neighbor->requests[irequest]->full = 1;  
@@ -1,5 +1,6 @@
 #include <math.h>
 #include "pppm_dplr.h"
+#include "pair_deepmd.h"
 #include "atom.h"
 #include "domain.h"
 #include "force.h"
@@ -38,6 +39,7 @@ PPPMDPLR::PPPMDPLR(LAMMPS *lmp) :
 #endif
 {
   triclinic_support = 1;
+  pair_deepmd = NULL;
 }
 
 /* ---------------------------------------------------------------------- */
@@ -55,13 +57,30 @@ void PPPMDPLR::init()
   // cout << " ninit pppm/dplr ---------------------- " << nlocal << endl;
   fele.resize(nlocal*3);
   fill(fele.begin(), fele.end(), 0.0);
+
+  // the short-range model runs while the charges are spread and the FFTs
+  // communicate, it is joined at the end of compute
+
+  pair_deepmd = (PairDeepMD *) force->pair_match("deepmd",1);
+  if (pair_deepmd) pair_deepmd->set_async(compute_flag);
 }
 
 /* ----------------------------------------------------------------------
-   compute the PPPM long-range force, energy, virial
+   compute the PPPM long-range force, energy, virial and join the
+   short-range model before the forces are summed
 ------------------------------------------------------------------------- */
 
 void PPPMDPLR::compute(int eflag, int vflag)
+{
+  compute_pppm(eflag,vflag);
+  if (pair_deepmd) pair_deepmd->compute_join();
+}
+
+/* ----------------------------------------------------------------------
+   compute the PPPM long-range force, energy, virial
+------------------------------------------------------------------------- */
+
+void PPPMDPLR::compute_pppm(int eflag, int vflag)
 {
   int i,j;
 
@@ -7,18 +7,14 @@ KSpaceStyle(pppm/dplr,PPPMDPLR)
 #ifndef LMP_PPPM_DPLR_H
 #define LMP_PPPM_DPLR_H
 
-#ifdef HIGH_PREC
-#define FLOAT_PREC double
-#else
-#define FLOAT_PREC float
-#endif
-
 #include "pppm.h"
 #include <iostream>
 #include <vector>
 
 namespace LAMMPS_NS {
 
+  class PairDeepMD;
+
   class PPPMDPLR : public PPPM {
 public:
 #if LAMMPS_VERSION_NUMBER<20181109
@@ -32,10 +28,12 @@ public:
     const std::vector<double > & get_fele() const {return fele;};
 protected:
     virtual void compute(int, int);
+    void compute_pppm(int, int);
     virtual void fieldforce_ik();
     virtual void fieldforce_ad();    
 private:
     std::vector<double > fele;
+    PairDeepMD * pair_deepmd;
   };
 
 }
@@ -12,6 +12,8 @@ class Gaussian
 public:
   void set_seed (unsigned long seed);
   void gen (double * vec, const int numb_gen);
+  // counter-based generation, the numbers only depend on the seed, the stream and their index
+  static void gen (double * vec, const int numb_gen, const unsigned long long seed, const unsigned long long stream);
 };
 
 
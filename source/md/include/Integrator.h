@@ -40,7 +40,8 @@ public:
 	       const double & dt, 
 	       const vector<int > & freez = vector<int> ()) const;
 private:
-  mutable Gaussian	gaussian;
+  long long int	rand_seed;
+  mutable unsigned long long	rand_counter;
   string	scheme;
   VALUETYPE	temperature;
   VALUETYPE	gamma;
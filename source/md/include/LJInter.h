@@ -25,12 +25,19 @@ public:
 		const vector<int> &		atype,
 		const SimulationRegion<VALUETYPE> &	region, 
 		const vector<vector<int > > &	nlist);
+  // the full neighbor list is built by the cell list, and the atoms are looped over in parallel
+  void compute (VALUETYPE &			ener,
+		vector<VALUETYPE> &		force,
+		vector<VALUETYPE> &		virial,
+		const vector<VALUETYPE> &	coord,
+		const vector<int> &		atype,
+		const SimulationRegion<VALUETYPE> &	region);
 private:
   VALUETYPE c6, c12, rc, rc2, one_over_6, one_over_12, one_over_rc6, one_over_rc12;
   void 
   lj_inner (VALUETYPE & ae,
 	    VALUETYPE & af,
-	    const VALUETYPE & r2);
+	    const VALUETYPE & r2) const;
 }
     ;
 
@@ -26,7 +26,15 @@ public:
 		const SimulationRegion<VALUETYPE> &	region, 
 		const vector<vector<int > > &	nlist)
       {lj_tab.compute (ener, force, virial, coord, atype, region, nlist);};
+  // the full neighbor list is built by the cell list, and the atoms are looped over in parallel
+  void compute (VALUETYPE &			ener,
+		vector<VALUETYPE> &		force,
+		vector<VALUETYPE> &		virial,
+		const vector<VALUETYPE> &	coord,
+		const vector<int> &		atype,
+		const SimulationRegion<VALUETYPE> &	region);
 private:
+  VALUETYPE rc;
   Tabulated lj_tab;
 }
     ;
@@ -37,14 +37,22 @@ public:
 		const vector<int> &		atype,
 		const SimulationRegion<VALUETYPE> &	region, 
 		const vector<vector<int > > &	nlist);
+  // the neighbor list is full, and the atoms are looped over in parallel
+  void compute_full (VALUETYPE &		ener,
+		     vector<VALUETYPE> &	force,
+		     vector<VALUETYPE> &	virial,
+		     const vector<VALUETYPE> &	coord,
+		     const vector<int> &	atype,
+		     const SimulationRegion<VALUETYPE> &	region, 
+		     const vector<vector<int > > &	nlist) const;
   void tb_inner (VALUETYPE & ae,
 		 VALUETYPE & af,
-		 const VALUETYPE & r2);
+		 const VALUETYPE & r2) const;
 private:
   VALUETYPE rc2, hi;
   vector<VALUETYPE> data;
   void compute_posi (int & idx, 
 		     VALUETYPE & eps,
-		     const VALUETYPE & rr);
+		     const VALUETYPE & rr) const;
 }
     ;
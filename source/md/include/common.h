@@ -1,12 +1,36 @@
 #pragma once
 
 #include "SimulationRegion.h"
+#include "neighbor_list.h"
 #include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 using namespace std;
 
 const double b2m_l = 10;
 const double b2m_e = 1.660539040e-21 / 1.602176621e-19;
 
+inline int
+get_md_nthreads ()
+{
+#ifdef _OPENMP
+  return omp_get_max_threads();
+#else
+  return 1;
+#endif
+}
+
+inline int
+get_md_thread_id ()
+{
+#ifdef _OPENMP
+  return omp_get_thread_num();
+#else
+  return 0;
+#endif
+}
+
 template <typename VALUETYPE>
 void
 clear (VALUETYPE &			ener,
@@ -24,6 +48,7 @@ normalize_coord (vector<VALUETYPE > & coord,
 		 const SimulationRegion<VALUETYPE > & region)
 {
   int natoms = coord.size() / 3;
+#pragma omp parallel for schedule(static)
   for (int ii = 0; ii < natoms; ++ii){
     double phys[3];
     for (int dd = 0; dd < 3; ++dd){
@@ -42,3 +67,32 @@ normalize_coord (vector<VALUETYPE > & coord,
   }
 }
 
+// build the full neighbor list of a periodic system by the cell list,
+// falls back to the brute force search if fewer than 3 cells fit in any direction
+template <typename VALUETYPE>
+void
+build_cell_nlist (vector<vector<int > > &		nlist,
+		  const vector<VALUETYPE > &		coord,
+		  const double &			rc,
+		  const SimulationRegion<VALUETYPE > &	region)
+{
+  vector<double > dcoord (coord.begin(), coord.end());
+  vector<double > dbox (region.getBoxTensor(), region.getBoxTensor() + 9);
+  SimulationRegion<double > dregion;
+  dregion.reinitBox (&dbox[0]);
+  double to_face[3];
+  dregion.toFaceDistance (to_face);
+  vector<int > grid (3);
+  bool small_box = false;
+  for (int dd = 0; dd < 3; ++dd){
+    grid[dd] = int(to_face[dd] / rc);
+    if (grid[dd] < 3) small_box = true;
+  }
+  vector<vector<int > > nlist_r;
+  if (small_box) {
+    build_nlist (nlist, nlist_r, dcoord, rc, rc, &dregion);
+  }
+  else {
+    build_nlist (nlist, nlist_r, dcoord, rc, rc, grid, dregion);
+  }
+}
@@ -1,5 +1,7 @@
 #include "common.h"
 #include "Integrator.h"
+#include "LJInter.h"
+#include "LJTab.h"
 #include "DeepPot.h"
 #include "Statistics.h"
 
@@ -146,6 +148,21 @@ int main(int argc, char * argv[])
     print_f = jdata["print_force"];
   }
 
+  // optional lennard-jones interaction added to the model, in the units of the model (A, eV)
+  LJInter * lj_inter = NULL;
+  LJTab * lj_tab = NULL;
+  if (jdata.find ("lj") != jdata.end()) {
+    VALUETYPE lj_c6 = jdata["lj"]["c6"];
+    VALUETYPE lj_c12 = jdata["lj"]["c12"];
+    VALUETYPE lj_rc = jdata["lj"]["rc"];
+    bool lj_use_tab = false;
+    if (jdata["lj"].find ("tab") != jdata["lj"].end()) {
+      lj_use_tab = jdata["lj"]["tab"];
+    }
+    if (lj_use_tab) lj_tab = new LJTab (lj_c6, lj_c12, lj_rc);
+    else lj_inter = new LJInter (lj_c6, lj_c12, lj_rc);
+  }
+
   Integrator<VALUETYPE> inte;
   ThermostatLangevin<VALUETYPE> thm (temperature, tau_t, seed);
   deepmd::DeepPot nnp (graph_file);
@@ -158,6 +175,8 @@ int main(int argc, char * argv[])
   nnp.compute (dener, dforce, dvirial, dcoord, dtype, dbox);
   // change virial to gromacs convention
   for (int ii = 0; ii < 9; ++ii) dvirial[ii] *= -0.5;
+  if (lj_inter) lj_inter->compute (dener, dforce, dvirial, dcoord, dtype, region);
+  if (lj_tab) lj_tab->compute (dener, dforce, dvirial, dcoord, dtype, region);
   st.record (dener, dvirial, dveloc, dmass, region);
   ofstream efout (ener_file);
   ofstream pforce;
@@ -174,6 +193,8 @@ int main(int argc, char * argv[])
     nnp.compute (dener, dforce, dvirial, dae, dav, dcoord, dtype, dbox);
     // change virial to gromacs convention
     for (int ii = 0; ii < 9; ++ii) dvirial[ii] *= -0.5;
+    if (lj_inter) lj_inter->compute (dener, dforce, dvirial, dcoord, dtype, region);
+    if (lj_tab) lj_tab->compute (dener, dforce, dvirial, dcoord, dtype, region);
     inte.stepVeloc (dveloc, dforce, dmass, 0.5*dt, freez);
     if ((ii + 1) % nener == 0) {
       st.record (dener, dvirial, dveloc, dmass, region);
@@ -212,6 +233,9 @@ int main(int argc, char * argv[])
   //   }
   //   oxyz << endl;
   // }
+
+  delete lj_inter;
+  delete lj_tab;
   
   return 0;
 }
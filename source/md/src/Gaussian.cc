@@ -24,4 +24,34 @@ gen (double * vec, const int numb_gen)
   }
 }
 
+// the output function of splitmix64
+static inline unsigned long long
+mix64 (unsigned long long zz)
+{
+  zz = (zz ^ (zz >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  zz = (zz ^ (zz >> 27)) * 0x94d049bb133111ebULL;
+  return zz ^ (zz >> 31);
+}
+
+// in (0,1), from the upper 53 bits
+static inline double
+to_real3 (const unsigned long long zz)
+{
+  return ((zz >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+void
+Gaussian::
+gen (double * vec, const int numb_gen, const unsigned long long seed, const unsigned long long stream)
+{
+  const unsigned long long golden = 0x9e3779b97f4a7c15ULL;
+  const unsigned long long key = mix64 (seed * golden + mix64 (stream + golden));
+  const double two_pi = 2.0*M_PI;
 
+#pragma omp parallel for schedule(static)
+  for (int ii = 0; ii < numb_gen; ++ii){
+    double u0 = to_real3 (mix64 (key + (2ULL * ii + 1) * golden));
+    double u1 = to_real3 (mix64 (key + (2ULL * ii + 2) * golden));
+    vec[ii] = sqrt(-2.0 * log(u0)) * cos(two_pi * u1);
+  }
+}
@@ -11,6 +11,7 @@ stepVeloc (vector<VALUETYPE > & vv,
 	   const vector<int > & freez) const
 {
   int natoms = ff.size() / 3;
+#pragma omp parallel for schedule(static)
   for (int kk = 0; kk < natoms; ++kk){
     VALUETYPE invmdt =  dt / (mass[kk] * massConst);
     vv[kk*3+0] += ff[kk*3+0] * invmdt;
@@ -32,7 +33,9 @@ stepCoord (vector<VALUETYPE > & rr,
 	   const vector<VALUETYPE > & vv, 
 	   const double & dt) const
 {
-  for (unsigned kk = 0; kk < vv.size(); ++kk){
+  int nn = vv.size();
+#pragma omp parallel for schedule(static)
+  for (int kk = 0; kk < nn; ++kk){
     rr[kk] += dt * vv[kk];
   }  
 }
@@ -55,7 +58,8 @@ reinit (const VALUETYPE		T_,
 	const VALUETYPE		tau_,
 	const long long int	seed)
 {
-  gaussian.set_seed (seed);
+  rand_seed = seed;
+  rand_counter = 0;
   temperature = T_;
   kT = UnitManager::BoltzmannConstant * T_;
   gamma = 1./tau_;
@@ -80,9 +84,12 @@ stepOU (vector<VALUETYPE> & vv,
   int numb_part =  mass.size();
   assert (int(vv.size() ) == 3 * numb_part);
 
+  // a new stream of the counter-based generator at each step, 
+  // the numbers do not depend on the number of threads
   double * all_rands = (double *) malloc (sizeof(double) * numb_part * 3);
-  gaussian.gen (all_rands, numb_part*3);
+  Gaussian::gen (all_rands, numb_part*3, rand_seed, rand_counter++);
 
+#pragma omp parallel for schedule(static)
   for (int kk = 0; kk < numb_part; ++kk){
     VALUETYPE sm = mass[kk] * UnitManager::IntegratorMassConstant;
     VALUETYPE invsqrtm = 1./sqrt (sm);
@@ -19,7 +19,7 @@ void
 LJInter::
 lj_inner (VALUETYPE & ae,
 	  VALUETYPE & af,
-	  const VALUETYPE & r2)
+	  const VALUETYPE & r2) const
 {
   VALUETYPE rinv = 1./sqrt(r2);
   VALUETYPE rinv2 = rinv * rinv;
@@ -79,3 +79,54 @@ compute (VALUETYPE &			ener,
   // }
 }
 
+void
+LJInter::
+compute (VALUETYPE &			ener,
+	 vector<VALUETYPE> &		force,
+	 vector<VALUETYPE> &		virial,
+	 const vector<VALUETYPE> &	coord,
+	 const vector<int> &		atype,
+	 const SimulationRegion<VALUETYPE> &	region)
+{
+  vector<vector<int > > nlist;
+  build_cell_nlist (nlist, coord, rc, region);
+  int natoms = nlist.size();
+  int nthreads = get_md_nthreads ();
+  vector<double > thread_ener (nthreads, 0.);
+  vector<double > thread_virial (nthreads * 9, 0.);
+  // every pair is visited from both atoms, each visit takes half of the energy and virial,
+  // so only the force on the center atom is written
+#pragma omp parallel num_threads(nthreads)
+  {
+    double ee = 0.;
+    double vv[9] = {0.};
+#pragma omp for schedule(static)
+    for (int ii = 0; ii < natoms; ++ii){
+      for (unsigned _ = 0; _ < nlist[ii].size(); ++_){
+	int jj = nlist[ii][_];
+	VALUETYPE diff[3];
+	region.diffNearestNeighbor (&coord[ii*3], &coord[jj*3], diff);      
+	VALUETYPE r2 = diff[0] * diff[0] + diff[1] * diff[1] + diff[2] * diff[2];
+	if (r2 < rc2) {
+	  VALUETYPE ae, af;
+	  lj_inner (ae, af, r2);
+	  for (int dd = 0; dd < 3; ++dd) force[ii*3+dd] += af * diff[dd];
+	  ee += 0.5 * ae;
+	  for (int dd0 = 0; dd0 < 3; ++dd0){
+	    for (int dd1 = 0; dd1 < 3; ++dd1){
+	      vv[dd0*3+dd1] -= 0.25 * diff[dd0] * af * diff[dd1];
+	    }
+	  }
+	}
+      }
+    }
+    int tid = get_md_thread_id ();
+    thread_ener[tid] = ee;
+    for (int dd = 0; dd < 9; ++dd) thread_virial[tid*9+dd] = vv[dd];
+  }
+  // sum in the thread order, so the result does not depend on the scheduling
+  for (int tt = 0; tt < nthreads; ++tt){
+    ener += thread_ener[tt];
+    for (int dd = 0; dd < 9; ++dd) virial[dd] += thread_virial[tt*9+dd];
+  }
+}
@@ -1,9 +1,11 @@
+#include "common.h"
 #include "LJTab.h"
 
 LJTab::
 LJTab (const VALUETYPE & c6,
        const VALUETYPE & c12,
-       const VALUETYPE & rc)
+       const VALUETYPE & rc_)
+    : rc (rc_)
 {
   VALUETYPE rcp = rc + 1;
   VALUETYPE hh = 2e-3;
@@ -31,6 +33,16 @@ LJTab (const VALUETYPE & c6,
   lj_tab.reinit (rcp, hh, tab);
 }
 
-
-
-
+void
+LJTab::
+compute (VALUETYPE &			ener,
+	 vector<VALUETYPE> &		force,
+	 vector<VALUETYPE> &		virial,
+	 const vector<VALUETYPE> &	coord,
+	 const vector<int> &		atype,
+	 const SimulationRegion<VALUETYPE> &	region)
+{
+  vector<vector<int > > nlist;
+  build_cell_nlist (nlist, coord, rc, region);
+  lj_tab.compute_full (ener, force, virial, coord, atype, region, nlist);
+}
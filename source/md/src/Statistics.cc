@@ -35,13 +35,15 @@ record (const VALUETYPE & ener,
   // }
   region.reinitBox(region_.getBoxTensor());
   natoms = mass.size();
-  r_kin_ener = 0;
   double pref = 0.5 * UnitManager::IntegratorMassConstant;
+  double kin_ener = 0;
+#pragma omp parallel for schedule(static) reduction(+:kin_ener)
   for (int ii = 0; ii < natoms; ++ii){
-    r_kin_ener += pref * mass[ii] * veloc[3*ii+0] * veloc[3*ii+0];
-    r_kin_ener += pref * mass[ii] * veloc[3*ii+1] * veloc[3*ii+1];
-    r_kin_ener += pref * mass[ii] * veloc[3*ii+2] * veloc[3*ii+2];
+    kin_ener += pref * mass[ii] * veloc[3*ii+0] * veloc[3*ii+0];
+    kin_ener += pref * mass[ii] * veloc[3*ii+1] * veloc[3*ii+1];
+    kin_ener += pref * mass[ii] * veloc[3*ii+2] * veloc[3*ii+2];
   }
+  r_kin_ener = kin_ener;
 }
 
 template <typename VALUETYPE>
@@ -62,7 +62,7 @@ inline void
 Tabulated::
 compute_posi (int & idx, 
 	      VALUETYPE & eps,
-	      const VALUETYPE & rr)
+	      const VALUETYPE & rr) const
 {
   VALUETYPE rt = rr * hi;
   idx = int(rt);
@@ -73,7 +73,7 @@ inline void
 Tabulated::
 tb_inner (VALUETYPE & ae,
 	  VALUETYPE & af,
-	  const VALUETYPE & r2)
+	  const VALUETYPE & r2) const
 {
   if (r2 > rc2) {
     ae = af = 0;
@@ -137,6 +137,57 @@ compute (VALUETYPE &			ener,
   }  
 }
 
+void
+Tabulated::
+compute_full (VALUETYPE &			ener,
+	      vector<VALUETYPE> &		force,
+	      vector<VALUETYPE> &		virial,
+	      const vector<VALUETYPE> &		coord,
+	      const vector<int> &		atype,
+	      const SimulationRegion<VALUETYPE> &	region, 
+	      const vector<vector<int > > &	nlist) const
+{
+  int natoms = nlist.size();
+  int nthreads = get_md_nthreads ();
+  vector<double > thread_ener (nthreads, 0.);
+  vector<double > thread_virial (nthreads * 9, 0.);
+  // every pair is visited from both atoms, each visit takes half of the energy and virial,
+  // so only the force on the center atom is written
+#pragma omp parallel num_threads(nthreads)
+  {
+    double ee = 0.;
+    double vv[9] = {0.};
+#pragma omp for schedule(static)
+    for (int ii = 0; ii < natoms; ++ii){
+      for (unsigned _ = 0; _ < nlist[ii].size(); ++_){
+	int jj = nlist[ii][_];
+	VALUETYPE diff[3];
+	region.diffNearestNeighbor (&coord[ii*3], &coord[jj*3], diff);      
+	VALUETYPE r2 = diff[0] * diff[0] + diff[1] * diff[1] + diff[2] * diff[2];
+	if (r2 < rc2) {
+	  VALUETYPE ae, af;
+	  tb_inner (ae, af, r2);
+	  for (int dd = 0; dd < 3; ++dd) force[ii*3+dd] += af * diff[dd];
+	  ee += 0.5 * ae;
+	  for (int dd0 = 0; dd0 < 3; ++dd0){
+	    for (int dd1 = 0; dd1 < 3; ++dd1){
+	      vv[dd0*3+dd1] -= 0.25 * diff[dd0] * af * diff[dd1];
+	    }
+	  }
+	}
+      }
+    }
+    int tid = get_md_thread_id ();
+    thread_ener[tid] = ee;
+    for (int dd = 0; dd < 9; ++dd) thread_virial[tid*9+dd] = vv[dd];
+  }
+  // sum in the thread order, so the result does not depend on the scheduling
+  for (int tt = 0; tt < nthreads; ++tt){
+    ener += thread_ener[tt];
+    for (int dd = 0; dd < 9; ++dd) virial[dd] += thread_virial[tt*9+dd];
+  }
+}
+
 void
 Tabulated::
 compute (VALUETYPE &			ener,
@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "Gaussian.h"
+
+class TestGaussian : public ::testing::Test
+{
+protected:
+  int numb_gen = 3001;
+  unsigned long long seed = 20;
+#ifdef _OPENMP
+  int nthreads_save;
+  void SetUp() override {
+    nthreads_save = omp_get_max_threads();
+  }
+  void TearDown() override {
+    omp_set_num_threads(nthreads_save);
+  }
+#endif
+};
+
+TEST_F(TestGaussian, thread_independent)
+{
+  std::vector<int > nthreads = {1, 2, 3, 4, 7};
+  std::vector<double > ref (numb_gen), vec (numb_gen);
+#ifdef _OPENMP
+  omp_set_num_threads(1);
+#endif
+  Gaussian::gen(&ref[0], numb_gen, seed, 5);
+  for (unsigned tt = 0; tt < nthreads.size(); ++tt){
+#ifdef _OPENMP
+    omp_set_num_threads(nthreads[tt]);
+#endif
+    Gaussian::gen(&vec[0], numb_gen, seed, 5);
+    for (int ii = 0; ii < numb_gen; ++ii){
+      EXPECT_EQ(vec[ii], ref[ii]);
+    }
+  }
+}
+
+TEST_F(TestGaussian, stream)
+{
+  std::vector<double > vec0 (numb_gen), vec1 (numb_gen), vec2 (numb_gen);
+  Gaussian::gen(&vec0[0], numb_gen, seed, 0);
+  Gaussian::gen(&vec1[0], numb_gen, seed, 1);
+  Gaussian::gen(&vec2[0], numb_gen, seed + 1, 0);
+  int same01 = 0, same02 = 0;
+  for (int ii = 0; ii < numb_gen; ++ii){
+    if (vec0[ii] == vec1[ii]) same01 ++;
+    if (vec0[ii] == vec2[ii]) same02 ++;
+  }
+  EXPECT_EQ(same01, 0);
+  EXPECT_EQ(same02, 0);
+}
+
+TEST_F(TestGaussian, moments)
+{
+  int nn = 200000;
+  std::vector<double > vec (nn);
+  Gaussian::gen(&vec[0], nn, seed, 0);
+  double mean = 0, var = 0;
+  for (int ii = 0; ii < nn; ++ii){
+    mean += vec[ii];
+    var += vec[ii] * vec[ii];
+  }
+  mean /= nn;
+  var = var / nn - mean * mean;
+  // about 5 times the standard errors
+  EXPECT_LT(fabs(mean), 0.012);
+  EXPECT_LT(fabs(var - 1.), 0.016);
+}
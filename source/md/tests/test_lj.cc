@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include "common.h"
+#include "LJInter.h"
+#include "LJTab.h"
+
+class TestLJ : public ::testing::Test
+{
+protected:
+  int natoms = 120;
+  double rc = 3.;
+  double c6 = 1.2;
+  double c12 = 2.1;
+  std::vector<double > boxt = {10., 0., 0., 0.5, 10.5, 0., 0.3, -0.2, 11.};
+  std::vector<double > coord;
+  std::vector<int > atype;
+  SimulationRegion<double > region;
+  std::vector<std::vector<int > > nlist;
+
+  void SetUp() override {
+    region.reinitBox(&boxt[0]);
+    // atoms on a perturbed lattice, so they are not too close
+    coord.clear();
+    for (int ii = 0; ii < 5; ++ii){
+      for (int jj = 0; jj < 6; ++jj){
+	for (int kk = 0; kk < 4; ++kk){
+	  double inter[3] = {(ii + 0.3 * sin(ii*jj+kk)) / 5.,
+			     (jj + 0.3 * cos(ii+jj*kk)) / 6.,
+			     (kk + 0.3 * sin(ii+jj+kk)) / 4.};
+	  double phys[3];
+	  region.inter2Phys(phys, inter);
+	  for (int dd = 0; dd < 3; ++dd) coord.push_back(phys[dd]);
+	}
+      }
+    }
+    EXPECT_EQ(coord.size(), natoms * 3);
+    normalize_coord<double> (coord, region);
+    atype.resize(natoms, 0);
+    // the full neighbor list by the brute force search
+    nlist.clear();
+    nlist.resize(natoms);
+    for (int ii = 0; ii < natoms; ++ii){
+      for (int jj = 0; jj < natoms; ++jj){
+	if (ii == jj) continue;
+	double diff[3];
+	region.diffNearestNeighbor(&coord[ii*3], &coord[jj*3], diff);
+	double r2 = diff[0] * diff[0] + diff[1] * diff[1] + diff[2] * diff[2];
+	if (r2 < rc * rc) nlist[ii].push_back(jj);
+      }
+    }
+  }
+
+  template <typename LJ>
+  void
+  check (LJ & lj) 
+  {
+    double ener0 = 0, ener1 = 0;
+    std::vector<double > force0 (natoms * 3, 0.), force1 (natoms * 3, 0.);
+    std::vector<double > virial0 (9, 0.), virial1 (9, 0.);
+    lj.compute(ener0, force0, virial0, coord, atype, region, nlist);
+    lj.compute(ener1, force1, virial1, coord, atype, region);
+    EXPECT_GT(fabs(ener0), 1e-3);
+    EXPECT_LT(fabs(ener1 - ener0), 1e-10);
+    for (int ii = 0; ii < natoms * 3; ++ii){
+      EXPECT_LT(fabs(force1[ii] - force0[ii]), 1e-10);
+    }
+    for (int ii = 0; ii < 9; ++ii){
+      EXPECT_LT(fabs(virial1[ii] - virial0[ii]), 1e-10);
+    }
+  }
+};
+
+TEST_F(TestLJ, inter_cell_nlist)
+{
+  // the cell list is used
+  double to_face[3];
+  region.toFaceDistance(to_face);
+  for (int dd = 0; dd < 3; ++dd) EXPECT_GE(int(to_face[dd] / rc), 3);
+  LJInter lj (c6, c12, rc);
+  check(lj);
+}
+
+TEST_F(TestLJ, tab_cell_nlist)
+{
+  LJTab lj (c6, c12, rc);
+  check(lj);
+}
+
+TEST_F(TestLJ, inter_small_box)
+{
+  // fewer than 3 cells fit in the box, the neighbor list is built by the brute force search
+  rc = 4.;
+  SetUp();
+  LJInter lj (c6, c12, rc);
+  check(lj);
+}
@@ -0,0 +1,42 @@
+#!/usr/bin/env python3
+"""
+Gradients for the fused prod force and virial.
+"""
+
+from tensorflow.python.framework import ops
+from deepmd.env import tf
+from deepmd.env import op_grads_module
+     
+@ops.RegisterGradient("ProdForceVirialSeA")
+def _prod_force_virial_se_a_grad_cc (op, grad_force, grad_virial, grad_atom_virial):    
+    n_a_sel = op.get_attr("n_a_sel")
+    n_r_sel = op.get_attr("n_r_sel")
+    if not tf.test.is_built_with_gpu_support():
+        # both gradients w.r.t. the net deriv in one pass over the env deriv
+        net_grad =  op_grads_module.prod_force_virial_se_a_grad (grad_force, 
+                                                                  grad_virial, 
+                                                                  op.inputs[0], 
+                                                                  op.inputs[1], 
+                                                                  op.inputs[2], 
+                                                                  op.inputs[3], 
+                                                                  op.inputs[4], 
+                                                                  n_a_sel = n_a_sel,
+                                                                  n_r_sel = n_r_sel)
+    else:
+        # the fused kernel is cpu only
+        net_grad =  op_grads_module.prod_force_se_a_grad (grad_force, 
+                                                           op.inputs[0], 
+                                                           op.inputs[1], 
+                                                           op.inputs[3], 
+                                                           op.inputs[4], 
+                                                           n_a_sel = n_a_sel,
+                                                           n_r_sel = n_r_sel) \
+                  + op_grads_module.prod_virial_se_a_grad (grad_virial, 
+                                                            op.inputs[0], 
+                                                            op.inputs[1], 
+                                                            op.inputs[2], 
+                                                            op.inputs[3], 
+                                                            op.inputs[4], 
+                                                            n_a_sel = n_a_sel,
+                                                            n_r_sel = n_r_sel)
+    return [net_grad, None, None, None, None]
@@ -16,4 +16,11 @@ def _tabulate_fusion_grad_cc (op, dy):
 @ops.RegisterGradient("TabulateFusionGrad")
 def _tabulate_fusion_grad_grad_cc (op, dy, dy_):
     dz_dy = op_module.tabulate_fusion_grad_grad(op.inputs[0], op.inputs[1], op.inputs[2], op.inputs[3], dy, dy_, op.inputs[5])
-    return [None, None, None, None, dz_dy, None]
\ No newline at end of file
+    return [None, None, None, None, dz_dy, None]
+
+@ops.RegisterGradient("TabulateFusionSeAGrad")
+def _tabulate_fusion_se_a_grad_grad_cc (op, dy):
+    dz_dy = op_module.tabulate_fusion_se_a_grad_grad(op.inputs[0], op.inputs[1], op.inputs[2], op.inputs[3], op.inputs[4], op.inputs[5], dy, op.inputs[6],
+                                                     sel_a = op.get_attr("sel_a"), 
+                                                     type_one_side = op.get_attr("type_one_side"))
+    return [None, None, None, None, None, None, dz_dy]
@@ -0,0 +1,81 @@
+#include "custom_op.h"
+#include "tabulate.h"
+
+// build the tables of the compressed embedding nets in one pass,
+// the weights of all the nets are stacked along the first dimension
+REGISTER_OP("BuildTabulateTable")
+    .Attr("T: {float, double} = DT_DOUBLE")
+    .Attr("nlayer: int")
+    .Input("matrix: nlayer * T")
+    .Input("bias: nlayer * T")
+    .Input("table_info: T")
+    .Attr("nspline: int")
+    .Attr("functype: int")
+    .Output("table: T");
+
+template<typename Device, typename FPTYPE>
+class BuildTabulateTableOp : public OpKernel {
+ public:
+  explicit BuildTabulateTableOp(OpKernelConstruction* context) : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("nlayer", &nlayer));
+    OP_REQUIRES_OK(context, context->GetAttr("nspline", &nspline));
+    OP_REQUIRES_OK(context, context->GetAttr("functype", &functype));
+  }
+  void Compute(OpKernelContext* context) override {
+      deepmd::safe_compute(context, [this](OpKernelContext* context) {this->_Compute(context);});
+  }
+
+  void _Compute(OpKernelContext* context) {
+    // Grab the input tensor
+    OpInputList matrix_list, bias_list;
+    OP_REQUIRES_OK(context, context->input_list("matrix", &matrix_list));
+    OP_REQUIRES_OK(context, context->input_list("bias", &bias_list));
+    const Tensor* table_info_tensor = NULL;
+    OP_REQUIRES_OK(context, context->input("table_info", &table_info_tensor));
+    // set size of the sample
+    OP_REQUIRES (context, (nlayer > 0),                                   errors::InvalidArgument ("the embedding net should have at least one layer"));
+    OP_REQUIRES (context, (table_info_tensor->NumElements() >= 5),        errors::InvalidArgument ("table info should contain lower, upper, max, stride0 and stride1"));
+    OP_REQUIRES (context, (functype == 1 || functype == 2),               errors::InvalidArgument ("Unknown activation function type"));
+    const int nnet = matrix_list[0].shape().dim_size(0);
+    std::vector<int> layer_size(nlayer + 1);
+    std::vector<const FPTYPE *> matrix(nlayer), bias(nlayer);
+    layer_size[0] = 1;
+    for (int ll = 0; ll < nlayer; ++ll) {
+      OP_REQUIRES (context, (matrix_list[ll].shape().dims() == 3),        errors::InvalidArgument ("Dim of matrix should be 3"));
+      OP_REQUIRES (context, (bias_list[ll].shape().dims() == 2),          errors::InvalidArgument ("Dim of bias should be 2"));
+      OP_REQUIRES (context, (matrix_list[ll].shape().dim_size(0) == nnet), errors::InvalidArgument ("number of nets should match"));
+      OP_REQUIRES (context, (bias_list[ll].shape().dim_size(0) == nnet),  errors::InvalidArgument ("number of nets should match"));
+      OP_REQUIRES (context, (matrix_list[ll].shape().dim_size(1) == layer_size[ll]), errors::InvalidArgument ("size of the layers should match"));
+      layer_size[ll + 1] = matrix_list[ll].shape().dim_size(2);
+      OP_REQUIRES (context, (bias_list[ll].shape().dim_size(1) == layer_size[ll + 1]), errors::InvalidArgument ("size of the bias should match"));
+      matrix[ll] = matrix_list[ll].flat<FPTYPE>().data();
+      bias[ll] = bias_list[ll].flat<FPTYPE>().data();
+    }
+    // Create an output tensor
+    TensorShape table_shape;
+    table_shape.AddDim (nnet);
+    table_shape.AddDim (nspline);
+    table_shape.AddDim (6 * layer_size[nlayer]);
+    int context_output_index = 0;
+    Tensor* table_tensor = NULL;
+    OP_REQUIRES_OK(context, context->allocate_output(
+        context_output_index++,
+        table_shape,
+        &table_tensor));
+    deepmd::build_tabulate_table_cpu(
+        table_tensor->flat<FPTYPE>().data(),
+        &matrix[0], &bias[0], &layer_size[0],
+        table_info_tensor->flat<FPTYPE>().data(),
+        nlayer, nnet, nspline, functype);
+  }
+ private:
+  int nlayer, nspline, functype;
+};
+
+// Register the CPU kernels.
+#define REGISTER_CPU(T)                                                                  \
+REGISTER_KERNEL_BUILDER(                                                                 \
+    Name("BuildTabulateTable").Device(DEVICE_CPU).TypeConstraint<T>("T"),                \
+    BuildTabulateTableOp<CPUDevice, T>);
+REGISTER_CPU(float);
+REGISTER_CPU(double);
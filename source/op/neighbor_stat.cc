@@ -1,5 +1,6 @@
 #include "custom_op.h"
 #include "neighbor_list.h"
+#include "neighbor_stat.h"
 #include "errors.h"
 
 typedef double boxtensor_t ;
@@ -16,6 +17,20 @@ REGISTER_OP("NeighborStat")
     .Output("max_nbor_size: int32")
     .Output("min_nbor_dist: T");
 
+// reduce the statistics inside the kernel instead of emitting the distances of all the pairs
+REGISTER_OP("NeighborStatReduce")
+    .Attr("T: {float, double} = DT_DOUBLE")
+    .Input("coord: T")
+    .Input("type: int32")
+    .Input("natoms: int32")
+    .Input("box : T")
+    .Input("mesh : int32")
+    .Attr("rcut: float")
+    .Attr("nbins: int = 0")
+    .Output("min_nbor_dist: T")
+    .Output("max_nbor_size: int32")
+    .Output("dist_hist: int32");
+
 template<typename Device, typename FPTYPE>
 class NeighborStatOp : public OpKernel {
 public:
@@ -179,9 +194,139 @@ private:
   float rcut;
 };
 
+template<typename Device, typename FPTYPE>
+class NeighborStatReduceOp : public OpKernel {
+public:
+    explicit NeighborStatReduceOp(OpKernelConstruction* context) : OpKernel(context) {
+        OP_REQUIRES_OK(context, context->GetAttr("rcut", &rcut));
+        OP_REQUIRES_OK(context, context->GetAttr("nbins", &nbins));
+    }
+
+    void Compute(OpKernelContext* context) override {
+        deepmd::safe_compute(context, [this](OpKernelContext* context) {this->_Compute(context);});
+    }
+
+    void _Compute(OpKernelContext* context) {
+        // Grab the input tensor
+        int context_input_index = 0;
+        const Tensor& coord_tensor	= context->input(context_input_index++);
+        const Tensor& type_tensor	= context->input(context_input_index++);
+        const Tensor& natoms_tensor	= context->input(context_input_index++);
+        const Tensor& box_tensor	= context->input(context_input_index++);
+        const Tensor& mesh_tensor	= context->input(context_input_index++);
+
+        OP_REQUIRES (context, (coord_tensor.shape().dims() == 2),	errors::InvalidArgument ("Dim of coord should be 2"));
+        OP_REQUIRES (context, (type_tensor.shape().dims() == 2),	errors::InvalidArgument ("Dim of type should be 2"));
+        OP_REQUIRES (context, (natoms_tensor.shape().dims() == 1),	errors::InvalidArgument ("Dim of natoms should be 1"));
+        OP_REQUIRES (context, (box_tensor.shape().dims() == 2),	errors::InvalidArgument ("Dim of box should be 2"));
+        OP_REQUIRES (context, (mesh_tensor.shape().dims() == 1),	errors::InvalidArgument ("Dim of mesh should be 1"));
+        OP_REQUIRES (context, (natoms_tensor.shape().dim_size(0) >= 3),		errors::InvalidArgument ("number of atoms should be larger than (or equal to) 3"));
+        OP_REQUIRES (context, (nbins >= 0),		errors::InvalidArgument ("nbins should not be negative"));
+        int nloc = natoms_tensor.flat<int>().data()[0];
+        int nall = natoms_tensor.flat<int>().data()[1];
+        int nsamples = coord_tensor.shape().dim_size(0);
+        int ntypes = natoms_tensor.shape().dim_size(0) - 2;
+        // check the sizes
+        OP_REQUIRES (context, (nsamples == type_tensor.shape().dim_size(0)),	errors::InvalidArgument ("number of samples should match"));
+        OP_REQUIRES (context, (nsamples == box_tensor.shape().dim_size(0)),		errors::InvalidArgument ("number of samples should match"));
+        OP_REQUIRES (context, (nall * 3 == coord_tensor.shape().dim_size(1)),	errors::InvalidArgument ("number of atoms should match"));
+        OP_REQUIRES (context, (nall == type_tensor.shape().dim_size(1)),		errors::InvalidArgument ("number of atoms should match"));
+        OP_REQUIRES (context, (9 == box_tensor.shape().dim_size(1)),		errors::InvalidArgument ("number of box should be 9"));
+
+        int nei_mode = 0;
+        if (mesh_tensor.shape().dim_size(0) == 6) {
+            // manual copied pbc
+            OP_REQUIRES (context, (nloc == nall),	errors::InvalidArgument ("number of local atoms and all atoms should match with pbc"));
+            nei_mode = 1;
+        }
+        else if (mesh_tensor.shape().dim_size(0) == 0) {
+            // no pbc
+            nei_mode = -1;
+        }
+        else {
+            throw deepmd::deepmd_exception("invalid mesh tensor");
+        }
+
+        TensorShape min_nbor_dist_shape;
+        min_nbor_dist_shape.AddDim (nsamples);
+        TensorShape max_nbor_size_shape;
+        max_nbor_size_shape.AddDim (nsamples);
+        max_nbor_size_shape.AddDim (ntypes);
+        TensorShape dist_hist_shape;
+        dist_hist_shape.AddDim (nsamples);
+        dist_hist_shape.AddDim (nbins);
+
+        int context_output_index = 0;
+        Tensor* min_nbor_dist_tensor = NULL;
+        OP_REQUIRES_OK(context, context->allocate_output(context_output_index++, 
+	    					     min_nbor_dist_shape,
+	    					     &min_nbor_dist_tensor));
+        Tensor* max_nbor_size_tensor = NULL;
+        OP_REQUIRES_OK(context, context->allocate_output(context_output_index++, 
+	    					     max_nbor_size_shape,
+	    					     &max_nbor_size_tensor));
+        Tensor* dist_hist_tensor = NULL;
+        OP_REQUIRES_OK(context, context->allocate_output(context_output_index++, 
+	    					     dist_hist_shape,
+	    					     &dist_hist_tensor));
+
+        const FPTYPE* p_coord	= coord_tensor.flat<FPTYPE>().data();
+        const int* p_type	= type_tensor	  .flat<int>().data();
+        const FPTYPE* p_box	= box_tensor  .flat<FPTYPE>().data();
+        FPTYPE* p_min_nbor_dist = min_nbor_dist_tensor->flat<FPTYPE>().data();
+        int* p_max_nbor_size = max_nbor_size_tensor->flat<int>().data();
+        int* p_dist_hist = dist_hist_tensor->flat<int>().data();
+
+        // a batch of frames is parallelized over frames, a single frame over atoms by the kernel
+        #pragma omp parallel for if (nsamples > 1)
+        for (int kk = 0; kk < nsamples; ++kk) {
+            const FPTYPE* coord = p_coord + kk * nall * 3;
+            const int* type = p_type + kk * nall;
+            std::vector<compute_t > d_coord3 (coord, coord + nall * 3);
+            std::vector<int > d_type (type, type + nall);
+            if (nei_mode == 1) {
+                // normalize and copy the periodic images within rcut
+                boxtensor_t boxt [9] = {0};
+                for (int dd = 0; dd < 9; ++dd) {
+                    boxt[dd] = p_box[kk * 9 + dd];
+                }
+                SimulationRegion<compute_t > region;
+                region.reinitBox (boxt);
+                for (int ii = 0; ii < nall; ++ii) {
+                    compute_t inter[3];
+                    region.phys2Inter (inter, &d_coord3[3 * ii]);
+                    for (int dd = 0; dd < 3; ++dd) {
+                        if      (inter[dd] < 0 ) inter[dd] += 1.;
+                        else if (inter[dd] >= 1) inter[dd] -= 1.;
+                    }
+                    region.inter2Phys (&d_coord3[3 * ii], inter);
+                }
+                std::vector<compute_t > bk_d_coord3 = d_coord3;
+                std::vector<int > bk_d_type = d_type;
+                std::vector<int > nlist_map, ncell, ngcell;
+                copy_coord(d_coord3, d_type, nlist_map, ncell, ngcell, bk_d_coord3, bk_d_type, rcut, region);
+            }
+            compute_t min_nbor_dist;
+            deepmd::neighbor_stat_cpu<compute_t>(
+                min_nbor_dist, 
+                p_max_nbor_size + kk * ntypes, 
+                p_dist_hist + kk * nbins, 
+                &d_coord3[0], &d_type[0], nloc, d_type.size(), ntypes, rcut, nbins);
+            p_min_nbor_dist[kk] = min_nbor_dist;
+        }
+    }
+
+private:
+  float rcut;
+  int nbins;
+};
+
 #define REGISTER_CPU(T)                                                                 \
 REGISTER_KERNEL_BUILDER(                                                                \
     Name("NeighborStat").Device(DEVICE_CPU).TypeConstraint<T>("T"),                     \
-    NeighborStatOp<CPUDevice, T>); 
+    NeighborStatOp<CPUDevice, T>);                                                      \
+REGISTER_KERNEL_BUILDER(                                                                \
+    Name("NeighborStatReduce").Device(DEVICE_CPU).TypeConstraint<T>("T"),               \
+    NeighborStatReduceOp<CPUDevice, T>); 
 REGISTER_CPU(float);
 REGISTER_CPU(double);
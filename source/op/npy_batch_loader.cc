@@ -0,0 +1,232 @@
+#include <map>
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <memory>
+#include <condition_variable>
+#include <sys/stat.h>
+#include "custom_op.h"
+#include "npy.h"
+#include "errors.h"
+
+// load the training batches of a system from the npy files of its sets.
+// The files are memory mapped, and the batches are assembled by nthreads
+// background threads, at most prefetch batches ahead of the consumer.
+// The batches are handed out in the order they are planned, so the
+// sequence of batches only depends on the seed.
+REGISTER_OP("NpyBatchLoader")
+    .Attr("set_dirs: list(string)")
+    .Attr("keys: list(string)")
+    .Attr("ndofs: list(int)")
+    .Attr("atomic: list(bool)")
+    .Attr("must: list(bool)")
+    .Attr("natoms: int")
+    .Attr("idx_map: list(int) = []")
+    .Attr("batch_size: int")
+    .Attr("prefetch: int = 2")
+    .Attr("nthreads: int = 1")
+    .Attr("seed: int = 0")
+    .Attr("shuffle: bool = true")
+    .Attr("out_types: list({float, double})")
+    .Output("data: out_types")
+    .Output("find: float")
+    .SetIsStateful();
+
+class NpyBatchLoaderOp : public OpKernel {
+ public:
+  explicit NpyBatchLoaderOp(OpKernelConstruction* context) : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("set_dirs", &set_dirs));
+    OP_REQUIRES_OK(context, context->GetAttr("keys", &keys));
+    OP_REQUIRES_OK(context, context->GetAttr("ndofs", &ndofs));
+    OP_REQUIRES_OK(context, context->GetAttr("atomic", &atomic));
+    OP_REQUIRES_OK(context, context->GetAttr("must", &must));
+    OP_REQUIRES_OK(context, context->GetAttr("natoms", &natoms));
+    OP_REQUIRES_OK(context, context->GetAttr("idx_map", &idx_map));
+    OP_REQUIRES_OK(context, context->GetAttr("batch_size", &batch_size));
+    OP_REQUIRES_OK(context, context->GetAttr("prefetch", &prefetch));
+    OP_REQUIRES_OK(context, context->GetAttr("nthreads", &nthreads));
+    OP_REQUIRES_OK(context, context->GetAttr("seed", &seed));
+    OP_REQUIRES_OK(context, context->GetAttr("shuffle", &shuffle));
+    OP_REQUIRES_OK(context, context->GetAttr("out_types", &out_types));
+    const int nkeys = keys.size();
+    OP_REQUIRES (context, (set_dirs.size() > 0),			errors::InvalidArgument ("no set to load"));
+    OP_REQUIRES (context, (ndofs.size() == nkeys),			errors::InvalidArgument ("the number of ndofs should match the number of keys"));
+    OP_REQUIRES (context, (atomic.size() == nkeys),			errors::InvalidArgument ("the number of atomic flags should match the number of keys"));
+    OP_REQUIRES (context, (must.size() == nkeys),			errors::InvalidArgument ("the number of must flags should match the number of keys"));
+    OP_REQUIRES (context, (out_types.size() == nkeys),			errors::InvalidArgument ("the number of out_types should match the number of keys"));
+    OP_REQUIRES (context, (idx_map.size() == 0 || idx_map.size() == natoms), errors::InvalidArgument ("the size of idx_map should be natoms"));
+    OP_REQUIRES (context, (batch_size > 0),				errors::InvalidArgument ("the batch size should be positive"));
+    OP_REQUIRES (context, (prefetch > 0),				errors::InvalidArgument ("prefetch should be positive"));
+    OP_REQUIRES (context, (nthreads > 0),				errors::InvalidArgument ("nthreads should be positive"));
+    coord_idx = std::find(keys.begin(), keys.end(), "coord") - keys.begin();
+    OP_REQUIRES (context, (coord_idx < nkeys),				errors::InvalidArgument ("coord should be one of the keys"));
+    inited = false;
+    stop = false;
+    next_ticket = 0;
+    next_out = 0;
+  }
+
+  ~NpyBatchLoaderOp() override {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      stop = true;
+    }
+    space_cv.notify_all();
+    for (unsigned ii = 0; ii < workers.size(); ++ii) {
+      workers[ii].join();
+    }
+  }
+
+  void Compute(OpKernelContext* context) override {
+    deepmd::safe_compute(context, [this](OpKernelContext* context) {this->_Compute(context);});
+  }
+
+  void _Compute(OpKernelContext* context) {
+    {
+      std::lock_guard<std::mutex> lock(init_mtx);
+      if (!inited) {
+        init();
+        inited = true;
+      }
+    }
+    // take the next batch in the planned order
+    Batch batch;
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      ready_cv.wait(lock, [this]{return ready.count(next_out) > 0;});
+      batch = std::move(ready[next_out]);
+      ready.erase(next_out);
+      next_out ++;
+    }
+    space_cv.notify_all();
+    if (!batch.error.empty()) {
+      throw deepmd::deepmd_exception(batch.error);
+    }
+    // the tensors are assembled by the workers and handed out without copy
+    OpOutputList data_list;
+    OP_REQUIRES_OK(context, context->output_list("data", &data_list));
+    for (unsigned kk = 0; kk < keys.size(); ++kk) {
+      data_list.set(kk, batch.data[kk]);
+    }
+    TensorShape find_shape;
+    find_shape.AddDim (keys.size());
+    Tensor* find_tensor = NULL;
+    OP_REQUIRES_OK(context, context->allocate_output("find", find_shape, &find_tensor));
+    auto find = find_tensor->flat<float>();
+    for (unsigned kk = 0; kk < keys.size(); ++kk) {
+      find(kk) = batch.find[kk];
+    }
+  }
+
+ private:
+  struct Batch {
+    std::vector<Tensor> data;
+    std::vector<float> find;
+    std::string error;
+  };
+  std::vector<std::string> set_dirs, keys;
+  std::vector<int> ndofs, idx_map;
+  std::vector<bool> atomic, must;
+  std::vector<DataType> out_types;
+  int natoms, batch_size, prefetch, nthreads, seed, coord_idx;
+  bool shuffle;
+  // files[set][key], NULL if the file is not found
+  std::vector<std::vector<std::unique_ptr<deepmd::NpyFile> > > files;
+  std::unique_ptr<deepmd::FrameSampler> sampler;
+  std::vector<std::thread> workers;
+  std::mutex init_mtx, mtx;
+  std::condition_variable ready_cv, space_cv;
+  std::map<long, Batch> ready;
+  bool inited, stop;
+  long next_ticket, next_out;
+
+  void init() {
+    const int nkeys = keys.size();
+    std::vector<int> set_nframes(set_dirs.size());
+    files.resize(set_dirs.size());
+    for (unsigned ss = 0; ss < set_dirs.size(); ++ss) {
+      files[ss].resize(nkeys);
+      for (int kk = 0; kk < nkeys; ++kk) {
+        std::string path = set_dirs[ss] + "/" + keys[kk] + ".npy";
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0) {
+          files[ss][kk].reset(new deepmd::NpyFile(path));
+        }
+        else if (must[kk] || kk == coord_idx) {
+          throw deepmd::deepmd_exception(path + " not found!");
+        }
+      }
+      // the number of frames of a set is given by the coordinates
+      set_nframes[ss] = files[ss][coord_idx]->nframes();
+      for (int kk = 0; kk < nkeys; ++kk) {
+        if (!files[ss][kk]) continue;
+        files[ss][kk]->reshape(set_nframes[ss]);
+        if (files[ss][kk]->frame_size() != frame_size(kk)) {
+          throw deepmd::deepmd_exception("the frame size of " + set_dirs[ss] + "/" + keys[kk] + ".npy is " + std::to_string(files[ss][kk]->frame_size()) + ", expected " + std::to_string(frame_size(kk)));
+        }
+      }
+    }
+    sampler.reset(new deepmd::FrameSampler(set_nframes, batch_size, seed, shuffle));
+    for (int ii = 0; ii < nthreads; ++ii) {
+      workers.push_back(std::thread(&NpyBatchLoaderOp::work, this));
+    }
+  }
+
+  int frame_size(const int kk) const {
+    return atomic[kk] ? ndofs[kk] * natoms : ndofs[kk];
+  }
+
+  void work() {
+    while (true) {
+      long ticket;
+      int set_idx;
+      std::vector<int> frames;
+      {
+        // the batches are planned in the order of the tickets
+        std::unique_lock<std::mutex> lock(mtx);
+        space_cv.wait(lock, [this]{return stop || next_ticket - next_out < prefetch;});
+        if (stop) return;
+        ticket = next_ticket ++;
+        sampler->next(set_idx, frames);
+      }
+      Batch batch;
+      try {
+        assemble(batch, set_idx, frames);
+      }
+      catch (const std::exception & e) {
+        batch.error = e.what();
+      }
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        ready[ticket] = std::move(batch);
+      }
+      ready_cv.notify_all();
+    }
+  }
+
+  void assemble(Batch & batch, const int set_idx, const std::vector<int> & frames) const {
+    const int nkeys = keys.size();
+    const int nsel = frames.size();
+    batch.data.resize(nkeys);
+    batch.find.resize(nkeys);
+    for (int kk = 0; kk < nkeys; ++kk) {
+      TensorShape shape;
+      shape.AddDim (nsel);
+      shape.AddDim (frame_size(kk));
+      batch.data[kk] = Tensor(out_types[kk], shape);
+      const deepmd::NpyFile * file = files[set_idx][kk].get();
+      const int * kk_idx_map = (atomic[kk] && idx_map.size() > 0) ? &idx_map[0] : NULL;
+      batch.find[kk] = file ? 1. : 0.;
+      if (out_types[kk] == DT_DOUBLE) {
+        if (file) file->gather(batch.data[kk].flat<double>().data(), &frames[0], nsel, kk_idx_map, natoms);
+        else batch.data[kk].flat<double>().setZero();
+      }
+      else {
+        if (file) file->gather(batch.data[kk].flat<float>().data(), &frames[0], nsel, kk_idx_map, natoms);
+        else batch.data[kk].flat<float>().setZero();
+      }
+    }
+  }
+};
+
+REGISTER_KERNEL_BUILDER(Name("NpyBatchLoader").Device(DEVICE_CPU), NpyBatchLoaderOp);
@@ -95,8 +95,8 @@ class PairTabOp : public OpKernel {
     OP_REQUIRES_OK(context, context->allocate_output(tmp_idx++, virial_shape, &virial_tensor));
     
     // flat the tensors
-    auto table_info = table_info_tensor.flat<FPTYPE>();
-    auto table_data = table_data_tensor.flat<FPTYPE>();
+    auto table_info = table_info_tensor.flat<double>();
+    auto table_data = table_data_tensor.flat<double>();
     auto type	= type_tensor	.matrix<int>();
     auto rij	= rij_tensor	.matrix<FPTYPE>();
     auto nlist	= nlist_tensor	.matrix<int>();
@@ -109,16 +109,17 @@ class PairTabOp : public OpKernel {
     int nspline = table_info(2)+0.1;
     int tab_stride = 4 * nspline;
     assert(ntypes * ntypes * tab_stride == table_data_tensor.shape().dim_size(0));
+    // the table is converted to the precision of the kernel once for all the frames
     std::vector<double > d_table_info(4);
-    std::vector<double > d_table_data(ntypes * ntypes * tab_stride);
+    std::vector<FPTYPE > t_table_data(ntypes * ntypes * tab_stride);
     for (unsigned ii = 0; ii < d_table_info.size(); ++ii){
       d_table_info[ii] = table_info(ii);
     }
-    for (unsigned ii = 0; ii < d_table_data.size(); ++ii){
-      d_table_data[ii] = table_data(ii);
+    for (unsigned ii = 0; ii < t_table_data.size(); ++ii){
+      t_table_data[ii] = table_data(ii);
     }
     const double * p_table_info = &(d_table_info[0]);
-    const double * p_table_data = &(d_table_data[0]);
+    const FPTYPE * p_table_data = &(t_table_data[0]);
 
     std::vector<int > t_sel_a(sel_a.size()), t_sel_r(sel_r.size());
     for (int ii = 0; ii < sel_a.size(); ++ii){
@@ -128,9 +129,10 @@ class PairTabOp : public OpKernel {
       t_sel_r[ii] = sel_r[ii];
     }
     // loop over samples
-#pragma omp parallel for 
+    int nviolate = 0;
+#pragma omp parallel for reduction(+:nviolate)
     for (int kk = 0; kk < nframes; ++kk){
-      deepmd::pair_tab_cpu<FPTYPE>(
+      nviolate += deepmd::pair_tab_cpu<FPTYPE>(
 	  &energy(kk,0),
 	  &force(kk,0),
 	  &virial(kk,0),
@@ -144,6 +146,10 @@ class PairTabOp : public OpKernel {
 	  t_sel_a,
 	  t_sel_r);
     }
+    // the step goes on, the pairs are evaluated at the boundary
+    if (nviolate > 0) {
+      LOG(WARNING) << nviolate << " pairs go beyond the table lower boundary, they are evaluated at the boundary";
+    }
   }
 private:
   std::vector<int32> sel_r;
@@ -1,9 +1,12 @@
+#include <mutex>
+#include <algorithm>
 #include "custom_op.h"
 #include "utilities.h"
 #include "coord.h"
 #include "region.h"
 #include "neighbor_list.h"
 #include "prod_env_mat.h"
+#include "nlist_stat.h"
 #include "errors.h"
 
 REGISTER_OP("ProdEnvMatA")
@@ -83,9 +86,101 @@ REGISTER_OP("DescrptSeR")
     .Output("rij: T")
     .Output("nlist: int32"); 
 
+// the DescrptSeAEf family: the se_a environment matrix projected onto the external field
+REGISTER_OP("DescrptSeAEf")
+    .Attr("T: {float, double} = DT_DOUBLE")
+    .Input("coord: T")
+    .Input("type: int32")
+    .Input("natoms: int32")
+    .Input("box: T")
+    .Input("mesh: int32")
+    .Input("ef: T")
+    .Input("davg: T")
+    .Input("dstd: T")
+    .Attr("rcut_a: float")
+    .Attr("rcut_r: float")
+    .Attr("rcut_r_smth: float")
+    .Attr("sel_a: list(int)")
+    .Attr("sel_r: list(int)")
+    .Output("descrpt: T")
+    .Output("descrpt_deriv: T")
+    .Output("rij: T")
+    .Output("nlist: int32");
+
+REGISTER_OP("DescrptSeAEfPara")
+    .Attr("T: {float, double} = DT_DOUBLE")
+    .Input("coord: T")
+    .Input("type: int32")
+    .Input("natoms: int32")
+    .Input("box: T")
+    .Input("mesh: int32")
+    .Input("ef: T")
+    .Input("davg: T")
+    .Input("dstd: T")
+    .Attr("rcut_a: float")
+    .Attr("rcut_r: float")
+    .Attr("rcut_r_smth: float")
+    .Attr("sel_a: list(int)")
+    .Attr("sel_r: list(int)")
+    .Output("descrpt: T")
+    .Output("descrpt_deriv: T")
+    .Output("rij: T")
+    .Output("nlist: int32");
+
+REGISTER_OP("DescrptSeAEfVert")
+    .Attr("T: {float, double} = DT_DOUBLE")
+    .Input("coord: T")
+    .Input("type: int32")
+    .Input("natoms: int32")
+    .Input("box: T")
+    .Input("mesh: int32")
+    .Input("ef: T")
+    .Input("davg: T")
+    .Input("dstd: T")
+    .Attr("rcut_a: float")
+    .Attr("rcut_r: float")
+    .Attr("rcut_r_smth: float")
+    .Attr("sel_a: list(int)")
+    .Attr("sel_r: list(int)")
+    .Output("descrpt: T")
+    .Output("descrpt_deriv: T")
+    .Output("rij: T")
+    .Output("nlist: int32");
+
+// ProdEnvMatA fused with the TabulateFusion of the compressed se_a, only on CPU.
+// The descriptor (nsamples * nloc x 4 x last_layer_size) is the sum over the neighbor types
+// of the tabulated embedding contracted with the environment matrix, evaluated per atom
+// while its environment matrix is in cache. table is nnet x (nspline * 6 * last_layer_size),
+// the neighbors of type tt of an atom of type ti use the net tt if type_one_side,
+// and the net ti * ntypes + tt otherwise.
+REGISTER_OP("ProdEnvMatATabulate")
+    .Attr("T: {float, double} = DT_DOUBLE")
+    .Input("coord: T")
+    .Input("type: int32")
+    .Input("natoms: int32")
+    .Input("box : T")
+    .Input("mesh : int32")
+    .Input("davg: T")
+    .Input("dstd: T")
+    .Input("table: T")
+    .Input("table_info: T")
+    .Attr("rcut_a: float")
+    .Attr("rcut_r: float")
+    .Attr("rcut_r_smth: float")
+    .Attr("sel_a: list(int)")
+    .Attr("sel_r: list(int)")
+    .Attr("last_layer_size: int")
+    .Attr("type_one_side: bool = true")
+    .Output("descrpt: T")
+    .Output("descrpt_deriv: T")
+    .Output("rij: T")
+    .Output("nlist: int32")
+    .Output("descriptor: T");
+
 template<typename FPTYPE>
 static int
 _norm_copy_coord_cpu(
+    std::vector<FPTYPE> & coord_norm,
     std::vector<FPTYPE> & coord_cpy,
     std::vector<int> & type_cpy,
     std::vector<int> & mapping,
@@ -120,20 +215,44 @@ _map_nlist_cpu(
     const int & nloc,
     const int & nnei);
 
+// the host buffers of the copied coordinates and the nlist of a frame.
+// They are owned by the op and never shrink, so once they reach the sizes
+// of the system the evaluations do not reallocate them.
+template <typename FPTYPE>
+struct NlistBuffer {
+  std::vector<FPTYPE> coord_norm, coord_cpy;
+  std::vector<int> type_cpy, idx_mapping;
+  std::vector<int> ilist, numneigh;
+  std::vector<int*> firstneigh;
+  std::vector<std::vector<int>> jlist;
+  void reserve_nlist (const int nloc) {
+    if (int(jlist.size()) < nloc) {
+      ilist.resize(nloc);
+      numneigh.resize(nloc);
+      firstneigh.resize(nloc);
+      jlist.resize(nloc);
+    }
+  }
+};
+
+// the buffers of the frames of a batch, used by one evaluation at a time
+template <typename FPTYPE>
+struct NlistWorkspace {
+  std::vector<NlistBuffer<FPTYPE>> frames;
+  std::mutex mutex;
+  void reserve (const int nframes) {
+    if (int(frames.size()) < nframes) frames.resize(nframes);
+  }
+};
+
 template <typename FPTYPE>
 static void
 _prepare_coord_nlist_cpu(
     OpKernelContext* context,
     FPTYPE const ** coord,
-    std::vector<FPTYPE> & coord_cpy,
     int const** type,
-    std::vector<int> & type_cpy,
-    std::vector<int> & idx_mapping,
+    NlistBuffer<FPTYPE> & buffer,
     deepmd::InputNlist & inlist,
-    std::vector<int> & ilist,
-    std::vector<int> & numneigh,
-    std::vector<int*> & firstneigh,
-    std::vector<std::vector<int>> & jlist,
     int & new_nall,
     int & mem_cpy,
     int & mem_nnei,
@@ -146,6 +265,46 @@ _prepare_coord_nlist_cpu(
     const int & max_cpy_trial,
     const int & max_nnei_trial);
 
+// the ghost atoms and the nlist of the last frame with copied pbc (nei_mode 1), built with rcut + skin.
+// They are reused, with the ghost positions refreshed, until an atom moves by more than skin / 2
+// or the box, the number or the types of atoms change.
+template <typename FPTYPE>
+struct NlistCache {
+  bool valid;
+  std::vector<FPTYPE> box;
+  std::vector<int> type;
+  // the input coordinates at the build
+  std::vector<FPTYPE> coord_ref;
+  // the copied coordinates minus the coordinates of the atoms they are copied from
+  std::vector<FPTYPE> shift;
+  std::vector<FPTYPE> coord_norm, coord_cpy;
+  std::vector<int> type_cpy, idx_mapping;
+  std::vector<int> ilist, numneigh;
+  std::vector<int*> firstneigh;
+  std::vector<std::vector<int>> jlist;
+  int nall, max_nbor_size;
+  std::mutex mutex;
+  NlistCache () : valid (false), nall (0), max_nbor_size (0) {}
+};
+
+template <typename FPTYPE>
+static int
+_prepare_coord_nlist_cache_cpu(
+    NlistCache<FPTYPE> & cache,
+    FPTYPE const ** coord,
+    int const** type,
+    deepmd::InputNlist & inlist,
+    int & new_nall,
+    int & mem_cpy,
+    int & mem_nnei,
+    int & max_nbor_size,
+    const FPTYPE * box,
+    const int & nloc,
+    const float & rcut_r,
+    const float & skin,
+    const int & max_cpy_trial,
+    const int & max_nnei_trial);
+
 #if GOOGLE_CUDA
 template<typename FPTYPE>
 static int
@@ -319,6 +478,9 @@ public:
     mem_cpy = 256;
     max_nnei_trial = 100;
     mem_nnei = 256;
+    // the skin of the nlist cached for copied pbc, the cache is not used if it is 0
+    const char* env_skin = std::getenv("DP_NLIST_SKIN");
+    nlist_skin = env_skin ? atof(env_skin) : 0.;
   }
 
   void Compute(OpKernelContext* context) override {
@@ -436,6 +598,55 @@ public:
     const FPTYPE * std = std_tensor.flat<FPTYPE>().data();
     const int * p_type = type_tensor.flat<int>().data();
 
+    if (device == "CPU" && nsamples > 1 && nei_mode != 3) {
+      // the nlists of the frames are built in parallel, then the environment 
+      // matrices of all the frames are evaluated in one parallel loop over atoms
+      std::vector<const FPTYPE *> frame_coord(nsamples);
+      std::vector<const int *> frame_type(nsamples);
+      std::vector<int> frame_nall(nsamples, nall), frame_nbor(nsamples, 0), frame_ok(nsamples, 1);
+      std::vector<int> frame_mem_cpy(nsamples, mem_cpy), frame_mem_nnei(nsamples, mem_nnei);
+      std::vector<deepmd::InputNlist> inlist(nsamples);
+      // the buffers of the op, or local ones if another evaluation holds them
+      std::unique_lock<std::mutex> workspace_lock(nlist_workspace.mutex, std::try_to_lock);
+      NlistWorkspace<FPTYPE> local_workspace;
+      NlistWorkspace<FPTYPE> & workspace = workspace_lock.owns_lock() ? nlist_workspace : local_workspace;
+      workspace.reserve(nsamples);
+#pragma omp parallel for
+      for(int ff = 0; ff < nsamples; ++ff){
+	NlistBuffer<FPTYPE> & buffer = workspace.frames[ff];
+	frame_coord[ff] = p_coord + ff*nall*3;
+	frame_type[ff] = p_type + ff*nall;
+	if (nei_mode == 1) {
+	  frame_ok[ff] = _norm_copy_coord_cpu(
+	      buffer.coord_norm, buffer.coord_cpy, buffer.type_cpy, buffer.idx_mapping, frame_nall[ff], frame_mem_cpy[ff],
+	      frame_coord[ff], p_box + ff*9, frame_type[ff], nloc, max_cpy_trial, rcut_r);
+	  if (!frame_ok[ff]) continue;
+	  frame_coord[ff] = &buffer.coord_cpy[0];
+	  frame_type[ff] = &buffer.type_cpy[0];
+	}
+	buffer.reserve_nlist(nloc);
+	frame_ok[ff] = _build_nlist_cpu(
+	    buffer.ilist, buffer.numneigh, buffer.firstneigh, buffer.jlist, frame_nbor[ff], frame_mem_nnei[ff],
+	    frame_coord[ff], nloc, frame_nall[ff], max_nnei_trial, rcut_r);
+	inlist[ff] = deepmd::InputNlist(nloc, &buffer.ilist[0], &buffer.numneigh[0], &buffer.firstneigh[0]);
+      }
+      OP_REQUIRES (context, (*std::min_element(frame_ok.begin(), frame_ok.end()) == 1), errors::Aborted("cannot allocate mem for copied coords or nlist"));
+      mem_cpy = *std::max_element(frame_mem_cpy.begin(), frame_mem_cpy.end());
+      mem_nnei = *std::max_element(frame_mem_nnei.begin(), frame_mem_nnei.end());
+      max_nbor_size = *std::max_element(frame_nbor.begin(), frame_nbor.end());
+      deepmd::prod_env_mat_a_batch_cpu(
+	  p_em, p_em_deriv, p_rij, p_nlist, 
+	  &frame_coord[0], &frame_type[0], &inlist[0], &frame_nall[0], nsamples,
+	  max_nbor_size, avg, std, nloc, rcut_r, rcut_r_smth, sec_a);
+      // do nlist mapping if coords were copied
+      if(b_nlist_map) {
+	for(int ff = 0; ff < nsamples; ++ff){
+	  _map_nlist_cpu(p_nlist + ff*nloc*nnei, &workspace.frames[ff].idx_mapping[0], nloc, nnei);
+	}
+      }
+      return;
+    }
+
     // loop over samples
     for(int ff = 0; ff < nsamples; ++ff){
       FPTYPE * em = p_em + ff*nloc*ndescrpt;
@@ -525,26 +736,38 @@ public:
     }
     else if (device == "CPU") {
       deepmd::InputNlist inlist;
-      // some buffers, be freed after the evaluation of this frame
-      std::vector<int> idx_mapping;
-      std::vector<int> ilist(nloc), numneigh(nloc);
-      std::vector<int*> firstneigh(nloc);
-      std::vector<std::vector<int>> jlist(nloc);
-      std::vector<FPTYPE> coord_cpy;
-      std::vector<int> type_cpy;
+      // the buffers of the op, or local ones if another evaluation holds them
+      std::unique_lock<std::mutex> workspace_lock(nlist_workspace.mutex, std::try_to_lock);
+      NlistWorkspace<FPTYPE> local_workspace;
+      NlistWorkspace<FPTYPE> & workspace = workspace_lock.owns_lock() ? nlist_workspace : local_workspace;
+      workspace.reserve(1);
+      NlistBuffer<FPTYPE> & buffer = workspace.frames[0];
       int frame_nall = nall;
-      // prepare coord and nlist
-      _prepare_coord_nlist_cpu<FPTYPE>(
-	  context, &coord, coord_cpy, &type, type_cpy, idx_mapping, 
-	  inlist, ilist, numneigh, firstneigh, jlist,
-	  frame_nall, mem_cpy, mem_nnei, max_nbor_size,
-	  box, mesh_tensor.flat<int>().data(), nloc, nei_mode, rcut_r, max_cpy_trial, max_nnei_trial);
+      // the cache is for single frame evaluations, and is skipped if another evaluation holds it
+      std::unique_lock<std::mutex> cache_lock;
+      if (nei_mode == 1 && nlist_skin > 0 && nsamples == 1) {
+	cache_lock = std::unique_lock<std::mutex>(nlist_cache.mutex, std::try_to_lock);
+      }
+      if (cache_lock.owns_lock()) {
+	int cache_ok = _prepare_coord_nlist_cache_cpu<FPTYPE>(
+	    nlist_cache, &coord, &type, inlist, 
+	    frame_nall, mem_cpy, mem_nnei, max_nbor_size,
+	    box, nloc, rcut_r, nlist_skin, max_cpy_trial, max_nnei_trial);
+	OP_REQUIRES (context, cache_ok, errors::Aborted("cannot allocate mem for copied coords or nlist"));
+      }
+      else {
+	// prepare coord and nlist
+	_prepare_coord_nlist_cpu<FPTYPE>(
+	    context, &coord, &type, buffer, inlist,
+	    frame_nall, mem_cpy, mem_nnei, max_nbor_size,
+	    box, mesh_tensor.flat<int>().data(), nloc, nei_mode, rcut_r, max_cpy_trial, max_nnei_trial);
+      }
       // launch the cpu compute function
       deepmd::prod_env_mat_a_cpu(
 	  em, em_deriv, rij, nlist, 
 	  coord, type, inlist, max_nbor_size, avg, std, nloc, frame_nall, rcut_r, rcut_r_smth, sec_a);
       // do nlist mapping if coords were copied
-      if(b_nlist_map) _map_nlist_cpu(nlist, &idx_mapping[0], nloc, nnei);
+      if(b_nlist_map) _map_nlist_cpu(nlist, cache_lock.owns_lock() ? &nlist_cache.idx_mapping[0] : &buffer.idx_mapping[0], nloc, nnei);
     }
     }
   }
@@ -567,6 +790,9 @@ private:
   unsigned long long * array_longlong = NULL;
   deepmd::InputNlist gpu_inlist;
   int * nbor_list_dev = NULL;
+  float nlist_skin;
+  NlistCache<FPTYPE> nlist_cache;
+  NlistWorkspace<FPTYPE> nlist_workspace;
 };
 
 template<typename Device, typename FPTYPE>
@@ -790,25 +1016,23 @@ public:
     }
     else if (device == "CPU") {
       deepmd::InputNlist inlist;
-      // some buffers, be freed after the evaluation of this frame
-      std::vector<int> idx_mapping;
-      std::vector<int> ilist(nloc), numneigh(nloc);
-      std::vector<int*> firstneigh(nloc);
-      std::vector<std::vector<int>> jlist(nloc);
-      std::vector<FPTYPE> coord_cpy;
-      std::vector<int> type_cpy;
+      // the buffers of the op, or local ones if another evaluation holds them
+      std::unique_lock<std::mutex> workspace_lock(nlist_workspace.mutex, std::try_to_lock);
+      NlistWorkspace<FPTYPE> local_workspace;
+      NlistWorkspace<FPTYPE> & workspace = workspace_lock.owns_lock() ? nlist_workspace : local_workspace;
+      workspace.reserve(1);
+      NlistBuffer<FPTYPE> & buffer = workspace.frames[0];
       int frame_nall = nall;
       // prepare coord and nlist
       _prepare_coord_nlist_cpu<FPTYPE>(
-	  context, &coord, coord_cpy, &type, type_cpy, idx_mapping, 
-	  inlist, ilist, numneigh, firstneigh, jlist,
+	  context, &coord, &type, buffer, inlist,
 	  frame_nall, mem_cpy, mem_nnei, max_nbor_size,
 	  box, mesh_tensor.flat<int>().data(), nloc, nei_mode, rcut, max_cpy_trial, max_nnei_trial);
       // launch the cpu compute function
       prod_env_mat_r_cpu(
           em, em_deriv, rij, nlist, 
           coord, type, inlist, max_nbor_size, avg, std, nloc, frame_nall, rcut, rcut_smth, sec);
-      if(b_nlist_map) _map_nlist_cpu(nlist, &idx_mapping[0], nloc, nnei);
+      if(b_nlist_map) _map_nlist_cpu(nlist, &buffer.idx_mapping[0], nloc, nnei);
     }
     }
   }
@@ -830,6 +1054,418 @@ private:
   unsigned long long * array_longlong = NULL;
   deepmd::InputNlist gpu_inlist;
   int * nbor_list_dev = NULL;
+  NlistWorkspace<FPTYPE> nlist_workspace;
+};
+
+
+// CPU only, the projection on the field is fused into the environment matrix loop
+template<typename Device, typename FPTYPE>
+class ProdEnvMatAEfOp : public OpKernel {
+public:
+  explicit ProdEnvMatAEfOp(OpKernelConstruction* context) : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("rcut_a", &rcut_a));
+    OP_REQUIRES_OK(context, context->GetAttr("rcut_r", &rcut_r));
+    OP_REQUIRES_OK(context, context->GetAttr("rcut_r_smth", &rcut_r_smth));
+    OP_REQUIRES_OK(context, context->GetAttr("sel_a", &sel_a));
+    OP_REQUIRES_OK(context, context->GetAttr("sel_r", &sel_r));
+    deepmd::cum_sum (sec_a, sel_a);
+    deepmd::cum_sum (sec_r, sel_r);
+    ndescrpt_a = sec_a.back() * 4;
+    ndescrpt_r = sec_r.back() * 1;
+    ndescrpt = ndescrpt_a + ndescrpt_r;
+    nnei_a = sec_a.back();
+    nnei_r = sec_r.back();
+    nnei = nnei_a + nnei_r;
+    fill_nei_a = (rcut_a < 0);
+    // 0: DescrptSeAEf, 1: DescrptSeAEfPara, 2: DescrptSeAEfVert
+    const std::string & op_name = context->def().op();
+    if (op_name == "DescrptSeAEfPara") {
+      ef_proj = 1;
+    }
+    else if (op_name == "DescrptSeAEfVert") {
+      ef_proj = 2;
+    }
+    else {
+      ef_proj = 0;
+    }
+    max_nbor_size = 1024;
+    max_cpy_trial = 100;
+    mem_cpy = 256;
+    max_nnei_trial = 100;
+    mem_nnei = 256;
+  }
+
+  void Compute(OpKernelContext* context) override {
+    deepmd::safe_compute(context, [this](OpKernelContext* context) {this->_Compute(context);});
+  }
+
+  void _Compute(OpKernelContext* context) {
+    // Grab the input tensor
+    int context_input_index = 0;
+    const Tensor& coord_tensor	= context->input(context_input_index++);
+    const Tensor& type_tensor	= context->input(context_input_index++);
+    const Tensor& natoms_tensor	= context->input(context_input_index++);
+    const Tensor& box_tensor	= context->input(context_input_index++);
+    const Tensor& mesh_tensor   = context->input(context_input_index++);
+    const Tensor& ef_tensor	= context->input(context_input_index++);
+    const Tensor& avg_tensor	= context->input(context_input_index++);
+    const Tensor& std_tensor	= context->input(context_input_index++);
+    // set size of the sample
+    OP_REQUIRES (context, (coord_tensor.shape().dims() == 2),       errors::InvalidArgument ("Dim of coord should be 2"));
+    OP_REQUIRES (context, (type_tensor.shape().dims() == 2),        errors::InvalidArgument ("Dim of type should be 2"));
+    OP_REQUIRES (context, (natoms_tensor.shape().dims() == 1),      errors::InvalidArgument ("Dim of natoms should be 1"));
+    OP_REQUIRES (context, (box_tensor.shape().dims() == 2),         errors::InvalidArgument ("Dim of box should be 2"));
+    OP_REQUIRES (context, (mesh_tensor.shape().dims() == 1),        errors::InvalidArgument ("Dim of mesh should be 1"));
+    OP_REQUIRES (context, (ef_tensor.shape().dims() == 2),          errors::InvalidArgument ("Dim of ef should be 2"));
+    OP_REQUIRES (context, (avg_tensor.shape().dims() == 2),         errors::InvalidArgument ("Dim of avg should be 2"));
+    OP_REQUIRES (context, (std_tensor.shape().dims() == 2),         errors::InvalidArgument ("Dim of std should be 2"));
+    OP_REQUIRES (context, (fill_nei_a),                             errors::InvalidArgument ("Rotational free descriptor only support the case rcut_a < 0"));
+    OP_REQUIRES (context, (sec_r.back() == 0),                      errors::InvalidArgument ("Rotational free descriptor only support all-angular information: sel_r should be all zero."));
+    OP_REQUIRES (context, (natoms_tensor.shape().dim_size(0) >= 3), errors::InvalidArgument ("number of atoms should be larger than (or equal to) 3"));
+    const int * natoms = natoms_tensor.flat<int>().data();
+    int nloc = natoms[0];
+    int nall = natoms[1];
+    int ntypes = natoms_tensor.shape().dim_size(0) - 2;
+    int nsamples = coord_tensor.shape().dim_size(0);
+    //// check the sizes
+    OP_REQUIRES (context, (nsamples == type_tensor.shape().dim_size(0)),  errors::InvalidArgument ("number of samples should match"));
+    OP_REQUIRES (context, (nsamples == box_tensor.shape().dim_size(0)),   errors::InvalidArgument ("number of samples should match"));
+    OP_REQUIRES (context, (nsamples == ef_tensor.shape().dim_size(0)),    errors::InvalidArgument ("number of samples should match"));
+    OP_REQUIRES (context, (ntypes == avg_tensor.shape().dim_size(0)),     errors::InvalidArgument ("number of avg should be ntype"));
+    OP_REQUIRES (context, (ntypes == std_tensor.shape().dim_size(0)),     errors::InvalidArgument ("number of std should be ntype"));
+
+    OP_REQUIRES (context, (nall * 3 == coord_tensor.shape().dim_size(1)), errors::InvalidArgument ("number of atoms should match"));
+    OP_REQUIRES (context, (nall == type_tensor.shape().dim_size(1)),      errors::InvalidArgument ("number of atoms should match"));
+    OP_REQUIRES (context, (9 == box_tensor.shape().dim_size(1)),          errors::InvalidArgument ("number of box should be 9"));
+    OP_REQUIRES (context, (nloc * 3 == ef_tensor.shape().dim_size(1)),    errors::InvalidArgument ("number of ef should be 3"));
+    OP_REQUIRES (context, (ndescrpt == avg_tensor.shape().dim_size(1)),   errors::InvalidArgument ("number of avg should be ndescrpt"));
+    OP_REQUIRES (context, (ndescrpt == std_tensor.shape().dim_size(1)),   errors::InvalidArgument ("number of std should be ndescrpt"));
+
+    OP_REQUIRES (context, (ntypes == int(sel_a.size())),  errors::InvalidArgument ("number of types should match the length of sel array"));
+    OP_REQUIRES (context, (ntypes == int(sel_r.size())),  errors::InvalidArgument ("number of types should match the length of sel array"));
+
+    int nei_mode = 0;
+    bool b_nlist_map = false;
+    if (mesh_tensor.shape().dim_size(0) == 16) {
+      // lammps neighbor list
+      nei_mode = 3;
+    }
+    else if (mesh_tensor.shape().dim_size(0) == 6) {
+      // manual copied pbc
+      assert (nloc == nall);
+      nei_mode = 1;
+      b_nlist_map = true;
+    }
+    else if (mesh_tensor.shape().dim_size(0) == 0) {
+      // no pbc
+      assert (nloc == nall);
+      nei_mode = -1;
+    }
+    else {
+      throw deepmd::deepmd_exception("invalid mesh tensor");
+    }
+
+    // Create output tensors
+    TensorShape descrpt_shape ;
+    descrpt_shape.AddDim (nsamples);
+    descrpt_shape.AddDim (nloc * ndescrpt);
+    TensorShape descrpt_deriv_shape ;
+    descrpt_deriv_shape.AddDim (nsamples);
+    descrpt_deriv_shape.AddDim (nloc * ndescrpt * 3);
+    TensorShape rij_shape ;
+    rij_shape.AddDim (nsamples);
+    rij_shape.AddDim (nloc * nnei * 3);
+    TensorShape nlist_shape ;
+    nlist_shape.AddDim (nsamples);
+    nlist_shape.AddDim (nloc * nnei);
+    // define output tensor
+    int context_output_index = 0;
+    Tensor* descrpt_tensor = NULL;
+    Tensor* descrpt_deriv_tensor = NULL;
+    Tensor* rij_tensor = NULL;
+    Tensor* nlist_tensor = NULL;
+    OP_REQUIRES_OK(context, context->allocate_output(
+        context_output_index++,
+        descrpt_shape,
+        &descrpt_tensor));
+    OP_REQUIRES_OK(context, context->allocate_output(
+        context_output_index++,
+        descrpt_deriv_shape,
+        &descrpt_deriv_tensor));
+    OP_REQUIRES_OK(context, context->allocate_output(
+        context_output_index++,
+        rij_shape,
+        &rij_tensor));
+    OP_REQUIRES_OK(context, context->allocate_output(
+        context_output_index++,
+        nlist_shape,
+        &nlist_tensor));
+
+    FPTYPE * p_em = descrpt_tensor->flat<FPTYPE>().data();
+    FPTYPE * p_em_deriv = descrpt_deriv_tensor->flat<FPTYPE>().data();
+    FPTYPE * p_rij = rij_tensor->flat<FPTYPE>().data();
+    int * p_nlist = nlist_tensor->flat<int>().data();
+    const FPTYPE * p_coord = coord_tensor.flat<FPTYPE>().data();
+    const FPTYPE * p_box = box_tensor.flat<FPTYPE>().data();
+    const FPTYPE * p_ef = ef_tensor.flat<FPTYPE>().data();
+    const FPTYPE * avg = avg_tensor.flat<FPTYPE>().data();
+    const FPTYPE * std = std_tensor.flat<FPTYPE>().data();
+    const int * p_type = type_tensor.flat<int>().data();
+
+    // loop over samples
+    for(int ff = 0; ff < nsamples; ++ff){
+      FPTYPE * em = p_em + ff*nloc*ndescrpt;
+      FPTYPE * em_deriv = p_em_deriv + ff*nloc*ndescrpt*3;
+      FPTYPE * rij = p_rij + ff*nloc*nnei*3;
+      int * nlist = p_nlist + ff*nloc*nnei;
+      const FPTYPE * coord = p_coord + ff*nall*3;
+      const FPTYPE * box = p_box + ff*9;
+      const FPTYPE * ef = p_ef + ff*nloc*3;
+      const int * type = p_type + ff*nall;
+
+      deepmd::InputNlist inlist;
+      // the buffers of the op, or local ones if another evaluation holds them
+      std::unique_lock<std::mutex> workspace_lock(nlist_workspace.mutex, std::try_to_lock);
+      NlistWorkspace<FPTYPE> local_workspace;
+      NlistWorkspace<FPTYPE> & workspace = workspace_lock.owns_lock() ? nlist_workspace : local_workspace;
+      workspace.reserve(1);
+      NlistBuffer<FPTYPE> & buffer = workspace.frames[0];
+      int frame_nall = nall;
+      // prepare coord and nlist
+      _prepare_coord_nlist_cpu<FPTYPE>(
+	  context, &coord, &type, buffer, inlist,
+	  frame_nall, mem_cpy, mem_nnei, max_nbor_size,
+	  box, mesh_tensor.flat<int>().data(), nloc, nei_mode, rcut_r, max_cpy_trial, max_nnei_trial);
+      // launch the cpu compute function
+      deepmd::prod_env_mat_a_ef_cpu(
+	  em, em_deriv, rij, nlist, 
+	  coord, type, ef, inlist, max_nbor_size, avg, std, nloc, frame_nall, rcut_r, rcut_r_smth, sec_a, ef_proj);
+      // do nlist mapping if coords were copied
+      if(b_nlist_map) _map_nlist_cpu(nlist, &buffer.idx_mapping[0], nloc, nnei);
+    }
+  }
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+private:
+  float rcut_a;
+  float rcut_r;
+  float rcut_r_smth;
+  std::vector<int32> sel_r;
+  std::vector<int32> sel_a;
+  std::vector<int> sec_a;
+  std::vector<int> sec_r;
+  int ndescrpt, ndescrpt_a, ndescrpt_r;
+  int nnei, nnei_a, nnei_r, max_nbor_size;
+  int mem_cpy, max_cpy_trial;
+  int mem_nnei, max_nnei_trial;
+  bool fill_nei_a;
+  int ef_proj;
+  NlistWorkspace<FPTYPE> nlist_workspace;
+};
+
+
+
+
+template<typename Device, typename FPTYPE>
+class ProdEnvMatATabulateOp : public OpKernel {
+public:
+  explicit ProdEnvMatATabulateOp(OpKernelConstruction* context) : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("rcut_a", &rcut_a));
+    OP_REQUIRES_OK(context, context->GetAttr("rcut_r", &rcut_r));
+    OP_REQUIRES_OK(context, context->GetAttr("rcut_r_smth", &rcut_r_smth));
+    OP_REQUIRES_OK(context, context->GetAttr("sel_a", &sel_a));
+    OP_REQUIRES_OK(context, context->GetAttr("sel_r", &sel_r));
+    OP_REQUIRES_OK(context, context->GetAttr("last_layer_size", &last_layer_size));
+    OP_REQUIRES_OK(context, context->GetAttr("type_one_side", &type_one_side));
+    deepmd::cum_sum (sec_a, sel_a);
+    deepmd::cum_sum (sec_r, sel_r);
+    ndescrpt = sec_a.back() * 4;
+    nnei = sec_a.back();
+    max_cpy_trial = 100;
+    mem_cpy = 256;
+    max_nnei_trial = 100;
+    mem_nnei = 256;
+  }
+
+  void Compute(OpKernelContext* context) override {
+    deepmd::safe_compute(context, [this](OpKernelContext* context) {this->_Compute(context);});
+  }
+
+  void _Compute(OpKernelContext* context) {
+    // Grab the input tensor
+    int context_input_index = 0;
+    const Tensor& coord_tensor	= context->input(context_input_index++);
+    const Tensor& type_tensor	= context->input(context_input_index++);
+    const Tensor& natoms_tensor	= context->input(context_input_index++);
+    const Tensor& box_tensor	= context->input(context_input_index++);
+    const Tensor& mesh_tensor   = context->input(context_input_index++);
+    const Tensor& avg_tensor	= context->input(context_input_index++);
+    const Tensor& std_tensor	= context->input(context_input_index++);
+    const Tensor& table_tensor	= context->input(context_input_index++);
+    const Tensor& table_info_tensor = context->input(context_input_index++);
+    OP_REQUIRES (context, (coord_tensor.shape().dims() == 2),       errors::InvalidArgument ("Dim of coord should be 2"));
+    OP_REQUIRES (context, (type_tensor.shape().dims() == 2),        errors::InvalidArgument ("Dim of type should be 2"));
+    OP_REQUIRES (context, (natoms_tensor.shape().dims() == 1),      errors::InvalidArgument ("Dim of natoms should be 1"));
+    OP_REQUIRES (context, (box_tensor.shape().dims() == 2),         errors::InvalidArgument ("Dim of box should be 2"));
+    OP_REQUIRES (context, (mesh_tensor.shape().dims() == 1),        errors::InvalidArgument ("Dim of mesh should be 1"));
+    OP_REQUIRES (context, (avg_tensor.shape().dims() == 2),         errors::InvalidArgument ("Dim of avg should be 2"));
+    OP_REQUIRES (context, (std_tensor.shape().dims() == 2),         errors::InvalidArgument ("Dim of std should be 2"));
+    OP_REQUIRES (context, (table_info_tensor.NumElements() >= 6),   errors::InvalidArgument ("table_info should have 6 elements"));
+    OP_REQUIRES (context, (sec_r.back() == 0),                      errors::InvalidArgument ("Rotational free descriptor only support all-angular information: sel_r should be all zero."));
+    OP_REQUIRES (context, (natoms_tensor.shape().dim_size(0) >= 3), errors::InvalidArgument ("number of atoms should be larger than (or equal to) 3"));
+    DeviceFunctor() (
+        device,
+        context->eigen_device<Device>()
+    );
+    OP_REQUIRES (context, (device == "CPU"),                        errors::InvalidArgument ("ProdEnvMatATabulate is only implemented on CPU"));
+    const int * natoms = natoms_tensor.flat<int>().data();
+    int nloc = natoms[0];
+    int nall = natoms[1];
+    int ntypes = natoms_tensor.shape().dim_size(0) - 2; //nloc and nall mean something.
+    int nsamples = coord_tensor.shape().dim_size(0);
+    int nnet = type_one_side ? ntypes : ntypes * ntypes;
+    //// check the sizes
+    OP_REQUIRES (context, (nsamples == type_tensor.shape().dim_size(0)),  errors::InvalidArgument ("number of samples should match"));
+    OP_REQUIRES (context, (nsamples == box_tensor.shape().dim_size(0)),   errors::InvalidArgument ("number of samples should match"));
+    OP_REQUIRES (context, (ntypes == avg_tensor.shape().dim_size(0)),     errors::InvalidArgument ("number of avg should be ntype"));
+    OP_REQUIRES (context, (ntypes == std_tensor.shape().dim_size(0)),     errors::InvalidArgument ("number of std should be ntype"));
+    OP_REQUIRES (context, (nall * 3 == coord_tensor.shape().dim_size(1)), errors::InvalidArgument ("number of atoms should match"));
+    OP_REQUIRES (context, (nall == type_tensor.shape().dim_size(1)),      errors::InvalidArgument ("number of atoms should match"));
+    OP_REQUIRES (context, (9 == box_tensor.shape().dim_size(1)),          errors::InvalidArgument ("number of box should be 9"));
+    OP_REQUIRES (context, (ndescrpt == avg_tensor.shape().dim_size(1)),   errors::InvalidArgument ("number of avg should be ndescrpt"));
+    OP_REQUIRES (context, (ndescrpt == std_tensor.shape().dim_size(1)),   errors::InvalidArgument ("number of std should be ndescrpt"));
+    OP_REQUIRES (context, (ntypes == int(sel_a.size())),  errors::InvalidArgument ("number of types should match the length of sel array"));
+    OP_REQUIRES (context, (ntypes == int(sel_r.size())),  errors::InvalidArgument ("number of types should match the length of sel array"));
+    OP_REQUIRES (context, (table_tensor.NumElements() % (nnet * 6 * last_layer_size) == 0), errors::InvalidArgument ("size of table should be nnet x nspline x 6 x last_layer_size"));
+    int nspline = table_tensor.NumElements() / (nnet * 6 * last_layer_size);
+
+    int nei_mode = 0;
+    bool b_nlist_map = false;
+    if (mesh_tensor.shape().dim_size(0) == 16) {
+      // lammps neighbor list
+      nei_mode = 3;
+    }
+    else if (mesh_tensor.shape().dim_size(0) == 6) {
+      // manual copied pbc
+      assert (nloc == nall);
+      nei_mode = 1;
+      b_nlist_map = true;
+    }
+    else if (mesh_tensor.shape().dim_size(0) == 0) {
+      // no pbc
+      assert (nloc == nall);
+      nei_mode = -1;
+    }
+    else {
+      throw deepmd::deepmd_exception("invalid mesh tensor");
+    }
+
+    // Create output tensors
+    TensorShape descrpt_shape ;
+    descrpt_shape.AddDim (nsamples);
+    descrpt_shape.AddDim (nloc * ndescrpt);
+    TensorShape descrpt_deriv_shape ;
+    descrpt_deriv_shape.AddDim (nsamples);
+    descrpt_deriv_shape.AddDim (nloc * ndescrpt * 3);
+    TensorShape rij_shape ;
+    rij_shape.AddDim (nsamples);
+    rij_shape.AddDim (nloc * nnei * 3);
+    TensorShape nlist_shape ;
+    nlist_shape.AddDim (nsamples);
+    nlist_shape.AddDim (nloc * nnei);
+    TensorShape descriptor_shape ;
+    descriptor_shape.AddDim (nsamples * nloc);
+    descriptor_shape.AddDim (4);
+    descriptor_shape.AddDim (last_layer_size);
+    // define output tensor
+    int context_output_index = 0;
+    Tensor* descrpt_tensor = NULL;
+    Tensor* descrpt_deriv_tensor = NULL;
+    Tensor* rij_tensor = NULL;
+    Tensor* nlist_tensor = NULL;
+    Tensor* descriptor_tensor = NULL;
+    OP_REQUIRES_OK(context, context->allocate_output(
+        context_output_index++,
+        descrpt_shape,
+        &descrpt_tensor));
+    OP_REQUIRES_OK(context, context->allocate_output(
+        context_output_index++,
+        descrpt_deriv_shape,
+        &descrpt_deriv_tensor));
+    OP_REQUIRES_OK(context, context->allocate_output(
+        context_output_index++,
+        rij_shape,
+        &rij_tensor));
+    OP_REQUIRES_OK(context, context->allocate_output(
+        context_output_index++,
+        nlist_shape,
+        &nlist_tensor));
+    OP_REQUIRES_OK(context, context->allocate_output(
+        context_output_index++,
+        descriptor_shape,
+        &descriptor_tensor));
+
+    FPTYPE * p_em = descrpt_tensor->flat<FPTYPE>().data();
+    FPTYPE * p_em_deriv = descrpt_deriv_tensor->flat<FPTYPE>().data();
+    FPTYPE * p_rij = rij_tensor->flat<FPTYPE>().data();
+    int * p_nlist = nlist_tensor->flat<int>().data();
+    FPTYPE * p_descriptor = descriptor_tensor->flat<FPTYPE>().data();
+    const FPTYPE * p_coord = coord_tensor.flat<FPTYPE>().data();
+    const FPTYPE * p_box = box_tensor.flat<FPTYPE>().data();
+    const FPTYPE * avg = avg_tensor.flat<FPTYPE>().data();
+    const FPTYPE * std = std_tensor.flat<FPTYPE>().data();
+    const FPTYPE * table = table_tensor.flat<FPTYPE>().data();
+    const FPTYPE * table_info = table_info_tensor.flat<FPTYPE>().data();
+    const int * p_type = type_tensor.flat<int>().data();
+
+    // the nlists of the frames are prepared one by one, then the descriptors
+    // of all the frames are evaluated in one parallel loop over atoms
+    std::vector<const FPTYPE *> frame_coord(nsamples);
+    std::vector<const int *> frame_type(nsamples);
+    std::vector<int> frame_nall(nsamples, nall), frame_nbor(nsamples, 0);
+    std::vector<deepmd::InputNlist> inlist(nsamples);
+    // the buffers of the op, or local ones if another evaluation holds them
+    std::unique_lock<std::mutex> workspace_lock(nlist_workspace.mutex, std::try_to_lock);
+    NlistWorkspace<FPTYPE> local_workspace;
+    NlistWorkspace<FPTYPE> & workspace = workspace_lock.owns_lock() ? nlist_workspace : local_workspace;
+    workspace.reserve(nsamples);
+    for(int ff = 0; ff < nsamples; ++ff){
+      frame_coord[ff] = p_coord + ff*nall*3;
+      frame_type[ff] = p_type + ff*nall;
+      _prepare_coord_nlist_cpu<FPTYPE>(
+	  context, &frame_coord[ff], &frame_type[ff], workspace.frames[ff], inlist[ff],
+	  frame_nall[ff], mem_cpy, mem_nnei, frame_nbor[ff],
+	  p_box + ff*9, mesh_tensor.flat<int>().data(), nloc, nei_mode, rcut_r, max_cpy_trial, max_nnei_trial);
+    }
+    int max_nbor_size = *std::max_element(frame_nbor.begin(), frame_nbor.end());
+    deepmd::prod_env_mat_a_tabulate_batch_cpu(
+	p_descriptor, p_em, p_em_deriv, p_rij, p_nlist,
+	&frame_coord[0], &frame_type[0], &inlist[0], &frame_nall[0], nsamples,
+	max_nbor_size, avg, std, table, table_info, nloc, rcut_r, rcut_r_smth, sec_a,
+	nspline, last_layer_size, type_one_side);
+    // do nlist mapping if coords were copied
+    if(b_nlist_map) {
+      for(int ff = 0; ff < nsamples; ++ff){
+	_map_nlist_cpu(p_nlist + ff*nloc*nnei, &workspace.frames[ff].idx_mapping[0], nloc, nnei);
+      }
+    }
+  }
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+private:
+  float rcut_a;
+  float rcut_r;
+  float rcut_r_smth;
+  std::vector<int32> sel_r;
+  std::vector<int32> sel_a;
+  std::vector<int> sec_a;
+  std::vector<int> sec_r;
+  int ndescrpt, nnei, last_layer_size;
+  bool type_one_side;
+  int mem_cpy, max_cpy_trial;
+  int mem_nnei, max_nnei_trial;
+  std::string device;
+  NlistWorkspace<FPTYPE> nlist_workspace;
 };
 
 
@@ -838,6 +1474,7 @@ private:
 template<typename FPTYPE>
 static int
 _norm_copy_coord_cpu(
+    std::vector<FPTYPE> & coord_norm,
     std::vector<FPTYPE> & coord_cpy,
     std::vector<int> & type_cpy,
     std::vector<int> & idx_mapping,
@@ -850,19 +1487,21 @@ _norm_copy_coord_cpu(
     const int &max_cpy_trial, 
     const float & rcut_r)
 {
-  std::vector<FPTYPE> tmp_coord(nall*3);
-  std::copy(coord, coord+nall*3, tmp_coord.begin());
+  coord_norm.assign(coord, coord+nall*3);
   deepmd::Region<FPTYPE> region;
   init_region_cpu(region, box);
-  normalize_coord_cpu(&tmp_coord[0], nall, region);
+  normalize_coord_cpu(&coord_norm[0], nall, region);
   int tt;
   for(tt = 0; tt < max_cpy_trial; ++tt){
-    coord_cpy.resize(mem_cpy*3);
-    type_cpy.resize(mem_cpy);
-    idx_mapping.resize(mem_cpy);
+    // the buffers are only grown, they may be larger than mem_cpy
+    if (int(idx_mapping.size()) < mem_cpy) {
+      coord_cpy.resize(mem_cpy*3);
+      type_cpy.resize(mem_cpy);
+      idx_mapping.resize(mem_cpy);
+    }
     int ret = copy_coord_cpu(
 	&coord_cpy[0], &type_cpy[0], &idx_mapping[0], &nall, 
-	&tmp_coord[0], type, nloc, mem_cpy, rcut_r, region);
+	&coord_norm[0], type, nloc, mem_cpy, rcut_r, region);
     if(ret == 0){
       break;
     }
@@ -870,6 +1509,11 @@ _norm_copy_coord_cpu(
       mem_cpy *= 2;
     }
   }
+  if (deepmd::nlist_stat_enabled() && tt > 0) {
+    deepmd::NlistStat stat;
+    stat.nretry = tt;
+    deepmd::nlist_stat_add(stat);
+  }
   return (tt != max_cpy_trial);
 }
 
@@ -891,7 +1535,7 @@ _build_nlist_cpu(
   int tt;
   for(tt = 0; tt < max_nnei_trial; ++tt){
     for(int ii = 0; ii < nloc; ++ii){
-      jlist[ii].resize(mem_nnei);
+      if (int(jlist[ii].size()) < mem_nnei) jlist[ii].resize(mem_nnei);
       firstneigh[ii] = &jlist[ii][0];
     }
     deepmd::InputNlist inlist(nloc, &ilist[0], &numneigh[0], &firstneigh[0]);
@@ -905,6 +1549,9 @@ _build_nlist_cpu(
       mem_nnei *= 2;
     }
   }
+  if (deepmd::nlist_stat_enabled()) {
+    deepmd::nlist_stat_add_build(tt, max_nnei);
+  }
   return (tt != max_nnei_trial);
 }
     
@@ -930,15 +1577,9 @@ static void
 _prepare_coord_nlist_cpu(
     OpKernelContext* context,
     FPTYPE const ** coord,
-    std::vector<FPTYPE> & coord_cpy,
     int const** type,
-    std::vector<int> & type_cpy,
-    std::vector<int> & idx_mapping,
+    NlistBuffer<FPTYPE> & buffer,
     deepmd::InputNlist & inlist,
-    std::vector<int> & ilist,
-    std::vector<int> & numneigh,
-    std::vector<int*> & firstneigh,
-    std::vector<std::vector<int>> & jlist,
     int & new_nall,
     int & mem_cpy,
     int & mem_nnei,
@@ -957,20 +1598,21 @@ _prepare_coord_nlist_cpu(
     // normalize and copy coord
     if(nei_mode == 1){
       int copy_ok = _norm_copy_coord_cpu(
-	  coord_cpy, type_cpy, idx_mapping, new_nall, mem_cpy,
+	  buffer.coord_norm, buffer.coord_cpy, buffer.type_cpy, buffer.idx_mapping, new_nall, mem_cpy,
 	  *coord, box, *type, nloc, max_cpy_trial, rcut_r);
       OP_REQUIRES (context, copy_ok, errors::Aborted("cannot allocate mem for copied coords"));
-      *coord = &coord_cpy[0];
-      *type = &type_cpy[0];
+      *coord = &buffer.coord_cpy[0];
+      *type = &buffer.type_cpy[0];
     }
     // build nlist
+    buffer.reserve_nlist(nloc);
     int build_ok = _build_nlist_cpu(
-	ilist, numneigh, firstneigh, jlist, max_nbor_size, mem_nnei,
+	buffer.ilist, buffer.numneigh, buffer.firstneigh, buffer.jlist, max_nbor_size, mem_nnei,
 	*coord, nloc, new_nall, max_nnei_trial, rcut_r);
     OP_REQUIRES (context, build_ok, errors::Aborted("cannot allocate mem for nlist"));
-    inlist.ilist = &ilist[0];
-    inlist.numneigh = &numneigh[0];
-    inlist.firstneigh = &firstneigh[0];
+    inlist.ilist = &buffer.ilist[0];
+    inlist.numneigh = &buffer.numneigh[0];
+    inlist.firstneigh = &buffer.firstneigh[0];
   }
   else{
     // copy pointers to nlist data
@@ -981,6 +1623,88 @@ _prepare_coord_nlist_cpu(
   }
 }
 
+template <typename FPTYPE>
+static int
+_prepare_coord_nlist_cache_cpu(
+    NlistCache<FPTYPE> & cache,
+    FPTYPE const ** coord,
+    int const** type,
+    deepmd::InputNlist & inlist,
+    int & new_nall,
+    int & mem_cpy,
+    int & mem_nnei,
+    int & max_nbor_size,
+    const FPTYPE * box,
+    const int & nloc,
+    const float & rcut_r,
+    const float & skin,
+    const int & max_cpy_trial,
+    const int & max_nnei_trial)
+{
+  bool reuse = cache.valid 
+      && int(cache.type.size()) == nloc
+      && std::equal(box, box + 9, cache.box.begin())
+      && std::equal(*type, *type + nloc, cache.type.begin());
+  if (reuse) {
+    FPTYPE max_disp2 = 0;
+    for (int ii = 0; ii < nloc * 3; ii += 3) {
+      FPTYPE diff[3];
+      for (int dd = 0; dd < 3; ++dd) {
+	diff[dd] = (*coord)[ii + dd] - cache.coord_ref[ii + dd];
+      }
+      max_disp2 = std::max(max_disp2, deepmd::dot3(diff, diff));
+    }
+    reuse = (4 * max_disp2 <= skin * skin);
+  }
+  if (reuse) {
+    // refresh the positions of the copied atoms
+    for (int ii = 0; ii < cache.nall; ++ii) {
+      const FPTYPE * src = *coord + cache.idx_mapping[ii] * 3;
+      for (int dd = 0; dd < 3; ++dd) {
+	cache.coord_cpy[ii * 3 + dd] = src[dd] + cache.shift[ii * 3 + dd];
+      }
+    }
+  }
+  else {
+    cache.valid = false;
+    cache.nall = nloc;
+    if (!_norm_copy_coord_cpu(
+	    cache.coord_norm, cache.coord_cpy, cache.type_cpy, cache.idx_mapping, cache.nall, mem_cpy,
+	    *coord, box, *type, nloc, max_cpy_trial, rcut_r + skin)) {
+      return 0;
+    }
+    cache.ilist.resize(nloc);
+    cache.numneigh.resize(nloc);
+    cache.firstneigh.resize(nloc);
+    cache.jlist.resize(nloc);
+    if (!_build_nlist_cpu(
+	    cache.ilist, cache.numneigh, cache.firstneigh, cache.jlist, cache.max_nbor_size, mem_nnei,
+	    &cache.coord_cpy[0], nloc, cache.nall, max_nnei_trial, rcut_r + skin)) {
+      return 0;
+    }
+    cache.shift.resize(cache.nall * 3);
+    for (int ii = 0; ii < cache.nall; ++ii) {
+      const FPTYPE * src = *coord + cache.idx_mapping[ii] * 3;
+      for (int dd = 0; dd < 3; ++dd) {
+	cache.shift[ii * 3 + dd] = cache.coord_cpy[ii * 3 + dd] - src[dd];
+      }
+    }
+    cache.coord_ref.assign(*coord, *coord + nloc * 3);
+    cache.box.assign(box, box + 9);
+    cache.type.assign(*type, *type + nloc);
+    cache.valid = true;
+  }
+  *coord = &cache.coord_cpy[0];
+  *type = &cache.type_cpy[0];
+  new_nall = cache.nall;
+  max_nbor_size = cache.max_nbor_size;
+  inlist.inum = nloc;
+  inlist.ilist = &cache.ilist[0];
+  inlist.numneigh = &cache.numneigh[0];
+  inlist.firstneigh = &cache.firstneigh[0];
+  return 1;
+}
+
 #if GOOGLE_CUDA
 template<typename FPTYPE>
 static int
@@ -1059,6 +1783,11 @@ _norm_copy_coord_gpu(
   }
   region_dev.boxt = new_boxt;
   region_dev.rec_boxt = new_rec_boxt;
+  if (deepmd::nlist_stat_enabled() && tt > 0) {
+    deepmd::NlistStat stat;
+    stat.nretry = tt;
+    deepmd::nlist_stat_add(stat);
+  }
   return (tt != max_cpy_trial);
 }
 
@@ -1111,6 +1840,9 @@ _build_nlist_gpu(
       mem_nnei *= 2;
     }
   }
+  if (deepmd::nlist_stat_enabled()) {
+    deepmd::nlist_stat_add_build(tt, max_nnei);
+  }
   return (tt != max_nnei_trial);
 }
 
@@ -1274,6 +2006,11 @@ _norm_copy_coord_gpu_rocm(
   }
   region_dev.boxt = new_boxt;
   region_dev.rec_boxt = new_rec_boxt;
+  if (deepmd::nlist_stat_enabled() && tt > 0) {
+    deepmd::NlistStat stat;
+    stat.nretry = tt;
+    deepmd::nlist_stat_add(stat);
+  }
   return (tt != max_cpy_trial);
 }
 
@@ -1326,6 +2063,9 @@ _build_nlist_gpu_rocm(
       mem_nnei *= 2;
     }
   }
+  if (deepmd::nlist_stat_enabled()) {
+    deepmd::nlist_stat_add_build(tt, max_nnei);
+  }
   return (tt != max_nnei_trial);
 }
 
@@ -1425,7 +2165,19 @@ REGISTER_KERNEL_BUILDER(
     ProdEnvMatAOp<CPUDevice, T>);                                                                         \
 REGISTER_KERNEL_BUILDER(                                                                                  \
     Name("DescrptSeR").Device(DEVICE_CPU).TypeConstraint<T>("T"),                                        \
-    ProdEnvMatROp<CPUDevice, T>);   
+    ProdEnvMatROp<CPUDevice, T>);                                                                         \
+REGISTER_KERNEL_BUILDER(                                                                                  \
+    Name("DescrptSeAEf").Device(DEVICE_CPU).TypeConstraint<T>("T"),                                      \
+    ProdEnvMatAEfOp<CPUDevice, T>);                                                                       \
+REGISTER_KERNEL_BUILDER(                                                                                  \
+    Name("DescrptSeAEfPara").Device(DEVICE_CPU).TypeConstraint<T>("T"),                                  \
+    ProdEnvMatAEfOp<CPUDevice, T>);                                                                       \
+REGISTER_KERNEL_BUILDER(                                                                                  \
+    Name("DescrptSeAEfVert").Device(DEVICE_CPU).TypeConstraint<T>("T"),                                  \
+    ProdEnvMatAEfOp<CPUDevice, T>);                                                                       \
+REGISTER_KERNEL_BUILDER(                                                                                  \
+    Name("ProdEnvMatATabulate").Device(DEVICE_CPU).TypeConstraint<T>("T"),                               \
+    ProdEnvMatATabulateOp<CPUDevice, T>);
 REGISTER_CPU(float);                  
 REGISTER_CPU(double);                 
             
@@ -1,6 +1,8 @@
 #include "custom_op.h"
+#include "utilities.h"
 #include "prod_force.h"
 
+// if sel_a is given, the CPU kernel only visits the valid neighbors of each type in nlist
 REGISTER_OP("ProdForceSeA")
     .Attr("T: {float, double} = DT_DOUBLE")
     .Input("net_deriv: T")
@@ -9,6 +11,7 @@ REGISTER_OP("ProdForceSeA")
     .Input("natoms: int32")
     .Attr("n_a_sel: int")
     .Attr("n_r_sel: int")
+    .Attr("sel_a: list(int) = []")
     .Output("force: T");
 
 REGISTER_OP("ProdForceSeR")
@@ -22,7 +25,13 @@ REGISTER_OP("ProdForceSeR")
 template<typename Device, typename FPTYPE>
 class ProdForceSeAOp : public OpKernel {
 public:
-  explicit ProdForceSeAOp(OpKernelConstruction* context) : OpKernel(context) {}
+  explicit ProdForceSeAOp(OpKernelConstruction* context) : OpKernel(context) {
+    std::vector<int32> sel_a;
+    OP_REQUIRES_OK(context, context->GetAttr("sel_a", &sel_a));
+    if (!sel_a.empty()) {
+      deepmd::cum_sum (sec_a, sel_a);
+    }
+  }
 
   void Compute(OpKernelContext* context) override {
     deepmd::safe_compute(context, [this](OpKernelContext* context) {this->_Compute(context);});
@@ -51,6 +60,7 @@ public:
     OP_REQUIRES (context, (nframes == in_deriv_tensor.shape().dim_size(0)), errors::InvalidArgument ("number of samples should match"));
     OP_REQUIRES (context, (nframes == nlist_tensor.shape().dim_size(0)),    errors::InvalidArgument ("number of samples should match"));
     OP_REQUIRES (context, (nloc * ndescrpt * 3 == in_deriv_tensor.shape().dim_size(1)), errors::InvalidArgument ("number of descriptors should match"));
+    OP_REQUIRES (context, (sec_a.empty() || sec_a.back() == nnei),  errors::InvalidArgument ("the sum of sel_a should be the number of neighbors"));
     // Create an output tensor
     TensorShape force_shape ;
     force_shape.AddDim (nframes);
@@ -102,12 +112,13 @@ public:
     else if (device == "CPU") {
       deepmd::prod_force_a_cpu(    
           force, 
-          net_deriv, in_deriv, nlist, nloc, nall, nnei);
+          net_deriv, in_deriv, nlist, nloc, nall, nnei, sec_a);
     }
     }
   }
  private:
   std::string device;
+  std::vector<int> sec_a;
 };
 
 template<typename Device, typename FPTYPE>
@@ -0,0 +1,123 @@
+#include "custom_op.h"
+#include "prod_virial_grad.h"
+
+REGISTER_OP("ProdForceVirialSeAGrad")
+    .Attr("T: {float, double} = DT_DOUBLE")
+    .Input("grad_force: T")
+    .Input("grad_virial: T")
+    .Input("net_deriv: T")
+    .Input("in_deriv: T")
+    .Input("rij: T")
+    .Input("nlist: int32")
+    .Input("natoms: int32")
+    .Attr("n_a_sel: int")
+    .Attr("n_r_sel: int")
+    .Output("grad_net: T");
+
+template<typename Device, typename FPTYPE>
+class ProdForceVirialSeAGradOp : public OpKernel
+{
+public:
+  explicit ProdForceVirialSeAGradOp(OpKernelConstruction* context) : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("n_a_sel", &n_a_sel));
+    OP_REQUIRES_OK(context, context->GetAttr("n_r_sel", &n_r_sel));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    deepmd::safe_compute(context, [this](OpKernelContext* context) {this->_Compute(context);});
+  }
+
+  void _Compute(OpKernelContext* context) {
+    // Grab the input tensor
+    int context_input_index = 0;
+    const Tensor& grad_force_tensor	= context->input(context_input_index++);
+    const Tensor& grad_virial_tensor	= context->input(context_input_index++);
+    const Tensor& net_deriv_tensor	= context->input(context_input_index++);
+    const Tensor& in_deriv_tensor	= context->input(context_input_index++);
+    const Tensor& rij_tensor		= context->input(context_input_index++);
+    const Tensor& nlist_tensor		= context->input(context_input_index++);
+    const Tensor& natoms_tensor		= context->input(context_input_index++);
+
+    // set size of the sample
+    TensorShape grad_force_shape	= grad_force_tensor.shape();
+    TensorShape grad_virial_shape	= grad_virial_tensor.shape();
+    TensorShape net_deriv_shape		= net_deriv_tensor.shape();
+    TensorShape in_deriv_shape		= in_deriv_tensor.shape();
+    TensorShape rij_shape		= rij_tensor.shape();
+    TensorShape nlist_shape		= nlist_tensor.shape();
+
+    OP_REQUIRES (context, (grad_force_shape.dims() == 2),	errors::InvalidArgument ("Dim of grad force should be 2"));
+    OP_REQUIRES (context, (grad_virial_shape.dims() == 2),	errors::InvalidArgument ("Dim of grad virial should be 2"));
+    OP_REQUIRES (context, (net_deriv_shape.dims() == 2),errors::InvalidArgument ("Dim of net deriv should be 2"));
+    OP_REQUIRES (context, (in_deriv_shape.dims() == 2), errors::InvalidArgument ("Dim of input deriv should be 2"));
+    OP_REQUIRES (context, (rij_shape.dims() == 2),	errors::InvalidArgument ("Dim of rij should be 2"));
+    OP_REQUIRES (context, (nlist_shape.dims() == 2),	errors::InvalidArgument ("Dim of nlist should be 2"));
+    OP_REQUIRES (context, (natoms_tensor.shape().dims() == 1),		errors::InvalidArgument ("Dim of natoms should be 1"));
+
+    OP_REQUIRES (context, (natoms_tensor.shape().dim_size(0) >= 3),	errors::InvalidArgument ("number of atoms should be larger than (or equal to) 3"));
+    auto natoms	= natoms_tensor	.flat<int>();
+
+    int nframes = net_deriv_tensor.shape().dim_size(0);
+    int nloc = natoms(0);
+    int ndescrpt = net_deriv_tensor.shape().dim_size(1) / nloc;
+    int nnei = nlist_tensor.shape().dim_size(1) / nloc;
+
+    // check the sizes
+    OP_REQUIRES (context, (nframes == grad_force_shape.dim_size(0)),	errors::InvalidArgument ("number of frames should match"));
+    OP_REQUIRES (context, (nframes == grad_virial_shape.dim_size(0)),	errors::InvalidArgument ("number of frames should match"));
+    OP_REQUIRES (context, (nframes == in_deriv_shape.dim_size(0)),	errors::InvalidArgument ("number of frames should match"));
+    OP_REQUIRES (context, (nframes == rij_shape.dim_size(0)),		errors::InvalidArgument ("number of frames should match"));
+    OP_REQUIRES (context, (nframes == nlist_shape.dim_size(0)),		errors::InvalidArgument ("number of frames should match"));
+
+    OP_REQUIRES (context, (nloc * 3 == grad_force_shape.dim_size(1)),	errors::InvalidArgument ("input grad force shape should be 3 x natoms"));
+    OP_REQUIRES (context, (9 == grad_virial_shape.dim_size(1)),		errors::InvalidArgument ("input grad virial shape should be 9"));
+    OP_REQUIRES (context, (nloc * ndescrpt * 3 == in_deriv_shape.dim_size(1)),errors::InvalidArgument ("number of descriptors should match"));
+    OP_REQUIRES (context, (nloc * nnei * 3 == rij_shape.dim_size(1)),	errors::InvalidArgument ("dim of rij should be  nnei * 3"));
+    OP_REQUIRES (context, (nnei == n_a_sel + n_r_sel),			errors::InvalidArgument ("number of neighbors should match"));
+    OP_REQUIRES (context, (nnei * 4 == ndescrpt),			errors::InvalidArgument ("number of descriptors should be 4 x nnei"));
+
+    // Create an output tensor
+    TensorShape grad_net_shape ;
+    grad_net_shape.AddDim (nframes);
+    grad_net_shape.AddDim (nloc * ndescrpt);
+
+    // allocate the output tensor
+    Tensor* grad_net_tensor = NULL;
+    int context_output_index = 0;
+    OP_REQUIRES_OK(context, context->allocate_output(
+        context_output_index++,
+        grad_net_shape,
+        &grad_net_tensor));
+
+    // flat the tensors
+    FPTYPE * p_grad_net = grad_net_tensor->flat<FPTYPE>().data();
+    const FPTYPE * p_grad_force = grad_force_tensor.flat<FPTYPE>().data();
+    const FPTYPE * p_grad_virial = grad_virial_tensor.flat<FPTYPE>().data();
+    const FPTYPE * p_in_deriv = in_deriv_tensor.flat<FPTYPE>().data();
+    const FPTYPE * p_rij = rij_tensor.flat<FPTYPE>().data();
+    const int * p_nlist	= nlist_tensor.flat<int>().data();
+
+    // loop over frames
+    for (int kk = 0; kk < nframes; ++kk){
+      FPTYPE * grad_net = p_grad_net + kk * nloc * ndescrpt;
+      const FPTYPE * grad_force = p_grad_force + kk * nloc * 3;
+      const FPTYPE * grad_virial = p_grad_virial + kk * 9;
+      const FPTYPE * in_deriv = p_in_deriv + kk * nloc * ndescrpt * 3;
+      const FPTYPE * rij = p_rij + kk * nloc * nnei * 3;
+      const int * nlist = p_nlist + kk * nloc * nnei;
+      deepmd::prod_force_virial_grad_a_cpu(
+          grad_net,
+          grad_force, grad_virial, in_deriv, rij, nlist, nloc, nnei);
+    }
+  }
+private:
+  int n_r_sel, n_a_sel;
+};
+
+// Register the CPU kernels.
+#define REGISTER_CPU(T)                                                                         \
+REGISTER_KERNEL_BUILDER(                                                                        \
+    Name("ProdForceVirialSeAGrad").Device(DEVICE_CPU).TypeConstraint<T>("T"),                   \
+    ProdForceVirialSeAGradOp<CPUDevice, T>);
+REGISTER_CPU(float);
+REGISTER_CPU(double);
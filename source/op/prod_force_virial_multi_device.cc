@@ -0,0 +1,174 @@
+#include "custom_op.h"
+#include "utilities.h"
+#include "prod_force.h"
+#include "prod_virial.h"
+
+// the force and the virial of the se_a descriptor in one op,
+// so that their gradients are computed by the fused ProdForceVirialSeAGrad.
+// If sel_a is given, the CPU kernel only visits the valid neighbors of each type in nlist
+REGISTER_OP("ProdForceVirialSeA")
+    .Attr("T: {float, double} = DT_DOUBLE")
+    .Input("net_deriv: T")
+    .Input("in_deriv: T")
+    .Input("rij: T")
+    .Input("nlist: int32")
+    .Input("natoms: int32")
+    .Attr("n_a_sel: int")
+    .Attr("n_r_sel: int")
+    .Attr("compute_atom_virial: bool = true")
+    .Attr("sel_a: list(int) = []")
+    .Output("force: T")
+    .Output("virial: T")
+    .Output("atom_virial: T");
+
+template<typename Device, typename FPTYPE>
+class ProdForceVirialSeAOp : public OpKernel {
+ public:
+  explicit ProdForceVirialSeAOp(OpKernelConstruction* context) : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("compute_atom_virial", &compute_atom_virial));
+    std::vector<int32> sel_a;
+    OP_REQUIRES_OK(context, context->GetAttr("sel_a", &sel_a));
+    if (!sel_a.empty()) {
+      deepmd::cum_sum (sec_a, sel_a);
+    }
+  }
+  void Compute(OpKernelContext* context) override {
+      deepmd::safe_compute(context, [this](OpKernelContext* context) {this->_Compute(context);});
+  }
+
+  void _Compute(OpKernelContext* context) {
+    // Grab the input tensor
+    int context_input_index = 0;
+    const Tensor& net_deriv_tensor  = context->input(context_input_index++);
+    const Tensor& in_deriv_tensor   = context->input(context_input_index++);
+    const Tensor& rij_tensor        = context->input(context_input_index++);
+    const Tensor& nlist_tensor      = context->input(context_input_index++);
+    const Tensor& natoms_tensor     = context->input(context_input_index++);
+    // set size of the sample
+    OP_REQUIRES (context, (net_deriv_tensor.shape().dims() == 2),   errors::InvalidArgument ("Dim of net deriv should be 2"));
+    OP_REQUIRES (context, (in_deriv_tensor.shape().dims() == 2),    errors::InvalidArgument ("Dim of input deriv should be 2"));
+    OP_REQUIRES (context, (rij_tensor.shape().dims() == 2),         errors::InvalidArgument ("Dim of rij should be 2"));
+    OP_REQUIRES (context, (nlist_tensor.shape().dims() == 2),       errors::InvalidArgument ("Dim of nlist should be 2"));
+    OP_REQUIRES (context, (natoms_tensor.shape().dims() == 1),      errors::InvalidArgument ("Dim of natoms should be 1"));
+    OP_REQUIRES (context, (natoms_tensor.shape().dim_size(0) >= 3), errors::InvalidArgument ("number of atoms should be larger than (or equal to) 3"));
+    const int * natoms = natoms_tensor.flat<int>().data();
+    int nloc = natoms[0];
+    int nall = natoms[1];
+    int nnei = nlist_tensor.shape().dim_size(1) / nloc;
+    int nframes = net_deriv_tensor.shape().dim_size(0);
+    int ndescrpt = net_deriv_tensor.shape().dim_size(1) / nloc;
+    // check the sizes
+    OP_REQUIRES (context, (nframes == in_deriv_tensor.shape().dim_size(0)), errors::InvalidArgument ("number of samples should match"));
+    OP_REQUIRES (context, (nframes == rij_tensor.shape().dim_size(0)),      errors::InvalidArgument ("number of samples should match"));
+    OP_REQUIRES (context, (nframes == nlist_tensor.shape().dim_size(0)),    errors::InvalidArgument ("number of samples should match"));
+    OP_REQUIRES (context, (nloc * ndescrpt * 3 == in_deriv_tensor.shape().dim_size(1)), errors::InvalidArgument ("number of descriptors should match"));
+    OP_REQUIRES (context, (nloc * nnei * 3 == rij_tensor.shape().dim_size(1)),  errors::InvalidArgument ("dim of rij should be nnei * 3"));
+    OP_REQUIRES (context, (sec_a.empty() || sec_a.back() == nnei),  errors::InvalidArgument ("the sum of sel_a should be the number of neighbors"));
+    // Create an output tensor
+    TensorShape force_shape ;
+    force_shape.AddDim (nframes);
+    force_shape.AddDim (3 * nall);
+    TensorShape virial_shape ;
+    virial_shape.AddDim (nframes);
+    virial_shape.AddDim (9);
+    TensorShape atom_virial_shape;
+    atom_virial_shape.AddDim (nframes);
+    // the atomic virial is left empty if not requested
+    atom_virial_shape.AddDim (compute_atom_virial ? 9 * nall : 0);
+    int context_output_index = 0;
+    Tensor* force_tensor = NULL;
+    OP_REQUIRES_OK(context, context->allocate_output(
+        context_output_index++,
+        force_shape,
+        &force_tensor));
+    Tensor* virial_tensor = NULL;
+    OP_REQUIRES_OK(context, context->allocate_output(
+        context_output_index++,
+        virial_shape,
+        &virial_tensor));
+    Tensor* atom_virial_tensor = NULL;
+    OP_REQUIRES_OK(context, context->allocate_output(
+        context_output_index++,
+        atom_virial_shape,
+        &atom_virial_tensor));
+    DeviceFunctor() (
+        device,
+        context->eigen_device<Device>()
+    );
+    // flat the tensors
+    FPTYPE * p_force = force_tensor->flat<FPTYPE>().data();
+    FPTYPE * p_virial = virial_tensor->flat<FPTYPE>().data();
+    FPTYPE * p_atom_virial = atom_virial_tensor->flat<FPTYPE>().data();
+    Tensor atom_virial_buff_tensor;
+    if (!compute_atom_virial && device == "GPU") {
+      // the gpu kernels always scatter into the atomic virial
+      TensorShape atom_virial_buff_shape;
+      atom_virial_buff_shape.AddDim (nframes);
+      atom_virial_buff_shape.AddDim (9 * nall);
+      OP_REQUIRES_OK(context, context->allocate_temp(DataTypeToEnum<FPTYPE>::value, atom_virial_buff_shape, &atom_virial_buff_tensor));
+      p_atom_virial = atom_virial_buff_tensor.flat<FPTYPE>().data();
+    }
+    const FPTYPE * p_net_deriv = net_deriv_tensor.flat<FPTYPE>().data();
+    const FPTYPE * p_in_deriv = in_deriv_tensor.flat<FPTYPE>().data();
+    const FPTYPE * p_rij = rij_tensor.flat<FPTYPE>().data();
+    const int * p_nlist = nlist_tensor.flat<int>().data();
+
+    for(int kk = 0; kk < nframes; ++kk){
+      FPTYPE * force = p_force + kk * nall * 3;
+      FPTYPE * virial = p_virial + kk * 9;
+      FPTYPE * atom_virial = (compute_atom_virial || device == "GPU") ? p_atom_virial + kk * nall * 9 : NULL;
+      const FPTYPE * net_deriv = p_net_deriv + kk * nloc * ndescrpt;
+      const FPTYPE * in_deriv = p_in_deriv + kk * nloc * ndescrpt * 3;
+      const FPTYPE * rij = p_rij + kk * nloc * nnei * 3;
+      const int * nlist = p_nlist + kk * nloc * nnei;
+    if (device == "GPU") {
+      #if GOOGLE_CUDA
+      deepmd::prod_force_a_gpu_cuda(
+          force,
+          net_deriv, in_deriv, nlist, nloc, nall, nnei);
+      deepmd::prod_virial_a_gpu_cuda(
+          virial, atom_virial,
+          net_deriv, in_deriv, rij, nlist, nloc, nall, nnei);
+      #endif // GOOGLE_CUDA
+
+      #if TENSORFLOW_USE_ROCM
+      deepmd::prod_force_a_gpu_rocm(
+          force,
+          net_deriv, in_deriv, nlist, nloc, nall, nnei);
+      deepmd::prod_virial_a_gpu_rocm(
+          virial, atom_virial,
+          net_deriv, in_deriv, rij, nlist, nloc, nall, nnei);
+      #endif // TENSORFLOW_USE_ROCM
+    }
+    else if (device == "CPU") {
+      deepmd::prod_force_a_cpu(
+          force,
+          net_deriv, in_deriv, nlist, nloc, nall, nnei, sec_a);
+      deepmd::prod_virial_a_cpu(
+          virial, atom_virial,
+          net_deriv, in_deriv, rij, nlist, nloc, nall, nnei, sec_a);
+    }
+    }
+  }
+ private:
+  std::string device;
+  bool compute_atom_virial;
+  std::vector<int> sec_a;
+};
+
+// Register the CPU kernels.
+#define REGISTER_CPU(T)                                                                  \
+REGISTER_KERNEL_BUILDER(                                                                 \
+    Name("ProdForceVirialSeA").Device(DEVICE_CPU).TypeConstraint<T>("T"),                \
+    ProdForceVirialSeAOp<CPUDevice, T>);
+REGISTER_CPU(float);
+REGISTER_CPU(double);
+// Register the GPU kernels.
+#if GOOGLE_CUDA || TENSORFLOW_USE_ROCM
+#define REGISTER_GPU(T)                                                                  \
+REGISTER_KERNEL_BUILDER(                                                                 \
+    Name("ProdForceVirialSeA").Device(DEVICE_GPU).TypeConstraint<T>("T").HostMemory("natoms"), \
+    ProdForceVirialSeAOp<GPUDevice, T>);
+REGISTER_GPU(float);
+REGISTER_GPU(double);
+#endif  // GOOGLE_CUDA || TENSORFLOW_USE_ROCM
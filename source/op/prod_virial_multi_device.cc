@@ -1,6 +1,8 @@
 #include "custom_op.h"
+#include "utilities.h"
 #include "prod_virial.h"
 
+// if sel_a is given, the CPU kernel only visits the valid neighbors of each type in nlist
 REGISTER_OP("ProdVirialSeA")
     .Attr("T: {float, double} = DT_DOUBLE")
     .Input("net_deriv: T")
@@ -10,6 +12,8 @@ REGISTER_OP("ProdVirialSeA")
     .Input("natoms: int32")
     .Attr("n_a_sel: int")
     .Attr("n_r_sel: int")
+    .Attr("compute_atom_virial: bool = true")
+    .Attr("sel_a: list(int) = []")
     .Output("virial: T")
     .Output("atom_virial: T");
 
@@ -20,13 +24,21 @@ REGISTER_OP("ProdVirialSeR")
     .Input("rij: T")
     .Input("nlist: int32")
     .Input("natoms: int32")
+    .Attr("compute_atom_virial: bool = true")
     .Output("virial: T")
     .Output("atom_virial: T");
 
 template<typename Device, typename FPTYPE>
 class ProdVirialSeAOp : public OpKernel {
  public:
-  explicit ProdVirialSeAOp(OpKernelConstruction* context) : OpKernel(context) {}
+  explicit ProdVirialSeAOp(OpKernelConstruction* context) : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("compute_atom_virial", &compute_atom_virial));
+    std::vector<int32> sel_a;
+    OP_REQUIRES_OK(context, context->GetAttr("sel_a", &sel_a));
+    if (!sel_a.empty()) {
+      deepmd::cum_sum (sec_a, sel_a);
+    }
+  }
   void Compute(OpKernelContext* context) override {
       deepmd::safe_compute(context, [this](OpKernelContext* context) {this->_Compute(context);});
   }
@@ -58,13 +70,15 @@ class ProdVirialSeAOp : public OpKernel {
     OP_REQUIRES (context, (nframes == nlist_tensor.shape().dim_size(0)),    errors::InvalidArgument ("number of samples should match"));
     OP_REQUIRES (context, (nloc * ndescrpt * 3 == in_deriv_tensor.shape().dim_size(1)), errors::InvalidArgument ("number of descriptors should match"));
     OP_REQUIRES (context, (nloc * nnei * 3 == rij_tensor.shape().dim_size(1)),  errors::InvalidArgument ("dim of rij should be nnei * 3"));
+    OP_REQUIRES (context, (sec_a.empty() || sec_a.back() == nnei),  errors::InvalidArgument ("the sum of sel_a should be the number of neighbors"));
     // Create an output tensor
     TensorShape virial_shape ;
     virial_shape.AddDim (nframes);
     virial_shape.AddDim (9);
     TensorShape atom_virial_shape;
     atom_virial_shape.AddDim (nframes);
-    atom_virial_shape.AddDim (9 * nall);
+    // the atomic virial is left empty if not requested
+    atom_virial_shape.AddDim (compute_atom_virial ? 9 * nall : 0);
     int context_output_index = 0;
     Tensor* virial_tensor = NULL;
     OP_REQUIRES_OK(context, context->allocate_output(
@@ -83,6 +97,15 @@ class ProdVirialSeAOp : public OpKernel {
     // flat the tensors
     FPTYPE * p_virial = virial_tensor->flat<FPTYPE>().data();
     FPTYPE * p_atom_virial = atom_virial_tensor->flat<FPTYPE>().data();
+    Tensor atom_virial_buff_tensor;
+    if (!compute_atom_virial && device == "GPU") {
+      // the gpu kernels always scatter into the atomic virial
+      TensorShape atom_virial_buff_shape;
+      atom_virial_buff_shape.AddDim (nframes);
+      atom_virial_buff_shape.AddDim (9 * nall);
+      OP_REQUIRES_OK(context, context->allocate_temp(DataTypeToEnum<FPTYPE>::value, atom_virial_buff_shape, &atom_virial_buff_tensor));
+      p_atom_virial = atom_virial_buff_tensor.flat<FPTYPE>().data();
+    }
     const FPTYPE * p_net_deriv = net_deriv_tensor.flat<FPTYPE>().data();
     const FPTYPE * p_in_deriv = in_deriv_tensor.flat<FPTYPE>().data();
     const FPTYPE * p_rij = rij_tensor.flat<FPTYPE>().data();
@@ -90,7 +113,7 @@ class ProdVirialSeAOp : public OpKernel {
     
     for(int kk = 0; kk < nframes; ++kk){
       FPTYPE * virial = p_virial + kk * 9;
-      FPTYPE * atom_virial = p_atom_virial + kk * nall * 9;
+      FPTYPE * atom_virial = (compute_atom_virial || device == "GPU") ? p_atom_virial + kk * nall * 9 : NULL;
       const FPTYPE * net_deriv = p_net_deriv + kk * nloc * ndescrpt;
       const FPTYPE * in_deriv = p_in_deriv + kk * nloc * ndescrpt * 3;
       const FPTYPE * rij = p_rij + kk * nloc * nnei * 3;
@@ -111,18 +134,22 @@ class ProdVirialSeAOp : public OpKernel {
     else if (device == "CPU") {
       deepmd::prod_virial_a_cpu(    
           virial, atom_virial,
-          net_deriv, in_deriv, rij, nlist, nloc, nall, nnei);
+          net_deriv, in_deriv, rij, nlist, nloc, nall, nnei, sec_a);
     }
     }
   }
  private:
   std::string device;
+  bool compute_atom_virial;
+  std::vector<int> sec_a;
 };
 
 template<typename Device, typename FPTYPE>
 class ProdVirialSeROp : public OpKernel {
  public:
-  explicit ProdVirialSeROp(OpKernelConstruction* context) : OpKernel(context) {}
+  explicit ProdVirialSeROp(OpKernelConstruction* context) : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("compute_atom_virial", &compute_atom_virial));
+  }
   void Compute(OpKernelContext* context) override {
       deepmd::safe_compute(context, [this](OpKernelContext* context) {this->_Compute(context);});
   }
@@ -160,7 +187,8 @@ class ProdVirialSeROp : public OpKernel {
     virial_shape.AddDim (9);
     TensorShape atom_virial_shape;
     atom_virial_shape.AddDim (nframes);
-    atom_virial_shape.AddDim (9 * nall);
+    // the atomic virial is left empty if not requested
+    atom_virial_shape.AddDim (compute_atom_virial ? 9 * nall : 0);
     int context_output_index = 0;
     Tensor* virial_tensor = NULL;
     OP_REQUIRES_OK(context, context->allocate_output(
@@ -179,6 +207,15 @@ class ProdVirialSeROp : public OpKernel {
     // flat the tensors
     FPTYPE * p_virial = virial_tensor->flat<FPTYPE>().data();
     FPTYPE * p_atom_virial = atom_virial_tensor->flat<FPTYPE>().data();
+    Tensor atom_virial_buff_tensor;
+    if (!compute_atom_virial && device == "GPU") {
+      // the gpu kernels always scatter into the atomic virial
+      TensorShape atom_virial_buff_shape;
+      atom_virial_buff_shape.AddDim (nframes);
+      atom_virial_buff_shape.AddDim (9 * nall);
+      OP_REQUIRES_OK(context, context->allocate_temp(DataTypeToEnum<FPTYPE>::value, atom_virial_buff_shape, &atom_virial_buff_tensor));
+      p_atom_virial = atom_virial_buff_tensor.flat<FPTYPE>().data();
+    }
     const FPTYPE * p_net_deriv = net_deriv_tensor.flat<FPTYPE>().data();
     const FPTYPE * p_in_deriv = in_deriv_tensor.flat<FPTYPE>().data();
     const FPTYPE * p_rij = rij_tensor.flat<FPTYPE>().data();
@@ -186,7 +223,7 @@ class ProdVirialSeROp : public OpKernel {
     
     for(int kk = 0; kk < nframes; ++kk){
       FPTYPE * virial = p_virial + kk * 9;
-      FPTYPE * atom_virial = p_atom_virial + kk * nall * 9;
+      FPTYPE * atom_virial = (compute_atom_virial || device == "GPU") ? p_atom_virial + kk * nall * 9 : NULL;
       const FPTYPE * net_deriv = p_net_deriv + kk * nloc * ndescrpt;
       const FPTYPE * in_deriv = p_in_deriv + kk * nloc * ndescrpt * 3;
       const FPTYPE * rij = p_rij + kk * nloc * nnei * 3;
@@ -213,6 +250,7 @@ class ProdVirialSeROp : public OpKernel {
   }
  private:
   std::string device;
+  bool compute_atom_virial;
 };
 
 // Register the CPU kernels.
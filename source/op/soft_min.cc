@@ -92,8 +92,8 @@ class SoftMinSwitchOp : public OpKernel {
     auto sw_value = sw_value_tensor	->matrix<FPTYPE>();
     auto sw_deriv = sw_deriv_tensor	->matrix<FPTYPE>();
 
-    // loop over samples
-#pragma omp parallel for 
+    // loop over samples, a single frame is parallelized over atoms by the kernel
+#pragma omp parallel for if (nframes > 1)
     for (int kk = 0; kk < nframes; ++kk){
       deepmd::soft_min_switch_cpu<FPTYPE>(
 	  &sw_value(kk, 0),
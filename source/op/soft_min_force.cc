@@ -70,7 +70,7 @@ class SoftMinForceOp : public OpKernel {
     auto force = force_tensor->matrix<FPTYPE>();
 
     // loop over samples
-#pragma omp parallel for 
+#pragma omp parallel for if (nframes > 1)
     for (int kk = 0; kk < nframes; ++kk){
       deepmd::soft_min_switch_force_cpu(
 	  &force(kk,0),
@@ -84,7 +84,7 @@ class SoftMinVirialOp : public OpKernel {
     auto atom_virial = atom_virial_tensor->matrix<FPTYPE>();
 
     // loop over samples
-#pragma omp parallel for
+#pragma omp parallel for if (nframes > 1)
     for (int kk = 0; kk < nframes; ++kk){
       deepmd::soft_min_switch_virial_cpu(
 	  &virial(kk,0),
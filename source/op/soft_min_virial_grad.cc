@@ -89,7 +89,7 @@ public:
     auto grad_net	= grad_net_tensor	->matrix<FPTYPE>();
 
     // loop over frames
-#pragma omp parallel for
+#pragma omp parallel for if (nframes > 1)
     for (int kk = 0; kk < nframes; ++kk){
       deepmd::soft_min_switch_virial_grad_cpu(
 	  &grad_net(kk, 0),
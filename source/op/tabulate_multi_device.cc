@@ -1,4 +1,5 @@
 #include "custom_op.h"
+#include "utilities.h"
 #include "tabulate.h"
 
 REGISTER_OP("TabulateFusion")
@@ -32,6 +33,37 @@ REGISTER_OP("TabulateFusionGradGrad")
     .Input("descriptor: T")
     .Output("dz_dy: T");
 
+// the gradient of the descriptor of ProdEnvMatATabulate with respect to descrpt,
+// the environment matrix of the frames (nsamples x nloc * nnei * 4), only the valid
+// neighbors of each type in nlist are visited
+REGISTER_OP("TabulateFusionSeAGrad")
+    .Attr("T: {float, double} = DT_DOUBLE")
+    .Input("table: T")
+    .Input("table_info: T")
+    .Input("descrpt: T")
+    .Input("nlist: int32")
+    .Input("type: int32")
+    .Input("natoms: int32")
+    .Input("dy: T")
+    .Attr("sel_a: list(int)")
+    .Attr("type_one_side: bool = true")
+    .Output("net_deriv: T");
+
+// the gradient of TabulateFusionSeAGrad with respect to dy
+REGISTER_OP("TabulateFusionSeAGradGrad")
+    .Attr("T: {float, double} = DT_DOUBLE")
+    .Input("table: T")
+    .Input("table_info: T")
+    .Input("descrpt: T")
+    .Input("nlist: int32")
+    .Input("type: int32")
+    .Input("natoms: int32")
+    .Input("dz_dy_dem: T")
+    .Input("dy: T")
+    .Attr("sel_a: list(int)")
+    .Attr("type_one_side: bool = true")
+    .Output("dz_dy: T");
+
 template<typename Device, typename FPTYPE>
 class TabulateFusionOp : public OpKernel {
  public:
@@ -234,6 +266,172 @@ private:
     std::string device;
 };
 
+template<typename Device, typename FPTYPE>
+class TabulateFusionSeAGradOp : public OpKernel {
+ public:
+  explicit TabulateFusionSeAGradOp(OpKernelConstruction* context) : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("sel_a", &sel_a));
+    OP_REQUIRES_OK(context, context->GetAttr("type_one_side", &type_one_side));
+    deepmd::cum_sum (sec_a, sel_a);
+  }
+  void Compute(OpKernelContext* context) override {
+      deepmd::safe_compute(context, [this](OpKernelContext* context) {this->_Compute(context);});
+  }
+
+  void _Compute(OpKernelContext* context) {
+    // Grab the input tensor
+    int context_input_index = 0;
+    const Tensor& table_tensor	= context->input(context_input_index++);
+    const Tensor& table_info_tensor = context->input(context_input_index++);
+    const Tensor& descrpt_tensor	= context->input(context_input_index++);
+    const Tensor& nlist_tensor	= context->input(context_input_index++);
+    const Tensor& type_tensor	= context->input(context_input_index++);
+    const Tensor& natoms_tensor	= context->input(context_input_index++);
+    const Tensor& dy_tensor	= context->input(context_input_index++);
+    // set size of the sample
+    OP_REQUIRES (context, (descrpt_tensor.shape().dims() == 2),   errors::InvalidArgument ("Dim of descrpt should be 2"));
+    OP_REQUIRES (context, (nlist_tensor.shape().dims() == 2),     errors::InvalidArgument ("Dim of nlist should be 2"));
+    OP_REQUIRES (context, (type_tensor.shape().dims() == 2),      errors::InvalidArgument ("Dim of type should be 2"));
+    OP_REQUIRES (context, (natoms_tensor.shape().dims() == 1),    errors::InvalidArgument ("Dim of natoms should be 1"));
+    OP_REQUIRES (context, (dy_tensor.shape().dims() == 3),        errors::InvalidArgument ("Dim of dy should be 3"));
+    OP_REQUIRES (context, (natoms_tensor.shape().dim_size(0) >= 3), errors::InvalidArgument ("number of atoms should be larger than (or equal to) 3"));
+    const int * natoms = natoms_tensor.flat<int>().data();
+    const int nloc = natoms[0];
+    const int nall = natoms[1];
+    const int ntypes = natoms_tensor.shape().dim_size(0) - 2;
+    const int nsamples = descrpt_tensor.shape().dim_size(0);
+    const int nnei = sec_a.back();
+    const int nnet = type_one_side ? ntypes : ntypes * ntypes;
+    const int last_layer_size = dy_tensor.shape().dim_size(2);
+    OP_REQUIRES (context, (ntypes == int(sel_a.size())),                          errors::InvalidArgument ("number of types should match the length of sel array"));
+    OP_REQUIRES (context, (nsamples == nlist_tensor.shape().dim_size(0)),         errors::InvalidArgument ("number of samples should match"));
+    OP_REQUIRES (context, (nloc * nnei == nlist_tensor.shape().dim_size(1)),      errors::InvalidArgument ("number of neighbors should match"));
+    OP_REQUIRES (context, (nsamples == type_tensor.shape().dim_size(0)),          errors::InvalidArgument ("number of samples should match"));
+    OP_REQUIRES (context, (nall == type_tensor.shape().dim_size(1)),              errors::InvalidArgument ("number of atoms should match"));
+    OP_REQUIRES (context, (nloc * nnei * 4 == descrpt_tensor.shape().dim_size(1)), errors::InvalidArgument ("number of descriptors should match"));
+    OP_REQUIRES (context, (nsamples * nloc == dy_tensor.shape().dim_size(0)),     errors::InvalidArgument ("number of samples should match"));
+    OP_REQUIRES (context, (4 == dy_tensor.shape().dim_size(1)),                   errors::InvalidArgument ("the second dim of dy should be 4"));
+    OP_REQUIRES (context, (table_tensor.NumElements() % (nnet * 6 * last_layer_size) == 0), errors::InvalidArgument ("size of table should be nnet x nspline x 6 x last_layer_size"));
+    const int nspline = table_tensor.NumElements() / (nnet * 6 * last_layer_size);
+    int context_output_index = 0;
+    Tensor* dy_dem_tensor = NULL;
+    OP_REQUIRES_OK(context, context->allocate_output(
+        context_output_index++,
+	  		descrpt_tensor.shape(),
+	  		&dy_dem_tensor));
+    DeviceFunctor() (
+        device,
+        context->eigen_device<Device>()
+    );
+    OP_REQUIRES (context, (device == "CPU"),                      errors::InvalidArgument ("TabulateFusionSeAGrad is only implemented on CPU"));
+
+    // flat the tensors
+    FPTYPE * dy_dem = dy_dem_tensor->flat<FPTYPE>().data();
+    const FPTYPE * table = table_tensor.flat<FPTYPE>().data();
+    const FPTYPE * table_info = table_info_tensor.flat<FPTYPE>().data();
+    const FPTYPE * em = descrpt_tensor.flat<FPTYPE>().data();
+    const int * nlist = nlist_tensor.flat<int>().data();
+    const int * type = type_tensor.flat<int>().data();
+    const FPTYPE * dy = dy_tensor.flat<FPTYPE>().data();
+
+    for (int ff = 0; ff < nsamples; ++ff) {
+      deepmd::tabulate_fusion_se_a_grad_cpu(
+          dy_dem + ff * nloc * nnei * 4,
+          table, table_info, em + ff * nloc * nnei * 4, nlist + ff * nloc * nnei, type + ff * nall, dy + ff * nloc * 4 * last_layer_size,
+          nloc, nspline, last_layer_size, sec_a, type_one_side);
+    }
+  }
+private:
+    std::vector<int32> sel_a;
+    std::vector<int> sec_a;
+    bool type_one_side;
+    std::string device;
+};
+
+template<typename Device, typename FPTYPE>
+class TabulateFusionSeAGradGradOp : public OpKernel {
+ public:
+  explicit TabulateFusionSeAGradGradOp(OpKernelConstruction* context) : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("sel_a", &sel_a));
+    OP_REQUIRES_OK(context, context->GetAttr("type_one_side", &type_one_side));
+    deepmd::cum_sum (sec_a, sel_a);
+  }
+  void Compute(OpKernelContext* context) override {
+      deepmd::safe_compute(context, [this](OpKernelContext* context) {this->_Compute(context);});
+  }
+
+  void _Compute(OpKernelContext* context) {
+    // Grab the input tensor
+    int context_input_index = 0;
+    const Tensor& table_tensor	= context->input(context_input_index++);
+    const Tensor& table_info_tensor = context->input(context_input_index++);
+    const Tensor& descrpt_tensor	= context->input(context_input_index++);
+    const Tensor& nlist_tensor	= context->input(context_input_index++);
+    const Tensor& type_tensor	= context->input(context_input_index++);
+    const Tensor& natoms_tensor	= context->input(context_input_index++);
+    const Tensor& dz_dy_dem_tensor	= context->input(context_input_index++);
+    const Tensor& dy_tensor	= context->input(context_input_index++);
+    // set size of the sample
+    OP_REQUIRES (context, (descrpt_tensor.shape().dims() == 2),   errors::InvalidArgument ("Dim of descrpt should be 2"));
+    OP_REQUIRES (context, (nlist_tensor.shape().dims() == 2),     errors::InvalidArgument ("Dim of nlist should be 2"));
+    OP_REQUIRES (context, (type_tensor.shape().dims() == 2),      errors::InvalidArgument ("Dim of type should be 2"));
+    OP_REQUIRES (context, (natoms_tensor.shape().dims() == 1),    errors::InvalidArgument ("Dim of natoms should be 1"));
+    OP_REQUIRES (context, (dy_tensor.shape().dims() == 3),        errors::InvalidArgument ("Dim of dy should be 3"));
+    OP_REQUIRES (context, (natoms_tensor.shape().dim_size(0) >= 3), errors::InvalidArgument ("number of atoms should be larger than (or equal to) 3"));
+    const int * natoms = natoms_tensor.flat<int>().data();
+    const int nloc = natoms[0];
+    const int nall = natoms[1];
+    const int ntypes = natoms_tensor.shape().dim_size(0) - 2;
+    const int nsamples = descrpt_tensor.shape().dim_size(0);
+    const int nnei = sec_a.back();
+    const int nnet = type_one_side ? ntypes : ntypes * ntypes;
+    const int last_layer_size = dy_tensor.shape().dim_size(2);
+    OP_REQUIRES (context, (ntypes == int(sel_a.size())),                          errors::InvalidArgument ("number of types should match the length of sel array"));
+    OP_REQUIRES (context, (nsamples == nlist_tensor.shape().dim_size(0)),         errors::InvalidArgument ("number of samples should match"));
+    OP_REQUIRES (context, (nloc * nnei == nlist_tensor.shape().dim_size(1)),      errors::InvalidArgument ("number of neighbors should match"));
+    OP_REQUIRES (context, (nsamples == type_tensor.shape().dim_size(0)),          errors::InvalidArgument ("number of samples should match"));
+    OP_REQUIRES (context, (nall == type_tensor.shape().dim_size(1)),              errors::InvalidArgument ("number of atoms should match"));
+    OP_REQUIRES (context, (nloc * nnei * 4 == descrpt_tensor.shape().dim_size(1)), errors::InvalidArgument ("number of descriptors should match"));
+    OP_REQUIRES (context, (descrpt_tensor.NumElements() == dz_dy_dem_tensor.NumElements()), errors::InvalidArgument ("size of dz_dy_dem should match descrpt"));
+    OP_REQUIRES (context, (nsamples * nloc == dy_tensor.shape().dim_size(0)),     errors::InvalidArgument ("number of samples should match"));
+    OP_REQUIRES (context, (4 == dy_tensor.shape().dim_size(1)),                   errors::InvalidArgument ("the second dim of dy should be 4"));
+    OP_REQUIRES (context, (table_tensor.NumElements() % (nnet * 6 * last_layer_size) == 0), errors::InvalidArgument ("size of table should be nnet x nspline x 6 x last_layer_size"));
+    const int nspline = table_tensor.NumElements() / (nnet * 6 * last_layer_size);
+    int context_output_index = 0;
+    Tensor* dz_dy_tensor = NULL;
+    OP_REQUIRES_OK(context, context->allocate_output(
+        context_output_index++,
+	  		dy_tensor.shape(),
+	  		&dz_dy_tensor));
+    DeviceFunctor() (
+        device,
+        context->eigen_device<Device>()
+    );
+    OP_REQUIRES (context, (device == "CPU"),                      errors::InvalidArgument ("TabulateFusionSeAGradGrad is only implemented on CPU"));
+
+    // flat the tensors
+    FPTYPE * dz_dy = dz_dy_tensor->flat<FPTYPE>().data();
+    const FPTYPE * table = table_tensor.flat<FPTYPE>().data();
+    const FPTYPE * table_info = table_info_tensor.flat<FPTYPE>().data();
+    const FPTYPE * em = descrpt_tensor.flat<FPTYPE>().data();
+    const int * nlist = nlist_tensor.flat<int>().data();
+    const int * type = type_tensor.flat<int>().data();
+    const FPTYPE * dz_dy_dem = dz_dy_dem_tensor.flat<FPTYPE>().data();
+
+    for (int ff = 0; ff < nsamples; ++ff) {
+      deepmd::tabulate_fusion_se_a_grad_grad_cpu(
+          dz_dy + ff * nloc * 4 * last_layer_size,
+          table, table_info, em + ff * nloc * nnei * 4, nlist + ff * nloc * nnei, type + ff * nall, dz_dy_dem + ff * nloc * nnei * 4,
+          nloc, nspline, last_layer_size, sec_a, type_one_side);
+    }
+  }
+private:
+    std::vector<int32> sel_a;
+    std::vector<int> sec_a;
+    bool type_one_side;
+    std::string device;
+};
+
 #define REGISTER_CPU(T)                                                                                 \
 REGISTER_KERNEL_BUILDER(                                                                                \
     Name("TabulateFusion").Device(DEVICE_CPU).TypeConstraint<T>("T").HostMemory("table_info"),          \
@@ -243,7 +441,13 @@ REGISTER_KERNEL_BUILDER(
     TabulateFusionGradOp<CPUDevice, T>);                                                                \
 REGISTER_KERNEL_BUILDER(                                                                                \
     Name("TabulateFusionGradGrad").Device(DEVICE_CPU).TypeConstraint<T>("T").HostMemory("table_info"),  \
-    TabulateFusionGradGradOp<CPUDevice, T>);                                              
+    TabulateFusionGradGradOp<CPUDevice, T>);                                                            \
+REGISTER_KERNEL_BUILDER(                                                                                \
+    Name("TabulateFusionSeAGrad").Device(DEVICE_CPU).TypeConstraint<T>("T").HostMemory("table_info"),   \
+    TabulateFusionSeAGradOp<CPUDevice, T>);                                                             \
+REGISTER_KERNEL_BUILDER(                                                                                \
+    Name("TabulateFusionSeAGradGrad").Device(DEVICE_CPU).TypeConstraint<T>("T").HostMemory("table_info"), \
+    TabulateFusionSeAGradGradOp<CPUDevice, T>);
 REGISTER_CPU(float);
 REGISTER_CPU(double);
 
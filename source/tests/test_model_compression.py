@@ -34,6 +34,7 @@ def _init_models():
     data_file  = str(tests_path / os.path.join("model_compression", "data"))
     frozen_model = str(tests_path / "dp-original.pb")
     compressed_model = str(tests_path / "dp-compressed.pb")
+    fused_model = str(tests_path / "dp-compressed-fused.pb")
     INPUT = str(tests_path / "input.json")
     jdata = j_loader(str(tests_path / os.path.join("model_compression", "input.json")))
     jdata["training"]["training_data"]["systems"] = data_file
@@ -47,9 +48,11 @@ def _init_models():
     np.testing.assert_equal(ret, 0, 'DP freeze failed!')
     ret = _subprocess_run("dp compress " + " -i " + frozen_model + " -o " + compressed_model)
     np.testing.assert_equal(ret, 0, 'DP model compression failed!')
-    return INPUT, frozen_model, compressed_model
+    ret = _subprocess_run("dp compress " + " -i " + frozen_model + " -o " + fused_model + " --fuse-env-mat")
+    np.testing.assert_equal(ret, 0, 'DP model compression with fused environment matrix failed!')
+    return INPUT, frozen_model, compressed_model, fused_model
 
-INPUT, FROZEN_MODEL, COMPRESSED_MODEL = _init_models()
+INPUT, FROZEN_MODEL, COMPRESSED_MODEL, FUSED_MODEL = _init_models()
 
 class TestDeepPotAPBC(unittest.TestCase) :
     @classmethod
@@ -298,6 +301,58 @@ class TestDeepPotALargeBoxNoPBC(unittest.TestCase) :
         np.testing.assert_almost_equal(ff0, ff1, default_places)
         np.testing.assert_almost_equal(ee0, ee1, default_places)
 
+class TestDeepPotAPBCFuseEnvMat(unittest.TestCase) :
+    @classmethod
+    def setUpClass(self):
+        self.dp_compressed = DeepPot(COMPRESSED_MODEL)
+        self.dp_fused = DeepPot(FUSED_MODEL)
+        self.coords = np.array([12.83, 2.56, 2.18,
+                                12.09, 2.87, 2.74,
+                                00.25, 3.32, 1.68,
+                                3.36, 3.00, 1.81,
+                                3.51, 2.51, 2.60,
+                                4.27, 3.22, 1.56])
+        self.atype = [0, 1, 1, 0, 1, 1]
+        self.box = np.array([13., 0., 0., 0., 13., 0., 0., 0., 13.])
+
+    def test_1frame_atm(self):
+        ee0, ff0, vv0, ae0, av0 = self.dp_compressed.eval(self.coords, self.box, self.atype, atomic = True)
+        ee1, ff1, vv1, ae1, av1 = self.dp_fused.eval(self.coords, self.box, self.atype, atomic = True)
+        # check shape of the returns
+        nframes = 1
+        natoms = len(self.atype)
+        self.assertEqual(ee1.shape, (nframes,1))
+        self.assertEqual(ff1.shape, (nframes,natoms,3))
+        self.assertEqual(vv1.shape, (nframes,9))
+        self.assertEqual(ae1.shape, (nframes,natoms,1))
+        self.assertEqual(av1.shape, (nframes,natoms,9))
+        # check values
+        np.testing.assert_almost_equal(ff0, ff1, default_places)
+        np.testing.assert_almost_equal(ae0, ae1, default_places)
+        np.testing.assert_almost_equal(av0, av1, default_places)
+        np.testing.assert_almost_equal(ee0, ee1, default_places)
+        np.testing.assert_almost_equal(vv0, vv1, default_places)
+
+    def test_2frame_atm(self):
+        coords2 = np.concatenate((self.coords, self.coords))
+        box2 = np.concatenate((self.box, self.box))
+        ee0, ff0, vv0, ae0, av0 = self.dp_compressed.eval(coords2, box2, self.atype, atomic = True)
+        ee1, ff1, vv1, ae1, av1 = self.dp_fused.eval(coords2, box2, self.atype, atomic = True)
+        # check shape of the returns
+        nframes = 2
+        natoms = len(self.atype)
+        self.assertEqual(ee1.shape, (nframes,1))
+        self.assertEqual(ff1.shape, (nframes,natoms,3))
+        self.assertEqual(vv1.shape, (nframes,9))
+        self.assertEqual(ae1.shape, (nframes,natoms,1))
+        self.assertEqual(av1.shape, (nframes,natoms,9))
+        # check values
+        np.testing.assert_almost_equal(ff0, ff1, default_places)
+        np.testing.assert_almost_equal(ae0, ae1, default_places)
+        np.testing.assert_almost_equal(av0, av1, default_places)
+        np.testing.assert_almost_equal(ee0, ee1, default_places)
+        np.testing.assert_almost_equal(vv0, vv1, default_places)
+
 class TestDeepPotAPBCExcludeTypes(unittest.TestCase) :
     @classmethod
     def setUpClass(self):
@@ -317,6 +372,7 @@ class TestDeepPotAPBCExcludeTypes(unittest.TestCase) :
         _file_delete(INPUT)
         _file_delete(FROZEN_MODEL)
         _file_delete(COMPRESSED_MODEL)
+        _file_delete(FUSED_MODEL)
         _file_delete("out.json")
         _file_delete("compress.json")
         _file_delete("checkpoint")
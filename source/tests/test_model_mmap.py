@@ -0,0 +1,86 @@
+import os,sys,platform,shutil,struct
+import numpy as np
+import unittest
+
+from deepmd.env import tf
+from common import tests_path
+from infer.convert2pb import convert_pbtxt_to_pb
+from deepmd.utils.convert import convert_pb_to_mmap, MEMMAPPED_PACKAGE_DEFAULT_GRAPH_DEF, MEMMAPPED_TENSOR_ALIGNMENT
+from tensorflow.core.util import memmapped_file_system_pb2
+
+class TestModelMmap(unittest.TestCase) :
+    @classmethod
+    def setUpClass(self):
+        self.pb_model = str(tests_path / "deeppot-mmap-in.pb")
+        self.mmap_model = str(tests_path / "deeppot-mmap.pb")
+        convert_pbtxt_to_pb(str(tests_path / os.path.join("infer","deeppot.pbtxt")), self.pb_model)
+        convert_pb_to_mmap(self.pb_model, self.mmap_model, min_conversion_size = 64)
+
+    @classmethod
+    def tearDownClass(self):
+        os.remove(self.pb_model)
+        os.remove(self.mmap_model)
+
+    def test_package(self):
+        with open(self.mmap_model, 'rb') as fp:
+            content = fp.read()
+        # the last 8 bytes store the offset of the directory
+        offset = struct.unpack('<Q', content[-8:])[0]
+        directory = memmapped_file_system_pb2.MemmappedFileSystemDirectory()
+        directory.ParseFromString(content[offset:-8])
+        regions = {}
+        for ee in directory.element:
+            regions[ee.name] = content[ee.offset:ee.offset+ee.length]
+        self.assertEqual(directory.element[-1].name, MEMMAPPED_PACKAGE_DEFAULT_GRAPH_DEF)
+        # offsets are sorted as required by the reader
+        offsets = [ee.offset for ee in directory.element]
+        self.assertEqual(offsets, sorted(offsets))
+        self.assertEqual(len(set(offsets)), len(offsets))
+        graph_def = tf.GraphDef()
+        graph_def.ParseFromString(regions[MEMMAPPED_PACKAGE_DEFAULT_GRAPH_DEF])
+        ref_graph_def = tf.GraphDef()
+        with open(self.pb_model, 'rb') as fp:
+            ref_graph_def.ParseFromString(fp.read())
+        ref_nodes = {nn.name: nn for nn in ref_graph_def.node}
+        self.assertEqual(len(graph_def.node), len(ref_graph_def.node))
+        nconverted = 0
+        for nn in graph_def.node:
+            if nn.op != 'ImmutableConst':
+                continue
+            nconverted += 1
+            region_name = nn.attr['memory_region_name'].s.decode()
+            for ee in directory.element:
+                if ee.name == region_name:
+                    self.assertEqual(ee.offset % MEMMAPPED_TENSOR_ALIGNMENT, 0)
+            ref_value = tf.make_ndarray(ref_nodes[nn.name].attr['value'].tensor)
+            value = np.frombuffer(regions[region_name], dtype = ref_value.dtype).reshape(ref_value.shape)
+            np.testing.assert_array_equal(value, ref_value)
+            self.assertEqual(nn.attr['dtype'].type, ref_nodes[nn.name].attr['dtype'].type)
+        self.assertGreater(nconverted, 0)
+        # the model attributes are kept in the graph
+        for nn in graph_def.node:
+            if nn.name in ['descrpt_attr/rcut', 'descrpt_attr/ntypes', 'model_attr/tmap', 'model_attr/model_version']:
+                self.assertEqual(nn.op, 'Const')
+
+    def test_scalars_kept(self):
+        # no size threshold, the scalars are still kept in the graph
+        mmap_model = str(tests_path / "deeppot-mmap-all.pb")
+        convert_pb_to_mmap(self.pb_model, mmap_model, min_conversion_size = 0)
+        with open(mmap_model, 'rb') as fp:
+            content = fp.read()
+        os.remove(mmap_model)
+        offset = struct.unpack('<Q', content[-8:])[0]
+        directory = memmapped_file_system_pb2.MemmappedFileSystemDirectory()
+        directory.ParseFromString(content[offset:-8])
+        ee = directory.element[-1]
+        self.assertEqual(ee.name, MEMMAPPED_PACKAGE_DEFAULT_GRAPH_DEF)
+        graph_def = tf.GraphDef()
+        graph_def.ParseFromString(content[ee.offset:ee.offset+ee.length])
+        nconverted = 0
+        for nn in graph_def.node:
+            if nn.name in ['descrpt_attr/rcut', 'descrpt_attr/ntypes', 'fitting_attr/dfparam', 'fitting_attr/daparam']:
+                self.assertEqual(nn.op, 'Const')
+            if nn.op == 'ImmutableConst':
+                nconverted += 1
+                self.assertGreater(len(nn.attr['shape'].shape.dim), 0)
+        self.assertGreater(nconverted, 0)
@@ -0,0 +1,84 @@
+import dpdata,os,sys,unittest
+import numpy as np
+from deepmd.env import tf
+from common import Data, gen_data, del_data, j_loader
+
+from deepmd.utils.data_system import DataSystem
+from deepmd.descriptor import DescrptSeAEf
+from deepmd.fit import EnerFitting
+from deepmd.model import EnerModel
+from deepmd.common import j_must_have
+
+GLOBAL_ENER_FLOAT_PRECISION = tf.float64
+GLOBAL_TF_FLOAT_PRECISION = tf.float64
+GLOBAL_NP_FLOAT_PRECISION = np.float64
+
+class TestModel(tf.test.TestCase):
+    def setUp(self) :
+        gen_data()
+
+    def tearDown(self):
+        del_data()
+
+    def test_model(self):
+        jfile = 'water_se_a.json'
+        jdata = j_loader(jfile)
+
+        systems = j_must_have(jdata, 'systems')
+        set_pfx = j_must_have(jdata, 'set_prefix')
+        batch_size = 1
+        test_size = 1
+        rcut = j_must_have (jdata['model']['descriptor'], 'rcut')
+        
+        data = DataSystem(systems, set_pfx, batch_size, test_size, rcut, run_opt = None)
+        
+        test_data = data.get_test ()
+        numb_test = 1
+
+        jdata['model']['descriptor'].pop('type', None)        
+        descrpt = DescrptSeAEf(**jdata['model']['descriptor'], uniform_seed=True)
+        jdata['model']['fitting_net']['descrpt'] = descrpt
+        fitting = EnerFitting(**jdata['model']['fitting_net'], uniform_seed=True)
+        model = EnerModel(descrpt, fitting)
+
+        t_coord            = tf.placeholder(GLOBAL_TF_FLOAT_PRECISION, [None], name='i_coord')
+        t_type             = tf.placeholder(tf.int32,   [None], name='i_type')
+        t_natoms           = tf.placeholder(tf.int32,   [model.ntypes+2], name='i_natoms')
+        t_box              = tf.placeholder(GLOBAL_TF_FLOAT_PRECISION, [None, 9], name='i_box')
+        t_mesh             = tf.placeholder(tf.int32,   [None], name='i_mesh')
+        t_efield           = tf.placeholder(GLOBAL_TF_FLOAT_PRECISION, [None], name='i_efield')
+
+        # the force and virial are built by the DescrptSeA.prod_force_virial
+        # inherited by the lower descriptors of se_a_ef
+        model_pred \
+            = model.build (t_coord, 
+                           t_type, 
+                           t_natoms, 
+                           t_box, 
+                           t_mesh,
+                           {'efield': t_efield},
+                           suffix = "se_a_ef", 
+                           reuse = False)
+        energy = model_pred['energy']
+        force  = model_pred['force']
+        virial = model_pred['virial']
+
+        natoms = test_data['natoms_vec'][0]
+        efield = np.tile([0., 0., 1.], natoms)
+        feed_dict_test = {t_coord:         np.reshape(test_data['coord']    [:numb_test, :], [-1]),
+                          t_box:           test_data['box']                 [:numb_test, :],
+                          t_type:          np.reshape(test_data['type']     [:numb_test, :], [-1]),
+                          t_natoms:        test_data['natoms_vec'],
+                          t_mesh:          test_data['default_mesh'],
+                          t_efield:        efield}
+
+        sess = self.test_session().__enter__()
+        sess.run(tf.global_variables_initializer())
+        [e, f, v] = sess.run([energy, force, virial], 
+                             feed_dict = feed_dict_test)
+
+        self.assertEqual(e.size, numb_test)
+        self.assertEqual(f.size, numb_test * natoms * 3)
+        self.assertEqual(v.size, numb_test * 9)
+        # the descriptor only depends on the relative positions, the net force vanishes
+        np.testing.assert_almost_equal(np.sum(f.reshape([-1, 3]), axis = 0), np.zeros(3), 10)
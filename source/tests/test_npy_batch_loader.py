@@ -0,0 +1,118 @@
+import os,sys,shutil
+import numpy as np
+import unittest
+from unittest import mock
+
+from deepmd.env import tf
+from deepmd.utils.data import DeepmdData
+from deepmd.env import GLOBAL_NP_FLOAT_PRECISION
+
+if GLOBAL_NP_FLOAT_PRECISION == np.float32 :
+    places = 6
+else:
+    places = 12
+
+class TestNpyBatchLoader(unittest.TestCase):
+    def setUp(self):
+        self.data_name = 'test_npy_batch_loader'
+        self.natoms = 5
+        # the atoms are sorted by type, so the atomic items are read through the idx_map
+        self.atom_type = np.array([1, 0, 1, 0, 0])
+        self.set_nframes = [7, 5]
+        self.batch_size = 3
+        os.makedirs(self.data_name, exist_ok = True)
+        np.savetxt(os.path.join(self.data_name, 'type.raw'), self.atom_type, fmt = '%d')
+        rng = np.random.RandomState(10)
+        for ss, nframes in enumerate(self.set_nframes):
+            set_dir = os.path.join(self.data_name, 'set.%03d' % ss)
+            os.makedirs(set_dir, exist_ok = True)
+            np.save(os.path.join(set_dir, 'coord.npy'), rng.random_sample([nframes, self.natoms * 3]))
+            np.save(os.path.join(set_dir, 'box.npy'), rng.random_sample([nframes, 9]))
+            # the energies are saved as a 1-d array
+            np.save(os.path.join(set_dir, 'energy.npy'), rng.random_sample([nframes]))
+            np.save(os.path.join(set_dir, 'force.npy'), rng.random_sample([nframes, self.natoms * 3]).astype(np.float32))
+        # only the first set has the atomic energies
+        np.save(os.path.join(self.data_name, 'set.000', 'atom_ener.npy'), rng.random_sample([self.set_nframes[0], self.natoms]))
+
+    def tearDown(self):
+        shutil.rmtree(self.data_name)
+
+    def _data(self, force_must = False):
+        return DeepmdData(self.data_name, trn_all_set = True)\
+            .add('energy', 1, atomic = False, must = False, high_prec = True)\
+            .add('force', 3, atomic = True, must = force_must, high_prec = False)\
+            .add('atom_ener', 1, atomic = True, must = False, high_prec = False)
+
+    def _run_op(self, data, nbatches, **kwargs):
+        graph = tf.Graph()
+        with graph.as_default():
+            batch = data.get_batch_op(self.batch_size, **kwargs)
+        ret = []
+        with tf.Session(graph = graph) as sess:
+            for ii in range(nbatches):
+                ret.append(sess.run(batch))
+        return ret
+
+    def test_get_batch(self):
+        nbatches = 8
+        # the frames are taken in the order of the files by both
+        with mock.patch('deepmd.utils.random.shuffle'):
+            data = self._data()
+            ref = [data.get_batch(self.batch_size) for ii in range(nbatches)]
+        ret = self._run_op(self._data(), nbatches, shuffle = False)
+        # the sets are visited in turn
+        self.assertEqual([rr['find_atom_ener'] for rr in ref[:4]], [1., 1., 0., 1.])
+        for rr, bb in zip(ref, ret):
+            for kk in ['coord', 'box', 'energy', 'force', 'atom_ener']:
+                self.assertEqual(bb[kk].shape, rr[kk].shape)
+                np.testing.assert_almost_equal(bb[kk], rr[kk], places)
+                self.assertEqual(bb['find_' + kk], rr['find_' + kk])
+
+    def test_nthreads(self):
+        nbatches = 10
+        ref = self._run_op(self._data(), nbatches, nthreads = 1, prefetch = 1, seed = 7)
+        for nthreads in [2, 4]:
+            ret = self._run_op(self._data(), nbatches, nthreads = nthreads, prefetch = 3, seed = 7)
+            for rr, bb in zip(ref, ret):
+                for kk in ['coord', 'box', 'energy', 'force', 'atom_ener', 'find_atom_ener']:
+                    np.testing.assert_equal(bb[kk], rr[kk])
+        # another seed gives another order
+        ret = self._run_op(self._data(), nbatches, nthreads = 1, seed = 8)
+        self.assertFalse(all(np.array_equal(rr['coord'], bb['coord']) for rr, bb in zip(ref, ret)))
+
+    def _check_error(self, data):
+        graph = tf.Graph()
+        with graph.as_default():
+            batch = data.get_batch_op(self.batch_size, nthreads = 2)
+        # a hang would be reported as DeadlineExceededError
+        options = tf.RunOptions(timeout_in_ms = 20000)
+        with tf.Session(graph = graph) as sess:
+            for ii in range(2):
+                with self.assertRaises(tf.errors.OpError) as cm:
+                    sess.run(batch, options = options)
+                self.assertNotIsInstance(cm.exception, tf.errors.DeadlineExceededError)
+
+    def test_missing(self):
+        os.remove(os.path.join(self.data_name, 'set.001', 'force.npy'))
+        self._check_error(self._data(force_must = True))
+
+    def test_not_npy(self):
+        with open(os.path.join(self.data_name, 'set.001', 'force.npy'), 'wb') as fp:
+            fp.write(b'not an npy file')
+        self._check_error(self._data())
+
+    def test_truncated(self):
+        path = os.path.join(self.data_name, 'set.000', 'coord.npy')
+        with open(path, 'rb') as fp:
+            content = fp.read()
+        with open(path, 'wb') as fp:
+            fp.write(content[:-8])
+        self._check_error(self._data())
+
+    def test_frame_size(self):
+        np.save(os.path.join(self.data_name, 'set.001', 'force.npy'), np.zeros([self.set_nframes[1], self.natoms * 2]))
+        self._check_error(self._data())
+
+
+if __name__ == '__main__':
+    unittest.main()
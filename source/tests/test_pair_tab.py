@@ -0,0 +1,57 @@
+import os,sys
+import numpy as np
+import unittest
+
+import deepmd.op
+from deepmd.env import tf
+from deepmd.env import op_module
+from deepmd.utils.pair_tab import PairTab
+
+class TestPairTab(tf.test.TestCase):
+    def setUp(self):
+        self.sess = self.test_session().__enter__()
+        # the table starts at 0.5
+        xx = np.arange(0.5, 6, 0.001)
+        yy = 1000/(xx+.5)**6
+        np.savetxt('tab_lower.xvg', np.array([xx, yy]).T)
+        tab_info, tab_data = PairTab('tab_lower.xvg').get()
+        self.tab_info = tf.constant(tab_info, dtype = tf.float64)
+        self.tab_data = tf.constant(tab_data, dtype = tf.float64)
+        # two atoms of one type, neighbors of each other
+        self.sel_a = [1]
+        self.sel_r = [0]
+        self.type = tf.constant([[0, 0]], dtype = tf.int32)
+        self.nlist = tf.constant([[1, 0]], dtype = tf.int32)
+        self.natoms = tf.constant([2, 2, 2], dtype = tf.int32)
+        self.scale = tf.constant([[1., 1.]], dtype = tf.float64)
+
+    def tearDown(self):
+        os.remove('tab_lower.xvg')
+
+    def _pair_tab(self, dist):
+        dr = np.array([dist, 0., 0.])
+        rij = tf.constant(np.concatenate([dr, -dr]).reshape([1, -1]), dtype = tf.float64)
+        return self.sess.run(op_module.pair_tab(self.tab_info,
+                                                self.tab_data,
+                                                self.type,
+                                                rij,
+                                                self.nlist,
+                                                self.natoms,
+                                                self.scale,
+                                                sel_a = self.sel_a,
+                                                sel_r = self.sel_r))
+
+    def test_lower_boundary(self):
+        # the pair closer than the lower boundary does not fail the step,
+        # it is evaluated at the boundary
+        ener, force, virial = self._pair_tab(0.3)
+        ener_b, force_b, virial_b = self._pair_tab(0.5)
+        self.assertTrue(np.all(np.isfinite(ener)))
+        self.assertTrue(np.all(np.isfinite(force)))
+        self.assertGreater(np.abs(ener_b).max(), 0.)
+        np.testing.assert_almost_equal(ener, ener_b, 10)
+        np.testing.assert_almost_equal(force, force_b, 10)
+
+
+if __name__ == '__main__':
+    unittest.main()
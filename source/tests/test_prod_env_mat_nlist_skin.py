@@ -0,0 +1,123 @@
+import os,sys
+import numpy as np
+import unittest
+
+import deepmd.op
+from deepmd.env import tf
+from deepmd.env import op_module
+from deepmd.env import GLOBAL_TF_FLOAT_PRECISION
+from deepmd.env import GLOBAL_NP_FLOAT_PRECISION
+
+if GLOBAL_NP_FLOAT_PRECISION == np.float32 :
+    default_places = 5
+else :
+    default_places = 10
+
+class TestProdEnvMatNlistSkin(unittest.TestCase):
+    """
+    ProdEnvMatA with the skin-cached nlist (DP_NLIST_SKIN) should give the
+    same results as the nlist rebuilt at every evaluation.
+    """
+    def setUp(self):
+        self.natoms = 24
+        self.ntypes = 2
+        self.sel = [40, 40]
+        self.rcut = 3.0
+        self.rcut_smth = 0.5
+        self.skin = 1.0
+        self.dnatoms = [self.natoms, self.natoms, self.natoms // 2, self.natoms - self.natoms // 2]
+        rng = np.random.RandomState(20)
+        self.coord0 = rng.uniform(0., 6., [self.natoms, 3])
+        self.box0 = np.array([6., 0., 0., 0., 6., 0., 0., 0., 6.])
+        self.type0 = np.array([0] * self.dnatoms[2] + [1] * self.dnatoms[3], dtype = np.int32)
+        self.rng = rng
+
+    def _frames(self):
+        # (coord, box, type) of each frame, and whether the cached nlist should be rebuilt
+        coord = self.coord0.copy()
+        box = self.box0.copy()
+        atype = self.type0.copy()
+        frames = [(coord.copy(), box.copy(), atype.copy())]
+        # the atoms move by less than skin / 2, some of them cross the boundary of the box
+        for ii in range(3):
+            coord += self.rng.uniform(-0.12, 0.12, coord.shape)
+            frames.append((coord.copy(), box.copy(), atype.copy()))
+        # one atom moves by more than skin / 2, towards atoms that were not its neighbors
+        coord[0] += np.array([2.5, 1.5, 0.5])
+        frames.append((coord.copy(), box.copy(), atype.copy()))
+        coord += self.rng.uniform(-0.12, 0.12, coord.shape)
+        frames.append((coord.copy(), box.copy(), atype.copy()))
+        # the box changes
+        box *= 1.05
+        frames.append((coord.copy(), box.copy(), atype.copy()))
+        coord += self.rng.uniform(-0.12, 0.12, coord.shape)
+        frames.append((coord.copy(), box.copy(), atype.copy()))
+        # the types of two atoms are swapped, the numbers of atoms of each type are kept
+        atype[[0, -1]] = atype[[-1, 0]]
+        frames.append((coord.copy(), box.copy(), atype.copy()))
+        coord += self.rng.uniform(-0.12, 0.12, coord.shape)
+        frames.append((coord.copy(), box.copy(), atype.copy()))
+        return frames
+
+    def _eval(self, skin, frames):
+        # the skin is read when the kernel is created at the first evaluation of a session
+        graph = tf.Graph()
+        with graph.as_default():
+            tcoord = tf.placeholder(GLOBAL_TF_FLOAT_PRECISION, [None, self.natoms * 3], name='t_coord')
+            tbox = tf.placeholder(GLOBAL_TF_FLOAT_PRECISION, [None, 9], name='t_box')
+            ttype = tf.placeholder(tf.int32, [None, self.natoms], name = "t_type")
+            tnatoms = tf.placeholder(tf.int32, [None], name = "t_natoms")
+            ndescrpt = 4 * sum(self.sel)
+            davg = np.zeros ([self.ntypes, ndescrpt])
+            dstd = np.ones  ([self.ntypes, ndescrpt])
+            outputs = op_module.prod_env_mat_a (
+                tcoord,
+                ttype,
+                tnatoms,
+                tbox,
+                tf.constant(np.zeros(6, dtype = np.int32)),
+                tf.constant(davg.astype(GLOBAL_NP_FLOAT_PRECISION)),
+                tf.constant(dstd.astype(GLOBAL_NP_FLOAT_PRECISION)),
+                rcut_a = -1,
+                rcut_r = self.rcut,
+                rcut_r_smth = self.rcut_smth,
+                sel_a = self.sel,
+                sel_r = [0, 0])
+        old_skin = os.environ.get('DP_NLIST_SKIN')
+        os.environ['DP_NLIST_SKIN'] = str(skin)
+        ret = []
+        try:
+            with tf.Session(graph = graph) as sess:
+                for coord, box, atype in frames:
+                    ret.append(sess.run(outputs, feed_dict = {
+                        tcoord: np.reshape(coord, [1, -1]),
+                        tbox: np.reshape(box, [1, -1]),
+                        ttype: np.reshape(atype, [1, -1]),
+                        tnatoms: self.dnatoms,
+                    }))
+        finally:
+            if old_skin is None:
+                del os.environ['DP_NLIST_SKIN']
+            else:
+                os.environ['DP_NLIST_SKIN'] = old_skin
+        return ret
+
+    def test_cache(self):
+        frames = self._frames()
+        ret_ref = self._eval(0, frames)
+        ret_skin = self._eval(self.skin, frames)
+        self.assertEqual(len(ret_ref), len(frames))
+        self.assertEqual(len(ret_skin), len(frames))
+        for ff in range(len(frames)):
+            em0, em_deriv0, rij0, nlist0 = ret_ref[ff]
+            em1, em_deriv1, rij1, nlist1 = ret_skin[ff]
+            # the frames have neighbors
+            self.assertGreater(np.sum(nlist0 >= 0), 0)
+            np.testing.assert_equal(nlist0, nlist1)
+            np.testing.assert_almost_equal(em0, em1, default_places)
+            np.testing.assert_almost_equal(em_deriv0, em_deriv1, default_places)
+            np.testing.assert_almost_equal(rij0, rij1, default_places)
+
+
+if __name__ == '__main__':
+    unittest.main()
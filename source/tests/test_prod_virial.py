@@ -108,3 +108,63 @@ class TestProdVirial(tf.test.TestCase):
         for ff in range(self.nframes):
             np.testing.assert_almost_equal(dvirial[ff], self.expected_virial, 5)
             np.testing.assert_almost_equal(datom_virial[ff], self.expected_atom_virial, 5)
+
+    def test_prod_virial_no_atom_virial(self):
+        tvirial, tatom_virial \
+            = op_module.prod_virial_se_a(
+                self.tnet_deriv,
+                self.tem_deriv,
+                self.trij,
+                self.tnlist,
+                self.tnatoms, 
+                n_a_sel=self.nnei,
+                n_r_sel=0,
+                compute_atom_virial=False)
+        self.sess.run (tf.global_variables_initializer())
+        dvirial, datom_virial = self.sess.run(
+            [tvirial, tatom_virial],
+            feed_dict = {
+                self.tnet_deriv: self.dnet_deriv,
+                self.tem_deriv: self.dem_deriv,
+                self.trij: self.drij,
+                self.tnlist: self.dnlist,
+                self.tnatoms: self.dnatoms}
+        )
+        self.assertEqual(dvirial.shape, (self.nframes, 9))
+        self.assertEqual(datom_virial.shape, (self.nframes, 0))
+        for ff in range(self.nframes):
+            np.testing.assert_almost_equal(dvirial[ff], self.expected_virial, 5)
+
+    def test_prod_force_virial(self):
+        tforce, tvirial, tatom_virial \
+            = op_module.prod_force_virial_se_a(
+                self.tnet_deriv,
+                self.tem_deriv,
+                self.trij,
+                self.tnlist,
+                self.tnatoms, 
+                n_a_sel=self.nnei,
+                n_r_sel=0)
+        tforce_ref \
+            = op_module.prod_force_se_a(
+                self.tnet_deriv,
+                self.tem_deriv,
+                self.tnlist,
+                self.tnatoms, 
+                n_a_sel=self.nnei,
+                n_r_sel=0)
+        self.sess.run (tf.global_variables_initializer())
+        dforce, dforce_ref, dvirial, datom_virial = self.sess.run(
+            [tforce, tforce_ref, tvirial, tatom_virial],
+            feed_dict = {
+                self.tnet_deriv: self.dnet_deriv,
+                self.tem_deriv: self.dem_deriv,
+                self.trij: self.drij,
+                self.tnlist: self.dnlist,
+                self.tnatoms: self.dnatoms}
+        )
+        self.assertEqual(dforce.shape, (self.nframes, self.nall*3))
+        np.testing.assert_almost_equal(dforce, dforce_ref, 10)
+        for ff in range(self.nframes):
+            np.testing.assert_almost_equal(dvirial[ff], self.expected_virial, 5)
+            np.testing.assert_almost_equal(datom_virial[ff], self.expected_atom_virial, 5)